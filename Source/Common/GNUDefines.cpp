@@ -0,0 +1,36 @@
+/**************************************************************************************************
+	Module:       GNUDefines.cpp
+
+	Utility functions for GCC / Clang platforms. Not built by the Visual Studio project
+**************************************************************************************************/
+
+#if !defined(_MSC_VER)
+
+#include <iostream>
+
+#include "Defines.h"
+#include "GNUDefines.h"
+
+namespace gen
+{
+
+/*------------------------------------------------------------------------------------------------
+	GUI support
+ ------------------------------------------------------------------------------------------------*/
+
+// System message box used to display errors or warnings. Written to stderr
+bool SystemMessageBox
+(
+	const string& sMessage, // Main message to display
+	const string& sCaption, // Caption to display before message
+	const bool    bYesNo    // Question with Yes and No answers instead of OK
+)
+{
+	cerr << sCaption << ": " << sMessage << endl;
+	return !bYesNo;
+}
+
+
+} // namespace gen
+
+#endif // !defined(_MSC_VER)
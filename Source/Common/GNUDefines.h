@@ -0,0 +1,96 @@
+/**************************************************************************************************
+	Module:       GNUDefines.h
+
+	Definitions for GCC / Clang platforms, allowing the platform independent parts of the code
+	(maths, scene data, null render backends) to be built and run headless, e.g. on Linux
+**************************************************************************************************/
+
+#ifndef GEN_GNU_DEFINES_H_INCLUDED
+#define GEN_GNU_DEFINES_H_INCLUDED
+
+#include <stdlib.h>
+#include <string>
+using namespace std;
+
+namespace gen
+{
+
+/*------------------------------------------------------------------------------------------------
+	Compiler settings
+ ------------------------------------------------------------------------------------------------*/
+
+// Check compiler options
+#ifndef __EXCEPTIONS
+	#error "Bad compiler option: C++ exception handling must be enabled"
+#endif
+
+// Function name used by exception guards
+#ifndef __FUNCTION__
+	#define __FUNCTION__ __func__
+#endif
+
+
+/*------------------------------------------------------------------------------------------------
+	Macros
+ ------------------------------------------------------------------------------------------------*/
+
+// Prefix to align a structure or class in memory to a multiple of the given amount
+#define GEN_ALIGN(a) __attribute__((aligned(a)))
+
+
+/*------------------------------------------------------------------------------------------------
+	Constants
+ ------------------------------------------------------------------------------------------------*/
+
+// Define compiler name
+#if defined(__clang__)
+	static const string ksCompiler = "Clang";
+#else
+	static const string ksCompiler = "GCC";
+#endif
+
+
+// String locale
+const string ksPathSeparator = "/";
+const string ksNewline = "\n";
+
+
+/*------------------------------------------------------------------------------------------------
+	Types
+ ------------------------------------------------------------------------------------------------*/
+
+// Typedefs for fixed size types
+typedef signed char        TInt8;
+typedef signed short       TInt16;
+typedef signed int         TInt32;
+typedef signed long long   TInt64;
+
+typedef unsigned char      TUInt8;
+typedef unsigned short     TUInt16;
+typedef unsigned int       TUInt32;
+typedef unsigned long long TUInt64;
+
+typedef float              TFloat32;
+typedef double             TFloat64;
+
+// Microsoft CRT functions used elsewhere
+inline TInt64 _abs64( const TInt64 x ) { return llabs( x ); }
+
+
+/*------------------------------------------------------------------------------------------------
+	GUI support
+ ------------------------------------------------------------------------------------------------*/
+
+// System message box used to display errors or warnings. No GUI is assumed, so the message is
+// written to stderr. Yes/No questions cannot be answered so always return false (No)
+bool SystemMessageBox
+(
+	const string& sMessage,                       // Main message to display
+	const string& sCaption = "TL-Engine Extreme", // Caption to display before message
+	const bool    bYesNo = false                  // Question with Yes and No answers instead of OK
+);
+
+
+} // namespace gen
+
+#endif // GEN_GNU_DEFINES_H_INCLUDED
@@ -0,0 +1,128 @@
+/***************************************************************************************
+	JobSystem.cpp
+
+	Simple job system - a fixed pool of worker threads that run batches of numbered jobs
+****************************************************************************************/
+
+#include "JobSystem.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+
+// Create the given number of worker threads
+CJobSystem::CJobSystem( TUInt32 numWorkers )
+{
+	StartWorkers( numWorkers );
+}
+
+// Create a worker for each hardware thread other than the one in use
+CJobSystem::CJobSystem()
+{
+	TUInt32 numThreads = thread::hardware_concurrency(); // May be 0 if unknown
+	StartWorkers( numThreads > 1 ? numThreads - 1 : 0 );
+}
+
+CJobSystem::~CJobSystem()
+{
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_Quit = true;
+	}
+	m_WorkReady.notify_all();
+	for (TUInt32 worker = 0; worker < m_Workers.size(); ++worker)
+	{
+		m_Workers[worker].join();
+	}
+}
+
+// Create the worker threads
+void CJobSystem::StartWorkers( TUInt32 numWorkers )
+{
+	m_Job = 0;
+	m_NumJobs = 0;
+	m_NextJob = 0;
+	m_NumJobsDone = 0;
+	m_Batch = 0;
+	m_Quit = false;
+	for (TUInt32 worker = 0; worker < numWorkers; ++worker)
+	{
+		m_Workers.push_back( thread( &CJobSystem::WorkerMain, this ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Running jobs
+//-----------------------------------------------------------------------------
+
+// Run jobs numbered 0 to numJobs-1, spread over the workers and this thread, returning when all have finished
+void CJobSystem::Run( TUInt32 numJobs, const function<void( TUInt32 job )>& job )
+{
+	if (numJobs == 0) return;
+
+	// Small batches, or no workers, just run here
+	if (numJobs == 1 || m_Workers.empty())
+	{
+		for (TUInt32 i = 0; i < numJobs; ++i)
+		{
+			job( i );
+		}
+		return;
+	}
+
+	// One batch at a time, a thread submitting while another's batch runs waits here
+	lock_guard<mutex> runLock( m_RunMutex );
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_Job = &job;
+		m_NumJobs = numJobs;
+		m_NextJob = 0;
+		m_NumJobsDone = 0;
+		++m_Batch;
+	}
+	m_WorkReady.notify_all();
+
+	// Help with the batch, then wait for any jobs still running on the workers
+	unique_lock<mutex> lock( m_Mutex );
+	RunJobs( lock );
+	m_WorkDone.wait( lock, [this] { return m_NumJobsDone == m_NumJobs; } );
+	m_Job = 0;
+}
+
+// Worker thread function
+void CJobSystem::WorkerMain()
+{
+	TUInt32 batch = 0;
+	unique_lock<mutex> lock( m_Mutex );
+	while (true)
+	{
+		m_WorkReady.wait( lock, [&] { return m_Quit || m_Batch != batch; } );
+		if (m_Quit) return;
+		batch = m_Batch;
+		RunJobs( lock );
+	}
+}
+
+// Run jobs from the current batch until there are none left. Called with the mutex locked
+void CJobSystem::RunJobs( unique_lock<mutex>& lock )
+{
+	while (m_Job && m_NextJob < m_NumJobs)
+	{
+		const function<void( TUInt32 )>& job = *m_Job;
+		TUInt32 jobNumber = m_NextJob++;
+
+		lock.unlock();
+		job( jobNumber );
+		lock.lock();
+
+		// The batch can't change until this job is counted, so the count is for the right batch
+		if (++m_NumJobsDone == m_NumJobs) m_WorkDone.notify_one();
+	}
+}
+
+
+} // namespace gen
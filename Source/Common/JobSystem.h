@@ -0,0 +1,92 @@
+/***************************************************************************************
+	JobSystem.h
+
+	Simple job system - a fixed pool of worker threads that run batches of numbered jobs.
+	The thread submitting a batch also runs jobs and returns when the whole batch is done
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+class CJobSystem
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	// Create the given number of worker threads. With no workers all jobs are run on the submitting thread
+	CJobSystem( TUInt32 numWorkers );
+
+	// Create a worker for each hardware thread other than the one in use
+	CJobSystem();
+
+	~CJobSystem();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CJobSystem( const CJobSystem& );
+	CJobSystem& operator=( const CJobSystem& );
+
+public:
+	/////////////////////////////////////
+	//	Public interface
+
+	// Number of threads that run jobs, including the submitting thread
+	TUInt32 GetNumThreads()
+	{
+		return static_cast<TUInt32>(m_Workers.size()) + 1;
+	}
+
+	// Run jobs numbered 0 to numJobs-1, spread over the workers and this thread, returning when all have finished.
+	// Jobs may run in any order and at the same time, so must only write to data of their own. Batches submitted from
+	// different threads at once are run one after the other. Must not be called from within a job
+	void Run( TUInt32 numJobs, const function<void( TUInt32 job )>& job );
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Create the worker threads
+	void StartWorkers( TUInt32 numWorkers );
+
+	// Worker thread function
+	void WorkerMain();
+
+	// Run jobs from the current batch until there are none left. Called with the mutex locked, it is unlocked
+	// while each job runs
+	void RunJobs( unique_lock<mutex>& lock );
+
+	vector<thread> m_Workers;
+
+	// Held while a batch is run, so a batch submitted from another thread waits for the current one to finish
+	mutex m_RunMutex;
+
+	// Current batch, protected by the mutex. Jobs are taken by incrementing the next job number (jobs are expected
+	// to be large, so the lock is not contended)
+	mutex                            m_Mutex;
+	const function<void( TUInt32 )>* m_Job;
+	TUInt32                          m_NumJobs;
+	TUInt32                          m_NextJob;
+	TUInt32                          m_NumJobsDone;
+
+	// Batch number increases for each batch, workers wake when it changes
+	condition_variable m_WorkReady;
+	condition_variable m_WorkDone;
+	TUInt32            m_Batch;
+	bool               m_Quit;
+};
+
+
+} // namespace gen
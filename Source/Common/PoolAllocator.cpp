@@ -0,0 +1,81 @@
+/***************************************************************************************
+	PoolAllocator.cpp
+
+	Pool allocator - hands out fixed size blocks carved from large chunks
+****************************************************************************************/
+
+#include "PoolAllocator.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+
+// Create a pool of blocks of at least the given size, allocated from the heap the given number at a time
+CPoolAllocator::CPoolAllocator( TUInt32 blockSize, TUInt32 blocksPerChunk /*= 256*/ )
+{
+	// Blocks must hold the free list pointer, and are rounded up so every block in a chunk is aligned
+	if (blockSize < sizeof(void*)) blockSize = sizeof(void*);
+	m_BlockSize = (blockSize + BlockAlignment - 1) & ~(BlockAlignment - 1);
+	m_BlocksPerChunk = blocksPerChunk;
+	m_FreeList = 0;
+	m_NumAllocated = 0;
+}
+
+// Frees all chunks - any blocks still allocated become invalid
+CPoolAllocator::~CPoolAllocator()
+{
+	for (TUInt32 chunk = 0; chunk < m_Chunks.size(); ++chunk)
+	{
+		delete[] m_Chunks[chunk];
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Allocation
+//-----------------------------------------------------------------------------
+
+// Return an uninitialised block, most recently freed first (still in cache)
+void* CPoolAllocator::Allocate()
+{
+	if (!m_FreeList) AddChunk();
+
+	void* block = m_FreeList;
+	m_FreeList = *static_cast<void**>(block);
+	++m_NumAllocated;
+	return block;
+}
+
+// Return a block to the pool, it must have been allocated from this pool
+void CPoolAllocator::Free( void* block )
+{
+	if (!block) return;
+	*static_cast<void**>(block) = m_FreeList;
+	m_FreeList = block;
+	--m_NumAllocated;
+}
+
+// Allocate another chunk, adding its blocks to the free list
+void CPoolAllocator::AddChunk()
+{
+	TUInt8* chunk = new TUInt8[m_BlocksPerChunk * m_BlockSize + BlockAlignment];
+	m_Chunks.push_back( chunk );
+
+	size_t address = reinterpret_cast<size_t>(chunk);
+	address = (address + BlockAlignment - 1) & ~static_cast<size_t>(BlockAlignment - 1);
+	TUInt8* firstBlock = reinterpret_cast<TUInt8*>(address);
+
+	// Link the blocks so they are handed out in address order
+	for (TUInt32 block = m_BlocksPerChunk; block-- > 0; )
+	{
+		void* blockAddress = firstBlock + block * m_BlockSize;
+		*static_cast<void**>(blockAddress) = m_FreeList;
+		m_FreeList = blockAddress;
+	}
+}
+
+
+} // namespace gen
@@ -0,0 +1,82 @@
+/***************************************************************************************
+	PoolAllocator.h
+
+	Pool allocator - hands out fixed size blocks carved from large chunks, recycling freed
+	blocks through a free list. Allocation and freeing never touch the general-purpose
+	heap once the pool has grown to its working size. Not thread-safe
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+class CPoolAllocator
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	// Create a pool of blocks of at least the given size, allocated from the heap the given number at a time. Blocks
+	// are aligned for SIMD access
+	CPoolAllocator( TUInt32 blockSize, TUInt32 blocksPerChunk = 256 );
+
+	// Frees all chunks - any blocks still allocated become invalid
+	~CPoolAllocator();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CPoolAllocator( const CPoolAllocator& );
+	CPoolAllocator& operator=( const CPoolAllocator& );
+
+public:
+	/////////////////////////////////////
+	//	Public interface
+
+	// Return an uninitialised block, most recently freed first (still in cache)
+	void* Allocate();
+
+	// Return a block to the pool, it must have been allocated from this pool
+	void Free( void* block );
+
+	// Size of each block, and the number of blocks allocated / held by the pool
+	TUInt32 GetBlockSize()
+	{
+		return m_BlockSize;
+	}
+	TUInt32 GetNumAllocated()
+	{
+		return m_NumAllocated;
+	}
+	TUInt32 GetCapacity()
+	{
+		return static_cast<TUInt32>(m_Chunks.size()) * m_BlocksPerChunk;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Alignment of blocks, enough for SSE
+	static const TUInt32 BlockAlignment = 16;
+
+	// Allocate another chunk, adding its blocks to the free list
+	void AddChunk();
+
+	TUInt32 m_BlockSize;
+	TUInt32 m_BlocksPerChunk;
+
+	// Memory allocated from the heap, and the first free block. Each free block holds a pointer to the next
+	vector<TUInt8*> m_Chunks;
+	void*           m_FreeList;
+	TUInt32         m_NumAllocated;
+};
+
+
+} // namespace gen
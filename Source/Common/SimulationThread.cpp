@@ -0,0 +1,129 @@
+/***************************************************************************************
+	SimulationThread.cpp
+
+	Fixed timestep simulation - the real time passed each frame is divided into steps of
+	a fixed length, which are run on a thread of their own while the frame is rendered
+****************************************************************************************/
+
+#include "BaseMath.h"
+#include "CTimer.h"
+#include "SimulationThread.h"
+
+namespace gen
+{
+
+// Most steps run for one frame - after a long pause (e.g. loading or a breakpoint), catching up on every step would
+// make the next frames longer still
+const TUInt32 MaxStepsPerFrame = 5;
+
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+
+// Run the given step function in steps of the given time (seconds), starting pipelined
+CSimulationThread::CSimulationThread( TFloat32 stepTime, const function<void( TFloat32 stepTime )>& step )
+{
+	m_Step = step;
+	m_StepTime = stepTime;
+	m_Accumulator = 0.0f;
+	m_NumSteps = 0;
+	m_StepsRunTime = 0.0f;
+	m_Pipelined = true;
+
+	m_PendingSteps = 0;
+	m_Quit = false;
+	m_Thread = thread( &CSimulationThread::ThreadMain, this );
+}
+
+// Waits for steps still running and stops the thread
+CSimulationThread::~CSimulationThread()
+{
+	Wait();
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_Quit = true;
+	}
+	m_WorkReady.notify_one();
+	m_Thread.join();
+}
+
+
+//-----------------------------------------------------------------------------
+// Running steps
+//-----------------------------------------------------------------------------
+
+// Add the real time passed (seconds) and start the whole steps it covers
+void CSimulationThread::Start( TFloat32 elapsedTime )
+{
+	m_Accumulator += elapsedTime;
+	TUInt32 numSteps = static_cast<TUInt32>(m_Accumulator / m_StepTime);
+	if (numSteps > MaxStepsPerFrame)
+	{
+		m_Accumulator -= (numSteps - MaxStepsPerFrame) * m_StepTime;
+		numSteps = MaxStepsPerFrame;
+	}
+	m_Accumulator = Max( m_Accumulator - numSteps * m_StepTime, 0.0f );
+	m_NumSteps = numSteps;
+	if (numSteps == 0) return;
+
+	if (!m_Pipelined)
+	{
+		RunSteps( numSteps );
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_PendingSteps = numSteps;
+	}
+	m_WorkReady.notify_one();
+}
+
+// Wait for the steps started to finish
+void CSimulationThread::Wait()
+{
+	unique_lock<mutex> lock( m_Mutex );
+	m_WorkDone.wait( lock, [this] { return m_PendingSteps == 0; } );
+}
+
+// Choose whether to run steps on the simulation thread or the calling thread, waiting for steps still running
+void CSimulationThread::SetPipelined( bool pipelined )
+{
+	Wait();
+	m_Pipelined = pipelined;
+}
+
+// Simulation thread function
+void CSimulationThread::ThreadMain()
+{
+	unique_lock<mutex> lock( m_Mutex );
+	while (true)
+	{
+		m_WorkReady.wait( lock, [this] { return m_Quit || m_PendingSteps != 0; } );
+		if (m_Quit) return;
+
+		// Steps run unlocked, nothing else changes the pending steps until they are done
+		TUInt32 numSteps = m_PendingSteps;
+		lock.unlock();
+		RunSteps( numSteps );
+		lock.lock();
+
+		m_PendingSteps = 0;
+		m_WorkDone.notify_one();
+	}
+}
+
+// Run the given number of steps, timing them
+void CSimulationThread::RunSteps( TUInt32 numSteps )
+{
+	CTimer timer;
+	for (TUInt32 step = 0; step < numSteps; ++step)
+	{
+		m_Step( m_StepTime );
+	}
+	m_StepsRunTime = timer.GetTime() * 1000.0f;
+}
+
+
+} // namespace gen
@@ -0,0 +1,112 @@
+/***************************************************************************************
+	SimulationThread.h
+
+	Fixed timestep simulation - the real time passed each frame is divided into steps of
+	a fixed length, which are run on a thread of their own while the frame is rendered
+****************************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+// Runs a step function a whole number of fixed length steps at a time, carrying the time left over to the next frame.
+// When pipelined, Start hands the steps to the simulation thread and returns at once, so the steps for the next frame
+// run while the caller renders the current one - the caller must only use data from the simulation between Wait and
+// the next Start. Otherwise the steps run in Start on the calling thread. The fraction of a step left over gives how
+// far the renderer should interpolate between the states before and after the last step
+class CSimulationThread
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	// Run the given step function in steps of the given time (seconds), starting pipelined
+	CSimulationThread( TFloat32 stepTime, const function<void( TFloat32 stepTime )>& step );
+
+	// Waits for steps still running and stops the thread
+	~CSimulationThread();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CSimulationThread( const CSimulationThread& );
+	CSimulationThread& operator=( const CSimulationThread& );
+
+public:
+	/////////////////////////////////////
+	//	Public interface
+
+	// Add the real time passed (seconds) and start the whole steps it covers. Must be called after Wait. A long pause
+	// is not caught up on, at most a few steps are run and the rest of the time is dropped
+	void Start( TFloat32 elapsedTime );
+
+	// Wait for the steps started to finish
+	void Wait();
+
+	// Choose whether to run steps on the simulation thread or the calling thread, waiting for steps still running
+	void SetPipelined( bool pipelined );
+	bool IsPipelined()
+	{
+		return m_Pipelined;
+	}
+
+	// Fraction of a step that the time given to Start is past the last step, for interpolating between the states
+	// before and after that step
+	TFloat32 GetInterpolation()
+	{
+		return m_Accumulator / m_StepTime;
+	}
+
+	// Length of a step (seconds), the number of steps started by the last Start and the time they took to run (ms),
+	// valid after Wait
+	TFloat32 GetStepTime()
+	{
+		return m_StepTime;
+	}
+	TUInt32 GetNumSteps()
+	{
+		return m_NumSteps;
+	}
+	TFloat32 GetStepsRunTime()
+	{
+		return m_StepsRunTime;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Simulation thread function
+	void ThreadMain();
+
+	// Run the given number of steps, timing them
+	void RunSteps( TUInt32 numSteps );
+
+	function<void( TFloat32 )> m_Step;
+	TFloat32                   m_StepTime;
+	TFloat32                   m_Accumulator;
+	TUInt32                    m_NumSteps;
+	TFloat32                   m_StepsRunTime;
+	bool                       m_Pipelined;
+
+	// Steps for the thread to run, protected by the mutex. The thread wakes when there are steps, and sets the
+	// number back to 0 when they are done
+	thread             m_Thread;
+	mutex              m_Mutex;
+	condition_variable m_WorkReady;
+	condition_variable m_WorkDone;
+	TUInt32            m_PendingSteps;
+	bool               m_Quit;
+};
+
+
+} // namespace gen
@@ -30,6 +30,7 @@ CParseLevel::CParseLevel( CEntityManager* entityManager )
 	m_TemplateType = "";
 	m_TemplateName = "";
 	m_TemplateMesh = "";
+	m_TemplateOccluder = false;
 
 	// Entity state
 	m_EntityType = "";
@@ -38,6 +39,10 @@ CParseLevel::CParseLevel( CEntityManager* entityManager )
 	m_Rot = CVector3::kOrigin;
 	m_Scale = CVector3(1.0f, 1.0f, 1.0f);
 	m_SpinSpeed = 0.0f;
+
+	// Random placement
+	m_RandomSeed = 0;
+	m_EntityIndex = 0;
 }
 
 
@@ -58,6 +63,9 @@ void CParseLevel::StartElt( const string& eltName, SAttribute* attrs )
 	else if (eltName == "Entities")
 	{
 		m_CurrentSection = Entities;
+
+		// Optional seed for random placement
+		m_RandomSeed = static_cast<TUInt32>(GetAttributeInt( attrs, "Seed", 0 ));
 	}
 
 	// Different parsing depending on section currently being read
@@ -109,6 +117,7 @@ void CParseLevel::TemplatesStartElt( const string& eltName, SAttribute* attrs )
 		m_TemplateType = GetAttribute( attrs, "Type" );
 		m_TemplateName = GetAttribute( attrs, "Name" );
 		m_TemplateMesh = GetAttribute( attrs, "Mesh" );
+		m_TemplateOccluder = (GetAttribute( attrs, "Occluder" ) == "true");
 	}
 }
 
@@ -138,6 +147,9 @@ void CParseLevel::EntitiesStartElt( const string& eltName, SAttribute* attrs )
 		m_Scale = CVector3(1.0f, 1.0f, 1.0f);
 
 		m_SpinSpeed = 0.0f;
+
+		// Random stream for this entity
+		m_Random.Seed( m_RandomSeed, m_EntityIndex++ );
 	}
 
 	// Started reading an entity position - get X,Y,Z
@@ -181,9 +193,9 @@ void CParseLevel::EntitiesStartElt( const string& eltName, SAttribute* attrs )
 		float randomX = GetAttributeFloat( attrs, "X" ) * 0.5f;
 		float randomY = GetAttributeFloat( attrs, "Y" ) * 0.5f;
 		float randomZ = GetAttributeFloat( attrs, "Z" ) * 0.5f;
-		m_Pos.x += Random( -randomX, randomX );
-		m_Pos.y += Random( -randomY, randomY );
-		m_Pos.z += Random( -randomZ, randomZ );
+		m_Pos.x += m_Random.GetFloat( -randomX, randomX );
+		m_Pos.y += m_Random.GetFloat( -randomY, randomY );
+		m_Pos.z += m_Random.GetFloat( -randomZ, randomZ );
 	}
 }
 
@@ -208,7 +220,8 @@ void CParseLevel::CreateEntityTemplate()
 	// Initialise the template depending on its type
 
 	// Generic template
-	m_EntityManager->CreateTemplate( m_TemplateType, m_TemplateName, m_TemplateMesh );
+	CEntityTemplate* entityTemplate = m_EntityManager->CreateTemplate( m_TemplateType, m_TemplateName, m_TemplateMesh );
+	entityTemplate->SetOccluder( m_TemplateOccluder );
 }
 
 // Create an entity using data collected from parsed XML elements
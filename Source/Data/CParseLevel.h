@@ -14,6 +14,7 @@ using namespace std;
 
 #include "Defines.h"
 #include "CVector3.h"
+#include "CRandom.h"
 #include "EntityManager.h"
 #include "CParseXML.h"
 
@@ -116,6 +117,7 @@ private:
 	string   m_TemplateType;
 	string   m_TemplateName;
 	string   m_TemplateMesh;
+	bool     m_TemplateOccluder;
 	TUInt32  m_ShipHP;
 	TFloat32 m_ShipMaxSpeed;
 	TFloat32 m_ShipAcceleration;
@@ -131,6 +133,12 @@ private:
 	CVector3 m_Scale;
 
 	TFloat32 m_SpinSpeed;
+
+	// Random placement. Each entity uses its own stream of the level seed (in order of the entities
+	// in the file) so placement is reproducible and independent of the order entities are created
+	TUInt64 m_RandomSeed;
+	TUInt32 m_EntityIndex;
+	CRandom m_Random;
 };
 
 
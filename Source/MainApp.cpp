@@ -13,6 +13,9 @@
 #include "CTimer.h"
 #include "CVector2.h"
 #include "PostProcessPoly.h"
+#include "RenderDeviceD3D10.h"
+#include "RenderCapture.h"
+#include "RenderStats.h"
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
@@ -38,6 +41,13 @@ ID3D10RenderTargetView* BackBufferRenderTarget = NULL;
 // D3DX font for OSD
 ID3DX10Font* OSDFont = NULL;
 
+// Render device used by the scene and post-processing code. Calls pass through the statistics and frame capture
+// devices to the D3D device above
+IRenderDevice* RenderDevice = NULL;
+CRenderStats* RenderStats = NULL;
+CRenderCapture* RenderCapture = NULL;
+CD3D10RenderDevice* D3D10RenderDevice = NULL;
+
 
 //--------------------------------------------------------------------------------------
 // Windows / System Variables
@@ -132,6 +142,14 @@ bool D3DSetup( HWND hWnd )
     if (FAILED(D3DX10CreateFont( g_pd3dDevice, 12, 0, FW_BOLD, 1, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
                                  DEFAULT_QUALITY, DEFAULT_PITCH | FF_DONTCARE, "Arial", &OSDFont ))) return false;
 
+	// Wrap the device for the rest of the app, all objects are created through the capture device so any frame can be
+	// captured. Outside a capture it only keeps how each object was created, contents are read back when a capture
+	// begins
+	D3D10RenderDevice = new CD3D10RenderDevice( g_pd3dDevice, SwapChain, BackBufferRenderTarget, DepthStencilView );
+	RenderCapture = new CRenderCapture( D3D10RenderDevice );
+	RenderStats = new CRenderStats( RenderCapture );
+	RenderDevice = RenderStats;
+
 	return true;
 }
 
@@ -169,6 +187,10 @@ bool ResetDevice( HWND hWnd, bool ToggleFullscreen = false )
 void D3DShutdown()
 {
 	// Release D3D interfaces
+	delete RenderStats;
+	delete RenderCapture;
+	delete D3D10RenderDevice;
+	RenderDevice = NULL;
 	if (g_pd3dDevice)           g_pd3dDevice->ClearState();
 	if (OSDFont)                OSDFont->Release();
 	if (DepthStencilView)       DepthStencilView->Release();
@@ -309,7 +331,7 @@ INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
             }
             else
 			{
-				// Render and update the scene - using variable timing
+				// Render and update the scene - the entities are simulated in fixed steps, overlapping the next render
                 gen::RenderScene();
 				float updateTime = gen::Timer.GetLapTime();
 				gen::UpdateScene( updateTime );
@@ -0,0 +1,253 @@
+/**************************************************************************************************
+	Module:       CRandom.cpp
+
+	Fast random number generator (xoshiro128**), seeded with splitmix64
+**************************************************************************************************/
+
+#if defined(__AVX2__)
+	#include <immintrin.h> // AVX2
+#else
+	#include <emmintrin.h> // SSE2
+#endif
+#include <atomic>
+using namespace std;
+
+#include "CRandom.h"
+
+namespace gen
+{
+
+/*-----------------------------------------------------------------------------------------
+	Helpers
+-----------------------------------------------------------------------------------------*/
+
+// Step of the splitmix64 generator, used to expand seeds into generator states
+inline TUInt64 SplitMix64( TUInt64& x )
+{
+	TUInt64 z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Fill four state words from a seed, stream and lane. Different streams and lanes start from
+// unrelated points in the 2^128 long sequence
+inline void SeedState( TUInt32* state, const TUInt32 stride, const TUInt64 seed, const TUInt32 stream,
+                       const TUInt32 lane )
+{
+	TUInt64 x = seed ^ (static_cast<TUInt64>(stream) * 0xd1342543de82ef95ULL)
+	                 ^ (static_cast<TUInt64>(lane) << 32);
+	TUInt64 a = SplitMix64( x );
+	TUInt64 b = SplitMix64( x );
+	state[0]          = static_cast<TUInt32>(a);
+	state[stride]     = static_cast<TUInt32>(a >> 32);
+	state[stride * 2] = static_cast<TUInt32>(b);
+	state[stride * 3] = static_cast<TUInt32>(b >> 32) | 1; // State must not be all zero
+}
+
+inline TUInt32 RotateLeft( const TUInt32 x, const int k )
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Constructors/Destructors
+-----------------------------------------------------------------------------------------*/
+
+// Default constructor - seed 0, stream 0
+CRandom::CRandom()
+{
+	Seed( 0 );
+}
+
+// Construct with given seed and stream
+CRandom::CRandom( const TUInt64 seed, const TUInt32 stream /*= 0*/ )
+{
+	Seed( seed, stream );
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Seeding
+-----------------------------------------------------------------------------------------*/
+
+// Restart the generator with the given seed and stream
+void CRandom::Seed( const TUInt64 seed, const TUInt32 stream /*= 0*/ )
+{
+	m_Seed = seed;
+	m_Stream = stream;
+	SeedState( m_State, 1, seed, stream, 0 );
+	m_LanesSeeded = false;
+}
+
+// Seed the states used by FillFloats, done on first use
+void CRandom::SeedLanes()
+{
+	for (TUInt32 lane = 0; lane < kiNumLanes; ++lane)
+	{
+		SeedState( &m_LaneStates[0][lane], kiNumLanes, m_Seed, m_Stream, lane + 1 );
+	}
+	m_LanesSeeded = true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Random values
+-----------------------------------------------------------------------------------------*/
+
+// Return random 32-bit unsigned integer, all bits random
+TUInt32 CRandom::GetUInt32()
+{
+	const TUInt32 result = RotateLeft( m_State[1] * 5, 7 ) * 9;
+	const TUInt32 t = m_State[1] << 9;
+
+	m_State[2] ^= m_State[0];
+	m_State[3] ^= m_State[1];
+	m_State[1] ^= m_State[2];
+	m_State[0] ^= m_State[3];
+	m_State[2] ^= t;
+	m_State[3] = RotateLeft( m_State[3], 11 );
+
+	return result;
+}
+
+// Return random integer from a to b (inclusive)
+TInt32 CRandom::GetInt( const TInt32 a, const TInt32 b )
+{
+	// Scale full 32-bit value into range using a multiply rather than a (slow and biased) modulus
+	const TUInt64 range = static_cast<TUInt64>(static_cast<TInt64>(b) - a + 1);
+	return a + static_cast<TInt32>((GetUInt32() * range) >> 32);
+}
+
+
+// Generate eight floats from 0 to 1 (exclusive) from the lane states. The same xoshiro128** step
+// as GetUInt32 for all lanes at once. Multiplies by 5 and 9 are done with shifts and adds as
+// SSE2 has no 32-bit multiply
+void CRandom::GetLaneFloats( TFloat32* values )
+{
+#if defined(__AVX2__)
+	__m256i s0 = _mm256_loadu_si256( reinterpret_cast<__m256i*>(m_LaneStates[0]) );
+	__m256i s1 = _mm256_loadu_si256( reinterpret_cast<__m256i*>(m_LaneStates[1]) );
+	__m256i s2 = _mm256_loadu_si256( reinterpret_cast<__m256i*>(m_LaneStates[2]) );
+	__m256i s3 = _mm256_loadu_si256( reinterpret_cast<__m256i*>(m_LaneStates[3]) );
+
+	__m256i r = _mm256_add_epi32( _mm256_slli_epi32( s1, 2 ), s1 );
+	r = _mm256_or_si256( _mm256_slli_epi32( r, 7 ), _mm256_srli_epi32( r, 25 ) );
+	r = _mm256_add_epi32( _mm256_slli_epi32( r, 3 ), r );
+	const __m256i t = _mm256_slli_epi32( s1, 9 );
+
+	s2 = _mm256_xor_si256( s2, s0 );
+	s3 = _mm256_xor_si256( s3, s1 );
+	s1 = _mm256_xor_si256( s1, s2 );
+	s0 = _mm256_xor_si256( s0, s3 );
+	s2 = _mm256_xor_si256( s2, t );
+	s3 = _mm256_or_si256( _mm256_slli_epi32( s3, 11 ), _mm256_srli_epi32( s3, 21 ) );
+
+	_mm256_storeu_si256( reinterpret_cast<__m256i*>(m_LaneStates[0]), s0 );
+	_mm256_storeu_si256( reinterpret_cast<__m256i*>(m_LaneStates[1]), s1 );
+	_mm256_storeu_si256( reinterpret_cast<__m256i*>(m_LaneStates[2]), s2 );
+	_mm256_storeu_si256( reinterpret_cast<__m256i*>(m_LaneStates[3]), s3 );
+
+	// Top 24 bits to a float from 0 to 1
+	__m256 f = _mm256_cvtepi32_ps( _mm256_srli_epi32( r, 8 ) );
+	_mm256_storeu_ps( values, _mm256_mul_ps( f, _mm256_set1_ps( 1.0f / 16777216.0f ) ) );
+#else
+	// Two halves of four lanes with SSE2
+	for (TUInt32 half = 0; half < kiNumLanes; half += 4)
+	{
+		__m128i s0 = _mm_loadu_si128( reinterpret_cast<__m128i*>(m_LaneStates[0] + half) );
+		__m128i s1 = _mm_loadu_si128( reinterpret_cast<__m128i*>(m_LaneStates[1] + half) );
+		__m128i s2 = _mm_loadu_si128( reinterpret_cast<__m128i*>(m_LaneStates[2] + half) );
+		__m128i s3 = _mm_loadu_si128( reinterpret_cast<__m128i*>(m_LaneStates[3] + half) );
+
+		__m128i r = _mm_add_epi32( _mm_slli_epi32( s1, 2 ), s1 );
+		r = _mm_or_si128( _mm_slli_epi32( r, 7 ), _mm_srli_epi32( r, 25 ) );
+		r = _mm_add_epi32( _mm_slli_epi32( r, 3 ), r );
+		const __m128i t = _mm_slli_epi32( s1, 9 );
+
+		s2 = _mm_xor_si128( s2, s0 );
+		s3 = _mm_xor_si128( s3, s1 );
+		s1 = _mm_xor_si128( s1, s2 );
+		s0 = _mm_xor_si128( s0, s3 );
+		s2 = _mm_xor_si128( s2, t );
+		s3 = _mm_or_si128( _mm_slli_epi32( s3, 11 ), _mm_srli_epi32( s3, 21 ) );
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(m_LaneStates[0] + half), s0 );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(m_LaneStates[1] + half), s1 );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(m_LaneStates[2] + half), s2 );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(m_LaneStates[3] + half), s3 );
+
+		// Top 24 bits to a float from 0 to 1
+		__m128 f = _mm_cvtepi32_ps( _mm_srli_epi32( r, 8 ) );
+		_mm_storeu_ps( values + half, _mm_mul_ps( f, _mm_set1_ps( 1.0f / 16777216.0f ) ) );
+	}
+#endif
+}
+
+// Fill an array with random floats from a to b (exclusive)
+void CRandom::FillFloats( TFloat32* values, const TUInt32 count, const TFloat32 a /*= 0.0f*/,
+                          const TFloat32 b /*= 1.0f*/ )
+{
+	if (!m_LanesSeeded)
+	{
+		SeedLanes();
+	}
+
+	const TFloat32 scale = b - a;
+	TUInt32 value = 0;
+	for (; value + kiNumLanes <= count; value += kiNumLanes)
+	{
+		GetLaneFloats( values + value );
+		for (TUInt32 lane = 0; lane < kiNumLanes; ++lane) // Simple enough for the compiler to vectorise
+		{
+			values[value + lane] = a + scale * values[value + lane];
+		}
+	}
+
+	// Final partial set of values
+	if (value < count)
+	{
+		TFloat32 lastValues[kiNumLanes];
+		GetLaneFloats( lastValues );
+		for (TUInt32 lane = 0; value < count; ++lane, ++value)
+		{
+			values[value] = a + scale * lastValues[lane];
+		}
+	}
+}
+
+
+/*---------------------------------------------------------------------------------------------
+	Per-thread generators
+---------------------------------------------------------------------------------------------*/
+
+// Seed and next stream number for thread generators. The seed may be set while other threads are creating their
+// generators, so both are atomic
+static atomic<TUInt64> ThreadRandomSeed( 0 );
+static atomic<TUInt32> NextThreadStream( 0 );
+
+// Return the stream number for the current thread, assigned once on first use so reseeding the
+// thread's generator with the same seed repeats the same sequence
+static TUInt32 ThreadStream()
+{
+	thread_local TUInt32 stream = NextThreadStream++;
+	return stream;
+}
+
+// Return the random generator for the current thread
+CRandom& ThreadRandom()
+{
+	thread_local CRandom random( ThreadRandomSeed, ThreadStream() );
+	return random;
+}
+
+// Set the seed used by thread random generators
+void SetThreadRandomSeed( const TUInt64 seed )
+{
+	ThreadRandomSeed = seed;
+	ThreadRandom().Seed( seed, ThreadStream() );
+}
+
+
+} // namespace gen
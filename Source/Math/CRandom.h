@@ -0,0 +1,119 @@
+/**************************************************************************************************
+	Module:       CRandom.h
+
+	Fast random number generator (xoshiro128**) as a replacement for rand(). Each generator
+	has its own state, so is safe to use on one thread per instance, and is seeded with a
+	seed and a stream number. The same seed & stream always give the same sequence and
+	different streams give unrelated sequences, so work split across threads can be made
+	reproducible by giving each item of work its own stream. Also supports a bulk fill of
+	floats, eight at a time using SSE2 or AVX2
+**************************************************************************************************/
+
+#ifndef GEN_C_RANDOM_H_INCLUDED
+#define GEN_C_RANDOM_H_INCLUDED
+
+#include "Defines.h"
+
+namespace gen
+{
+
+class CRandom
+{
+	GEN_CLASS( CRandom );
+
+// Concrete class - public access
+public:
+
+	/*-----------------------------------------------------------------------------------------
+		Constructors/Destructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Default constructor - seed 0, stream 0
+	CRandom();
+
+	// Construct with given seed and stream
+	explicit CRandom( const TUInt64 seed, const TUInt32 stream = 0 );
+
+
+	/*-----------------------------------------------------------------------------------------
+		Seeding
+	-----------------------------------------------------------------------------------------*/
+
+	// Restart the generator with the given seed and stream
+	void Seed( const TUInt64 seed, const TUInt32 stream = 0 );
+
+
+	/*-----------------------------------------------------------------------------------------
+		Random values
+	-----------------------------------------------------------------------------------------*/
+
+	// Return random 32-bit unsigned integer, all bits random
+	TUInt32 GetUInt32();
+
+	// Return random integer from a to b (inclusive)
+	TInt32 GetInt( const TInt32 a, const TInt32 b );
+
+	// Return random 32-bit float from 0 to 1 (exclusive)
+	TFloat32 GetFloat()
+	{
+		return static_cast<TFloat32>(GetUInt32() >> 8) * (1.0f / 16777216.0f); // 24-bits, exact in a float
+	}
+
+	// Return random 32-bit float from a to b (exclusive)
+	TFloat32 GetFloat( const TFloat32 a, const TFloat32 b )
+	{
+		return a + (b - a) * GetFloat();
+	}
+
+	// Fill an array with random floats from a to b (exclusive). Values are generated eight at a
+	// time from eight separate streams, so the sequence differs from repeated calls to GetFloat.
+	// Results are identical whichever instruction set is used
+	void FillFloats( TFloat32* values, const TUInt32 count, const TFloat32 a = 0.0f,
+	                 const TFloat32 b = 1.0f );
+
+
+/*-----------------------------------------------------------------------------------------
+	Private interface
+-----------------------------------------------------------------------------------------*/
+private:
+
+	// Number of streams used by FillFloats
+	static const TUInt32 kiNumLanes = 8;
+
+	// Seed the states used by FillFloats, done on first use
+	void SeedLanes();
+
+	// Generate eight floats from 0 to 1 (exclusive) from the lane states
+	void GetLaneFloats( TFloat32* values );
+
+	// Seed and stream, kept to seed the lanes
+	TUInt64 m_Seed;
+	TUInt32 m_Stream;
+
+	// Generator state for single values
+	TUInt32 m_State[4];
+
+	// Generator states for FillFloats - each of the four state words for all eight lanes
+	// together, making it simple to process the lanes in parallel
+	TUInt32 m_LaneStates[4][kiNumLanes];
+	bool    m_LanesSeeded;
+};
+
+
+/*---------------------------------------------------------------------------------------------
+	Per-thread generators
+---------------------------------------------------------------------------------------------*/
+
+// Return the random generator for the current thread. Each thread's generator is seeded with the
+// thread random seed and its own stream number, assigned in order of first use. For results that
+// must be reproducible across runs use a CRandom with a stream per item of work instead
+CRandom& ThreadRandom();
+
+// Set the seed used by thread random generators - reseeds the current thread's generator and
+// affects other threads that have not yet used ThreadRandom
+void SetThreadRandomSeed( const TUInt64 seed );
+
+
+} // namespace gen
+
+#endif // GEN_C_RANDOM_H_INCLUDED
@@ -0,0 +1,770 @@
+/*******************************************
+	PostProcessFrame.cpp
+
+	Scene and post-process rendering for one frame. Uses only the render device interface, so also
+	builds without D3D (e.g. for the FrameBench tool)
+********************************************/
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "BaseMath.h"
+#include "CVector2.h"
+#include "CVector3.h"
+#include "CVector4.h"
+#include "CRandom.h"
+#include "Camera.h"
+#include "Light.h"
+#include "EntityManager.h"
+#include "PostProcessPoly.h"
+#include "ProceduralMaps.h"
+#include "PostProcessPreset.h"
+#include "EffectParams.h"
+#include "EffectParamsDevice.h"
+#include "RenderDevice.h"
+#include "RenderMethod.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Global system variables
+//-----------------------------------------------------------------------------
+
+// Get reference to global variables from another source file
+// Not good practice - these functions should be part of a class with this as a member
+extern IRenderDevice* RenderDevice;
+
+// Folders used for meshes/textures and effect files
+extern const string MediaFolder;
+extern const string ShaderFolder;
+
+// Actual viewport dimensions (fullscreen or windowed)
+extern TUInt32 BackBufferWidth;
+extern TUInt32 BackBufferHeight;
+
+// Scene rendered each frame
+extern CEntityManager EntityManager;
+extern CCamera* MainCamera;
+extern CLight* Lights[];
+extern const SColourRGBA AmbientColour;
+
+
+//*****************************************************************************
+// Post-process data
+//*****************************************************************************
+
+// Post-process presets, each a chain of post-processes with their settings and the plan compiled from them (see
+// PostProcessPreset.h). The current preset is the one rendered and edited
+vector<SPostProcessPreset> PPPresets;
+TUInt32 CurrentPreset = 0;
+
+// Settings of the current preset
+SPostProcessSettings& PPSettings()
+{
+	return PPPresets[CurrentPreset].settings;
+}
+
+// Post-process animation, updated with the scene (see UpdatePostProcesses)
+float BurnLevel = 0.0f;
+float SpiralTimer = 0.0f;
+float HeatHazeTimer = 0.0f;
+float WiggleTimer = 0.0f;
+
+
+
+// Separate effect file for full screen & area post-processes. Not necessary to use a separate file, but convenient given the architecture of this lab
+SRenderEffect* PPEffect;
+
+// Technique pointers for each post-process
+SRenderTechnique* PPTechniques[NumPostProcesses];
+
+// Dual filter blur techniques - not post-processes in their own right, used by the blur and bloom post-processes
+SRenderTechnique* PPDualFilterDownTechnique = NULL;
+SRenderTechnique* PPDualFilterUpTechnique = NULL;
+SRenderTechnique* PPDualFilterUpMapTechnique = NULL;
+
+
+// Will render the scene to a texture in a first pass, then copy that texture to the back buffer in a second post-processing pass
+// So need a texture with two "views": a render target (to render into the texture - 1st pass) and a shader resource (use the rendered texture as a normal texture - 2nd pass)
+SRenderTarget*   SceneRenderTarget = NULL;
+SRenderTarget*   SceneRenderTarget2 = NULL;
+SRenderResource* SceneShaderResource = NULL;
+SRenderResource* SceneShaderResource2 = NULL;
+SRenderTarget*   BloomRenderTarget = NULL;
+SRenderResource* BloomShaderResource = NULL;
+
+// Chain of textures used by the dual filter blur, each half the size of the previous (the first is half the viewport size)
+extern const int MaxDualFilterLevels = 6;
+SRenderTarget*   DualFilterRenderTargets[MaxDualFilterLevels];
+SRenderResource* DualFilterShaderResources[MaxDualFilterLevels];
+TUInt32          DualFilterWidths[MaxDualFilterLevels];
+TUInt32          DualFilterHeights[MaxDualFilterLevels];
+
+// Additional textures used by post-processes
+SRenderResource* NoiseMap = NULL;
+SRenderResource* BurnMap = NULL;
+SRenderResource* DistortMap = NULL;
+
+// The textures above can be generated procedurally rather than loaded from the media folder. The noise map can
+// also be animated, regenerated on a worker thread and uploaded when each new frame is ready
+extern const bool UseProceduralMaps = true;
+extern const TUInt32 ProceduralMapSize = 256;
+CProceduralMapAnimator* NoiseMapAnimator = NULL;
+
+// Variables to link C++ post-process textures to HLSL shader variables (for area / full-screen post-processing)
+SRenderVariable* SceneTextureVar = NULL;
+SRenderVariable* PostProcessMapVar = NULL; // Single shader variable used for the three maps above (noise, burn, distort). Only one is needed at a time
+
+// Post-process shader constants, held in a parameter block so only values that have changed are sent to the effect. Each
+// parameter is referred to by its index in this list, the table below gives the matching HLSL variable and value size
+enum PostProcessParams
+{
+	// Area used for post-processing
+	PPAreaTopLeftParam, PPAreaBottomRightParam, PPAreaDepthParam,
+
+	// Dimensions of the viewport
+	PPViewportWidthParam, PPViewportHeightParam,
+
+	// Individual post-processes
+	TintColourParam, TintColour2Param, NoiseScaleParam, NoiseOffsetParam, DistortLevelParam, BurnLevelParam,
+	SpiralTimerParam, HeatHazeTimerParam, PixelationParam, ColourPalletParam, GaussianBlurSigmaParam,
+	DualFilterHalfPixelParam, DualFilterOffsetParam,
+	BloomThresholdParam, BloomPixelationParam, BloomIntensityParam, BloomOriginalIntensityParam, BloomSaturationParam,
+	BloomOriginalSaturationParam, GameboyPixelsParam, GameboyColourDepthParam, GameboyColourParam,
+	NumPostProcessParams
+};
+
+const SEffectParamDesc PPParamDescs[NumPostProcessParams] =
+{
+	{ "PPAreaTopLeft", 8 }, { "PPAreaBottomRight", 8 }, { "PPAreaDepth", 4 },
+	{ "PPViewportWidth", 4 }, { "PPViewportHeight", 4 },
+	{ "TintColour", 12 }, { "TintColour2", 12 }, { "NoiseScale", 8 }, { "NoiseOffset", 8 }, { "DistortLevel", 4 }, { "BurnLevel", 4 },
+	{ "SpiralTimer", 4 }, { "HeatHazeTimer", 4 }, { "Pixelation", 4 }, { "ColourPallet", 4 }, { "GaussianBlurSigma", 4 },
+	{ "DualFilterHalfPixel", 8 }, { "DualFilterOffset", 4 },
+	{ "BloomThreshold", 4 }, { "BloomPixelation", 4 }, { "BloomIntensity", 4 }, { "BloomOriginalIntensity", 4 }, { "BloomSaturation", 4 },
+	{ "BloomOriginalSaturation", 4 }, { "GameboyPixels", 4 }, { "GameboyColourDepth", 4 }, { "GameboyColour", 12 },
+};
+
+CEffectParamBlock PPParams;
+IEffectParamBackend* PPParamBackend = NULL;
+
+
+//*****************************************************************************
+
+
+//*****************************************************************************
+// Post Processing Setup
+//*****************************************************************************
+
+// Create a texture for a procedural map and fill it with the generated map, including mip-maps
+bool CreateProceduralMap( EProceduralMap map, SRenderResource** mapView )
+{
+	vector<TFloat32> noise( ProceduralMapSize * ProceduralMapSize );
+	vector<TUInt8> pixels( ProceduralMapSize * ProceduralMapSize * 4 );
+	GenerateProceduralMap( map, DefaultProceduralMapSettings( map ), ProceduralMapSize, ProceduralMapSize, 0.0f, &noise[0], &pixels[0] );
+	*mapView = RenderDevice->CreateTexture( ProceduralMapSize, ProceduralMapSize, &pixels[0], true );
+	return *mapView != NULL;
+}
+
+// Prepare resources required for the post-processing pass
+bool PostProcessSetup()
+{
+	// Create the "scene texture" - the texture into which the scene will be rendered in the first pass. Match it to viewport size
+	if (!RenderDevice->CreateRenderTarget( BackBufferWidth, BackBufferHeight, &SceneRenderTarget, &SceneShaderResource )) return false;
+	if (!RenderDevice->CreateRenderTarget( BackBufferWidth, BackBufferHeight, &SceneRenderTarget2, &SceneShaderResource2 )) return false;
+	if (!RenderDevice->CreateRenderTarget( BackBufferWidth, BackBufferHeight, &BloomRenderTarget, &BloomShaderResource )) return false;
+
+	// Create the chain of ever smaller textures used by the dual filter blur
+	for (int level = 0; level < MaxDualFilterLevels; ++level)
+	{
+		DualFilterWidths[level]  = Max( BackBufferWidth  >> (level + 1), 1u );
+		DualFilterHeights[level] = Max( BackBufferHeight >> (level + 1), 1u );
+		if (!RenderDevice->CreateRenderTarget( DualFilterWidths[level], DualFilterHeights[level],
+		                                       &DualFilterRenderTargets[level], &DualFilterShaderResources[level] )) return false;
+	}
+	
+	// Generate or load post-processing support textures
+	if (UseProceduralMaps)
+	{
+		if (!CreateProceduralMap( ProceduralNoise,   &NoiseMap ))   return false;
+		if (!CreateProceduralMap( ProceduralBurn,    &BurnMap ))    return false;
+		if (!CreateProceduralMap( ProceduralDistort, &DistortMap )) return false;
+	}
+	else
+	{
+		if (!(NoiseMap   = RenderDevice->LoadTexture( MediaFolder + "Noise.png" )))   return false;
+		if (!(BurnMap    = RenderDevice->LoadTexture( MediaFolder + "Burn.png" )))    return false;
+		if (!(DistortMap = RenderDevice->LoadTexture( MediaFolder + "Distort.png" ))) return false;
+	}
+
+
+	// Load and compile a separate effect file for post-processes.
+	string fullFileName = ShaderFolder + "PostProcess.fx";
+	PPEffect = RenderDevice->LoadEffect( fullFileName );
+	if (!PPEffect)
+	{
+		return false;
+	}
+
+	// There's an array of post-processing technique names above - get array of post-process techniques matching those names from the compiled effect file
+	for (int pp = 0; pp < NumPostProcesses; pp++)
+	{
+		PPTechniques[pp] = RenderDevice->GetTechnique( PPEffect, PPTechniqueNames[pp] );
+	}
+	PPDualFilterDownTechnique  = RenderDevice->GetTechnique( PPEffect, "PPDualFilterDown" );
+	PPDualFilterUpTechnique    = RenderDevice->GetTechnique( PPEffect, "PPDualFilterUp" );
+	PPDualFilterUpMapTechnique = RenderDevice->GetTechnique( PPEffect, "PPDualFilterUpMap" );
+
+	// Link to HLSL variables in post-process shaders
+	SceneTextureVar      = RenderDevice->GetVariable( PPEffect, "SceneTexture" );
+	PostProcessMapVar    = RenderDevice->GetVariable( PPEffect, "PostProcessMap" );
+
+	// Post-process constants
+	PPParamBackend = new CRenderDeviceParamBackend( PPEffect );
+	if (!PPParams.Initialise( PPParamBackend, PPParamDescs, NumPostProcessParams ))
+	{
+		SystemMessageBox( "Missing variable in PostProcess.fx", "Error" );
+		return false;
+	}
+
+	// Built-in presets
+	const char* presetNames[] = { "Default", "Blur", "Bloom" };
+	const vector<PostProcesses> presetChains[] = { { Copy }, { GaussianBlurHori, GaussianBlurVert }, { Bloom } };
+	PPPresets.resize( 3 );
+	for (TUInt32 preset = 0; preset < PPPresets.size(); ++preset)
+	{
+		PPPresets[preset].name = presetNames[preset];
+		PPPresets[preset].chain = presetChains[preset];
+		CompilePostProcessPlan( &PPPresets[preset] );
+	}
+	CurrentPreset = 0;
+
+	return true;
+}
+
+void PostProcessShutdown()
+{
+	delete PPParamBackend;
+	RenderDevice->ReleaseEffect( PPEffect );
+	RenderDevice->ReleaseResource( DistortMap );
+	RenderDevice->ReleaseResource( BurnMap );
+	RenderDevice->ReleaseResource( NoiseMap );
+	delete NoiseMapAnimator;
+	for (int level = MaxDualFilterLevels - 1; level >= 0; --level)
+	{
+		RenderDevice->ReleaseResource( DualFilterShaderResources[level] );
+		RenderDevice->ReleaseRenderTarget( DualFilterRenderTargets[level] );
+	}
+	RenderDevice->ReleaseResource( BloomShaderResource );
+	RenderDevice->ReleaseRenderTarget( BloomRenderTarget );
+	RenderDevice->ReleaseResource( SceneShaderResource2 );
+	RenderDevice->ReleaseResource( SceneShaderResource );
+	RenderDevice->ReleaseRenderTarget( SceneRenderTarget2 );
+	RenderDevice->ReleaseRenderTarget( SceneRenderTarget );
+}
+
+// Set the top-left, bottom-right and depth coordinates for the area post process to work on for full-screen processing
+// Since all post process code is now area-based, full-screen processing needs to explicitly set up the appropriate full-screen rectangle
+void SetFullScreenPostProcessArea()
+{
+	CVector2 TopLeftUV = CVector2(0.0f, 0.0f); // Top-left and bottom-right in UV space
+	CVector2 BottomRightUV = CVector2(1.0f, 1.0f);
+
+	PPParams.SetRawValue(PPAreaTopLeftParam, &TopLeftUV, 8);
+	PPParams.SetRawValue(PPAreaBottomRightParam, &BottomRightUV, 8);
+	PPParams.SetFloat(PPAreaDepthParam, 0.0f); // Full screen depth set at 0 - in front of everything
+}
+
+// Send any changed post-process constants to the effect then apply the (single) pass of the given technique
+void ApplyPostProcessPass( SRenderTechnique* technique )
+{
+	PPParams.Commit();
+	RenderDevice->ApplyPass( technique, 0 );
+}
+
+// Set the viewport to cover a render target of the given size
+void SetPostProcessViewport( TUInt32 width, TUInt32 height )
+{
+	RenderDevice->SetViewport( width, height );
+}
+
+// Dual filter (kawase) blur of the source texture. Downsamples through the given number of levels of the dual filter
+// textures then upsamples back up to the first level. If a target is given the final upsample to full size is rendered
+// into it, otherwise the blur is left in the first level for the post-process list to upsample (see PostProcessTechnique)
+void DualFilterBlur( SRenderResource* source, SRenderTarget* target, int iterations )
+{
+	iterations = Max( 1, Min( iterations, MaxDualFilterLevels ) );
+
+	// No depth buffer, it doesn't match the size of the smaller levels
+	SetFullScreenPostProcessArea();
+	PPParams.SetFloat( DualFilterOffsetParam, PPSettings().dualFilterOffset );
+	RenderDevice->SetInputLayout( NULL );
+	RenderDevice->SetPrimitiveTopology( TriangleStrip );
+
+	// Downsample, each pass reads the previous level
+	for (int level = 0; level < iterations; ++level)
+	{
+		RenderDevice->SetRenderTarget( DualFilterRenderTargets[level], false );
+		SetPostProcessViewport( DualFilterWidths[level], DualFilterHeights[level] );
+		RenderDevice->SetResourceVariable( SceneTextureVar, level == 0 ? source : DualFilterShaderResources[level - 1] );
+
+		CVector2 halfPixel = CVector2( 0.5f / DualFilterWidths[level], 0.5f / DualFilterHeights[level] );
+		PPParams.SetRawValue( DualFilterHalfPixelParam, &halfPixel, 8 );
+		ApplyPostProcessPass( PPDualFilterDownTechnique );
+		RenderDevice->Draw( 4, 0 );
+	}
+
+	// Upsample back to the first level
+	for (int level = iterations - 2; level >= 0; --level)
+	{
+		RenderDevice->SetRenderTarget( DualFilterRenderTargets[level], false );
+		SetPostProcessViewport( DualFilterWidths[level], DualFilterHeights[level] );
+		RenderDevice->SetResourceVariable( SceneTextureVar, DualFilterShaderResources[level + 1] );
+
+		CVector2 halfPixel = CVector2( 0.5f / DualFilterWidths[level], 0.5f / DualFilterHeights[level] );
+		PPParams.SetRawValue( DualFilterHalfPixelParam, &halfPixel, 8 );
+		ApplyPostProcessPass( PPDualFilterUpTechnique );
+		RenderDevice->Draw( 4, 0 );
+	}
+
+	// Final upsample to full size, or prepare for the post-process list to do it
+	RenderDevice->SetResourceVariable( SceneTextureVar, NULL );
+	ApplyPostProcessPass( PPDualFilterUpTechnique ); // Unbind the last level before it is used again
+	SetPostProcessViewport( BackBufferWidth, BackBufferHeight );
+	CVector2 halfPixel = CVector2( 0.5f / BackBufferWidth, 0.5f / BackBufferHeight );
+	PPParams.SetRawValue( DualFilterHalfPixelParam, &halfPixel, 8 );
+	RenderDevice->SetResourceVariable( PostProcessMapVar, DualFilterShaderResources[0] );
+	if (target)
+	{
+		RenderDevice->SetRenderTarget( target, false );
+		ApplyPostProcessPass( PPDualFilterUpMapTechnique );
+		RenderDevice->Draw( 4, 0 );
+	}
+}
+
+// Render target and shader resource for the buffers used by post-process plans
+SRenderTarget* PostProcessTarget( EPostProcessBuffer buffer )
+{
+	if (buffer == SceneBuffer)  return SceneRenderTarget;
+	if (buffer == SceneBuffer2) return SceneRenderTarget2;
+	return RenderDevice->GetBackBuffer();
+}
+SRenderResource* PostProcessResource( EPostProcessBuffer buffer )
+{
+	return (buffer == SceneBuffer) ? SceneShaderResource : SceneShaderResource2;
+}
+
+// Technique used for the final pass of a plan step - blurs using the dual filter kernel have already been mostly
+// processed in SelectPostProcess and only need the final upsample
+SRenderTechnique* PostProcessTechnique( const SPostProcessStep& step )
+{
+	if (step.kernel == KernelDualFilterBlur)
+	{
+		return PPDualFilterUpMapTechnique;
+	}
+	return PPTechniques[step.postProcess];
+}
+
+//*****************************************************************************
+
+
+//-----------------------------------------------------------------------------
+// Post Process Selection
+//-----------------------------------------------------------------------------
+
+// Set up shaders for a step of a post-process plan (used for full screen and area processing). Multi-pass kernels
+// render all but their final pass here
+void SelectPostProcess( const SPostProcessStep& step )
+{
+	const SPostProcessSettings& settings = PPSettings();
+	switch (step.postProcess)
+	{
+		case Tint:
+		{
+			// Set the colour used to tint the scene
+			PPParams.SetRawValue( TintColourParam, &settings.tintColour, 12 );
+		}
+		break;
+
+		case Tint2:
+		{
+			// Set the colour used to tint the scene
+			PPParams.SetRawValue(TintColourParam, &settings.tint2Colour1, 12);
+			PPParams.SetRawValue(TintColour2Param, &settings.tint2Colour2, 12);
+		}
+		break;
+
+		case GreyNoise:
+		{
+			// Set shader constants - scale and offset for noise. Scaling adjusts how fine the noise is.
+			CVector2 NoiseScale = CVector2( BackBufferWidth / settings.grainSize, BackBufferHeight / settings.grainSize );
+			PPParams.SetRawValue( NoiseScaleParam, &NoiseScale, 8 );
+
+			// The offset is randomised to give a constantly changing noise effect (like tv static)
+			CVector2 RandomUVs;
+			ThreadRandom().FillFloats( &RandomUVs.x, 2 );
+			PPParams.SetRawValue( NoiseOffsetParam, &RandomUVs, 8 );
+
+			// Set noise texture
+			RenderDevice->SetResourceVariable( PostProcessMapVar, NoiseMap );
+		}
+		break;
+
+		case Burn:
+		{
+			// Set the burn level (value from 0 to 1 during animation)
+			PPParams.SetFloat( BurnLevelParam, BurnLevel );
+
+			// Set burn texture
+			RenderDevice->SetResourceVariable( PostProcessMapVar, BurnMap );
+		}
+		break;
+
+		case Distort:
+		{
+			// Set the level of distortion
+			PPParams.SetFloat( DistortLevelParam, settings.distortLevel );
+
+			// Set distort texture
+			RenderDevice->SetResourceVariable( PostProcessMapVar, DistortMap );
+		}
+		break;
+
+		case Spiral:
+		{
+			// Set the amount of spiral - use a tweaked cos wave to animate
+			PPParams.SetFloat( SpiralTimerParam, (1.0f - Cos(SpiralTimer)) * 4.0f );
+			break;
+		}
+
+		case HeatHaze:
+		{
+			// Set the amount of spiral - use a tweaked cos wave to animate
+			PPParams.SetFloat( HeatHazeTimerParam, HeatHazeTimer );
+			break;
+		}
+
+		case Water:
+		{
+			// Set the colour used to tint the scene
+			PPParams.SetRawValue(TintColourParam, &settings.waterColour, 12);
+
+			// Set and increase the amount of spiral - use a tweaked cos wave to animate
+			PPParams.SetFloat(SpiralTimerParam, WiggleTimer);
+			break;
+		}
+
+		case Retro:
+		{
+			PPParams.SetFloat(PixelationParam, settings.pixelation);
+			PPParams.SetFloat(ColourPalletParam, settings.colourDepth);
+			break;
+		}
+		case GaussianBlurHori:
+		case GaussianBlurVert:
+		{
+			PPParams.SetFloat(GaussianBlurSigmaParam, settings.gaussianBlurSigma);
+
+			// Dual filter blurs the whole image in both directions here, the plan step does the final upsample
+			if (step.kernel == KernelDualFilterBlur)
+			{
+				DualFilterBlur(PostProcessResource(step.source), NULL, settings.blurDualFilterIterations);
+			}
+			break;
+		}
+
+		case Bloom:
+		{
+			// settings
+			PPParams.SetFloat(GaussianBlurSigmaParam, settings.bloomStrength);
+			PPParams.SetFloat(BloomThresholdParam, settings.bloomThreshold);
+			PPParams.SetFloat(BloomPixelationParam, settings.bloomPixelation);
+
+			PPParams.SetFloat(BloomIntensityParam, settings.bloomIntensity);
+			PPParams.SetFloat(BloomOriginalIntensityParam, settings.bloomOriginalIntensity);
+			PPParams.SetFloat(BloomSaturationParam, settings.bloomSaturation);
+			PPParams.SetFloat(BloomOriginalSaturationParam, settings.bloomOriginalSaturation);
+
+			// The other scene buffer is free to use as working space for the gaussian blur
+			EPostProcessBuffer scratch = (step.source == SceneBuffer) ? SceneBuffer2 : SceneBuffer;
+
+			// draw bloom selection to bloom tex
+			{
+				// Select the back buffer to use for rendering (will ignore depth-buffer for full-screen quad) and select scene texture for use in shader
+				// No need to clear the back-buffer, we're going to overwrite it all
+				RenderDevice->SetRenderTarget(BloomRenderTarget, true);
+				RenderDevice->SetResourceVariable( SceneTextureVar, PostProcessResource(step.source) );
+
+				// Prepare shader settings for the current full screen filter
+				SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
+
+				// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
+				// Select technique to match currently selected post-process
+				RenderDevice->SetInputLayout(NULL);
+				RenderDevice->SetPrimitiveTopology(TriangleStrip);
+				ApplyPostProcessPass(PPTechniques[BloomSelection]);
+				RenderDevice->Draw(4, 0);
+			}
+
+			// draw blur to scene tex
+			if (step.kernel == KernelBloomGaussian)
+			{
+				RenderDevice->SetRenderTarget(PostProcessTarget(scratch), true);
+
+				RenderDevice->SetResourceVariable( SceneTextureVar, BloomShaderResource );
+
+				// Prepare shader settings for the current full screen filter
+				SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
+
+				// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
+				// Select technique to match currently selected post-process
+				RenderDevice->SetInputLayout(NULL);
+				RenderDevice->SetPrimitiveTopology(TriangleStrip);
+				ApplyPostProcessPass(PPTechniques[GaussianBlurHori]);
+				RenderDevice->Draw(4, 0);
+			}
+			// draw final blur to bloom tex
+			if (step.kernel == KernelBloomGaussian)
+			{
+				RenderDevice->SetRenderTarget(BloomRenderTarget, true);
+				RenderDevice->SetResourceVariable( SceneTextureVar, PostProcessResource(scratch) );
+
+				// Prepare shader settings for the current full screen filter
+				SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
+
+				// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
+				// Select technique to match currently selected post-process
+				RenderDevice->SetInputLayout(NULL);
+				RenderDevice->SetPrimitiveTopology(TriangleStrip);
+				ApplyPostProcessPass(PPTechniques[GaussianBlurVert]);
+				RenderDevice->Draw(4, 0);
+			}
+
+			// or dual filter blur of the bloom tex back into itself
+			if (step.kernel == KernelBloomDualFilter)
+			{
+				DualFilterBlur(BloomShaderResource, BloomRenderTarget, settings.bloomDualFilterIterations);
+			}
+
+			RenderDevice->SetResourceVariable( PostProcessMapVar, BloomShaderResource );
+			break;
+		}
+
+		case Gameboy:
+		{
+			PPParams.SetFloat(GameboyPixelsParam, settings.gameboyPixels);
+			PPParams.SetFloat(GameboyColourDepthParam, settings.gameboyColourDepth);
+			PPParams.SetRawValue(GameboyColourParam, &settings.gameboyColour, 12);
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+// Set up shaders for a single pass post-process outside of a plan (e.g. area post-processes)
+void SelectPostProcess( PostProcesses filter )
+{
+	SPostProcessStep step;
+	step.postProcess = filter;
+	step.kernel = KernelTechnique;
+	step.source = SceneBuffer;
+	step.target = BackBuffer;
+	SelectPostProcess( step );
+}
+
+// Sets in the shaders the top-left, bottom-right and depth coordinates of the area post process to work on
+// Requires a world point at the centre of the area, the width and height of the area (in world units), an optional depth offset (to pull or push 
+// the effect of the post-processing into the scene). Also requires the camera, since we are creating a camera facing quad.
+void SetPostProcessArea( CCamera* camera, CVector3 areaCentre, float width, float height, float depthOffset = 0.0f )
+{
+	// Get the area centre in camera space.
+	CVector4 cameraSpaceCentre = CVector4(areaCentre, 1.0f) * camera->GetViewMatrix();
+
+	// Get top-left and bottom-right of camera-facing area of required dimensions 
+	cameraSpaceCentre.x -= width / 2;
+	cameraSpaceCentre.y += height / 2; // Careful, y axis goes up here
+	CVector4 cameraTopLeft = cameraSpaceCentre;
+	cameraSpaceCentre.x += width;
+	cameraSpaceCentre.y -= height;
+	CVector4 cameraBottomRight = cameraSpaceCentre;
+
+	// Get the projection space coordinates of the post process area
+	CVector4 projTopLeft     = cameraTopLeft     * camera->GetProjMatrix();
+	CVector4 projBottomRight = cameraBottomRight * camera->GetProjMatrix();
+
+	// Perform perspective divide to get coordinates in normalised viewport space (-1.0 to 1.0 from left->right and bottom->top of the viewport)
+	projTopLeft.x /= projTopLeft.w;
+	projTopLeft.y /= projTopLeft.w;
+	projBottomRight.x /= projBottomRight.w;
+	projBottomRight.y /= projBottomRight.w;
+
+	// Also do perspective divide on z to get depth buffer value for the area. Add the required depth offset (using an approximation)
+	projTopLeft.z += depthOffset;
+	projTopLeft.w += depthOffset;
+	projTopLeft.z /= projTopLeft.w;
+
+	// Convert the x & y coordinates to UV space (0 -> 1, y flipped). This extra step makes the shader work simpler
+	projTopLeft.x =	 projTopLeft.x / 2.0f + 0.5f;
+	projTopLeft.y = -projTopLeft.y / 2.0f + 0.5f;
+	projBottomRight.x =	 projBottomRight.x / 2.0f + 0.5f;
+	projBottomRight.y = -projBottomRight.y / 2.0f + 0.5f;
+
+	// Send the values calculated to the shader. The post-processing vertex shader needs only these values to
+	// create the vertex buffer for the quad to render, we don't need to create a vertex buffer for post-processing at all.
+	PPParams.SetRawValue( PPAreaTopLeftParam, &projTopLeft.Vector2(), 8 );         // Viewport space x & y for top-left
+	PPParams.SetRawValue( PPAreaBottomRightParam, &projBottomRight.Vector2(), 8 ); // Same for bottom-right
+	PPParams.SetFloat( PPAreaDepthParam, projTopLeft.z ); // Depth buffer value for area
+
+	// ***NOTE*** Most applications you will see doing post-processing would continue here to create a vertex buffer in C++, and would
+	// not use the unusual vertex shader that you will see in the .fx file here. That might (or might not) give a tiny performance boost,
+	// but very tiny, if any (only a handful of vertices affected). I prefer this method because I find it cleaner and more flexible overall. 
+}
+
+
+//-----------------------------------------------------------------------------
+// Frame rendering
+//-----------------------------------------------------------------------------
+
+// Render the scene and post-processing for one frame, everything except the UI
+void RenderFrame()
+{
+	// Setup the viewport - defines which part of the back-buffer we will render to (usually all of it)
+	RenderDevice->SetViewport( BackBufferWidth, BackBufferHeight );
+
+	PPParams.ResetStats();
+	PPParams.SetFloat(PPViewportWidthParam, static_cast<float>(BackBufferWidth));
+	PPParams.SetFloat(PPViewportHeightParam, static_cast<float>(BackBufferHeight));
+
+	//------------------------------------------------
+	// SCENE RENDER PASS - rendering to a texture
+
+	// Specify that we will render to the scene texture in this first pass (rather than the backbuffer), will share the depth/stencil buffer with the backbuffer though
+	RenderDevice->SetRenderTarget( SceneRenderTarget, true );
+
+	// Clear the texture and the depth buffer
+	RenderDevice->ClearRenderTarget( SceneRenderTarget, &AmbientColour.r );
+	RenderDevice->ClearRenderTarget( SceneRenderTarget2, &AmbientColour.r);
+	RenderDevice->ClearDepthBuffer();
+
+	// Prepare camera
+	MainCamera->SetAspect( static_cast<TFloat32>(BackBufferWidth) / BackBufferHeight );
+	MainCamera->CalculateMatrices();
+	MainCamera->CalculateFrustrumPlanes();
+
+	// Set camera and light data in shaders
+	SetCamera( MainCamera );
+	SetAmbientLight( AmbientColour );
+	SetLights( &Lights[0] );
+
+	// Cull entities and calculate their matrices once for both entity passes, then render the normal materials
+	EntityManager.QueueVisibleEntities( MainCamera );
+	EntityManager.RenderAllEntities();
+
+	//------------------------------------------------
+	// FULL SCREEN POST PROCESS RENDER PASS - Render full screen quad on the back-buffer mapped with the scene texture, with post-processing
+
+	// Select the back buffer to use for rendering (will ignore depth-buffer for full-screen quad) and select scene texture for use in shader
+	RenderDevice->SetRenderTarget(SceneRenderTarget2, true); // No need to clear the back-buffer, we're going to overwrite it all
+	RenderDevice->SetResourceVariable( SceneTextureVar, SceneShaderResource );
+
+	// Prepare shader settings for the current full screen filter
+	SelectPostProcess(Copy);
+	SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
+
+	// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
+	// Select technique to match currently selected post-process
+	RenderDevice->SetInputLayout(NULL);
+	RenderDevice->SetPrimitiveTopology(TriangleStrip);
+	ApplyPostProcessPass(PPTechniques[Copy]);
+	RenderDevice->Draw(4, 0);
+
+	//------------------------------------------------
+
+
+	//**|PPPOLY|***************************************
+	// POLY POST PROCESS RENDER PASS
+	// The scene has been rendered in full into a texture then copied to the back-buffer. However, the post-processed polygons were missed out. Now render the entities
+	// again, but only the post-processed materials. These are rendered to the back-buffer in the correct places in the scene, but most importantly their shaders will
+	// have the scene texture available to them. So these polygons can distort or affect the scene behind them (e.g. distortion through cut glass). Note that this also
+	// means we can do blending (additive, multiplicative etc.) in the shader. The post-processed materials are identified with a boolean (RenderMethod.cpp). They are held
+	// in a separate "bucket" (the post-process pass of the render queue, filled by the same visibility pass as the normal materials), so this second pass only
+	// touches the post-processed polygons.
+
+	// NOTE: Post-processing - need to set the back buffer as a render target. Relying on the fact that the section above already did that
+	// Polygon post-processing occurs in the scene rendering code (RenderMethod.cpp) - so pass over the scene texture and viewport dimensions for the scene post-processing materials/shaders
+	SetSceneTexture(SceneShaderResource, BackBufferWidth, BackBufferHeight);
+
+	// Render the entities again, but flag that we only want the post-processed polygons (queued with the others above)
+	EntityManager.RenderAllEntities( true );
+	
+
+
+	//************************************************
+
+
+	//------------------------------------------------
+	// AREA POST PROCESS RENDER PASS - Render smaller quad on the back-buffer mapped with a matching area of the scene texture, with different post-processing
+
+	// NOTE: Post-processing - need to render to the back buffer and select scene texture for use in shader. Relying on the fact that the section above already did that
+
+	// Will have post-processed area over the moving cube
+	CEntity* cubey = EntityManager.GetEntity( "Cubey" );
+
+	// Set the area size, 20 units wide and high, 0 depth offset. This sets up a viewport space quad for the post-process to work on
+	// Note that the function needs the camera to turn the cube's point into a camera facing rectangular area
+	SetPostProcessArea( MainCamera, cubey->GetInterpolatedMatrix().Position(), 20, 20, -9 );
+
+	// Select one of the post-processing techniques and render the area using it
+	SelectPostProcess( Spiral ); // Make sure you also update the line below when you change the post-process method here!
+	RenderDevice->SetInputLayout( NULL );
+	RenderDevice->SetPrimitiveTopology( TriangleStrip );
+	ApplyPostProcessPass( PPTechniques[Spiral] );
+	RenderDevice->Draw( 4, 0 );
+
+	//------------------------------------------------
+	// post full screen post process
+	FullScreenPostProcess();
+
+	// These two lines unbind the scene texture from the shader to stop DirectX issuing a warning when we try to render to it again next frame
+	RenderDevice->SetResourceVariable( SceneTextureVar, 0 );
+	ApplyPostProcessPass( PPTechniques[Spiral] );
+}
+
+void FullScreenPostProcess()
+{
+	//------------------------------------------------
+	// FULL SCREEN POST PROCESS RENDER PASS - Render full screen quad on the back-buffer mapped with the scene texture, with post-processing
+
+	RenderDevice->SetInputLayout(NULL);
+	RenderDevice->SetPrimitiveTopology(TriangleStrip);
+
+	// Run the current preset's plan, each step has its buffers already assigned
+	const SPostProcessPlan& plan = PPPresets[CurrentPreset].plan;
+	for (TUInt32 i = 0; i < plan.steps.size(); ++i)
+	{
+		const SPostProcessStep& step = plan.steps[i];
+		SelectPostProcess(step);
+
+		// Select the target to render to (will ignore depth-buffer for full-screen quad) and select source texture for use in shader
+		RenderDevice->SetRenderTarget(PostProcessTarget(step.target), true); // No need to clear the target, we're going to overwrite it all
+		RenderDevice->SetResourceVariable( SceneTextureVar, PostProcessResource(step.source) );
+
+		// Prepare shader settings for the current full screen filter
+		SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
+
+		// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
+		// Select technique to match the current step
+		ApplyPostProcessPass(PostProcessTechnique(step));
+		RenderDevice->Draw(4, 0);
+	}
+
+	//------------------------------------------------
+}
+
+
+} // namespace gen
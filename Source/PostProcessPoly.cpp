@@ -18,9 +18,21 @@ using namespace std;
 #include "Camera.h"
 #include "Light.h"
 #include "EntityManager.h"
+#include "TransformStore.h"
 #include "Messenger.h"
 #include "CParseLevel.h"
+#include "CRandom.h"
+#include "CTimer.h"
+#include "SimulationThread.h"
 #include "PostProcessPoly.h"
+#include "ProceduralMaps.h"
+#include "PostProcessPreset.h"
+#include "EffectParams.h"
+#include "EffectParamsDevice.h"
+#include "RenderDevice.h"
+#include "RenderDeviceNull.h"
+#include "RenderCapture.h"
+#include "RenderStats.h"
 #include "HSL.h"
 
 #include "imgui.h"
@@ -34,104 +46,34 @@ namespace gen
 // Post-process data
 //*****************************************************************************
 
-// Enumeration of different post-processes
-enum PostProcesses
-{
-	Copy, Tint, Tint2, GreyNoise, Burn, Distort, Spiral, HeatHaze, Water, Retro, Grayscale,
-	Invert, GaussianBlurHori, GaussianBlurVert, BloomSelection, Bloom, Gameboy,
-	NumPostProcesses
-};
+// Post-process presets, animation, textures and constants, defined with the frame rendering in PostProcessFrame.cpp
+// Not good practice - these should be part of a class
+extern vector<SPostProcessPreset> PPPresets;
+extern TUInt32 CurrentPreset;
+SPostProcessSettings& PPSettings();
+
+extern float BurnLevel;
+extern float SpiralTimer;
+extern float HeatHazeTimer;
+extern float WiggleTimer;
+
+extern const int MaxDualFilterLevels;
+extern SRenderResource* NoiseMap;
+extern const bool UseProceduralMaps;
+extern const TUInt32 ProceduralMapSize;
+extern CProceduralMapAnimator* NoiseMapAnimator;
 
-// Currently used post process
-vector<PostProcesses> CurrentPostProcessList = { Copy };
-vector<string> CurrentPostProcessListString = { "PPCopy" };
+extern CEffectParamBlock PPParams;
 
-// Post-process settings
-float BurnLevel = 0.0f;
+// Post-process animation speeds
 const float BurnSpeed = 0.2f;
-float SpiralTimer = 0.0f;
 const float SpiralSpeed = 1.0f;
-float HeatHazeTimer = 0.0f;
 const float HeatHazeSpeed = 1.0f;
 float TintHueRotateTimer = 0.0f;
 const float TintHueRotateSpeed = 10.0f;
-float WiggleTimer = 0.0f;
 const float WiggleSpeed = 1.0f;
 
 
-
-// Separate effect file for full screen & area post-processes. Not necessary to use a separate file, but convenient given the architecture of this lab
-ID3D10Effect* PPEffect;
-
-// Technique name for each post-process
-const string PPTechniqueNames[NumPostProcesses] = {	"PPCopy", "PPTint", "PPTint2", "PPGreyNoise", "PPBurn", "PPDistort", "PPSpiral", "PPHeatHaze", "PPWater", "PPRetro", "PPGrayscale",
-													"PPInvert", "PPGaussianBlurHori", "PPGaussianBlurVert", "PPBloomSelection", "PPBloom", "PPGameboy" };
-
-// Technique pointers for each post-process
-ID3D10EffectTechnique* PPTechniques[NumPostProcesses];
-
-
-// Will render the scene to a texture in a first pass, then copy that texture to the back buffer in a second post-processing pass
-// So need a texture and two "views": a render target view (to render into the texture - 1st pass) and a shader resource view (use the rendered texture as a normal texture - 2nd pass)
-ID3D10Texture2D*          SceneTexture = NULL;
-ID3D10Texture2D*          SceneTexture2 = NULL;
-ID3D10RenderTargetView*   SceneRenderTarget = NULL;
-ID3D10RenderTargetView*   SceneRenderTarget2 = NULL;
-ID3D10ShaderResourceView* SceneShaderResource = NULL;
-ID3D10ShaderResourceView* SceneShaderResource2 = NULL;
-ID3D10Texture2D*          BloomTexture = NULL;
-ID3D10RenderTargetView*   BloomRenderTarget = NULL;
-ID3D10ShaderResourceView* BloomShaderResource = NULL;
-
-// Additional textures used by post-processes
-ID3D10ShaderResourceView* NoiseMap = NULL;
-ID3D10ShaderResourceView* BurnMap = NULL;
-ID3D10ShaderResourceView* DistortMap = NULL;
-
-// Variables to link C++ post-process textures to HLSL shader variables (for area / full-screen post-processing)
-ID3D10EffectShaderResourceVariable* SceneTextureVar = NULL;
-ID3D10EffectShaderResourceVariable* PostProcessMapVar = NULL; // Single shader variable used for the three maps above (noise, burn, distort). Only one is needed at a time
-
-// Variables specifying the area used for post-processing
-ID3D10EffectVectorVariable* PPAreaTopLeftVar = NULL;
-ID3D10EffectVectorVariable* PPAreaBottomRightVar = NULL;
-ID3D10EffectScalarVariable* PPAreaDepthVar = NULL;
-
-// Other variables for individual post-processes
-ID3D10EffectVectorVariable* TintColourVar = NULL;
-ID3D10EffectVectorVariable* TintColour2Var = NULL;
-ID3D10EffectVectorVariable* NoiseScaleVar = NULL;
-ID3D10EffectVectorVariable* NoiseOffsetVar = NULL;
-ID3D10EffectScalarVariable* DistortLevelVar = NULL;
-ID3D10EffectScalarVariable* BurnLevelVar = NULL;
-ID3D10EffectScalarVariable* SpiralTimerVar = NULL;
-ID3D10EffectScalarVariable* HeatHazeTimerVar = NULL;
-
-// Bloom
-ID3D10EffectScalarVariable* BloomThresholdVar = NULL;
-ID3D10EffectScalarVariable* BloomPixelationVar = NULL;
-ID3D10EffectScalarVariable* BloomIntensityVar = NULL;
-ID3D10EffectScalarVariable* BloomOriginalIntensityVar = NULL;
-ID3D10EffectScalarVariable* BloomSaturationVar = NULL;
-ID3D10EffectScalarVariable* BloomOriginalSaturationVar = NULL;
-
-// gameboy
-ID3D10EffectScalarVariable* GameboyPixelsVar = NULL;
-ID3D10EffectScalarVariable* GameboyColourDepthVar = NULL;
-ID3D10EffectVectorVariable* GameboyColourVar = NULL;
-
-// retro settings
-ID3D10EffectScalarVariable* PixelationVar = NULL;
-ID3D10EffectScalarVariable* ColourPalletVar = NULL;
-
-// Dimensions of the viewport
-ID3D10EffectScalarVariable* PPViewportWidthVar = NULL;
-ID3D10EffectScalarVariable* PPViewportHeightVar = NULL;
-
-// Gaussian Blur
-ID3D10EffectScalarVariable* GaussianBlurSigmaVar = NULL;
-
-
 //*****************************************************************************
 
 
@@ -157,11 +99,10 @@ extern const string MediaFolder;
 extern const string ShaderFolder;
 
 // Get reference to global DirectX variables from another source file
-extern ID3D10Device*           g_pd3dDevice;
-extern IDXGISwapChain*         SwapChain;
-extern ID3D10DepthStencilView* DepthStencilView;
-extern ID3D10RenderTargetView* BackBufferRenderTarget;
-extern ID3DX10Font*            OSDFont;
+extern IRenderDevice* RenderDevice;
+extern CRenderCapture* RenderCapture;
+extern CRenderStats* RenderStats;
+extern ID3DX10Font*   OSDFont;
 
 // Actual viewport dimensions (fullscreen or windowed)
 extern TUInt32 BackBufferWidth;
@@ -182,7 +123,6 @@ extern CMessenger Messenger;
 // Entity manager and level parser
 CEntityManager EntityManager;
 CParseLevel LevelParser( &EntityManager );
-bool firstSceneRenderer = false;
 
 // Other scene elements
 const int NumLights = 2;
@@ -195,52 +135,65 @@ float SumUpdateTimes = 0.0f;
 int NumUpdateTimes = 0;
 float AverageUpdateTime = -1.0f; // Invalid value at first
 
-// Settings
-// tint
-ImVec4 PPTintColour = ImVec4(1, 0, 0, 1);
-
-// tint2
-bool PPTint2Rotate = true;
-ImVec4 PPTint2Colour1 = ImVec4(0, 0, 1, 1);
-ImVec4 PPTint2Colour2 = ImVec4(1, 1, 0, 1);
-
-// Graynoise
-float GrainSize = 140; // Fineness of the noise grain
-
-// Distort
-float DistortLevel = 0.03f;
-
-// Water effect
-ImVec4 PPWaterColour = ImVec4(0, 1, 1, 1);
-
-// Retro
-float Pixelation = 128.0f;
-float ColourDepth = 4.0f;
-
-// Blur
-float GaussianBlurSigma = 40.0f;
-
-// Bloom
-float BloomStrenght = 40.0f;
-float BloomThreshold = 0.3f;
-float BloomPixelation = 512;
-
-float BloomIntensity = 1.3;
-float BloomOriginalIntensity = 1.0;
-float BloomSaturation = 1.0;
-float BloomOriginalSaturation = 1.0;
-
-// gameboy
-float GameboyPixels = 150.0f;
-float GameboyColourDepth = 4.0f;
-ImVec4 GameboyColour = ImVec4(0.509f, 0.675f, 0.059f, 1.0f);
+// Animated noise map (settings for each post-process are held in the presets)
+float NoiseMapTime = 0.0f;
+const float NoiseMapSpeed = 8.0f;
+
+// Submission profiling - frames are rendered to a device that only counts the calls made, to measure the CPU cost of
+// submitting a frame without the GPU (see ProfileSubmission)
+CNullRenderDevice SubmissionProfileDevice;
+const TUInt32 SubmissionProfileFrames = 100;
+float SubmissionProfileTime = -1.0f; // Average time to submit a frame (ms), invalid value until profiled
+
+// Frame capture - the next frame rendered is written to the capture file, which can be replayed offline with the
+// ReplayCapture tool
+const string CaptureFileName = "Frame.rcap";
+bool CaptureRequested = false;
+bool CaptureFailed = false;
+
+// Export of the per-frame draw statistics
+const string DrawStatsFileName = "DrawStats.csv";
+bool DrawStatsExportFailed = false;
+
+// Benchmark of entity transform updates with matrices allocated per entity against the transform store (see
+// ProfileTransforms). Times (ms) to update every node of every entity, or of the store with nothing moving, invalid
+// values until profiled
+const TUInt32 NumTransformProfiles = 2;
+const TUInt32 TransformProfileEntities[NumTransformProfiles] = { 10000, 100000 };
+float TransformProfileHeapTime[NumTransformProfiles] = { -1.0f, -1.0f };
+float TransformProfileStoreTime[NumTransformProfiles] = { -1.0f, -1.0f };
+float TransformProfileStaticTime[NumTransformProfiles] = { -1.0f, -1.0f };
+
+// Times (ms) to test the bounding spheres of many entities against the camera frustum one at a time and in SIMD
+// batches (see ProfileCulling), invalid until profiled
+const TUInt32 NumCullingProfiles = 2;
+const TUInt32 CullingProfileSpheres[NumCullingProfiles] = { 10000, 100000 };
+float CullingProfileScalarTime[NumCullingProfiles] = { -1.0f, -1.0f };
+float CullingProfileBatchTime[NumCullingProfiles] = { -1.0f, -1.0f };
+TUInt32 CullingProfileVisible[NumCullingProfiles] = { 0, 0 };
+
+// Worker threads used to update entities and record their rendering into command lists in parallel
+CJobSystem* JobSystem;
+bool ParallelEntities = true;
+
+// Entities are simulated in fixed steps, run on the simulation thread while the previous frame is rendered when the
+// update is pipelined. The renderer interpolates between the entity matrices before and after the latest step
+const float SimulationStepTime = 1.0f / 60.0f;
+CSimulationThread* Simulation;
+bool PipelinedUpdate = true;
+
+// Cull entities with the bounding volume hierarchy, or with a flat SIMD pass over all entities
+bool HierarchicalCulling = true;
+
+// Also cull entities hidden behind large occluders with a software depth buffer
+bool OcclusionCulling = true;
 
 //-----------------------------------------------------------------------------
 // Game Constants
 //-----------------------------------------------------------------------------
 
 // Lighting
-const SColourRGBA AmbientColour( 0.3f, 0.3f, 0.4f, 1.0f );
+extern const SColourRGBA AmbientColour( 0.3f, 0.3f, 0.4f, 1.0f ); // Also used by RenderFrame
 CVector3 LightCentre( 0.0f, 30.0f, 50.0f );
 const float LightOrbit = 170.0f;
 const float LightOrbitSpeed = 0.2f;
@@ -269,6 +222,18 @@ bool SceneSetup()
 	// Light orbiting area
 	Lights[1] = new CLight( LightCentre, SColourRGBA(0.0f, 0.2f, 1.0f) * 50, 100.0f );
 
+	// Update and record entity rendering on all cores
+	JobSystem = new CJobSystem;
+	EntityManager.SetJobSystem( ParallelEntities ? JobSystem : 0 );
+
+	// Broadcast messages find their recipients in the entity manager's grid of entity positions
+	Messenger.SetEntityGrid( EntityManager.GetEntityGrid() );
+
+	// Give the renderer the entities just created, then start simulating them
+	EntityManager.TakeSnapshot();
+	Simulation = new CSimulationThread( SimulationStepTime, UpdateSimulation );
+	Simulation->SetPipelined( PipelinedUpdate );
+
 	return true;
 }
 
@@ -276,6 +241,11 @@ bool SceneSetup()
 // Release everything in the scene
 void SceneShutdown()
 {
+	// Stop the simulation and worker threads
+	delete Simulation;
+	EntityManager.SetJobSystem( 0 );
+	delete JobSystem;
+
 	// Release render methods
 	ReleaseMethods();
 
@@ -294,325 +264,10 @@ void SceneShutdown()
 }
 
 
-//*****************************************************************************
-// Post Processing Setup
-//*****************************************************************************
-
-// Prepare resources required for the post-processing pass
-bool PostProcessSetup()
-{
-	// Create the "scene texture" - the texture into which the scene will be rendered in the first pass
-	D3D10_TEXTURE2D_DESC textureDesc;
-	textureDesc.Width  = BackBufferWidth;  // Match views to viewport size
-	textureDesc.Height = BackBufferHeight;
-	textureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we will have to render every level)
-	textureDesc.ArraySize = 1;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D10_USAGE_DEFAULT;
-	textureDesc.BindFlags = D3D10_BIND_RENDER_TARGET | D3D10_BIND_SHADER_RESOURCE; // Indicate we will use texture as render target, and pass it to shaders
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.MiscFlags = 0;
-	if (FAILED(g_pd3dDevice->CreateTexture2D( &textureDesc, NULL, &SceneTexture ))) return false;
-	if (FAILED(g_pd3dDevice->CreateTexture2D( &textureDesc, NULL, &SceneTexture2 ))) return false;
-	if (FAILED(g_pd3dDevice->CreateTexture2D(&textureDesc, NULL, &BloomTexture))) return false;
-
-	// Get a "view" of the texture as a render target - giving us an interface for rendering to the texture
-	if (FAILED(g_pd3dDevice->CreateRenderTargetView( SceneTexture, NULL, &SceneRenderTarget ))) return false;
-	if (FAILED(g_pd3dDevice->CreateRenderTargetView( SceneTexture2, NULL, &SceneRenderTarget2))) return false;
-	if (FAILED(g_pd3dDevice->CreateRenderTargetView(BloomTexture, NULL, &BloomRenderTarget))) return false;
-
-	// And get a shader-resource "view" - giving us an interface for passing the texture to shaders
-	D3D10_SHADER_RESOURCE_VIEW_DESC srDesc;
-	srDesc.Format = textureDesc.Format;
-	srDesc.ViewDimension = D3D10_SRV_DIMENSION_TEXTURE2D;
-	srDesc.Texture2D.MostDetailedMip = 0;
-	srDesc.Texture2D.MipLevels = 1;
-	if (FAILED(g_pd3dDevice->CreateShaderResourceView( SceneTexture, &srDesc, &SceneShaderResource ))) return false;
-	if (FAILED(g_pd3dDevice->CreateShaderResourceView( SceneTexture2, &srDesc, &SceneShaderResource2))) return false;
-	if (FAILED(g_pd3dDevice->CreateShaderResourceView(BloomTexture, &srDesc, &BloomShaderResource))) return false;
-	
-	// Load post-processing support textures
-	if (FAILED( D3DX10CreateShaderResourceViewFromFile( g_pd3dDevice, (MediaFolder + "Noise.png").c_str() ,   NULL, NULL, &NoiseMap,   NULL ) )) return false;
-	if (FAILED( D3DX10CreateShaderResourceViewFromFile( g_pd3dDevice, (MediaFolder + "Burn.png").c_str() ,    NULL, NULL, &BurnMap,    NULL ) )) return false;
-	if (FAILED( D3DX10CreateShaderResourceViewFromFile( g_pd3dDevice, (MediaFolder + "Distort.png").c_str() , NULL, NULL, &DistortMap, NULL ) )) return false;
-
-
-	// Load and compile a separate effect file for post-processes.
-	ID3D10Blob* pErrors;
-	DWORD dwShaderFlags = D3D10_SHADER_ENABLE_STRICTNESS; // These "flags" are used to set the compiler options
-
-	string fullFileName = ShaderFolder + "PostProcess.fx";
-	if( FAILED( D3DX10CreateEffectFromFile( fullFileName.c_str(), NULL, NULL, "fx_4_0", dwShaderFlags, 0, g_pd3dDevice, NULL, NULL, &PPEffect, &pErrors, NULL ) ))
-	{
-		if (pErrors != 0)  MessageBox( NULL, reinterpret_cast<char*>(pErrors->GetBufferPointer()), "Error", MB_OK ); // Compiler error: display error message
-		else               MessageBox( NULL, "Error loading FX file. Ensure your FX file is in the same folder as this executable.", "Error", MB_OK );  // No error message - probably file not found
-		return false;
-	}
-
-	// There's an array of post-processing technique names above - get array of post-process techniques matching those names from the compiled effect file
-	for (int pp = 0; pp < NumPostProcesses; pp++)
-	{
-		PPTechniques[pp] = PPEffect->GetTechniqueByName( PPTechniqueNames[pp].c_str() );
-	}
-
-	// Link to HLSL variables in post-process shaders
-	SceneTextureVar      = PPEffect->GetVariableByName( "SceneTexture" )->AsShaderResource();
-	PostProcessMapVar    = PPEffect->GetVariableByName( "PostProcessMap" )->AsShaderResource();
-	PPAreaTopLeftVar     = PPEffect->GetVariableByName( "PPAreaTopLeft" )->AsVector();
-	PPAreaBottomRightVar = PPEffect->GetVariableByName( "PPAreaBottomRight" )->AsVector();
-	PPAreaDepthVar       = PPEffect->GetVariableByName( "PPAreaDepth" )->AsScalar();
-
-	// Viewport dimensions
-	PPViewportWidthVar = PPEffect->GetVariableByName("PPViewportWidth")->AsScalar();
-	PPViewportHeightVar = PPEffect->GetVariableByName("PPViewportHeight")->AsScalar();
-
-	// effects
-	TintColourVar        = PPEffect->GetVariableByName( "TintColour" )->AsVector();
-	TintColour2Var       = PPEffect->GetVariableByName( "TintColour2" )->AsVector();
-	NoiseScaleVar        = PPEffect->GetVariableByName( "NoiseScale" )->AsVector();
-	NoiseOffsetVar       = PPEffect->GetVariableByName( "NoiseOffset" )->AsVector();
-	DistortLevelVar      = PPEffect->GetVariableByName( "DistortLevel" )->AsScalar();
-	BurnLevelVar         = PPEffect->GetVariableByName( "BurnLevel" )->AsScalar();
-	SpiralTimerVar       = PPEffect->GetVariableByName( "SpiralTimer" )->AsScalar();
-	HeatHazeTimerVar     = PPEffect->GetVariableByName( "HeatHazeTimer" )->AsScalar();
-
-	// Retro
-	PixelationVar        = PPEffect->GetVariableByName( "Pixelation" )->AsScalar();
-	ColourPalletVar      = PPEffect->GetVariableByName( "ColourPallet" )->AsScalar();
-
-	// Gaussian Blur
-	GaussianBlurSigmaVar = PPEffect->GetVariableByName( "GaussianBlurSigma" )->AsScalar();
-
-	// Bloom
-	BloomThresholdVar          = PPEffect->GetVariableByName("BloomThreshold")->AsScalar();
-	BloomPixelationVar         = PPEffect->GetVariableByName("BloomPixelation")->AsScalar();
-	BloomIntensityVar          = PPEffect->GetVariableByName("BloomIntensity")->AsScalar();
-	BloomOriginalIntensityVar  = PPEffect->GetVariableByName("BloomOriginalIntensity")->AsScalar();
-	BloomSaturationVar         = PPEffect->GetVariableByName("BloomSaturation")->AsScalar();
-	BloomOriginalSaturationVar = PPEffect->GetVariableByName("BloomOriginalSaturation")->AsScalar();
-
-	// gameboy
-	GameboyPixelsVar           = PPEffect->GetVariableByName("GameboyPixels")->AsScalar();
-	GameboyColourDepthVar      = PPEffect->GetVariableByName("GameboyColourDepth")->AsScalar();
-	GameboyColourVar           = PPEffect->GetVariableByName("GameboyColour")->AsVector();
-
-	return true;
-}
-
-void PostProcessShutdown()
-{
-	if (PPEffect)             PPEffect->Release();
-    if (DistortMap)           DistortMap->Release();
-    if (BurnMap)              BurnMap->Release();
-    if (NoiseMap)             NoiseMap->Release();
-	if (SceneShaderResource2) SceneShaderResource2->Release();
-	if (SceneShaderResource)  SceneShaderResource->Release();
-	if (SceneRenderTarget2)   SceneRenderTarget2->Release();
-	if (SceneRenderTarget)    SceneRenderTarget->Release();
-	if (SceneTexture2)        SceneTexture2->Release();
-	if (SceneTexture)         SceneTexture->Release();
-}
-
-// Set the top-left, bottom-right and depth coordinates for the area post process to work on for full-screen processing
-// Since all post process code is now area-based, full-screen processing needs to explicitly set up the appropriate full-screen rectangle
-void SetFullScreenPostProcessArea()
-{
-	CVector2 TopLeftUV = CVector2(0.0f, 0.0f); // Top-left and bottom-right in UV space
-	CVector2 BottomRightUV = CVector2(1.0f, 1.0f);
-
-	PPAreaTopLeftVar->SetRawValue(&TopLeftUV, 0, 8);
-	PPAreaBottomRightVar->SetRawValue(&BottomRightUV, 0, 8);
-	PPAreaDepthVar->SetFloat(0.0f); // Full screen depth set at 0 - in front of everything
-}
-
-//*****************************************************************************
-
-
 //-----------------------------------------------------------------------------
-// Post Process Setup / Update
+// Post Process Update
 //-----------------------------------------------------------------------------
 
-// Set up shaders for given post-processing filter (used for full screen and area processing)
-void SelectPostProcess( PostProcesses filter )
-{
-	switch (filter)
-	{
-		case Tint:
-		{
-			// Set the colour used to tint the scene
-			D3DXCOLOR Tint = D3DXCOLOR(PPTintColour.x, PPTintColour.y, PPTintColour.z, PPTintColour.w);
-			TintColourVar->SetRawValue( &Tint, 0, 12 );
-		}
-		break;
-
-		case Tint2:
-		{
-			// Set the colour used to tint the scene
-			D3DXCOLOR Tint1 = D3DXCOLOR(PPTint2Colour1.x, PPTint2Colour1.y, PPTint2Colour1.z, PPTint2Colour1.w);
-			D3DXCOLOR Tint2 = D3DXCOLOR(PPTint2Colour2.x, PPTint2Colour2.y, PPTint2Colour2.z, PPTint2Colour2.w);
-			TintColourVar->SetRawValue(&Tint1, 0, 12);
-			TintColour2Var->SetRawValue(&Tint2, 0, 12);
-		}
-		break;
-
-		case GreyNoise:
-		{
-			// Set shader constants - scale and offset for noise. Scaling adjusts how fine the noise is.
-			CVector2 NoiseScale = CVector2( BackBufferWidth / GrainSize, BackBufferHeight / GrainSize );
-			NoiseScaleVar->SetRawValue( &NoiseScale, 0, 8 );
-
-			// The offset is randomised to give a constantly changing noise effect (like tv static)
-			CVector2 RandomUVs = CVector2( Random( 0.0f,1.0f ),Random( 0.0f,1.0f ) );
-			NoiseOffsetVar->SetRawValue( &RandomUVs, 0, 8 );
-
-			// Set noise texture
-			PostProcessMapVar->SetResource( NoiseMap );
-		}
-		break;
-
-		case Burn:
-		{
-			// Set the burn level (value from 0 to 1 during animation)
-			BurnLevelVar->SetFloat( BurnLevel );
-
-			// Set burn texture
-			PostProcessMapVar->SetResource( BurnMap );
-		}
-		break;
-
-		case Distort:
-		{
-			// Set the level of distortion
-			DistortLevelVar->SetFloat( DistortLevel );
-
-			// Set distort texture
-			PostProcessMapVar->SetResource( DistortMap );
-		}
-		break;
-
-		case Spiral:
-		{
-			// Set the amount of spiral - use a tweaked cos wave to animate
-			SpiralTimerVar->SetFloat( (1.0f - Cos(SpiralTimer)) * 4.0f );
-			break;
-		}
-
-		case HeatHaze:
-		{
-			// Set the amount of spiral - use a tweaked cos wave to animate
-			HeatHazeTimerVar->SetFloat( HeatHazeTimer );
-			break;
-		}
-
-		case Water:
-		{
-			// Set the colour used to tint the scene
-			D3DXCOLOR TintColour = D3DXCOLOR(PPWaterColour.x, PPWaterColour.y, PPWaterColour.z, PPWaterColour.w);
-			TintColourVar->SetRawValue(&TintColour, 0, 12);
-
-			// Set and increase the amount of spiral - use a tweaked cos wave to animate
-			SpiralTimerVar->SetFloat(WiggleTimer);
-			break;
-		}
-
-		case Retro:
-		{
-			PixelationVar->SetFloat(Pixelation);
-			ColourPalletVar->SetFloat(ColourDepth);
-		}
-		case GaussianBlurHori:
-		case GaussianBlurVert:
-		{
-			GaussianBlurSigmaVar->SetFloat(5.0f);
-			break;
-		}
-
-		case Bloom:
-		{
-			// settings
-			GaussianBlurSigmaVar->SetFloat(BloomStrenght);
-			BloomThresholdVar->SetFloat(BloomThreshold);
-			BloomPixelationVar->SetFloat(BloomPixelation);
-
-			BloomIntensityVar->SetFloat(BloomIntensity);
-			BloomOriginalIntensityVar->SetFloat(BloomOriginalIntensity);
-			BloomSaturationVar->SetFloat(BloomSaturation);
-			BloomOriginalSaturationVar->SetFloat(BloomOriginalSaturation);
-
-			// draw bloom selection to bloom tex
-			{
-				// Select the back buffer to use for rendering (will ignore depth-buffer for full-screen quad) and select scene texture for use in shader
-				// No need to clear the back-buffer, we're going to overwrite it all
-				g_pd3dDevice->OMSetRenderTargets(1, &BloomRenderTarget, DepthStencilView);
-				if (firstSceneRenderer)
-					SceneTextureVar->SetResource(SceneShaderResource);
-				else
-					SceneTextureVar->SetResource(SceneShaderResource2);
-
-				// Prepare shader settings for the current full screen filter
-				SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
-
-				// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
-				// Select technique to match currently selected post-process
-				g_pd3dDevice->IASetInputLayout(NULL);
-				g_pd3dDevice->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-				PPTechniques[BloomSelection]->GetPassByIndex(0)->Apply(0);
-				g_pd3dDevice->Draw(4, 0);
-			}
-
-			// draw blur to scene tex
-			{
-				if (firstSceneRenderer)
-					g_pd3dDevice->OMSetRenderTargets(1, &SceneRenderTarget2, DepthStencilView);
-				else
-					g_pd3dDevice->OMSetRenderTargets(1, &SceneRenderTarget, DepthStencilView);
-
-				SceneTextureVar->SetResource(BloomShaderResource);
-
-				// Prepare shader settings for the current full screen filter
-				SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
-
-				// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
-				// Select technique to match currently selected post-process
-				g_pd3dDevice->IASetInputLayout(NULL);
-				g_pd3dDevice->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-				PPTechniques[GaussianBlurHori]->GetPassByIndex(0)->Apply(0);
-				g_pd3dDevice->Draw(4, 0);
-			}
-			// draw final blur to bloom tex
-			{
-				g_pd3dDevice->OMSetRenderTargets(1, &BloomRenderTarget, DepthStencilView);
-				if (firstSceneRenderer)
-					SceneTextureVar->SetResource(SceneShaderResource2);
-				else
-					SceneTextureVar->SetResource(SceneShaderResource);
-
-				// Prepare shader settings for the current full screen filter
-				SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
-
-				// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
-				// Select technique to match currently selected post-process
-				g_pd3dDevice->IASetInputLayout(NULL);
-				g_pd3dDevice->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-				PPTechniques[GaussianBlurVert]->GetPassByIndex(0)->Apply(0);
-				g_pd3dDevice->Draw(4, 0);
-			}
-
-			PostProcessMapVar->SetResource(BloomShaderResource);
-		}
-
-		case Gameboy:
-		{
-			GameboyPixelsVar->SetFloat(GameboyPixels);
-			GameboyColourDepthVar->SetFloat(GameboyColourDepth);
-			D3DXCOLOR GameboyTint = D3DXCOLOR(GameboyColour.x, GameboyColour.y, GameboyColour.z, GameboyColour.w);
-			GameboyColourVar->SetRawValue(&GameboyTint, 0, 12);
-		}
-	}
-}
-
 // Update post-processes (those that need updating) during scene update
 void UpdatePostProcesses( float updateTime )
 {
@@ -625,73 +280,42 @@ void UpdatePostProcesses( float updateTime )
 	WiggleTimer += WiggleSpeed * updateTime;
 	TintHueRotateTimer = TintHueRotateSpeed * updateTime;
 
-	if (PPTint2Rotate)
+	// Animated noise map - upload the latest frame from the worker thread (if there is one) then request the next
+	SPostProcessSettings& settings = PPSettings();
+	if (settings.animateNoiseMap && UseProceduralMaps)
+	{
+		if (!NoiseMapAnimator)
+		{
+			NoiseMapAnimator = new CProceduralMapAnimator( ProceduralNoise, DefaultProceduralMapSettings( ProceduralNoise ),
+			                                               ProceduralMapSize, ProceduralMapSize );
+		}
+		const TUInt8* pixels = NoiseMapAnimator->FetchFrame();
+		if (pixels)
+		{
+			RenderDevice->UpdateTexture( NoiseMap, pixels );
+		}
+		NoiseMapTime += NoiseMapSpeed * updateTime;
+		NoiseMapAnimator->RequestFrame( NoiseMapTime );
+	}
+
+	if (settings.tint2Rotate)
 	{
 		// Rotate tints
-		auto HslColor1 = RGBToHSL(&PPTint2Colour1);
+		auto HslColor1 = RGBToHSL(reinterpret_cast<ImVec4*>(&settings.tint2Colour1));
 		HslColor1.x += TintHueRotateTimer;
 		if (HslColor1.x > 360)
 			HslColor1.x -= 360;
-		PPTint2Colour1 = HSLToRBG(&HslColor1);
+		*reinterpret_cast<ImVec4*>(&settings.tint2Colour1) = HSLToRBG(&HslColor1);
 
-		auto HslColor2 = RGBToHSL(&PPTint2Colour2);
+		auto HslColor2 = RGBToHSL(reinterpret_cast<ImVec4*>(&settings.tint2Colour2));
 		HslColor2.x += TintHueRotateTimer;
 		if (HslColor2.x > 360)
 			HslColor2.x -= 360;
-		PPTint2Colour2 = HSLToRBG(&HslColor2);
+		*reinterpret_cast<ImVec4*>(&settings.tint2Colour2) = HSLToRBG(&HslColor2);
 	}
 }
 
 
-// Sets in the shaders the top-left, bottom-right and depth coordinates of the area post process to work on
-// Requires a world point at the centre of the area, the width and height of the area (in world units), an optional depth offset (to pull or push 
-// the effect of the post-processing into the scene). Also requires the camera, since we are creating a camera facing quad.
-void SetPostProcessArea( CCamera* camera, CVector3 areaCentre, float width, float height, float depthOffset = 0.0f )
-{
-	// Get the area centre in camera space.
-	CVector4 cameraSpaceCentre = CVector4(areaCentre, 1.0f) * camera->GetViewMatrix();
-
-	// Get top-left and bottom-right of camera-facing area of required dimensions 
-	cameraSpaceCentre.x -= width / 2;
-	cameraSpaceCentre.y += height / 2; // Careful, y axis goes up here
-	CVector4 cameraTopLeft = cameraSpaceCentre;
-	cameraSpaceCentre.x += width;
-	cameraSpaceCentre.y -= height;
-	CVector4 cameraBottomRight = cameraSpaceCentre;
-
-	// Get the projection space coordinates of the post process area
-	CVector4 projTopLeft     = cameraTopLeft     * camera->GetProjMatrix();
-	CVector4 projBottomRight = cameraBottomRight * camera->GetProjMatrix();
-
-	// Perform perspective divide to get coordinates in normalised viewport space (-1.0 to 1.0 from left->right and bottom->top of the viewport)
-	projTopLeft.x /= projTopLeft.w;
-	projTopLeft.y /= projTopLeft.w;
-	projBottomRight.x /= projBottomRight.w;
-	projBottomRight.y /= projBottomRight.w;
-
-	// Also do perspective divide on z to get depth buffer value for the area. Add the required depth offset (using an approximation)
-	projTopLeft.z += depthOffset;
-	projTopLeft.w += depthOffset;
-	projTopLeft.z /= projTopLeft.w;
-
-	// Convert the x & y coordinates to UV space (0 -> 1, y flipped). This extra step makes the shader work simpler
-	projTopLeft.x =	 projTopLeft.x / 2.0f + 0.5f;
-	projTopLeft.y = -projTopLeft.y / 2.0f + 0.5f;
-	projBottomRight.x =	 projBottomRight.x / 2.0f + 0.5f;
-	projBottomRight.y = -projBottomRight.y / 2.0f + 0.5f;
-
-	// Send the values calculated to the shader. The post-processing vertex shader needs only these values to
-	// create the vertex buffer for the quad to render, we don't need to create a vertex buffer for post-processing at all.
-	PPAreaTopLeftVar->SetRawValue( &projTopLeft.Vector2(), 0, 8 );         // Viewport space x & y for top-left
-	PPAreaBottomRightVar->SetRawValue( &projBottomRight.Vector2(), 0, 8 ); // Same for bottom-right
-	PPAreaDepthVar->SetFloat( projTopLeft.z ); // Depth buffer value for area
-
-	// ***NOTE*** Most applications you will see doing post-processing would continue here to create a vertex buffer in C++, and would
-	// not use the unusual vertex shader that you will see in the .fx file here. That might (or might not) give a tiny performance boost,
-	// but very tiny, if any (only a handful of vertices affected). I prefer this method because I find it cleaner and more flexible overall. 
-}
-
-
 //-----------------------------------------------------------------------------
 // Game loop functions
 //-----------------------------------------------------------------------------
@@ -699,177 +323,174 @@ void SetPostProcessArea( CCamera* camera, CVector3 areaCentre, float width, floa
 // Draw one frame of the scene
 void RenderScene()
 {
-	// Setup the viewport - defines which part of the back-buffer we will render to (usually all of it)
-	D3D10_VIEWPORT vp;
-	vp.Width  = BackBufferWidth;
-	vp.Height = BackBufferHeight;
-	vp.MinDepth = 0.0f;
-	vp.MaxDepth = 1.0f;
-	vp.TopLeftX = 0;
-	vp.TopLeftY = 0;
-	g_pd3dDevice->RSSetViewports( 1, &vp );
-
-	PPViewportWidthVar->SetFloat(static_cast<float>(BackBufferWidth));
-	PPViewportHeightVar->SetFloat(static_cast<float>(BackBufferHeight));
-
-	//------------------------------------------------
-	// SCENE RENDER PASS - rendering to a texture
-
-	// Specify that we will render to the scene texture in this first pass (rather than the backbuffer), will share the depth/stencil buffer with the backbuffer though
-	g_pd3dDevice->OMSetRenderTargets( 1, &SceneRenderTarget, DepthStencilView );
-	firstSceneRenderer = true;
-
-	// Clear the texture and the depth buffer
-	g_pd3dDevice->ClearRenderTargetView( SceneRenderTarget, &AmbientColour.r );
-	g_pd3dDevice->ClearRenderTargetView( SceneRenderTarget2, &AmbientColour.r);
-	g_pd3dDevice->ClearDepthStencilView( DepthStencilView, D3D10_CLEAR_DEPTH, 1.0f, 0 );
-
-	// Prepare camera
-	MainCamera->SetAspect( static_cast<TFloat32>(BackBufferWidth) / BackBufferHeight );
-	MainCamera->CalculateMatrices();
-	MainCamera->CalculateFrustrumPlanes();
-
-	// Set camera and light data in shaders
-	SetCamera( MainCamera );
-	SetAmbientLight( AmbientColour );
-	SetLights( &Lights[0] );
-
-	// Render entities
-	EntityManager.RenderAllEntities( MainCamera );
-
-	//------------------------------------------------
-	// FULL SCREEN POST PROCESS RENDER PASS - Render full screen quad on the back-buffer mapped with the scene texture, with post-processing
-
-	// Select the back buffer to use for rendering (will ignore depth-buffer for full-screen quad) and select scene texture for use in shader
-	g_pd3dDevice->OMSetRenderTargets(1, &SceneRenderTarget2, DepthStencilView); // No need to clear the back-buffer, we're going to overwrite it all
-	SceneTextureVar->SetResource(SceneShaderResource);
-	firstSceneRenderer = false;
-
-	// Prepare shader settings for the current full screen filter
-	SelectPostProcess(Copy);
-	SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
-
-	// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
-	// Select technique to match currently selected post-process
-	g_pd3dDevice->IASetInputLayout(NULL);
-	g_pd3dDevice->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	PPTechniques[Copy]->GetPassByIndex(0)->Apply(0);
-	g_pd3dDevice->Draw(4, 0);
-
-	//------------------------------------------------
-
-
-	//**|PPPOLY|***************************************
-	// POLY POST PROCESS RENDER PASS
-	// The scene has been rendered in full into a texture then copied to the back-buffer. However, the post-processed polygons were missed out. Now render the entities
-	// again, but only the post-processed materials. These are rendered to the back-buffer in the correct places in the scene, but most importantly their shaders will
-	// have the scene texture available to them. So these polygons can distort or affect the scene behind them (e.g. distortion through cut glass). Note that this also
-	// means we can do blending (additive, multiplicative etc.) in the shader. The post-processed materials are identified with a boolean (RenderMethod.cpp). This entire
-	// approach works even better with "bucket" rendering, where post-process shaders are held in a separate bucket - making it unnecessary to "RenderAllEntities" as 
-	// we are doing here.
-
-	// NOTE: Post-processing - need to set the back buffer as a render target. Relying on the fact that the section above already did that
-	// Polygon post-processing occurs in the scene rendering code (RenderMethod.cpp) - so pass over the scene texture and viewport dimensions for the scene post-processing materials/shaders
-	SetSceneTexture(SceneShaderResource, BackBufferWidth, BackBufferHeight);
-
-	// Render all entities again, but flag that we only want the post-processed polygons
-	EntityManager.RenderAllEntities( MainCamera, true );
-	
-
-
-	//************************************************
-
-
-	//------------------------------------------------
-	// AREA POST PROCESS RENDER PASS - Render smaller quad on the back-buffer mapped with a matching area of the scene texture, with different post-processing
-
-	// NOTE: Post-processing - need to render to the back buffer and select scene texture for use in shader. Relying on the fact that the section above already did that
-
-	// Will have post-processed area over the moving cube
-	CEntity* cubey = EntityManager.GetEntity( "Cubey" );
-
-	// Set the area size, 20 units wide and high, 0 depth offset. This sets up a viewport space quad for the post-process to work on
-	// Note that the function needs the camera to turn the cube's point into a camera facing rectangular area
-	SetPostProcessArea( MainCamera, cubey->Position(), 20, 20, -9 );
-
-	// Select one of the post-processing techniques and render the area using it
-	SelectPostProcess( Spiral ); // Make sure you also update the line below when you change the post-process method here!
-	g_pd3dDevice->IASetInputLayout( NULL );
-	g_pd3dDevice->IASetPrimitiveTopology( D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP );
-	PPTechniques[Spiral]->GetPassByIndex(0)->Apply(0);
-	g_pd3dDevice->Draw( 4, 0 );
-
-	//------------------------------------------------
-	// post full screen post process
-	FullScreenPostProcess();
+	// Capture covers all the device calls for the frame
+	bool capturing = CaptureRequested && RenderCapture->BeginCapture( CaptureFileName );
+	CaptureFailed = CaptureRequested && !capturing;
+	CaptureRequested = false;
 
-	// These two lines unbind the scene texture from the shader to stop DirectX issuing a warning when we try to render to it again next frame
-	SceneTextureVar->SetResource( 0 );
-	PPTechniques[Spiral]->GetPassByIndex(0)->Apply(0);
+	RenderFrame();
 
 	// Render UI elements last - don't want them post-processed
 	RenderImGui();
 	RenderSceneText();
 
 	// Present the backbuffer contents to the display
-	SwapChain->Present( 0, 0 );
+	RenderDevice->Present();
+
+	if (capturing)
+	{
+		CaptureFailed = !RenderCapture->EndCapture();
+	}
 }
 
-void FullScreenPostProcess()
+// Compare the cost of updating entity matrices held in arrays allocated per entity (each entity allocated separately,
+// as entities were before the transform store) against the transform store, for each of the benchmark sizes. Every
+// entity has the same small hierarchy and moves its root each update
+void ProfileTransforms()
 {
-	//------------------------------------------------
-	// FULL SCREEN POST PROCESS RENDER PASS - Render full screen quad on the back-buffer mapped with the scene texture, with post-processing
+	const TUInt32 NumNodes = 4;
+	const TUInt32 NodeParents[NumNodes] = { 0, 0, 1, 1 };
+	const TUInt32 NumUpdates = 10;
 
-	g_pd3dDevice->IASetInputLayout(NULL);
-	g_pd3dDevice->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-
-	int listCount = CurrentPostProcessList.size();
-	for (int i = 0; i < listCount; ++i)
+	for (TUInt32 profile = 0; profile < NumTransformProfiles; ++profile)
 	{
-		SelectPostProcess(CurrentPostProcessList[i]);
+		TUInt32 numEntities = TransformProfileEntities[profile];
 
-		// Select the back buffer to use for rendering (will ignore depth-buffer for full-screen quad) and select scene texture for use in shader
-		if (i == listCount - 1) // last one
+		// Per-entity allocations, reached through a list of pointers
+		struct SEntityMatrices
+		{
+			CMatrix4x4* relMatrices;
+			CMatrix4x4* matrices;
+		};
+		vector<SEntityMatrices*> heapEntities( numEntities );
+		for (TUInt32 entity = 0; entity < numEntities; ++entity)
 		{
-			g_pd3dDevice->OMSetRenderTargets(1, &BackBufferRenderTarget, DepthStencilView);
-			if (firstSceneRenderer)
+			heapEntities[entity] = new SEntityMatrices;
+			heapEntities[entity]->relMatrices = new CMatrix4x4[NumNodes];
+			heapEntities[entity]->matrices = new CMatrix4x4[NumNodes];
+			for (TUInt32 node = 0; node < NumNodes; ++node)
 			{
-				SceneTextureVar->SetResource(SceneShaderResource);
-				firstSceneRenderer = false;
+				heapEntities[entity]->relMatrices[node] = CMatrix4x4( CVector3( 1.0f, 2.0f, 3.0f ) );
 			}
-			else
+		}
+		CTimer timer;
+		for (TUInt32 update = 0; update < NumUpdates; ++update)
+		{
+			for (TUInt32 entity = 0; entity < numEntities; ++entity)
 			{
-				SceneTextureVar->SetResource(SceneShaderResource2);
-				firstSceneRenderer = true;
+				SEntityMatrices* matrices = heapEntities[entity];
+				matrices->relMatrices[0].Position().x += 0.001f;
+				matrices->matrices[0] = matrices->relMatrices[0];
+				for (TUInt32 node = 1; node < NumNodes; ++node)
+				{
+					matrices->matrices[node] = matrices->relMatrices[node] * matrices->matrices[NodeParents[node]];
+				}
 			}
 		}
-		else if (firstSceneRenderer)
+		TransformProfileHeapTime[profile] = timer.GetTime() * 1000.0f / NumUpdates;
+		for (TUInt32 entity = 0; entity < numEntities; ++entity)
 		{
-			g_pd3dDevice->OMSetRenderTargets(1, &SceneRenderTarget2, DepthStencilView); // No need to clear the back-buffer, we're going to overwrite it all
-			SceneTextureVar->SetResource(SceneShaderResource);
+			delete[] heapEntities[entity]->relMatrices;
+			delete[] heapEntities[entity]->matrices;
+			delete heapEntities[entity];
+		}
 
-			firstSceneRenderer = false;
+		// Transform store
+		CTransformStore store;
+		vector<TUInt32> firstNodes( numEntities );
+		for (TUInt32 entity = 0; entity < numEntities; ++entity)
+		{
+			firstNodes[entity] = store.Allocate( NumNodes );
+			for (TUInt32 node = 0; node < NumNodes; ++node)
+			{
+				store.RelMatrix( firstNodes[entity] + node ) = CMatrix4x4( CVector3( 1.0f, 2.0f, 3.0f ) );
+				if (node > 0) store.SetParent( firstNodes[entity] + node, firstNodes[entity] + NodeParents[node] );
+			}
 		}
-		else
+		store.UpdateMatrices();
+		timer.Reset();
+		for (TUInt32 update = 0; update < NumUpdates; ++update)
+		{
+			for (TUInt32 entity = 0; entity < numEntities; ++entity)
+			{
+				store.RelMatrix( firstNodes[entity] ).Position().x += 0.001f;
+			}
+			store.UpdateMatrices();
+		}
+		TransformProfileStoreTime[profile] = timer.GetTime() * 1000.0f / NumUpdates;
+
+		// Nothing moving, only the check for dirty nodes
+		timer.Reset();
+		for (TUInt32 update = 0; update < NumUpdates; ++update)
 		{
-			g_pd3dDevice->OMSetRenderTargets(1, &SceneRenderTarget, DepthStencilView); // No need to clear the back-buffer, we're going to overwrite it all
-			SceneTextureVar->SetResource(SceneShaderResource2);
+			store.UpdateMatrices();
+		}
+		TransformProfileStaticTime[profile] = timer.GetTime() * 1000.0f / NumUpdates;
+	}
+}
+
+// Time culling many bounding spheres, scattered around the camera, against the main camera's frustum - testing each
+// sphere in turn and testing all the spheres in SIMD batches
+void ProfileCulling()
+{
+	const TUInt32 NumTests = 10;
+	const TFloat32 SceneSize = 2000.0f;
 
-			firstSceneRenderer = true;
+	CRandom random( 12345 );
+	for (TUInt32 profile = 0; profile < NumCullingProfiles; ++profile)
+	{
+		TUInt32 numSpheres = CullingProfileSpheres[profile];
+		vector<TFloat32> centresX( numSpheres ), centresY( numSpheres ), centresZ( numSpheres ), radii( numSpheres );
+		for (TUInt32 sphere = 0; sphere < numSpheres; ++sphere)
+		{
+			centresX[sphere] = MainCamera->Position().x + random.GetFloat( -SceneSize, SceneSize );
+			centresY[sphere] = MainCamera->Position().y + random.GetFloat( -SceneSize, SceneSize );
+			centresZ[sphere] = MainCamera->Position().z + random.GetFloat( -SceneSize, SceneSize );
+			radii[sphere] = random.GetFloat( 1.0f, 20.0f );
+		}
+
+		CTimer timer;
+		TUInt32 numVisible = 0;
+		for (TUInt32 test = 0; test < NumTests; ++test)
+		{
+			numVisible = 0;
+			for (TUInt32 sphere = 0; sphere < numSpheres; ++sphere)
+			{
+				CVector3 centre( centresX[sphere], centresY[sphere], centresZ[sphere] );
+				if (MainCamera->SphereInFrustum( centre, radii[sphere] )) ++numVisible;
+			}
 		}
+		CullingProfileScalarTime[profile] = timer.GetTime() * 1000.0f / NumTests;
+		CullingProfileVisible[profile] = numVisible;
 
-		// Prepare shader settings for the current full screen filter
+		vector<TUInt32> visible( (numSpheres + 31) / 32 );
+		timer.Reset();
+		for (TUInt32 test = 0; test < NumTests; ++test)
+		{
+			MainCamera->SpheresInFrustum( &centresX[0], &centresY[0], &centresZ[0], &radii[0], numSpheres, &visible[0] );
+		}
+		CullingProfileBatchTime[profile] = timer.GetTime() * 1000.0f / NumTests;
+	}
+}
 
-		SetFullScreenPostProcessArea(); // Define the full-screen as the area to affect
+// Measure the CPU cost of submitting a frame by rendering frames to the null device. The device's statistics are left
+// holding the totals for a single frame
+void ProfileSubmission()
+{
+	IRenderDevice* realDevice = RenderDevice;
+	RenderDevice = &SubmissionProfileDevice;
 
-		// Using special vertex shader than creates its own data for a full screen quad (see .fx file). No need to set vertex/index buffer, just draw 4 vertices of quad
-		// Select technique to match currently selected post-process
-		PPTechniques[CurrentPostProcessList[i]]->GetPassByIndex(0)->Apply(0);
-		g_pd3dDevice->Draw(4, 0);
-		
+	CTimer timer;
+	for (TUInt32 frame = 0; frame < SubmissionProfileFrames; ++frame)
+	{
+		SubmissionProfileDevice.ResetStats();
+		RenderFrame();
 	}
+	SubmissionProfileTime = timer.GetTime() * 1000.0f / SubmissionProfileFrames;
 
-	//------------------------------------------------
+	// Constants uploaded during profiling never reached the real device, so send them all again next frame
+	RenderDevice = realDevice;
+	PPParams.Invalidate();
 }
 
 static void HelpMarker(const char* desc)
@@ -896,6 +517,64 @@ void RenderImGui()
 	// post process order window
 	{
 		ImGui::Begin("Render");
+
+		// preset selection
+		SPostProcessPreset& preset = PPPresets[CurrentPreset];
+		if (ImGui::BeginCombo("Preset", preset.name.c_str()))
+		{
+			for (TUInt32 n = 0; n < PPPresets.size(); ++n)
+			{
+				ImGui::PushID(n);
+				if (ImGui::Selectable(PPPresets[n].name.c_str(), n == CurrentPreset))
+				{
+					CurrentPreset = n; // Presets are already compiled, so switching is just selecting another one
+				}
+				ImGui::PopID();
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("New"))
+		{
+			// Copy of the current preset
+			PPPresets.push_back(PPPresets[CurrentPreset]);
+			CurrentPreset = PPPresets.size() - 1;
+			stringstream presetName;
+			presetName << "Preset " << CurrentPreset;
+			PPPresets[CurrentPreset].name = presetName.str();
+		}
+		SPostProcessPreset& currentPreset = PPPresets[CurrentPreset];
+
+		// preset files, text form if the file name ends in .txt, otherwise binary
+		static char presetFile[256] = "Preset.ppst";
+		ImGui::InputText("File", presetFile, sizeof(presetFile));
+		string presetFileName = presetFile;
+		bool textPreset = presetFileName.length() > 4 && presetFileName.substr(presetFileName.length() - 4) == ".txt";
+		if (ImGui::Button("Save"))
+		{
+			bool saved = textPreset ? SavePostProcessPresetText(currentPreset, presetFileName) : SavePostProcessPreset(currentPreset, presetFileName);
+			if (!saved) SystemMessageBox("Failed to save preset " + presetFileName, "Error");
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Load"))
+		{
+			SPostProcessPreset loaded;
+			bool success = textPreset ? LoadPostProcessPresetText(presetFileName, &loaded) : LoadPostProcessPreset(presetFileName, &loaded);
+			if (success)
+			{
+				PPPresets.push_back(loaded);
+				CurrentPreset = PPPresets.size() - 1;
+			}
+			else
+			{
+				SystemMessageBox("Failed to load preset " + presetFileName, "Error");
+			}
+		}
+
+		// chain of the current preset, the plan is recompiled whenever it is changed
+		vector<PostProcesses>& chain = PPPresets[CurrentPreset].chain;
+		bool chainChanged = false;
+
 		ImGui::Text("Add render:");
 
 		// combo box
@@ -920,16 +599,14 @@ void RenderImGui()
 		ImGui::SameLine();
 		if (ImGui::Button("Add"))
 		{
-			// push sting to vector
-			CurrentPostProcessListString.push_back(dropBoxCurrent);
-
 			// find enum
 			for (int i = 0; i < NumPostProcesses; ++i)
 			{
 				if (!PPTechniqueNames[i].compare(dropBoxCurrent))
 				{
 					// push enum to vector
-					CurrentPostProcessList.push_back((PostProcesses)i);
+					chain.push_back((PostProcesses)i);
+					chainChanged = true;
 					break;
 				}
 			}
@@ -937,19 +614,19 @@ void RenderImGui()
 
 
 		// listbox
-		const int listBoxCount = CurrentPostProcessListString.size();
-		static const char* listBoxCurrent = CurrentPostProcessListString[0].c_str();
+		const int listBoxCount = chain.size();
 		static int listBoxIndex = 0;
+		if (listBoxIndex >= listBoxCount)
+			listBoxIndex = listBoxCount - 1;
 
 		if (ImGui::ListBoxHeader("Listbox"))
 		{
 			for (int i = 0; i < listBoxCount; ++i)
 			{
 				ImGui::PushID(i);
-				bool is_selected = (listBoxCurrent == CurrentPostProcessListString[i] && listBoxIndex == i);
-				if (ImGui::Selectable(CurrentPostProcessListString[i].c_str(), is_selected))
+				bool is_selected = (listBoxIndex == i);
+				if (ImGui::Selectable(PPTechniqueNames[chain[i]].c_str(), is_selected))
 				{
-					listBoxCurrent = CurrentPostProcessListString[i].c_str();
 					listBoxIndex = i;
 				}
 				if (is_selected)
@@ -965,8 +642,8 @@ void RenderImGui()
 		{
 			if (listBoxCount > 1)
 			{
-				CurrentPostProcessList.erase(CurrentPostProcessList.begin() + listBoxIndex);
-				CurrentPostProcessListString.erase(CurrentPostProcessListString.begin() + listBoxIndex);
+				chain.erase(chain.begin() + listBoxIndex);
+				chainChanged = true;
 			}
 		}
 		ImGui::SameLine();
@@ -976,9 +653,9 @@ void RenderImGui()
 		{
 			if (listBoxCount > 1 && listBoxIndex > 0)
 			{
-				swap(CurrentPostProcessList[listBoxIndex], CurrentPostProcessList[listBoxIndex - 1]);
-				swap(CurrentPostProcessListString[listBoxIndex], CurrentPostProcessListString[listBoxIndex - 1]);
+				swap(chain[listBoxIndex], chain[listBoxIndex - 1]);
 				--listBoxIndex;
+				chainChanged = true;
 			}
 		}
 		ImGui::SameLine();
@@ -986,15 +663,153 @@ void RenderImGui()
 		// move down
 		if (ImGui::Button("Move Down"))
 		{
-			if (listBoxCount > 1 && listBoxIndex < CurrentPostProcessList.size() - 1)
+			if (listBoxCount > 1 && listBoxIndex < listBoxCount - 1)
 			{
-				swap(CurrentPostProcessList[listBoxIndex], CurrentPostProcessList[listBoxIndex + 1]);
-				swap(CurrentPostProcessListString[listBoxIndex], CurrentPostProcessListString[listBoxIndex + 1]);
+				swap(chain[listBoxIndex], chain[listBoxIndex + 1]);
 				++listBoxIndex;
+				chainChanged = true;
 			}
 		}
 
+		if (chainChanged)
+		{
+			CompilePostProcessPlan(&PPPresets[CurrentPreset]);
+		}
+		const SPostProcessPlan& plan = PPPresets[CurrentPreset].plan;
+		ImGui::Text("Plan: %d steps (%d passes removed, %d fused)", (int)plan.steps.size(), plan.numElided, plan.numFused);
+
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		ImGui::Text("Post-process constants: %d set, %d uploaded (%d bytes)", PPParams.GetNumSets(), PPParams.GetNumUploads(), PPParams.GetNumBytesUploaded());
+
+		// Draw statistics for the last frame, duplicate draws are wasted submissions
+		const SRenderFrameStats& frameStats = RenderStats->GetLastFrame();
+		ImGui::Text("%d draws (%d instanced), %llu triangles, %d constant updates", frameStats.draws, frameStats.instancedDraws,
+		            frameStats.triangles, frameStats.constantUpdates);
+		ImGui::Text("%d state changes (%d redundant)", frameStats.stateChanges, frameStats.redundantStateChanges);
+		if (frameStats.duplicateDraws > 0)
+		{
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%d duplicate draws", frameStats.duplicateDraws);
+		}
+		else
+		{
+			ImGui::Text("No duplicate draws");
+		}
+		ImGui::SameLine(); HelpMarker("Draws repeating an earlier draw in the frame with the same geometry, pass and matrices");
+		if (ImGui::Button("Export Draw Stats"))
+		{
+			DrawStatsExportFailed = !RenderStats->Export( DrawStatsFileName );
+		}
+		ImGui::SameLine(); HelpMarker("Writes the statistics for recent frames to DrawStats.csv");
+		if (DrawStatsExportFailed)
+		{
+			ImGui::Text("Error writing %s", DrawStatsFileName.c_str());
+		}
+
+		// Submission cost measured on the null device
+		if (ImGui::Button("Profile Submission"))
+		{
+			ProfileSubmission();
+		}
+		ImGui::SameLine(); HelpMarker("Renders frames to a device that only counts the calls made, to measure the CPU cost of submitting a frame");
+		if (SubmissionProfileTime >= 0.0f)
+		{
+			CNullRenderDevice& profile = SubmissionProfileDevice;
+			ImGui::Text("Submission %.3f ms/frame: %d calls, %d draws", SubmissionProfileTime, profile.GetTotalCalls(),
+			            profile.GetNumCalls(CallDraw) + profile.GetNumCalls(CallDrawIndexed));
+			ImGui::Text("%llu vertices, %llu bytes", profile.GetNumVerticesDrawn(), profile.GetNumBytes());
+			if (ImGui::TreeNode("Calls"))
+			{
+				for (int call = 0; call < NumRenderDeviceCalls; ++call)
+				{
+					if (profile.GetNumCalls(static_cast<ERenderDeviceCall>(call)))
+					{
+						ImGui::Text("%s: %d", RenderDeviceCallNames[call], profile.GetNumCalls(static_cast<ERenderDeviceCall>(call)));
+					}
+				}
+				ImGui::TreePop();
+			}
+		}
+
+		// Frame capture
+		if (ImGui::Button("Capture Frame"))
+		{
+			CaptureRequested = true;
+		}
+		ImGui::SameLine(); HelpMarker("Writes all the device calls of the next frame, and the objects they use, to Frame.rcap");
+		if (CaptureFailed)
+		{
+			ImGui::Text("Error writing %s", CaptureFileName.c_str());
+		}
+		else if (RenderCapture->GetCaptureSize())
+		{
+			ImGui::Text("Captured %d calls, %d bytes", RenderCapture->GetNumCapturedCalls(), RenderCapture->GetCaptureSize());
+		}
+
+		// Parallel update and recording of entity rendering
+		if (ImGui::Checkbox("Parallel Entities", &ParallelEntities))
+		{
+			Simulation->Wait();
+			EntityManager.SetJobSystem( ParallelEntities ? JobSystem : 0 );
+		}
+		ImGui::SameLine(); HelpMarker("Updates entities on all threads, and records entity rendering into a command list per thread, replayed in a fixed order");
+		ImGui::Text("%d threads, %d command lists, %d commands", JobSystem->GetNumThreads(),
+		            EntityManager.GetNumCommandListsUsed(), EntityManager.GetNumCommandsRecorded());
+		if (ImGui::Checkbox("Pipelined Update", &PipelinedUpdate))
+		{
+			Simulation->SetPipelined( PipelinedUpdate );
+		}
+		ImGui::SameLine(); HelpMarker("Simulates entities in fixed 60Hz steps on a thread of their own while the previous frame is rendered, rendering them interpolated between the last two steps");
+		ImGui::Text("%d steps last frame, %.3f ms simulating", Simulation->GetNumSteps(), Simulation->GetStepsRunTime());
+		if (ImGui::Checkbox("Hierarchical Culling", &HierarchicalCulling))
+		{
+			EntityManager.SetHierarchicalCulling( HierarchicalCulling );
+		}
+		ImGui::SameLine(); HelpMarker("Finds visible entities with a bounding volume hierarchy, otherwise tests every entity's bounding sphere in SIMD batches");
+		ImGui::Text("%d of %d entities visible, %d culling nodes visited", EntityManager.GetNumVisibleEntities(),
+		            EntityManager.NumEntities(), EntityManager.GetNumCullingNodesVisited());
+		if (ImGui::Checkbox("Occlusion Culling", &OcclusionCulling))
+		{
+			EntityManager.SetOcclusionCulling( OcclusionCulling );
+		}
+		ImGui::SameLine(); HelpMarker("Draws the largest visible garages, tribunes and walls into a small depth buffer on the CPU, then removes entities hidden behind them");
+		ImGui::Text("%d occluders, %d entities occluded", EntityManager.GetNumOccluders(),
+		            EntityManager.GetNumOccludedEntities());
+		ImGui::End();
+	}
+
+	// profiling window
+	{
+		ImGui::Begin("Profiling");
+
+		// Entity transform storage
+		if (ImGui::Button("Benchmark Transforms"))
+		{
+			ProfileTransforms();
+		}
+		ImGui::SameLine(); HelpMarker("Times updating the matrices of many moving entities, allocated per entity and in the transform store");
+		for (TUInt32 profile = 0; profile < NumTransformProfiles; ++profile)
+		{
+			if (TransformProfileHeapTime[profile] >= 0.0f)
+			{
+				ImGui::Text("%d entities: per entity %.3f ms, store %.3f ms (static %.3f ms)", TransformProfileEntities[profile],
+				            TransformProfileHeapTime[profile], TransformProfileStoreTime[profile], TransformProfileStaticTime[profile]);
+			}
+		}
+
+		// Frustum culling
+		if (ImGui::Button("Benchmark Culling"))
+		{
+			ProfileCulling();
+		}
+		ImGui::SameLine(); HelpMarker("Times testing many bounding spheres against the camera frustum one at a time and in SIMD batches");
+		for (TUInt32 profile = 0; profile < NumCullingProfiles; ++profile)
+		{
+			if (CullingProfileScalarTime[profile] >= 0.0f)
+			{
+				ImGui::Text("%d spheres (%d visible): scalar %.3f ms, batch %.3f ms", CullingProfileSpheres[profile],
+				            CullingProfileVisible[profile], CullingProfileScalarTime[profile], CullingProfileBatchTime[profile]);
+			}
+		}
 		ImGui::End();
 	}
 
@@ -1008,53 +823,63 @@ void RenderImGui()
 
 		ImGui::Begin("Render Settings");
 
+		// settings of the current preset, the plan is recompiled if a blur backend changes
+		SPostProcessSettings& settings = PPSettings();
+		const SPostProcessSettings defaults;
+		bool backendChanged = false;
+
 
 		if (ImGui::CollapsingHeader("PPTint"))
 		{
 			ImGui::Text("Color widget:");
 			ImGui::SameLine(); HelpMarker("Click on the colored square to open a color picker.\nCTRL+click on individual component to input value.\n");
-			ImGui::ColorEdit3("PPTintColor", (float*)&PPTintColour, misc_flags);
+			ImGui::ColorEdit3("PPTintColor", &settings.tintColour.r, misc_flags);
 
 			if (ImGui::Button("Default"))
 			{
-				PPTintColour = ImVec4(1, 0, 0, 1);
+				settings.tintColour = defaults.tintColour;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPTint2"))
 		{
-			ImGui::Checkbox("Rotate Colours", &PPTint2Rotate);
+			ImGui::Checkbox("Rotate Colours", &settings.tint2Rotate);
 			ImGui::Text("Color widget:");
 			ImGui::SameLine(); HelpMarker("Click on the colored square to open a color picker.\nCTRL+click on individual component to input value.\n");
-			ImGui::ColorEdit3("PPTint2Color1", (float*)&PPTint2Colour1, misc_flags);
-			ImGui::ColorEdit3("PPTint2Color2", (float*)&PPTint2Colour2, misc_flags);
+			ImGui::ColorEdit3("PPTint2Color1", &settings.tint2Colour1.r, misc_flags);
+			ImGui::ColorEdit3("PPTint2Color2", &settings.tint2Colour2.r, misc_flags);
 
 			if (ImGui::Button("Default"))
 			{
-				PPTintColour = ImVec4(0, 0, 1, 1);
-				PPTintColour = ImVec4(1, 1, 0, 1);
+				settings.tint2Colour1 = defaults.tint2Colour1;
+				settings.tint2Colour2 = defaults.tint2Colour2;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPGrayNoise"))
 		{
 			ImGui::Text("Grain size:");
-			ImGui::SliderFloat("GrainSlider", &GrainSize, 0.0f, 256.0f, "ratio = %.3f");
+			ImGui::SliderFloat("GrainSlider", &settings.grainSize, 0.0f, 256.0f, "ratio = %.3f");
+			if (UseProceduralMaps)
+			{
+				ImGui::Checkbox("Animate Noise Map", &settings.animateNoiseMap);
+			}
 
 			if (ImGui::Button("Default"))
 			{
-				GrainSize = 140.0f;
+				settings.grainSize = defaults.grainSize;
+				settings.animateNoiseMap = defaults.animateNoiseMap;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPDistort"))
 		{
 			ImGui::Text("Distort level:");
-			ImGui::SliderFloat("DistortSlider", &DistortLevel, 0.0f, 0.05f, "ratio = %.4f");
+			ImGui::SliderFloat("DistortSlider", &settings.distortLevel, 0.0f, 0.05f, "ratio = %.4f");
 
 			if (ImGui::Button("Default"))
 			{
-				DistortLevel = 0.03f;
+				settings.distortLevel = defaults.distortLevel;
 			}
 		}
 
@@ -1062,74 +887,87 @@ void RenderImGui()
 		{
 			ImGui::Text("Color widget:");
 			ImGui::SameLine(); HelpMarker("Click on the colored square to open a color picker.\nCTRL+click on individual component to input value.\n");
-			ImGui::ColorEdit3("PPWaterColor", (float*)&PPWaterColour, misc_flags);
+			ImGui::ColorEdit3("PPWaterColor", &settings.waterColour.r, misc_flags);
 
 			if (ImGui::Button("Default"))
 			{
-				PPWaterColour = ImVec4(0, 1, 1, 1);
+				settings.waterColour = defaults.waterColour;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPRetro"))
 		{
 			ImGui::Text("Retro settings:");
-			ImGui::SliderFloat("Distort Slider", &Pixelation, 1.0f, 1024.0f, "ratio = %.1f");
-			ImGui::SliderFloat("Colour Depth", &ColourDepth, 1.0f, 32.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Distort Slider", &settings.pixelation, 1.0f, 1024.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Colour Depth", &settings.colourDepth, 1.0f, 32.0f, "ratio = %.1f");
 
 			if (ImGui::Button("Default"))
 			{
-				DistortLevel = 120.0f;
-				ColourDepth = 4.0f;
+				settings.pixelation = defaults.pixelation;
+				settings.colourDepth = defaults.colourDepth;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPGaussianBlur"))
 		{
 			ImGui::Text("Blur settings:");
-			ImGui::SliderFloat("Blur Strength Slider", &GaussianBlurSigma, 1.0f, 40.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Blur Strength Slider", &settings.gaussianBlurSigma, 1.0f, 40.0f, "ratio = %.1f");
+			backendChanged |= ImGui::Combo("Blur Backend", (int*)&settings.blurBackend, BlurBackendNames, NumBlurBackends);
+			ImGui::SameLine(); HelpMarker("Dual Filter blurs in both directions, a horizontal and vertical blur pair needs only one dual filter blur.\n");
+			ImGui::SliderInt("Blur Dual Filter Iterations", &settings.blurDualFilterIterations, 1, MaxDualFilterLevels);
+			ImGui::SliderFloat("Dual Filter Offset", &settings.dualFilterOffset, 0.5f, 3.0f, "ratio = %.2f");
 
 			if (ImGui::Button("Default"))
 			{
-				GaussianBlurSigma = 5.0f;
+				settings.gaussianBlurSigma = defaults.gaussianBlurSigma;
+				settings.blurBackend = defaults.blurBackend;
+				settings.blurDualFilterIterations = defaults.blurDualFilterIterations;
+				settings.dualFilterOffset = defaults.dualFilterOffset;
+				backendChanged = true;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPBloom"))
 		{
 			ImGui::Text("Bloom settings:");
-			ImGui::SliderFloat("Bloom Strength Slider", &GaussianBlurSigma, 0.0f, 64.0f, "ratio = %1.0f");
-			ImGui::SliderFloat("Bloom Threshold Slider", &BloomThreshold, 0.0f, 1.0f, "ratio = %.3f");
-			ImGui::SliderFloat("Bloom Pixelation Slider", &BloomPixelation, 1.0f, 1024.0f, "ratio = %.1f");
-			ImGui::SliderFloat("Bloom Intensity Slider", &BloomIntensity, 0.0f, 3.0f, "ratio = %.1f");
-			ImGui::SliderFloat("Original Intensity Slider", &BloomOriginalIntensity, 0.0f, 3.0f, "ratio = %.1f");
-			ImGui::SliderFloat("Bloom Saturation Slider", &BloomSaturation, 0.0f, 3.0f, "ratio = %.1f");
-			ImGui::SliderFloat("Original Saturation Slider", &BloomOriginalSaturation, 0.0f, 3.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Bloom Strength Slider", &settings.bloomStrength, 0.0f, 64.0f, "ratio = %1.0f");
+			ImGui::SliderFloat("Bloom Threshold Slider", &settings.bloomThreshold, 0.0f, 1.0f, "ratio = %.3f");
+			ImGui::SliderFloat("Bloom Pixelation Slider", &settings.bloomPixelation, 1.0f, 1024.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Bloom Intensity Slider", &settings.bloomIntensity, 0.0f, 3.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Original Intensity Slider", &settings.bloomOriginalIntensity, 0.0f, 3.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Bloom Saturation Slider", &settings.bloomSaturation, 0.0f, 3.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Original Saturation Slider", &settings.bloomOriginalSaturation, 0.0f, 3.0f, "ratio = %.1f");
+			backendChanged |= ImGui::Combo("Bloom Blur Backend", (int*)&settings.bloomBlurBackend, BlurBackendNames, NumBlurBackends);
+			ImGui::SliderInt("Bloom Dual Filter Iterations", &settings.bloomDualFilterIterations, 1, MaxDualFilterLevels);
 
 			if (ImGui::Button("Default"))
 			{
-				GaussianBlurSigma = 40.0f;
-				BloomThreshold = 0.3f;
-				BloomPixelation = 512;
-
-				BloomIntensity = 1.3;
-				BloomOriginalIntensity = 1.0;
-				BloomSaturation = 1.0;
-				BloomOriginalSaturation = 1.0;
+				settings.bloomStrength = defaults.bloomStrength;
+				settings.bloomThreshold = defaults.bloomThreshold;
+				settings.bloomPixelation = defaults.bloomPixelation;
+
+				settings.bloomIntensity = defaults.bloomIntensity;
+				settings.bloomOriginalIntensity = defaults.bloomOriginalIntensity;
+				settings.bloomSaturation = defaults.bloomSaturation;
+				settings.bloomOriginalSaturation = defaults.bloomOriginalSaturation;
+				settings.bloomBlurBackend = defaults.bloomBlurBackend;
+				settings.bloomDualFilterIterations = defaults.bloomDualFilterIterations;
+				backendChanged = true;
 			}
 		}
 
 		if (ImGui::CollapsingHeader("PPGameboy"))
 		{
 			ImGui::Text("Gameboy settings:");
-			ImGui::SliderFloat("Gameboy Pixelation Slider", &GameboyPixels, 1.0f, 1024.0f, "ratio = %.1f");
-			ImGui::SliderFloat("Gameboy Colour Depth Slider", &GameboyColourDepth, 0.0f, 32.0f, "ratio = %.2f");
-			ImGui::ColorEdit3("Color", (float*)&GameboyColour, misc_flags);
+			ImGui::SliderFloat("Gameboy Pixelation Slider", &settings.gameboyPixels, 1.0f, 1024.0f, "ratio = %.1f");
+			ImGui::SliderFloat("Gameboy Colour Depth Slider", &settings.gameboyColourDepth, 0.0f, 32.0f, "ratio = %.2f");
+			ImGui::ColorEdit3("Color", &settings.gameboyColour.r, misc_flags);
 
 			if (ImGui::Button("Default"))
 			{
-				GameboyPixels = 150.0f;
-				GameboyColourDepth = 4.0f;
-				GameboyColour = ImVec4(0.509f, 0.675f, 0.059f, 1.0f);
+				settings.gameboyPixels = defaults.gameboyPixels;
+				settings.gameboyColourDepth = defaults.gameboyColourDepth;
+				settings.gameboyColour = defaults.gameboyColour;
 			}
 		}
 
@@ -1140,6 +978,11 @@ void RenderImGui()
 			misc_flags = ((drag_and_drop ? 0 : ImGuiColorEditFlags_NoDragDrop) | (options_menu ? 0 : ImGuiColorEditFlags_NoOptions));
 		}
 
+		if (backendChanged)
+		{
+			CompilePostProcessPlan(&PPPresets[CurrentPreset]);
+		}
+
 		ImGui::End();
 	}
 
@@ -1183,8 +1026,11 @@ void RenderSceneText()
 // Update the scene between rendering
 void UpdateScene( float updateTime )
 {
-	// Call all entity update functions
-	EntityManager.UpdateAllEntities( updateTime );
+	// Wait for the simulation steps started last frame, then hand their results to the renderer. The simulation is
+	// stopped until the next steps are started below, so entities may be used freely in between
+	Simulation->Wait();
+	EntityManager.TakeSnapshot();
+	EntityManager.SetInterpolation( Simulation->GetInterpolation() );
 
 	// Update any post processes that need updates
 	UpdatePostProcesses( updateTime );
@@ -1198,21 +1044,17 @@ void UpdateScene( float updateTime )
 
 	// Choose post-process
 
-	// Rotate cube and attach light to it
+	// Attach light to the cube where it is rendered
 	CEntity* cubey = EntityManager.GetEntity( "Cubey" );
-	cubey->Matrix().RotateX( ToRadians(53.0f) * updateTime );
-	cubey->Matrix().RotateZ( ToRadians(42.0f) * updateTime );
-	cubey->Matrix().RotateWorldY( ToRadians(12.0f) * updateTime );
-	Lights[1]->SetPosition( cubey->Position() );
-	
-	// Rotate polygon post-processed entity
-	CEntity* ppEntity = EntityManager.GetEntity( "PostProcessBlock" );
-	ppEntity->Matrix().RotateY( ToRadians(30.0f) * updateTime );
+	Lights[1]->SetPosition( cubey->GetInterpolatedMatrix().Position() );
 
 	// Move the camera
 	MainCamera->Control( Key_Up, Key_Down, Key_Left, Key_Right, Key_W, Key_S, Key_A, Key_D, 
 	                     CameraMoveSpeed * updateTime, CameraRotSpeed * updateTime );
 
+	// Start the simulation steps covering the time passed, they run while the next frame is rendered
+	Simulation->Start( updateTime );
+
 	// Accumulate update times to calculate the average over a given period
 	SumUpdateTimes += updateTime;
 	++NumUpdateTimes;
@@ -1224,5 +1066,23 @@ void UpdateScene( float updateTime )
 	}
 }
 
+// Advance the simulated part of the scene by one fixed step. Runs on the simulation thread when the update is
+// pipelined, so must only change entities
+void UpdateSimulation( float stepTime )
+{
+	// Rotate cube
+	CEntity* cubey = EntityManager.GetEntity( "Cubey" );
+	cubey->Matrix().RotateX( ToRadians(53.0f) * stepTime );
+	cubey->Matrix().RotateZ( ToRadians(42.0f) * stepTime );
+	cubey->Matrix().RotateWorldY( ToRadians(12.0f) * stepTime );
+
+	// Rotate polygon post-processed entity
+	CEntity* ppEntity = EntityManager.GetEntity( "PostProcessBlock" );
+	ppEntity->Matrix().RotateY( ToRadians(30.0f) * stepTime );
+
+	// Call all entity update functions, then update the matrices of those that moved
+	EntityManager.UpdateAllEntities( stepTime );
+}
+
 
 } // namespace gen
@@ -35,6 +35,12 @@ void PostProcessShutdown();
 // Draw one frame of the scene
 void RenderScene();
 
+// Render the scene and post-processing for one frame, everything except the UI
+void RenderFrame();
+
+// Measure the CPU cost of submitting a frame by rendering frames to the null device
+void ProfileSubmission();
+
 // full screen post process
 void FullScreenPostProcess();
 
@@ -47,4 +53,7 @@ void RenderSceneText();
 // Update the scene between rendering
 void UpdateScene( float updateTime );
 
+// Advance the simulated part of the scene by one fixed step
+void UpdateSimulation( float stepTime );
+
 } // namespace gen
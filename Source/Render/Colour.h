@@ -8,8 +8,6 @@
 #ifndef GEN_COLOUR_H_INCLUDED
 #define GEN_COLOUR_H_INCLUDED
 
-#include <d3dx9.h>
-
 #include "Defines.h"
 
 namespace gen
@@ -34,17 +32,6 @@ struct SColourRGBA
 inline SColourRGBA operator*( const SColourRGBA& c, const TFloat32 s ) { return SColourRGBA(c.r*s, c.g*s, c.b*s, c.a); }
 inline SColourRGBA operator*( const TFloat32 s, const SColourRGBA& c ) { return SColourRGBA(c.r*s, c.g*s, c.b*s, c.a); }
 
-// Reinterpret a SColourRGBA as a D3DXCOLOR - in various forms (const & ptr)
-inline D3DXCOLOR& ToD3DXCOLOR( SColourRGBA& colour )
-{
-	return *reinterpret_cast<D3DXCOLOR*>(&colour);
-}
-
-inline const D3DXCOLOR& ToD3DXCOLOR( const SColourRGBA& colour )
-{
-	return *reinterpret_cast<const D3DXCOLOR*>(&colour);
-}
-
 
 } // namespace gen
 
@@ -0,0 +1,124 @@
+/***************************************************************************************
+	EffectParams.cpp
+
+	Packed block of effect parameters, uploading only changed values
+****************************************************************************************/
+
+#include <string.h>
+
+#include "EffectParams.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Construction / setup
+//-----------------------------------------------------------------------------
+
+CEffectParamBlock::CEffectParamBlock()
+{
+	m_Backend = 0;
+	m_Version = 0;
+	m_CommittedVersion = 0;
+	ResetStats();
+}
+
+// Set up the block with the given table of parameters, each parameter is referred to by its index in the table
+bool CEffectParamBlock::Initialise( IEffectParamBackend* backend, const SEffectParamDesc* params, TUInt32 numParams )
+{
+	m_Backend = backend;
+
+	// Pack parameters one after another
+	m_Params.resize( numParams );
+	TUInt32 offset = 0;
+	bool success = true;
+	for (TUInt32 param = 0; param < numParams; ++param)
+	{
+		m_Params[param].offset = offset;
+		m_Params[param].size = params[param].size;
+		offset += (params[param].size + 3) & ~3u;
+
+		if (!m_Backend->BindParam( param, params[param].name )) success = false;
+	}
+	m_Data.assign( offset, 0 );
+
+	// All dirty so the first commit uploads everything
+	m_DirtyBits.assign( (numParams + 31) / 32, 0xffffffff );
+	++m_Version;
+
+	return success;
+}
+
+
+//-----------------------------------------------------------------------------
+// Values
+//-----------------------------------------------------------------------------
+
+// Set the value of a parameter, the parameter is only marked dirty if the value differs from the current value
+void CEffectParamBlock::SetRawValue( TUInt32 param, const void* data, TUInt32 size )
+{
+	++m_NumSets;
+
+	TUInt8* value = &m_Data[m_Params[param].offset];
+	if (memcmp( value, data, size ) != 0)
+	{
+		memcpy( value, data, size );
+		m_DirtyBits[param >> 5] |= 1u << (param & 31);
+		++m_Version;
+		++m_NumChanges;
+	}
+}
+
+// Upload all dirty parameters to the backend and clear the dirty bits
+void CEffectParamBlock::Commit()
+{
+	if (m_CommittedVersion == m_Version)
+	{
+		return;
+	}
+
+	for (TUInt32 word = 0; word < m_DirtyBits.size(); ++word)
+	{
+		TUInt32 bits = m_DirtyBits[word];
+		while (bits)
+		{
+			// Index of lowest set bit, then clear it
+			TUInt32 bit = 0;
+			while (!(bits & (1u << bit))) ++bit;
+			bits &= bits - 1;
+
+			TUInt32 param = word * 32 + bit;
+			if (param < m_Params.size())
+			{
+				m_Backend->UploadParam( param, &m_Data[m_Params[param].offset], m_Params[param].size );
+				++m_NumUploads;
+				m_NumBytesUploaded += m_Params[param].size;
+			}
+		}
+		m_DirtyBits[word] = 0;
+	}
+	m_CommittedVersion = m_Version;
+}
+
+// Mark all parameters dirty so the next commit uploads everything
+void CEffectParamBlock::Invalidate()
+{
+	m_DirtyBits.assign( m_DirtyBits.size(), 0xffffffff );
+	++m_Version;
+}
+
+
+//-----------------------------------------------------------------------------
+// Statistics
+//-----------------------------------------------------------------------------
+
+void CEffectParamBlock::ResetStats()
+{
+	m_NumSets = 0;
+	m_NumChanges = 0;
+	m_NumUploads = 0;
+	m_NumBytesUploaded = 0;
+}
+
+
+} // namespace gen
@@ -0,0 +1,186 @@
+/***************************************************************************************
+	EffectParams.h
+
+	Packed block of effect parameters (shader constants). Values are set into the block
+	each frame as before, but only parameters whose value has actually changed are
+	marked dirty and uploaded when the block is committed (just before a pass is
+	applied). Uploads go through a backend interface - the D3D10 backend sets effect
+	variables, the null backend just counts calls and bytes so the overhead can be
+	measured without a device (see Tools/EffectParamsBench.cpp)
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <string>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Backends
+//-----------------------------------------------------------------------------
+
+// Interface for the destination of parameter uploads
+class IEffectParamBackend
+{
+public:
+	virtual ~IEffectParamBackend() {}
+
+	// Associate a parameter index with the named effect variable. Returns false if there is no such variable
+	virtual bool BindParam( TUInt32 param, const string& name ) = 0;
+
+	// Upload the value of a parameter
+	virtual void UploadParam( TUInt32 param, const void* data, TUInt32 size ) = 0;
+};
+
+
+// Backend that uploads nowhere, counts uploads to measure the work a real backend would do
+class CNullEffectParamBackend : public IEffectParamBackend
+{
+public:
+	CNullEffectParamBackend()
+	{
+		ResetStats();
+	}
+
+	bool BindParam( TUInt32 param, const string& name )
+	{
+		return true;
+	}
+
+	void UploadParam( TUInt32 param, const void* data, TUInt32 size )
+	{
+		++m_NumUploads;
+		m_NumBytes += size;
+	}
+
+	TUInt32 GetNumUploads()
+	{
+		return m_NumUploads;
+	}
+	TUInt32 GetNumBytes()
+	{
+		return m_NumBytes;
+	}
+	void ResetStats()
+	{
+		m_NumUploads = 0;
+		m_NumBytes = 0;
+	}
+
+private:
+	TUInt32 m_NumUploads;
+	TUInt32 m_NumBytes;
+};
+
+
+//-----------------------------------------------------------------------------
+// Parameter block
+//-----------------------------------------------------------------------------
+
+// Description of a parameter: effect variable name and size of value in bytes
+struct SEffectParamDesc
+{
+	const char* name;
+	TUInt32     size;
+};
+
+// Packed block of effect parameter values with a dirty bit for each
+class CEffectParamBlock
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	CEffectParamBlock();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CEffectParamBlock( const CEffectParamBlock& );
+	CEffectParamBlock& operator=( const CEffectParamBlock& );
+
+public:
+	/////////////////////////////////////
+	//	Public interface
+
+	// Set up the block with the given table of parameters, each parameter is referred to by its index in the
+	// table. Binds each parameter in the backend, returns false if any fail. All parameters start dirty
+	bool Initialise( IEffectParamBackend* backend, const SEffectParamDesc* params, TUInt32 numParams );
+
+	// Set the value of a parameter, the parameter is only marked dirty if the value differs from the current value.
+	// Size must not exceed the size given for the parameter
+	void SetRawValue( TUInt32 param, const void* data, TUInt32 size );
+	void SetFloat( TUInt32 param, TFloat32 value )
+	{
+		SetRawValue( param, &value, sizeof(value) );
+	}
+
+	// Upload all dirty parameters to the backend and clear the dirty bits. Does nothing if no value has changed
+	// since the last commit
+	void Commit();
+
+	// Mark all parameters dirty so the next commit uploads everything, e.g. after the effect's variables have been
+	// changed by something other than this block
+	void Invalidate();
+
+	// Version number increases with every change to a value, can be used to detect changes to the block
+	TUInt32 GetVersion()
+	{
+		return m_Version;
+	}
+
+
+	/////////////////////////////////////
+	//	Statistics
+
+	TUInt32 GetNumSets()
+	{
+		return m_NumSets;
+	}
+	TUInt32 GetNumChanges()
+	{
+		return m_NumChanges;
+	}
+	TUInt32 GetNumUploads()
+	{
+		return m_NumUploads;
+	}
+	TUInt32 GetNumBytesUploaded()
+	{
+		return m_NumBytesUploaded;
+	}
+	void ResetStats();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Location of a parameter in the packed data
+	struct SParam
+	{
+		TUInt32 offset;
+		TUInt32 size;
+	};
+
+	IEffectParamBackend* m_Backend;
+
+	vector<SParam> m_Params;
+	vector<TUInt8> m_Data;      // All values packed together, each aligned to 4 bytes
+	vector<TUInt32> m_DirtyBits; // One bit per parameter
+
+	TUInt32 m_Version;
+	TUInt32 m_CommittedVersion;
+
+	TUInt32 m_NumSets;
+	TUInt32 m_NumChanges;
+	TUInt32 m_NumUploads;
+	TUInt32 m_NumBytesUploaded;
+};
+
+
+} // namespace gen
@@ -0,0 +1,38 @@
+/***************************************************************************************
+	EffectParamsDevice.cpp
+
+	Effect parameter backend that uploads to the variables of an effect on the render device
+****************************************************************************************/
+
+#include "EffectParamsDevice.h"
+
+namespace gen
+{
+
+// Get reference to global variables from another source file
+extern IRenderDevice* RenderDevice;
+
+CRenderDeviceParamBackend::CRenderDeviceParamBackend( SRenderEffect* effect )
+{
+	m_Effect = effect;
+}
+
+// Associate a parameter index with the named effect variable. Returns false if there is no such variable
+bool CRenderDeviceParamBackend::BindParam( TUInt32 param, const string& name )
+{
+	if (param >= m_Variables.size())
+	{
+		m_Variables.resize( param + 1, NULL );
+	}
+	m_Variables[param] = RenderDevice->GetVariable( m_Effect, name );
+	return m_Variables[param] != NULL;
+}
+
+// Upload the value of a parameter to its effect variable
+void CRenderDeviceParamBackend::UploadParam( TUInt32 param, const void* data, TUInt32 size )
+{
+	RenderDevice->SetVariable( m_Variables[param], data, size );
+}
+
+
+} // namespace gen
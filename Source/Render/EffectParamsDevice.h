@@ -0,0 +1,37 @@
+/***************************************************************************************
+	EffectParamsDevice.h
+
+	Effect parameter backend that uploads to the variables of an effect on the render device
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "EffectParams.h"
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+class CRenderDeviceParamBackend : public IEffectParamBackend
+{
+public:
+	// Uploads go to the current render device (the global RenderDevice), so follow any change of device
+	CRenderDeviceParamBackend( SRenderEffect* effect );
+
+	// Associate a parameter index with the named effect variable. Returns false if there is no such variable
+	bool BindParam( TUInt32 param, const string& name );
+
+	// Upload the value of a parameter to its effect variable
+	void UploadParam( TUInt32 param, const void* data, TUInt32 size );
+
+private:
+	SRenderEffect* m_Effect;
+	vector<SRenderVariable*> m_Variables;
+};
+
+
+} // namespace gen
@@ -4,22 +4,34 @@
 	Mesh class implementation
 ********************************************/
 
-#include <d3d10.h>
-#include <d3dx10.h>
 #include "Mesh.h"
+#include "RenderDevice.h"
+#if defined(_MSC_VER)
 #include "CImportXFile.h"
+#endif
 #include "RenderMethod.h"
+#include "RenderQueue.h"
+#include "OcclusionCuller.h"
+#include "MeshSimplify.h"
 
 namespace gen
 {
 
 // Get reference to global variables from another source file
 // Not good practice - these functions should be part of a class with this as a member
-extern ID3D10Device* g_pd3dDevice;
+extern IRenderDevice* RenderDevice;
 
 // Folder for all texture and mesh files
 extern const string MediaFolder;
 
+// Fewest triangles in a sub-mesh (or level of detail) worth simplifying further
+const TUInt32 MinLodTriangles = 64;
+
+// Size on screen (the bounding sphere's diameter over the screen height) below which each level of detail is used,
+// and the fraction the size must move past these sizes before the level changes
+const TFloat32 LodScreenSizes[CMesh::MaxLods] = { 1.0f, 0.25f, 0.1f, 0.04f };
+const TFloat32 LodHysteresis = 0.15f;
+
 
 //-----------------------------------------------------------------------------
 // Constructor / destructor
@@ -37,6 +49,7 @@ CMesh::CMesh()
 	m_NumSubMeshes = 0;
 	m_SubMeshes = 0;
 	m_SubMeshesDX = 0;
+	m_NumLods = 0;
 
 	m_NumMaterials = 0;
 	m_Materials = 0;
@@ -56,7 +69,7 @@ void CMesh::ReleaseResources()
 	{
 		for (TUInt32 texture = 0; texture < m_Materials[material].numTextures; ++texture)
 		{
-			if (m_Materials[material].textures[texture]) m_Materials[material].textures[texture]->Release();
+			RenderDevice->ReleaseResource( m_Materials[material].textures[texture] );
 		}
 	}
 	delete[] m_Materials;
@@ -65,15 +78,23 @@ void CMesh::ReleaseResources()
 
 	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
 	{
-		if (m_SubMeshesDX[subMesh].indexBuffer)	 m_SubMeshesDX[subMesh].indexBuffer->Release();
-		if (m_SubMeshesDX[subMesh].vertexBuffer) m_SubMeshesDX[subMesh].vertexBuffer->Release();
-		if (m_SubMeshesDX[subMesh].vertexLayout) m_SubMeshesDX[subMesh].vertexLayout->Release();
+		for (TUInt32 lod = 0; lod < m_SubMeshesDX[subMesh].numLods; ++lod)
+		{
+			RenderDevice->ReleaseBuffer( m_SubMeshesDX[subMesh].indexBuffers[lod] );
+		}
+		RenderDevice->ReleaseBuffer( m_SubMeshesDX[subMesh].vertexBuffer );
+		RenderDevice->ReleaseInputLayout( m_SubMeshesDX[subMesh].vertexLayout );
+		if (m_SubMeshesDX[subMesh].instancedLayout)
+		{
+			RenderDevice->ReleaseInputLayout( m_SubMeshesDX[subMesh].instancedLayout );
+		}
 	}
 	delete[] m_SubMeshesDX;
 	delete[] m_SubMeshes;
 	m_SubMeshesDX = 0;
 	m_SubMeshes = 0;
 	m_NumSubMeshes = 0;
+	m_NumLods = 0;
 
 	delete[] m_Nodes;
 	m_Nodes = 0;
@@ -230,9 +251,11 @@ bool CMesh::GetVertex( CVector3* pVertex )
 // Creation
 //-----------------------------------------------------------------------------
 
-// Create the model from an X-File, returns true on success
+// Create the model from an X-File, returns true on success. X-Files are imported with D3DX, so are only supported in
+// Windows builds
 bool CMesh::Load( const string& fileName )
 {
+#if defined(_MSC_VER)
 	// Create a X-File import helper class
 	CImportXFile importFile;
 
@@ -257,14 +280,48 @@ bool CMesh::Load( const string& fileName )
 		return false;
 	}
 
+	// Get node, material and sub-mesh data from import class
+	vector<SMeshNode> nodes( importFile.GetNumNodes() );
+	for (TUInt32 node = 0; node < nodes.size(); ++node)
+	{
+		importFile.GetNode( node, &nodes[node] );
+	}
+	vector<SMeshMaterial> materials( importFile.GetNumMaterials() );
+	for (TUInt32 material = 0; material < materials.size(); ++material)
+	{
+		importFile.GetMaterial( material, &materials[material] );
+	}
+	vector<SSubMesh> subMeshes( importFile.GetNumSubMeshes() );
+	for (TUInt32 subMesh = 0; subMesh < subMeshes.size(); ++subMesh)
+	{
+		// Determine if the render method for this mesh needs tangents
+		ERenderMethod meshMethod = importFile.GetSubMeshRenderMethod( subMesh );
+		bool needTangents = RenderMethodUsesTangents( meshMethod );
+
+		importFile.GetSubMesh( subMesh, &subMeshes[subMesh], needTangents );
+	}
+
+	return Create( nodes.empty() ? 0 : &nodes[0], static_cast<TUInt32>(nodes.size()),
+	               materials.empty() ? 0 : &materials[0], static_cast<TUInt32>(materials.size()),
+	               subMeshes.empty() ? 0 : &subMeshes[0], static_cast<TUInt32>(subMeshes.size()) );
+#else
+	return false;
+#endif
+}
+
+// Create the mesh from given nodes, materials and sub-meshes, returns true on success. The sub-meshes' vertex and face
+// data is referred to by the mesh, not copied
+bool CMesh::Create( const SMeshNode* nodes, TUInt32 numNodes, const SMeshMaterial* materials, TUInt32 numMaterials,
+                    const SSubMesh* subMeshes, TUInt32 numSubMeshes )
+{
 	// Release any existing geometry
 	if (m_HasGeometry)
 	{
 		ReleaseResources();
 	}
 
-	// Get node data from import class
-	m_NumNodes = importFile.GetNumNodes();
+	// Copy nodes
+	m_NumNodes = numNodes;
 	m_Nodes = new SMeshNode[m_NumNodes];
 	if (!m_Nodes)
 	{
@@ -272,45 +329,36 @@ bool CMesh::Load( const string& fileName )
 	}
 	for (TUInt32 node = 0; node < m_NumNodes; ++node)
 	{
-		importFile.GetNode( node, &m_Nodes[node] );
+		m_Nodes[node] = nodes[node];
 	}
 
-	// Get material data from import class, also load textures
-	TUInt32 requiredMaterials = importFile.GetNumMaterials();
-	m_Materials = new SMeshMaterialDX[requiredMaterials];
+	// Prepare materials, also load textures
+	m_Materials = new SMeshMaterialDX[numMaterials];
 	if (!m_Materials)
 	{
 		ReleaseResources();
 		return false;
 	}
-	for (m_NumMaterials = 0; m_NumMaterials < requiredMaterials; ++m_NumMaterials)
+	for (m_NumMaterials = 0; m_NumMaterials < numMaterials; ++m_NumMaterials)
 	{
-		SMeshMaterial importMaterial; 
-		importFile.GetMaterial( m_NumMaterials, &importMaterial );
-		if (!CreateMaterialDX( importMaterial, &m_Materials[m_NumMaterials] ))
+		if (!CreateMaterialDX( materials[m_NumMaterials], &m_Materials[m_NumMaterials] ))
 		{
 			ReleaseResources();
 			return false;
 		}
 	}
 
-	// Get submesh data from import class - convert to DirectX data for rendering
-	// but retain original data for easy access to vertices / faces
-	TUInt32 requiredSubMeshes = importFile.GetNumSubMeshes();
-	m_SubMeshes = new SSubMesh[requiredSubMeshes];
-	m_SubMeshesDX = new SSubMeshDX[requiredSubMeshes];
+	// Convert sub-meshes to DirectX data for rendering but retain original data for easy access to vertices / faces
+	m_SubMeshes = new SSubMesh[numSubMeshes];
+	m_SubMeshesDX = new SSubMeshDX[numSubMeshes];
 	if (!m_SubMeshes || !m_SubMeshesDX)
 	{
 		ReleaseResources();
 		return false;
 	}
-	for (m_NumSubMeshes = 0; m_NumSubMeshes < requiredSubMeshes; ++m_NumSubMeshes)
+	for (m_NumSubMeshes = 0; m_NumSubMeshes < numSubMeshes; ++m_NumSubMeshes)
 	{
-		// Determine if the render method for this mesh needs tangents
-		ERenderMethod meshMethod = importFile.GetSubMeshRenderMethod( m_NumSubMeshes );
-		bool needTangents = RenderMethodUsesTangents( meshMethod );
-
-		importFile.GetSubMesh( m_NumSubMeshes, &m_SubMeshes[m_NumSubMeshes], needTangents );
+		m_SubMeshes[m_NumSubMeshes] = subMeshes[m_NumSubMeshes];
 		if (!CreateSubMeshDX( m_SubMeshes[m_NumSubMeshes], &m_SubMeshesDX[m_NumSubMeshes] ))
 		{
 			ReleaseResources();
@@ -339,132 +387,158 @@ bool CMesh::CreateSubMeshDX
 	// Copy node and material
 	subMeshDX->node = subMesh.node;
 	subMeshDX->material = subMesh.material;
+	subMeshDX->geometryId = NewRenderGeometryId();
 
 	// Buffer sizes
 	subMeshDX->numVertices = subMesh.numVertices;
-	subMeshDX->numIndices = subMesh.numFaces * 3; // Using triangle lists, so always 3 indexes per face
+	subMeshDX->numLods = 0;
 
 	// Create vertex element list & layout.
 	unsigned int numElts = 0;
 	unsigned int offset = 0;
 
 	// Position is always required
-	subMeshDX->vertexElts[numElts].SemanticName = "POSITION";   // Semantic in HLSL (what is this data for)
-	subMeshDX->vertexElts[numElts].SemanticIndex = 0;           // Index to add to semantic (a count for this kind of data, when using multiple of the same type, e.g. TEXCOORD0, TEXCOORD1)
-	subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32B32_FLOAT; // Type of data - this one will be a float3 in the shader. Most data communicated as though it were colours
-	subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;  // Offset of element from start of vertex data (e.g. if we have position (float3), uv (float2) then normal, the normal's offset is 5 floats = 5*4 = 20)
-	subMeshDX->vertexElts[numElts].InputSlot = 0;               // For when using multiple vertex buffers (e.g. instancing - an advanced topic)
-	subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA; // Use this value for most cases (only changed for instancing)
-	subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;                     // --"--
+	subMeshDX->vertexElts[numElts].semanticName = "POSITION";  // Semantic in HLSL (what is this data for)
+	subMeshDX->vertexElts[numElts].semanticIndex = 0;          // Index to add to semantic (a count for this kind of data, when using multiple of the same type, e.g. TEXCOORD0, TEXCOORD1)
+	subMeshDX->vertexElts[numElts].format = VertexFloat3;      // Type of data - this one will be a float3 in the shader
+	subMeshDX->vertexElts[numElts].offset = offset;            // Offset of element from start of vertex data (e.g. if we have position (float3), uv (float2) then normal, the normal's offset is 5 floats = 5*4 = 20)
+	subMeshDX->vertexElts[numElts].slot = 0;                   // For when using multiple vertex buffers (e.g. instancing - an advanced topic)
+	subMeshDX->vertexElts[numElts].instanceStep = 0;           // Use this value for most cases (only changed for instancing)
 	offset += 12;
 	++numElts;
 
 	// Repeat for each kind of vertex data
 	if (subMesh.hasSkinningData) // If sub-mesh contains skinning data
 	{
-		subMeshDX->vertexElts[numElts].SemanticName = "BLENDWEIGHT";
-		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
-		subMeshDX->vertexElts[numElts].InputSlot = 0;
-		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
-		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
+		subMeshDX->vertexElts[numElts].semanticName = "BLENDWEIGHT";
+		subMeshDX->vertexElts[numElts].semanticIndex = 0;
+		subMeshDX->vertexElts[numElts].format = VertexFloat4;
+		subMeshDX->vertexElts[numElts].offset = offset;
+		subMeshDX->vertexElts[numElts].slot = 0;
+		subMeshDX->vertexElts[numElts].instanceStep = 0;
 		offset += 16;
 		++numElts;
-		subMeshDX->vertexElts[numElts].SemanticName = "BLENDINDICES";
-		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R8G8B8A8_UINT;
-		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
-		subMeshDX->vertexElts[numElts].InputSlot = 0;
-		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
-		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
+		subMeshDX->vertexElts[numElts].semanticName = "BLENDINDICES";
+		subMeshDX->vertexElts[numElts].semanticIndex = 0;
+		subMeshDX->vertexElts[numElts].format = VertexUByte4;
+		subMeshDX->vertexElts[numElts].offset = offset;
+		subMeshDX->vertexElts[numElts].slot = 0;
+		subMeshDX->vertexElts[numElts].instanceStep = 0;
 		offset += 4;
 		++numElts;
 	}
 	if (subMesh.hasNormals)
 	{
-		subMeshDX->vertexElts[numElts].SemanticName = "NORMAL";
-		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
-		subMeshDX->vertexElts[numElts].InputSlot = 0;
-		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
-		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
+		subMeshDX->vertexElts[numElts].semanticName = "NORMAL";
+		subMeshDX->vertexElts[numElts].semanticIndex = 0;
+		subMeshDX->vertexElts[numElts].format = VertexFloat3;
+		subMeshDX->vertexElts[numElts].offset = offset;
+		subMeshDX->vertexElts[numElts].slot = 0;
+		subMeshDX->vertexElts[numElts].instanceStep = 0;
 		offset += 12;
 		++numElts;
 	}
 	if (subMesh.hasTangents)
 	{
-		subMeshDX->vertexElts[numElts].SemanticName = "TANGENT";
-		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
-		subMeshDX->vertexElts[numElts].InputSlot = 0;
-		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
-		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
+		subMeshDX->vertexElts[numElts].semanticName = "TANGENT";
+		subMeshDX->vertexElts[numElts].semanticIndex = 0;
+		subMeshDX->vertexElts[numElts].format = VertexFloat3;
+		subMeshDX->vertexElts[numElts].offset = offset;
+		subMeshDX->vertexElts[numElts].slot = 0;
+		subMeshDX->vertexElts[numElts].instanceStep = 0;
 		offset += 12;
 		++numElts;
 	}
 	if (subMesh.hasTextureCoords)
 	{
-		subMeshDX->vertexElts[numElts].SemanticName = "TEXCOORD";
-		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32_FLOAT;
-		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
-		subMeshDX->vertexElts[numElts].InputSlot = 0;
-		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
-		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
+		subMeshDX->vertexElts[numElts].semanticName = "TEXCOORD";
+		subMeshDX->vertexElts[numElts].semanticIndex = 0;
+		subMeshDX->vertexElts[numElts].format = VertexFloat2;
+		subMeshDX->vertexElts[numElts].offset = offset;
+		subMeshDX->vertexElts[numElts].slot = 0;
+		subMeshDX->vertexElts[numElts].instanceStep = 0;
 		offset += 8;
 		++numElts;
 	}
 	if (subMesh.hasVertexColours)
 	{
-		subMeshDX->vertexElts[numElts].SemanticName = "COLOR";
-		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R8G8B8A8_UNORM; // A RGBA colour with 1 byte (0-255) per component
-		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
-		subMeshDX->vertexElts[numElts].InputSlot = 0;
-		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
-		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
+		subMeshDX->vertexElts[numElts].semanticName = "COLOR";
+		subMeshDX->vertexElts[numElts].semanticIndex = 0;
+		subMeshDX->vertexElts[numElts].format = VertexUByte4Norm; // A RGBA colour with 1 byte (0-255) per component
+		subMeshDX->vertexElts[numElts].offset = offset;
+		subMeshDX->vertexElts[numElts].slot = 0;
+		subMeshDX->vertexElts[numElts].instanceStep = 0;
 		offset += 4;
 		++numElts;
 	}
 	subMeshDX->vertexSize = offset;
 
-	// Given the vertex element list, pass it to DirectX to create a vertex layout. We also need to pass an example of a technique that will
+	// Given the vertex element list, pass it to the device to create a vertex layout. We also need to pass an example of a technique that will
 	// render this model. We will only be able to render this model with techniques that have the same vertex input as the example we use here
-	D3D10_PASS_DESC PassDesc;
-	ID3D10EffectTechnique* technique = GetRenderMethodTechnique( m_Materials[subMeshDX->material].renderMethod );
-	technique->GetPassByIndex( 0 )->GetDesc( &PassDesc );
-	g_pd3dDevice->CreateInputLayout( subMeshDX->vertexElts, numElts, PassDesc.pIAInputSignature, PassDesc.IAInputSignatureSize, &subMeshDX->vertexLayout );
+	SRenderTechnique* technique = GetRenderMethodTechnique( m_Materials[subMeshDX->material].renderMethod );
+	subMeshDX->vertexLayout = RenderDevice->CreateInputLayout( subMeshDX->vertexElts, numElts, technique );
+
+	// If the render method can be instanced, also create a layout with the rows of a world matrix for each instance,
+	// read from a second vertex buffer (the instance buffer) stepping once per instance
+	subMeshDX->instancedLayout = 0;
+	SRenderTechnique* instancedTechnique = GetRenderMethodInstancedTechnique( m_Materials[subMeshDX->material].renderMethod );
+	if (instancedTechnique)
+	{
+		for (unsigned int row = 0; row < 4; ++row)
+		{
+			subMeshDX->vertexElts[numElts + row].semanticName = "WORLD";
+			subMeshDX->vertexElts[numElts + row].semanticIndex = row;
+			subMeshDX->vertexElts[numElts + row].format = VertexFloat4;
+			subMeshDX->vertexElts[numElts + row].offset = row * 16;
+			subMeshDX->vertexElts[numElts + row].slot = 1;
+			subMeshDX->vertexElts[numElts + row].instanceStep = 1;
+		}
+		subMeshDX->instancedLayout = RenderDevice->CreateInputLayout( subMeshDX->vertexElts, numElts + 4, instancedTechnique );
+	}
 
 
 	// Create the vertex buffer and fill it with the sub-mesh vertex data
-	D3D10_BUFFER_DESC bufferDesc;
-	bufferDesc.BindFlags = D3D10_BIND_VERTEX_BUFFER;
-	bufferDesc.Usage = D3D10_USAGE_DEFAULT; // Not a dynamic buffer
-	bufferDesc.ByteWidth = subMeshDX->numVertices * subMeshDX->vertexSize; // Buffer size
-	bufferDesc.CPUAccessFlags = 0;   // Indicates that CPU won't access this buffer at all after creation
-	bufferDesc.MiscFlags = 0;
-	D3D10_SUBRESOURCE_DATA initData; // Initial data
-	initData.pSysMem = subMesh.vertices;   
-	if (FAILED( g_pd3dDevice->CreateBuffer( &bufferDesc, &initData, &subMeshDX->vertexBuffer )))
+	subMeshDX->vertexBuffer = RenderDevice->CreateBuffer( VertexBuffer, subMesh.vertices, subMeshDX->numVertices * subMeshDX->vertexSize );
+	if (!subMeshDX->vertexBuffer)
 	{
 		return false;
 	}
 
 
-	// Create the index buffer - assuming 2-byte (WORD) index data
-	bufferDesc.BindFlags = D3D10_BIND_INDEX_BUFFER;
-	bufferDesc.Usage = D3D10_USAGE_DEFAULT;
-	bufferDesc.ByteWidth = subMeshDX->numIndices * sizeof(WORD);
-	bufferDesc.CPUAccessFlags = 0;
-	bufferDesc.MiscFlags = 0;
-	initData.pSysMem = subMesh.faces;   
-	if (FAILED( g_pd3dDevice->CreateBuffer( &bufferDesc, &initData, &subMeshDX->indexBuffer )))
+	// Create the index buffer - assuming 2-byte (TUInt16) index data
+	subMeshDX->numIndices[0] = subMesh.numFaces * 3; // Using triangle lists, so always 3 indexes per face
+	subMeshDX->indexBuffers[0] = RenderDevice->CreateBuffer( IndexBuffer, subMesh.faces, subMeshDX->numIndices[0] * sizeof(TUInt16) );
+	if (!subMeshDX->indexBuffers[0])
 	{
 		return false;
 	}
+	subMeshDX->numLods = 1;
+
+	// Create simplified levels of detail, each aiming for half the triangles of the last. Stop when simplification
+	// achieves little, e.g. when most vertices are on the sub-mesh's border or on seams, which can't be moved
+	vector<TUInt16> lodIndices[2];
+	const TUInt16* indices = reinterpret_cast<const TUInt16*>(subMesh.faces);
+	lodIndices[0].assign( indices, indices + subMeshDX->numIndices[0] );
+	TUInt32 numTriangles = subMesh.numFaces;
+	while (subMeshDX->numLods < MaxLods && numTriangles >= MinLodTriangles)
+	{
+		const vector<TUInt16>& lastIndices = lodIndices[(subMeshDX->numLods - 1) % 2];
+		vector<TUInt16>& newIndices = lodIndices[subMeshDX->numLods % 2];
+		TUInt32 numLodTriangles = SimplifyMesh( subMesh.vertices, subMesh.vertexSize, subMesh.numVertices, &lastIndices[0],
+		                                        numTriangles, numTriangles / 2, &newIndices );
+		if (numLodTriangles > numTriangles * 3 / 4) break;
+
+		TUInt32 lod = subMeshDX->numLods;
+		subMeshDX->numIndices[lod] = numLodTriangles * 3;
+		subMeshDX->indexBuffers[lod] = RenderDevice->CreateBuffer( IndexBuffer, &newIndices[0], subMeshDX->numIndices[lod] * sizeof(TUInt16) );
+		if (!subMeshDX->indexBuffers[lod])
+		{
+			return false;
+		}
+		++subMeshDX->numLods;
+		numTriangles = numLodTriangles;
+	}
+	m_NumLods = Max( m_NumLods, subMeshDX->numLods );
 
 	return true;
 }
@@ -484,10 +558,8 @@ bool CMesh::CreateMaterialDX
 	}
 
 	// Copy colours and shininess from material
-	materialDX->diffuseColour = D3DXCOLOR( material.diffuseColour.r, material.diffuseColour.g, 
-	                                       material.diffuseColour.b, material.diffuseColour.a );
-	materialDX->specularColour = D3DXCOLOR( material.specularColour.r, material.specularColour.g, 
-	                                        material.specularColour.b, material.specularColour.a );
+	materialDX->diffuseColour = material.diffuseColour;
+	materialDX->specularColour = material.specularColour;
 	materialDX->specularPower = material.specularPower;
 
 	// Load material textures
@@ -495,13 +567,18 @@ bool CMesh::CreateMaterialDX
 	for (TUInt32 texture = 0; texture < material.numTextures; ++texture)
 	{
 		string fullFileName = MediaFolder + material.textureFileNames[texture];
-		if (FAILED( D3DX10CreateShaderResourceViewFromFile( g_pd3dDevice, fullFileName.c_str(), NULL, NULL, &materialDX->textures[texture], NULL ) ))
+		materialDX->textures[texture] = RenderDevice->LoadTexture( fullFileName );
+		if (!materialDX->textures[texture])
 		{
 			string errorMsg = "Error loading texture " + fullFileName;
 			SystemMessageBox( errorMsg.c_str(), "Mesh Error" );
 			return false;
 		}
 	}
+
+	// Ids to sort by in the render queue
+	materialDX->materialId = NewRenderMaterialId();
+	materialDX->textureSetId = GetRenderTextureSetId( materialDX->textures, materialDX->numTextures );
 	return true;
 }
 
@@ -594,54 +671,78 @@ bool CMesh::PreProcess()
 // Rendering
 //-----------------------------------------------------------------------------
 
-// Render the model from the given camera using the given matrix list as a hierarchy (must be one matrix per node)
-void CMesh::Render(	CMatrix4x4* matrices, CCamera* camera, bool postProcess /*= false*/ )
+// Add the sub-meshes of the model visible from the given camera to a render queue, using the given matrix list as a
+// hierarchy (must be one matrix per node). Sub-meshes of both the normal and post-processed passes are added, the
+// queue sorts them by pass. The level of detail is chosen from the model's size on screen, starting from the level
+// in lod, which is updated
+void CMesh::AddToRenderQueue( CRenderQueue* queue, CMatrix4x4* matrices, CCamera* camera, bool cull /*= true*/,
+                              TUInt32* lod /*= 0*/ )
 {
 	if (!m_HasGeometry) return;
 
 	// Test if mesh is visible - test the mesh's bounding sphere against the camera frustum
 	CVector3 scale = matrices[0].GetScale();
 	TFloat32 scaledRadius = m_BoundingRadius * Max(scale.x, Max(scale.y, scale.z) ); // Scale bounding sphere by largest dimension of mesh scale
-	if (!camera->SphereInFrustum( matrices->Position(), scaledRadius ))
+	if (cull)
 	{
-		return;
+		if (!camera->SphereInFrustum( matrices->Position(), scaledRadius ))
+		{
+			return;
+		}
+	}
+
+	// Choose the level of detail from the size of the bounding sphere on screen, starting from the level used last
+	// time. Only move to a coarser level once the size is well below the level's size, and back to a finer level
+	// once the size is well above it
+	TUInt32 level = 0;
+	if (m_NumLods > 1)
+	{
+		TFloat32 distance = Max( camera->Position().DistanceTo( matrices->Position() ), camera->GetNearClip() );
+		TFloat32 tanHalfFOVY = Tan( camera->GetFOV() * 0.5f ) / camera->GetAspect();
+		TFloat32 screenSize = scaledRadius / (distance * tanHalfFOVY);
+		level = lod ? Min( *lod, m_NumLods - 1 ) : 0;
+		while (level + 1 < m_NumLods && screenSize < LodScreenSizes[level + 1] * (1.0f - LodHysteresis))
+		{
+			++level;
+		}
+		while (level > 0 && screenSize > LodScreenSizes[level] * (1.0f + LodHysteresis))
+		{
+			--level;
+		}
 	}
+	if (lod) *lod = level;
 
-	// Render each sub-mesh
+	// Queue each sub-mesh
 	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
 	{
-		// Get a reference to the submesh and its material to reduce code clutter
 		SSubMeshDX& subMeshDX = m_SubMeshesDX[subMesh];
 		SMeshMaterialDX& material = m_Materials[subMeshDX.material];
 
 		//****|PPPPOLY|********************************************************************************
-		// In the model rendering code, we can now request to render either normal or post-processed 
-		// materials. Post processed materials are rendered in a 2nd pass after all the normal materials
-		//
-		// Check that material type (normal or post-processed) matches request passed as parameter before rendering
-		if (RenderMethodIsPostProcess( material.renderMethod ) == postProcess)
-		{
-			// Set up render method passing material colours & textures and the sub-mesh's world matrix, also get back the fx file technique to use
-			SetRenderMethod( material.renderMethod, &material.diffuseColour, &material.specularColour, material.specularPower, material.textures, &matrices[subMeshDX.node] );
-			ID3D10EffectTechnique* technique = GetRenderMethodTechnique( material.renderMethod );
-
-			// Select vertex and index buffer for sub-mesh - assuming all geometry data is triangle lists
-			UINT offset = 0;
-			g_pd3dDevice->IASetVertexBuffers( 0, 1, &subMeshDX.vertexBuffer, &subMeshDX.vertexSize, &offset );
-			g_pd3dDevice->IASetInputLayout(subMeshDX.vertexLayout );
-			g_pd3dDevice->IASetIndexBuffer(subMeshDX.indexBuffer, DXGI_FORMAT_R16_UINT, 0 );
-			g_pd3dDevice->IASetPrimitiveTopology( D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-
-			// Render the sub-mesh. Geometry buffers and shader variables, just select the technique for this method and draw.
-			D3D10_TECHNIQUE_DESC techDesc;
-			technique->GetDesc( &techDesc );
-			for( UINT p = 0; p < techDesc.Passes; ++p )
-			{
-				technique->GetPassByIndex( p )->Apply( 0 );
-				g_pd3dDevice->DrawIndexed( subMeshDX.numIndices, 0, 0 );
-			}
-			g_pd3dDevice->DrawIndexed( subMeshDX.numIndices, 0, 0 );
-		}
+		// Post processed materials are rendered in a 2nd pass after all the normal materials. Both are
+		// queued together (culling and matrices are only done once) and the queue sorts them by pass
+		SRenderItem item;
+		item.subMesh = &subMeshDX;
+		item.material = &material;
+		item.worldMatrix = &matrices[subMeshDX.node];
+		item.lod = Min( level, subMeshDX.numLods - 1 );
+		queue->Add( item, RenderMethodIsPostProcess( material.renderMethod ) );
+	}
+}
+
+// Rasterize the triangles of the model into an occlusion culler's depth buffer, using the given matrix list as a
+// hierarchy (must be one matrix per node)
+void CMesh::RasterizeOccluder( COcclusionCuller* culler, CMatrix4x4* matrices )
+{
+	if (!m_HasGeometry) return;
+
+	// The original sub-mesh data is kept after loading, positions are at the start of each vertex and faces are
+	// packed triples of indices
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		const SSubMesh& data = m_SubMeshes[subMesh];
+		culler->RasterizeTriangles( data.vertices, data.vertexSize, reinterpret_cast<const TUInt16*>(data.faces),
+		                            data.numFaces, matrices[data.node] );
 	}
 }
 
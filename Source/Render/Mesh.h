@@ -9,16 +9,18 @@
 #include <string>
 using namespace std;
 
-#include <d3d10.h>
-
 #include "Defines.h"
 #include "CVector3.h"
 #include "CMatrix4x4.h"
 #include "MeshData.h"
+#include "RenderDevice.h"
 #include "Camera.h"
 
 namespace gen
 {
+
+class CRenderQueue;
+class COcclusionCuller;
 	
 // Mesh class
 class CMesh
@@ -63,6 +65,12 @@ public:
 		return m_BoundingRadius;
 	}
 
+	// Get the most levels of detail of any sub-mesh (including the original)
+	TUInt32 GetNumLods()
+	{
+		return m_NumLods;
+	}
+
 
 	// Return total number of triangles in the mesh
 	TUInt32 GetNumTriangles();
@@ -110,22 +118,20 @@ public:
 	// Load the mesh from an X-File
 	bool Load( const string& fileName );
 
+	// Create the mesh from given nodes, materials and sub-meshes, e.g. generated geometry. The sub-meshes' vertex and
+	// face data is referred to by the mesh, not copied, so must remain valid for the life of the mesh
+	bool Create( const SMeshNode* nodes, TUInt32 numNodes, const SMeshMaterial* materials, TUInt32 numMaterials,
+	             const SSubMesh* subMeshes, TUInt32 numSubMeshes );
 
-	/////////////////////////////////////
-	// Rendering
-
-	// Render the model from the given camera using the given matrix list as a hierarchy (must be one matrix per node)
-	void Render( CMatrix4x4* matrices, CCamera* camera, bool postProcess = false );
 
-
-/*-----------------------------------------------------------------------------------------
-	Private interface
------------------------------------------------------------------------------------------*/
-private:
-	
 	/////////////////////////////////////
 	// Types
 
+	// Sub-meshes and materials are referred to by the render queue
+
+	// Most levels of detail of a sub-mesh, level 0 is the original
+	static const TUInt32 MaxLods = 4;
+
 	// The DirectX form of a sub-mesh. Stores controlling node and material used. The vertex/index data is
 	// stored in seperate vertex and index buffers for each mesh. This is sub-optimal - it/ would be better
 	// to share buffers between different meshes where possible, but this would make the code much more complex
@@ -135,18 +141,24 @@ private:
 		TUInt32                  material; // Index of material used by this sub-mesh
 
 		// Vertex data for the sub-mesh stored in a vertex buffer and the number of vertices in the buffer
-		ID3D10Buffer*            vertexBuffer;
+		SRenderBuffer*           vertexBuffer;
 		TUInt32                  numVertices;
 
 		// Description of the elements in a single vertex (position, normal, UVs etc.)
 		static const int         MAX_VERTEX_ELTS = 64;
-		D3D10_INPUT_ELEMENT_DESC vertexElts[MAX_VERTEX_ELTS];
-		ID3D10InputLayout*       vertexLayout; // Layout of a vertex (derived from above array)
+		SVertexElement           vertexElts[MAX_VERTEX_ELTS];
+		SRenderInputLayout*      vertexLayout; // Layout of a vertex (derived from above array)
+		SRenderInputLayout*      instancedLayout; // Layout with a world matrix per-instance in vertex buffer slot 1, NULL if the method cannot be instanced
 		unsigned int             vertexSize;   // Size of vertex calculated from contained elements
 
-		// Index data for the sub-mesh stored in a index buffer and the number of indices in the buffer
-		ID3D10Buffer*            indexBuffer;
-		TUInt32                  numIndices;
+		// Index data for each level of detail of the sub-mesh stored in an index buffer and the number of indices in
+		// the buffer. Level 0 is the original triangles, each further level is simplified from the last with about
+		// half the triangles. All levels use the vertex buffer above
+		TUInt32                  numLods;
+		SRenderBuffer*           indexBuffers[MaxLods];
+		TUInt32                  numIndices[MaxLods];
+
+		TUInt32                  geometryId; // Id of the vertex layout and buffers for render queue sort keys
 	};
 
 
@@ -155,15 +167,42 @@ private:
 	{
 		ERenderMethod renderMethod;
 
-		D3DXCOLOR     diffuseColour;
-		D3DXCOLOR     specularColour;
+		SColourRGBA   diffuseColour;
+		SColourRGBA   specularColour;
 		TFloat32      specularPower;
 
 		TUInt32       numTextures;
-		ID3D10ShaderResourceView* textures[kiMaxTextures];
+		SRenderResource* textures[kiMaxTextures];
+
+		// Ids for render queue sort keys
+		TUInt32       materialId;
+		TUInt32       textureSetId;
 	};
 
 
+	/////////////////////////////////////
+	// Rendering
+
+	// Add the sub-meshes of the model visible from the given camera to a render queue, using the given matrix list as
+	// a hierarchy (must be one matrix per node). Sub-meshes with post-processed materials are added to the queue's
+	// post-process pass, the others to the normal pass. The matrices must stay valid until the queue is submitted.
+	// Pass cull as false if the model is already known to be visible (e.g. found by a bounding volume hierarchy).
+	// The level of detail is chosen from the size of the model on screen. Pass the level used last time for this
+	// instance of the model in lod, which is updated - levels only change once the size has moved well past the
+	// switching point, so they don't flicker back and forth
+	void AddToRenderQueue( CRenderQueue* queue, CMatrix4x4* matrices, CCamera* camera, bool cull = true,
+	                       TUInt32* lod = 0 );
+
+	// Rasterize the triangles of the model into an occlusion culler's depth buffer, using the given matrix list as a
+	// hierarchy (must be one matrix per node)
+	void RasterizeOccluder( COcclusionCuller* culler, CMatrix4x4* matrices );
+
+
+/*-----------------------------------------------------------------------------------------
+	Private interface
+-----------------------------------------------------------------------------------------*/
+private:
+	
 	/////////////////////////////////////
 	// Support functions
 
@@ -204,6 +243,7 @@ private:
 	TUInt32          m_NumSubMeshes;
 	SSubMesh*        m_SubMeshes;    // Original sub-mesh data (dynamically allocated array)
 	SSubMeshDX*      m_SubMeshesDX;  // DirectX sub-mesh data (vertex / index buffers)
+	TUInt32          m_NumLods;      // Most levels of detail of any sub-mesh
 
 	// Materials used in mesh
 	TUInt32          m_NumMaterials;
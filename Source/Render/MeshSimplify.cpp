@@ -0,0 +1,292 @@
+/***************************************************************************************
+	MeshSimplify.cpp
+
+	Mesh simplification for levels of detail
+****************************************************************************************/
+
+#include <algorithm>
+using namespace std;
+
+#include "CVector3.h"
+#include "MeshSimplify.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Quadrics
+//-----------------------------------------------------------------------------
+
+// Symmetric 4x4 matrix giving the sum of squared distances from a point to a set of planes (ax + by + cz + d = 0).
+// Doubles are used as the terms for nearby planes nearly cancel
+struct SQuadric
+{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+// Add a plane with the given unit normal passing through a point, weighted (e.g. by triangle area)
+static void AddPlane( SQuadric* q, const CVector3& normal, const CVector3& point, double weight )
+{
+	double a = normal.x, b = normal.y, c = normal.z;
+	double d = -(a * point.x + b * point.y + c * point.z);
+	q->a2 += weight * a * a;  q->ab += weight * a * b;  q->ac += weight * a * c;  q->ad += weight * a * d;
+	q->b2 += weight * b * b;  q->bc += weight * b * c;  q->bd += weight * b * d;
+	q->c2 += weight * c * c;  q->cd += weight * c * d;
+	q->d2 += weight * d * d;
+}
+
+static void AddQuadric( SQuadric* q, const SQuadric& add )
+{
+	q->a2 += add.a2;  q->ab += add.ab;  q->ac += add.ac;  q->ad += add.ad;
+	q->b2 += add.b2;  q->bc += add.bc;  q->bd += add.bd;
+	q->c2 += add.c2;  q->cd += add.cd;
+	q->d2 += add.d2;
+}
+
+// Sum of squared distances of a point to the planes
+static double QuadricError( const SQuadric& q, const CVector3& p )
+{
+	double x = p.x, y = p.y, z = p.z;
+	double error = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x +
+	               q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y +
+	               q.c2 * z * z + 2.0 * q.cd * z +
+	               q.d2;
+	return (error > 0.0) ? error : 0.0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Simplification
+//-----------------------------------------------------------------------------
+
+// Collapse of the edge from one vertex to another (the first moves onto the second)
+struct SCollapse
+{
+	double  error;
+	TUInt32 from;
+	TUInt32 to;
+
+	bool operator<( const SCollapse& collapse ) const
+	{
+		return error < collapse.error;
+	}
+};
+
+// Triangles using each vertex, built for each pass
+struct STriangleAdjacency
+{
+	vector<TUInt32> first;     // First entry in triangles for each vertex (one extra entry at the end)
+	vector<TUInt32> triangles;
+};
+
+static void BuildAdjacency( const vector<TUInt16>& indices, TUInt32 numVertices, STriangleAdjacency* adjacency )
+{
+	adjacency->first.assign( numVertices + 1, 0 );
+	for (TUInt32 i = 0; i < indices.size(); ++i)
+	{
+		++adjacency->first[indices[i] + 1];
+	}
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		adjacency->first[vertex + 1] += adjacency->first[vertex];
+	}
+	adjacency->triangles.resize( indices.size() );
+	vector<TUInt32> next( adjacency->first.begin(), adjacency->first.end() - 1 );
+	for (TUInt32 i = 0; i < indices.size(); ++i)
+	{
+		adjacency->triangles[next[indices[i]]++] = i / 3;
+	}
+}
+
+// Return true if moving one vertex onto another keeps the surface's shape - no triangle around the moving vertex
+// flips over, and the two vertices share no neighbours other than those opposite the edge (otherwise the collapse
+// would join two separate parts of the surface)
+static bool IsCollapseValid( const vector<TUInt16>& indices, const vector<CVector3>& positions,
+                             const STriangleAdjacency& adjacency, TUInt32 from, TUInt32 to, vector<TUInt32>* neighbours )
+{
+	// Triangles around the moving vertex that don't use the edge must not flip. Collect the moving vertex's
+	// neighbours that aren't opposite the edge
+	TUInt32 numEdgeTriangles = 0;
+	TUInt32 opposite[2] = { from, from };
+	neighbours->clear();
+	for (TUInt32 i = adjacency.first[from]; i < adjacency.first[from + 1]; ++i)
+	{
+		const TUInt16* triangle = &indices[adjacency.triangles[i] * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			if (numEdgeTriangles < 2)
+			{
+				opposite[numEdgeTriangles] = triangle[0] ^ triangle[1] ^ triangle[2] ^ from ^ to;
+			}
+			++numEdgeTriangles;
+			continue;
+		}
+
+		CVector3 corners[3];
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			corners[corner] = positions[triangle[corner]];
+			if (triangle[corner] != from) neighbours->push_back( triangle[corner] );
+		}
+		CVector3 oldNormal = Cross( corners[1] - corners[0], corners[2] - corners[0] );
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			if (triangle[corner] == from) corners[corner] = positions[to];
+		}
+		CVector3 newNormal = Cross( corners[1] - corners[0], corners[2] - corners[0] );
+		if (Dot( oldNormal, newNormal ) <= 0.25f * oldNormal.Length() * newNormal.Length()) return false;
+	}
+	if (numEdgeTriangles == 0 || numEdgeTriangles > 2) return false;
+
+	// The target vertex's neighbours must not include any of those
+	sort( neighbours->begin(), neighbours->end() );
+	for (TUInt32 i = adjacency.first[to]; i < adjacency.first[to + 1]; ++i)
+	{
+		const TUInt16* triangle = &indices[adjacency.triangles[i] * 3];
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			TUInt32 vertex = triangle[corner];
+			if (vertex != to && vertex != from && vertex != opposite[0] && vertex != opposite[1] &&
+			    binary_search( neighbours->begin(), neighbours->end(), vertex ))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Simplify a triangle list towards the given number of triangles, writing the indices of the simplified triangles.
+// Returns the number of simplified triangles
+TUInt32 SimplifyMesh( const TUInt8* vertices, TUInt32 vertexSize, TUInt32 numVertices, const TUInt16* indices,
+                      TUInt32 numTriangles, TUInt32 targetTriangles, vector<TUInt16>* simplified )
+{
+	simplified->assign( indices, indices + numTriangles * 3 );
+
+	vector<CVector3> positions( numVertices );
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		positions[vertex] = *reinterpret_cast<const CVector3*>(vertices + vertex * vertexSize);
+	}
+
+	// Quadric of each vertex from the planes of the triangles around it, weighted by area
+	SQuadric zero = { 0 };
+	vector<SQuadric> quadrics( numVertices, zero );
+	for (TUInt32 triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		const TUInt16* corners = &indices[triangle * 3];
+		CVector3 normal = Cross( positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]] );
+		TFloat32 length = normal.Length();
+		if (length <= 0.0f) continue;
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			AddPlane( &quadrics[corners[corner]], normal / length, positions[corners[0]], 0.5 * length );
+		}
+	}
+
+	// Lock vertices on open edges (used by only one triangle) or edges shared by more than two triangles. Edges are
+	// counted as pairs of vertices packed into a key, then sorted so equal edges are together
+	vector<bool> locked( numVertices, false );
+	vector<TUInt32> edges;
+	edges.reserve( numTriangles * 3 );
+	for (TUInt32 i = 0; i < numTriangles * 3; ++i)
+	{
+		TUInt32 a = indices[i];
+		TUInt32 b = indices[(i % 3 == 2) ? i - 2 : i + 1];
+		edges.push_back( (Min( a, b ) << 16) | Max( a, b ) );
+	}
+	sort( edges.begin(), edges.end() );
+	for (TUInt32 i = 0; i < edges.size(); )
+	{
+		TUInt32 count = 1;
+		while (i + count < edges.size() && edges[i + count] == edges[i]) ++count;
+		if (count != 2)
+		{
+			locked[edges[i] >> 16] = true;
+			locked[edges[i] & 0xffff] = true;
+		}
+		i += count;
+	}
+
+	// Collapse edges in passes. Each pass collapses the cheapest edges first, skipping any edge near one already
+	// collapsed in the pass, then removes the triangles that became degenerate
+	TUInt32 currentTriangles = numTriangles;
+	STriangleAdjacency adjacency;
+	vector<SCollapse> collapses;
+	vector<TUInt32> remap( numVertices );
+	vector<bool> touched( numVertices );
+	vector<TUInt32> neighbours;
+	while (currentTriangles > targetTriangles)
+	{
+		// Candidate collapses, each unlocked vertex onto its neighbours
+		collapses.clear();
+		for (TUInt32 i = 0; i < simplified->size(); ++i)
+		{
+			TUInt32 a = (*simplified)[i];
+			TUInt32 b = (*simplified)[(i % 3 == 2) ? i - 2 : i + 1];
+			if (!locked[a])
+			{
+				SCollapse collapse = { QuadricError( quadrics[a], positions[b] ), a, b };
+				collapses.push_back( collapse );
+			}
+			if (!locked[b])
+			{
+				SCollapse collapse = { QuadricError( quadrics[b], positions[a] ), b, a };
+				collapses.push_back( collapse );
+			}
+		}
+		if (collapses.empty()) break;
+		sort( collapses.begin(), collapses.end() );
+
+		// Each collapse removes about two triangles
+		BuildAdjacency( *simplified, numVertices, &adjacency );
+		for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+		{
+			remap[vertex] = vertex;
+		}
+		touched.assign( numVertices, false );
+		TUInt32 numCollapsed = 0;
+		TUInt32 maxCollapsed = (currentTriangles - targetTriangles + 1) / 2;
+		for (TUInt32 c = 0; c < collapses.size() && numCollapsed < maxCollapsed; ++c)
+		{
+			const SCollapse& collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to]) continue;
+			if (!IsCollapseValid( *simplified, positions, adjacency, collapse.from, collapse.to, &neighbours )) continue;
+
+			// Vertices of the triangles around the moved vertex can't be collapsed again this pass, their triangles
+			// in the adjacency are out of date
+			remap[collapse.from] = collapse.to;
+			AddQuadric( &quadrics[collapse.to], quadrics[collapse.from] );
+			for (TUInt32 i = adjacency.first[collapse.from]; i < adjacency.first[collapse.from + 1]; ++i)
+			{
+				const TUInt16* triangle = &(*simplified)[adjacency.triangles[i] * 3];
+				touched[triangle[0]] = true;
+				touched[triangle[1]] = true;
+				touched[triangle[2]] = true;
+			}
+			++numCollapsed;
+		}
+		if (numCollapsed == 0) break;
+
+		// Move the collapsed vertices and remove degenerate triangles
+		TUInt32 numKept = 0;
+		for (TUInt32 triangle = 0; triangle < currentTriangles; ++triangle)
+		{
+			TUInt16 a = static_cast<TUInt16>(remap[(*simplified)[triangle * 3]]);
+			TUInt16 b = static_cast<TUInt16>(remap[(*simplified)[triangle * 3 + 1]]);
+			TUInt16 c = static_cast<TUInt16>(remap[(*simplified)[triangle * 3 + 2]]);
+			if (a == b || b == c || c == a) continue;
+			(*simplified)[numKept * 3] = a;
+			(*simplified)[numKept * 3 + 1] = b;
+			(*simplified)[numKept * 3 + 2] = c;
+			++numKept;
+		}
+		currentTriangles = numKept;
+		simplified->resize( currentTriangles * 3 );
+	}
+
+	return currentTriangles;
+}
+
+
+} // namespace gen
@@ -0,0 +1,34 @@
+/***************************************************************************************
+	MeshSimplify.h
+
+	Mesh simplification for levels of detail. Edges of a triangle list are collapsed in
+	order of the quadric error metric (the sum of squared distances to the planes of the
+	original triangles around a vertex), moving one vertex onto the other. Vertices are
+	never moved or created, so the simplified triangles index the original vertices and
+	can share their vertex buffer
+
+	Vertices on open edges - where the triangle list ends, or where vertices are split
+	along a UV seam or hard edge so neighbouring triangles use different copies - are
+	never moved, so simplified sub-meshes still meet their neighbours and seams don't
+	tear. Collapses that would flip a triangle or join two separate parts of the surface
+	are skipped. Does not depend on D3D
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+// Simplify a triangle list towards the given number of triangles, writing the indices of the simplified triangles
+// (which may be more than requested if no further edges can be collapsed). Each vertex starts with its position,
+// vertices are the given number of bytes apart. Returns the number of simplified triangles
+TUInt32 SimplifyMesh( const TUInt8* vertices, TUInt32 vertexSize, TUInt32 numVertices, const TUInt16* indices,
+                      TUInt32 numTriangles, TUInt32 targetTriangles, vector<TUInt16>* simplified );
+
+
+} // namespace gen
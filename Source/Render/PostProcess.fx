@@ -31,6 +31,10 @@ float ColourPallet;
 float GaussianBlurSigma;
 static const float PI = 3.14159265f;
 
+// dual filter (kawase) blur
+float2 DualFilterHalfPixel; // Half a texel of the texture being rendered to, in UVs
+float  DualFilterOffset;    // Spread of the bilinear taps, 1.0 is the standard dual filter pattern
+
 // bloom
 float BloomThreshold;
 float BloomPixelation;
@@ -482,6 +486,51 @@ float4 PPGaussianBlurVertical(PS_POSTPROCESS_INPUT ppIn) : SV_Target
 	return float4(GaussianBlurPass(ppIn, SceneTexture, false));
 }
 
+// Dual filter blur - downsample. Renders into a target half the size of the source, the four corner taps fall between
+// source texels so the bilinear filter averages 16 texels with only 5 samples
+float4 PPDualFilterDownShader(PS_POSTPROCESS_INPUT ppIn) : SV_Target
+{
+	float2 UV = ppIn.UVScene;
+	float2 offset = DualFilterHalfPixel * DualFilterOffset;
+
+	float3 ppColour = SceneTexture.Sample(BilinearClamp, UV) * 4.0f;
+	ppColour += SceneTexture.Sample(BilinearClamp, UV - offset);
+	ppColour += SceneTexture.Sample(BilinearClamp, UV + offset);
+	ppColour += SceneTexture.Sample(BilinearClamp, UV + float2(offset.x, -offset.y));
+	ppColour += SceneTexture.Sample(BilinearClamp, UV - float2(offset.x, -offset.y));
+
+	return float4(ppColour / 8.0f, 1.0f);
+}
+
+// Dual filter blur - upsample. Renders into a target twice the size of the source using a tent of 8 bilinear taps
+float4 DualFilterUpPass(PS_POSTPROCESS_INPUT ppIn, Texture2D sampleTex)
+{
+	float2 UV = ppIn.UVScene;
+	float2 offset = DualFilterHalfPixel * DualFilterOffset;
+
+	float3 ppColour = sampleTex.Sample(BilinearClamp, UV + float2(-offset.x * 2.0f, 0.0f));
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(-offset.x, offset.y)) * 2.0f;
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(0.0f, offset.y * 2.0f));
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(offset.x, offset.y)) * 2.0f;
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(offset.x * 2.0f, 0.0f));
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(offset.x, -offset.y)) * 2.0f;
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(0.0f, -offset.y * 2.0f));
+	ppColour += sampleTex.Sample(BilinearClamp, UV + float2(-offset.x, -offset.y)) * 2.0f;
+
+	return float4(ppColour / 12.0f, 1.0f);
+}
+
+float4 PPDualFilterUpShader(PS_POSTPROCESS_INPUT ppIn) : SV_Target
+{
+	return DualFilterUpPass(ppIn, SceneTexture);
+}
+
+// Final upsample when the blur is part of the post-process list - the blurred image is in the post process map
+float4 PPDualFilterUpMapShader(PS_POSTPROCESS_INPUT ppIn) : SV_Target
+{
+	return DualFilterUpPass(ppIn, PostProcessMap);
+}
+
 float4 BloomSelection(PS_POSTPROCESS_INPUT ppIn) : SV_Target
 {
 	float2 UV = ppIn.UVArea;
@@ -791,6 +840,49 @@ technique10 PPGaussianBlurVert
 	}
 }
 
+// Dual filter (kawase) blur, alternative backend for the gaussian blur and bloom
+technique10 PPDualFilterDown
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_4_0, PPQuad()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_4_0, PPDualFilterDownShader()));
+
+		SetBlendState(NoBlending, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetRasterizerState(CullNone);
+		SetDepthStencilState(DisableDepth, 0);
+	}
+}
+
+technique10 PPDualFilterUp
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_4_0, PPQuad()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_4_0, PPDualFilterUpShader()));
+
+		SetBlendState(NoBlending, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetRasterizerState(CullNone);
+		SetDepthStencilState(DisableDepth, 0);
+	}
+}
+
+technique10 PPDualFilterUpMap
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_4_0, PPQuad()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_4_0, PPDualFilterUpMapShader()));
+
+		SetBlendState(NoBlending, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetRasterizerState(CullNone);
+		SetDepthStencilState(DisableDepth, 0);
+	}
+}
+
 technique10 PPBloomSelection
 {
 	pass P0
@@ -0,0 +1,505 @@
+/***************************************************************************************
+	PostProcessPreset.cpp
+
+	Post-process presets - binary and text forms, and compilation into plans
+****************************************************************************************/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <sstream>
+
+#include "PostProcessPreset.h"
+
+namespace gen
+{
+
+const string PPTechniqueNames[NumPostProcesses] = {	"PPCopy", "PPTint", "PPTint2", "PPGreyNoise", "PPBurn", "PPDistort", "PPSpiral", "PPHeatHaze", "PPWater", "PPRetro", "PPGrayscale",
+													"PPInvert", "PPGaussianBlurHori", "PPGaussianBlurVert", "PPBloomSelection", "PPBloom", "PPGameboy" };
+
+const char* BlurBackendNames[NumBlurBackends] = { "Gaussian", "Dual Filter" };
+
+
+//-----------------------------------------------------------------------------
+// Settings
+//-----------------------------------------------------------------------------
+
+SPostProcessSettings::SPostProcessSettings()
+{
+	tintColour = SColourRGBA( 1, 0, 0, 1 );
+
+	tint2Rotate = true;
+	tint2Colour1 = SColourRGBA( 0, 0, 1, 1 );
+	tint2Colour2 = SColourRGBA( 1, 1, 0, 1 );
+
+	grainSize = 140.0f;
+	animateNoiseMap = false;
+
+	distortLevel = 0.03f;
+
+	waterColour = SColourRGBA( 0, 1, 1, 1 );
+
+	pixelation = 128.0f;
+	colourDepth = 4.0f;
+
+	gaussianBlurSigma = 5.0f;
+	blurBackend = BlurBackendGaussian;
+	blurDualFilterIterations = 3;
+	dualFilterOffset = 1.0f;
+
+	bloomStrength = 40.0f;
+	bloomThreshold = 0.3f;
+	bloomPixelation = 512.0f;
+	bloomIntensity = 1.3f;
+	bloomOriginalIntensity = 1.0f;
+	bloomSaturation = 1.0f;
+	bloomOriginalSaturation = 1.0f;
+	bloomBlurBackend = BlurBackendGaussian;
+	bloomDualFilterIterations = 5;
+
+	gameboyPixels = 150.0f;
+	gameboyColourDepth = 4.0f;
+	gameboyColour = SColourRGBA( 0.509f, 0.675f, 0.059f, 1.0f );
+}
+
+
+// Types of setting stored in presets
+enum EPresetFieldType
+{
+	FieldFloat,   // TFloat32
+	FieldInt,     // TInt32
+	FieldBool,    // bool, one byte in the binary form
+	FieldColour,  // SColourRGBA, only RGB is stored
+	FieldBackend, // EBlurBackend, one byte in the binary form
+};
+
+// Description of a setting stored in presets. The position of a field in the table below is its id in the binary
+// form, so new fields must only be added at the end of the table
+struct SPresetField
+{
+	const char*      name;
+	EPresetFieldType type;
+	TUInt32          offset; // In SPostProcessSettings
+};
+
+const SPresetField PresetFields[] =
+{
+	{ "TintColour",                FieldColour,  offsetof(SPostProcessSettings, tintColour) },
+	{ "Tint2Rotate",               FieldBool,    offsetof(SPostProcessSettings, tint2Rotate) },
+	{ "Tint2Colour1",              FieldColour,  offsetof(SPostProcessSettings, tint2Colour1) },
+	{ "Tint2Colour2",              FieldColour,  offsetof(SPostProcessSettings, tint2Colour2) },
+	{ "GrainSize",                 FieldFloat,   offsetof(SPostProcessSettings, grainSize) },
+	{ "AnimateNoiseMap",           FieldBool,    offsetof(SPostProcessSettings, animateNoiseMap) },
+	{ "DistortLevel",              FieldFloat,   offsetof(SPostProcessSettings, distortLevel) },
+	{ "WaterColour",               FieldColour,  offsetof(SPostProcessSettings, waterColour) },
+	{ "Pixelation",                FieldFloat,   offsetof(SPostProcessSettings, pixelation) },
+	{ "ColourDepth",               FieldFloat,   offsetof(SPostProcessSettings, colourDepth) },
+	{ "GaussianBlurSigma",         FieldFloat,   offsetof(SPostProcessSettings, gaussianBlurSigma) },
+	{ "BlurBackend",               FieldBackend, offsetof(SPostProcessSettings, blurBackend) },
+	{ "BlurDualFilterIterations",  FieldInt,     offsetof(SPostProcessSettings, blurDualFilterIterations) },
+	{ "DualFilterOffset",          FieldFloat,   offsetof(SPostProcessSettings, dualFilterOffset) },
+	{ "BloomStrength",             FieldFloat,   offsetof(SPostProcessSettings, bloomStrength) },
+	{ "BloomThreshold",            FieldFloat,   offsetof(SPostProcessSettings, bloomThreshold) },
+	{ "BloomPixelation",           FieldFloat,   offsetof(SPostProcessSettings, bloomPixelation) },
+	{ "BloomIntensity",            FieldFloat,   offsetof(SPostProcessSettings, bloomIntensity) },
+	{ "BloomOriginalIntensity",    FieldFloat,   offsetof(SPostProcessSettings, bloomOriginalIntensity) },
+	{ "BloomSaturation",           FieldFloat,   offsetof(SPostProcessSettings, bloomSaturation) },
+	{ "BloomOriginalSaturation",   FieldFloat,   offsetof(SPostProcessSettings, bloomOriginalSaturation) },
+	{ "BloomBlurBackend",          FieldBackend, offsetof(SPostProcessSettings, bloomBlurBackend) },
+	{ "BloomDualFilterIterations", FieldInt,     offsetof(SPostProcessSettings, bloomDualFilterIterations) },
+	{ "GameboyPixels",             FieldFloat,   offsetof(SPostProcessSettings, gameboyPixels) },
+	{ "GameboyColourDepth",        FieldFloat,   offsetof(SPostProcessSettings, gameboyColourDepth) },
+	{ "GameboyColour",             FieldColour,  offsetof(SPostProcessSettings, gameboyColour) },
+};
+const TUInt32 NumPresetFields = sizeof(PresetFields) / sizeof(PresetFields[0]);
+
+// Names of the blur backends in the text form
+const char* BlurBackendTokens[NumBlurBackends] = { "Gaussian", "DualFilter" };
+
+
+// Size in bytes of a field in the binary form
+TUInt32 PresetFieldSize( EPresetFieldType type )
+{
+	switch (type)
+	{
+		case FieldFloat:   return 4;
+		case FieldInt:     return 4;
+		case FieldColour:  return 12;
+		default:           return 1;
+	}
+}
+
+// Copy a field from settings to its binary form
+void PackPresetField( const SPresetField& field, const SPostProcessSettings& settings, TUInt8* data )
+{
+	const TUInt8* value = reinterpret_cast<const TUInt8*>(&settings) + field.offset;
+	switch (field.type)
+	{
+		case FieldBool:
+			data[0] = *reinterpret_cast<const bool*>(value) ? 1 : 0;
+			break;
+		case FieldBackend:
+			data[0] = static_cast<TUInt8>(*reinterpret_cast<const EBlurBackend*>(value));
+			break;
+		default:
+			memcpy( data, value, PresetFieldSize( field.type ) );
+	}
+}
+
+// Copy a field from its binary form to settings
+void UnpackPresetField( const SPresetField& field, const TUInt8* data, SPostProcessSettings* settings )
+{
+	TUInt8* value = reinterpret_cast<TUInt8*>(settings) + field.offset;
+	switch (field.type)
+	{
+		case FieldBool:
+			*reinterpret_cast<bool*>(value) = data[0] != 0;
+			break;
+		case FieldBackend:
+			*reinterpret_cast<EBlurBackend*>(value) = data[0] < NumBlurBackends ? static_cast<EBlurBackend>(data[0]) : BlurBackendGaussian;
+			break;
+		default:
+			memcpy( value, data, PresetFieldSize( field.type ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Plans
+//-----------------------------------------------------------------------------
+
+// Compile the preset's chain into its plan. Must be called whenever the chain or blur backends change
+void CompilePostProcessPlan( SPostProcessPreset* preset )
+{
+	const vector<PostProcesses>& chain = preset->chain;
+	const SPostProcessSettings& settings = preset->settings;
+	SPostProcessPlan& plan = preset->plan;
+
+	plan.steps.clear();
+	plan.numElided = 0;
+	plan.numFused = 0;
+
+	// Choose the kernel for each post-process
+	for (TUInt32 i = 0; i < chain.size(); ++i)
+	{
+		SPostProcessStep step;
+		step.postProcess = chain[i];
+		step.kernel = KernelTechnique;
+		switch (chain[i])
+		{
+			case Copy:
+			{
+				// A copy only moves the image to the other buffer, the buffer assignment below makes that unnecessary
+				++plan.numElided;
+				continue;
+			}
+
+			case GaussianBlurHori:
+			case GaussianBlurVert:
+			{
+				if (settings.blurBackend == BlurBackendDualFilter)
+				{
+					// The dual filter blurs in both directions, so a horizontal and vertical pair of entries (the way a
+					// gaussian blur is set up) needs only one dual filter blur
+					step.kernel = KernelDualFilterBlur;
+					PostProcesses pair = (chain[i] == GaussianBlurHori) ? GaussianBlurVert : GaussianBlurHori;
+					if (i + 1 < chain.size() && chain[i + 1] == pair)
+					{
+						++i;
+						++plan.numFused;
+					}
+				}
+				break;
+			}
+
+			case Bloom:
+			{
+				step.kernel = (settings.bloomBlurBackend == BlurBackendDualFilter) ? KernelBloomDualFilter : KernelBloomGaussian;
+				break;
+			}
+
+			default:
+				break;
+		}
+		plan.steps.push_back( step );
+	}
+
+	// Something must always be rendered to the back buffer
+	if (plan.steps.empty())
+	{
+		SPostProcessStep step;
+		step.postProcess = Copy;
+		step.kernel = KernelTechnique;
+		plan.steps.push_back( step );
+		if (plan.numElided > 0) --plan.numElided;
+	}
+
+	// Assign buffers - ping-pong between the scene buffers starting with the one holding the scene, the last step
+	// renders to the back buffer
+	EPostProcessBuffer source = SceneBuffer2;
+	for (TUInt32 s = 0; s < plan.steps.size(); ++s)
+	{
+		EPostProcessBuffer target = (source == SceneBuffer) ? SceneBuffer2 : SceneBuffer;
+		plan.steps[s].source = source;
+		plan.steps[s].target = (s == plan.steps.size() - 1) ? BackBuffer : target;
+		source = target;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Binary form
+//-----------------------------------------------------------------------------
+
+// Layout: "PPST" identifier, 16-bit version, name (8-bit length + chars), chain (8-bit count + one byte for each
+// post-process), settings (8-bit count, then for each an 8-bit field id, 8-bit size and the value). Little-endian
+const char PresetIdentifier[4] = { 'P', 'P', 'S', 'T' };
+const TUInt16 PresetVersion = 1;
+
+// Save a preset in the binary form. Returns false on failure
+bool SavePostProcessPreset( const SPostProcessPreset& preset, const string& fileName )
+{
+	if (preset.name.length() > 255 || preset.chain.size() > 255) return false;
+
+	vector<TUInt8> data( PresetIdentifier, PresetIdentifier + 4 );
+	data.push_back( static_cast<TUInt8>(PresetVersion) );
+	data.push_back( static_cast<TUInt8>(PresetVersion >> 8) );
+
+	data.push_back( static_cast<TUInt8>(preset.name.length()) );
+	data.insert( data.end(), preset.name.begin(), preset.name.end() );
+
+	data.push_back( static_cast<TUInt8>(preset.chain.size()) );
+	for (TUInt32 i = 0; i < preset.chain.size(); ++i)
+	{
+		data.push_back( static_cast<TUInt8>(preset.chain[i]) );
+	}
+
+	data.push_back( static_cast<TUInt8>(NumPresetFields) );
+	for (TUInt32 field = 0; field < NumPresetFields; ++field)
+	{
+		TUInt32 size = PresetFieldSize( PresetFields[field].type );
+		data.push_back( static_cast<TUInt8>(field) );
+		data.push_back( static_cast<TUInt8>(size) );
+		data.resize( data.size() + size );
+		PackPresetField( PresetFields[field], preset.settings, &data[data.size() - size] );
+	}
+
+	FILE* file = fopen( fileName.c_str(), "wb" );
+	if (!file) return false;
+	bool success = fwrite( &data[0], 1, data.size(), file ) == data.size();
+	fclose( file );
+	return success;
+}
+
+// Load a preset in the binary form and compile its plan. Settings missing from the file are left at their defaults and
+// unknown settings are skipped. Returns false on failure, the preset is unchanged
+bool LoadPostProcessPreset( const string& fileName, SPostProcessPreset* preset )
+{
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if (!file) return false;
+	vector<TUInt8> data;
+	TUInt8 buffer[1024];
+	size_t numRead;
+	while ((numRead = fread( buffer, 1, sizeof(buffer), file )) > 0)
+	{
+		data.insert( data.end(), buffer, buffer + numRead );
+	}
+	fclose( file );
+
+	// Header
+	if (data.size() < 7 || memcmp( &data[0], PresetIdentifier, 4 ) != 0) return false;
+	TUInt16 version = data[4] | (data[5] << 8);
+	if (version > PresetVersion) return false;
+	TUInt32 pos = 6;
+
+	SPostProcessPreset loaded;
+
+	// Name
+	TUInt32 nameLength = data[pos++];
+	if (pos + nameLength + 1 > data.size()) return false;
+	loaded.name.assign( reinterpret_cast<const char*>(&data[pos]), nameLength );
+	pos += nameLength;
+
+	// Chain
+	TUInt32 chainLength = data[pos++];
+	if (pos + chainLength + 1 > data.size()) return false;
+	for (TUInt32 i = 0; i < chainLength; ++i)
+	{
+		if (data[pos] >= NumPostProcesses) return false;
+		loaded.chain.push_back( static_cast<PostProcesses>(data[pos++]) );
+	}
+
+	// Settings
+	TUInt32 numFields = data[pos++];
+	for (TUInt32 i = 0; i < numFields; ++i)
+	{
+		if (pos + 2 > data.size()) return false;
+		TUInt32 field = data[pos++];
+		TUInt32 size = data[pos++];
+		if (pos + size > data.size()) return false;
+		if (field < NumPresetFields && size == PresetFieldSize( PresetFields[field].type ))
+		{
+			UnpackPresetField( PresetFields[field], &data[pos], &loaded.settings );
+		}
+		pos += size;
+	}
+
+	if (loaded.chain.empty()) loaded.chain.push_back( Copy );
+	CompilePostProcessPlan( &loaded );
+	*preset = loaded;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Text form
+//-----------------------------------------------------------------------------
+
+// One setting per line: key followed by values. Lines starting with # are comments. E.g.
+//   Name Soft Bloom
+//   Chain PPBloom PPTint
+//   BloomThreshold 0.3
+//   TintColour 1 0.5 0.5
+//   BloomBlurBackend DualFilter
+
+// Save a preset in the text form. Returns false on failure
+bool SavePostProcessPresetText( const SPostProcessPreset& preset, const string& fileName )
+{
+	stringstream text;
+	text << "# Post-process preset" << endl;
+	text << "Name " << preset.name << endl;
+	text << "Chain";
+	for (TUInt32 i = 0; i < preset.chain.size(); ++i)
+	{
+		text << " " << PPTechniqueNames[preset.chain[i]];
+	}
+	text << endl;
+
+	for (TUInt32 field = 0; field < NumPresetFields; ++field)
+	{
+		const TUInt8* value = reinterpret_cast<const TUInt8*>(&preset.settings) + PresetFields[field].offset;
+		text << PresetFields[field].name << " ";
+		switch (PresetFields[field].type)
+		{
+			case FieldFloat:
+				text << *reinterpret_cast<const TFloat32*>(value);
+				break;
+			case FieldInt:
+				text << *reinterpret_cast<const TInt32*>(value);
+				break;
+			case FieldBool:
+				text << (*reinterpret_cast<const bool*>(value) ? 1 : 0);
+				break;
+			case FieldColour:
+			{
+				const SColourRGBA& colour = *reinterpret_cast<const SColourRGBA*>(value);
+				text << colour.r << " " << colour.g << " " << colour.b;
+				break;
+			}
+			case FieldBackend:
+				text << BlurBackendTokens[*reinterpret_cast<const EBlurBackend*>(value)];
+				break;
+		}
+		text << endl;
+	}
+
+	FILE* file = fopen( fileName.c_str(), "wt" );
+	if (!file) return false;
+	string output = text.str();
+	bool success = fwrite( output.c_str(), 1, output.length(), file ) == output.length();
+	fclose( file );
+	return success;
+}
+
+// Load a preset in the text form and compile its plan. Settings missing from the file are left at their defaults.
+// Returns false on failure (including unknown keys or post-processes), the preset is unchanged
+bool LoadPostProcessPresetText( const string& fileName, SPostProcessPreset* preset )
+{
+	FILE* file = fopen( fileName.c_str(), "rt" );
+	if (!file) return false;
+	string input;
+	char buffer[1024];
+	size_t numRead;
+	while ((numRead = fread( buffer, 1, sizeof(buffer), file )) > 0)
+	{
+		input.append( buffer, numRead );
+	}
+	fclose( file );
+
+	SPostProcessPreset loaded;
+	stringstream lines( input );
+	string line;
+	while (getline( lines, line ))
+	{
+		stringstream values( line );
+		string key;
+		if (!(values >> key) || key[0] == '#') continue;
+
+		if (key == "Name")
+		{
+			getline( values >> ws, loaded.name );
+			continue;
+		}
+
+		if (key == "Chain")
+		{
+			string technique;
+			while (values >> technique)
+			{
+				int pp = 0;
+				while (pp < NumPostProcesses && PPTechniqueNames[pp] != technique) ++pp;
+				if (pp == NumPostProcesses) return false;
+				loaded.chain.push_back( static_cast<PostProcesses>(pp) );
+			}
+			continue;
+		}
+
+		TUInt32 field = 0;
+		while (field < NumPresetFields && key != PresetFields[field].name) ++field;
+		if (field == NumPresetFields) return false;
+
+		TUInt8* value = reinterpret_cast<TUInt8*>(&loaded.settings) + PresetFields[field].offset;
+		bool valid = true;
+		switch (PresetFields[field].type)
+		{
+			case FieldFloat:
+				valid = !!(values >> *reinterpret_cast<TFloat32*>(value));
+				break;
+			case FieldInt:
+				valid = !!(values >> *reinterpret_cast<TInt32*>(value));
+				break;
+			case FieldBool:
+			{
+				int flag;
+				valid = !!(values >> flag);
+				*reinterpret_cast<bool*>(value) = flag != 0;
+				break;
+			}
+			case FieldColour:
+			{
+				SColourRGBA& colour = *reinterpret_cast<SColourRGBA*>(value);
+				valid = !!(values >> colour.r >> colour.g >> colour.b);
+				break;
+			}
+			case FieldBackend:
+			{
+				string token;
+				values >> token;
+				int backend = 0;
+				while (backend < NumBlurBackends && token != BlurBackendTokens[backend]) ++backend;
+				valid = backend < NumBlurBackends;
+				if (valid) *reinterpret_cast<EBlurBackend*>(value) = static_cast<EBlurBackend>(backend);
+				break;
+			}
+		}
+		if (!valid) return false;
+	}
+
+	if (loaded.chain.empty()) loaded.chain.push_back( Copy );
+	CompilePostProcessPlan( &loaded );
+	*preset = loaded;
+	return true;
+}
+
+
+} // namespace gen
@@ -0,0 +1,166 @@
+/***************************************************************************************
+	PostProcessPreset.h
+
+	Post-process presets: a chain of full screen post-processes together with all the
+	settings used by them. Presets are stored in a compact binary form, or a text form
+	for authoring. Each preset is compiled into a plan for rendering the chain - the
+	redundant passes are removed, passes are fused where the chosen blur backend allows,
+	the blur kernels are chosen and the ping-pong buffers for each pass are assigned.
+	Switching preset at run-time is then just selecting a different plan
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <string>
+using namespace std;
+
+#include "Defines.h"
+#include "Colour.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Post-processes
+//-----------------------------------------------------------------------------
+
+// Enumeration of different post-processes
+enum PostProcesses
+{
+	Copy, Tint, Tint2, GreyNoise, Burn, Distort, Spiral, HeatHaze, Water, Retro, Grayscale,
+	Invert, GaussianBlurHori, GaussianBlurVert, BloomSelection, Bloom, Gameboy,
+	NumPostProcesses
+};
+
+// Technique name for each post-process, also the name used for the post-process in text presets
+extern const string PPTechniqueNames[NumPostProcesses];
+
+// Blur implementations available for the blur and bloom post-processes. The dual filter (kawase) blur downsamples
+// then upsamples through a chain of smaller textures, giving a similar wide blur with far fewer taps than the gaussian
+enum EBlurBackend
+{
+	BlurBackendGaussian, BlurBackendDualFilter,
+	NumBlurBackends
+};
+extern const char* BlurBackendNames[NumBlurBackends];
+
+
+//-----------------------------------------------------------------------------
+// Settings
+//-----------------------------------------------------------------------------
+
+// All the user settings for the post-processes. Constructed with the default settings
+struct SPostProcessSettings
+{
+	SPostProcessSettings();
+
+	// Tint
+	SColourRGBA tintColour;
+
+	// Tint2
+	bool        tint2Rotate;
+	SColourRGBA tint2Colour1;
+	SColourRGBA tint2Colour2;
+
+	// Grey noise
+	TFloat32 grainSize; // Fineness of the noise grain
+	bool     animateNoiseMap;
+
+	// Distort
+	TFloat32 distortLevel;
+
+	// Water
+	SColourRGBA waterColour;
+
+	// Retro
+	TFloat32 pixelation;
+	TFloat32 colourDepth;
+
+	// Blur
+	TFloat32     gaussianBlurSigma;
+	EBlurBackend blurBackend;
+	TInt32       blurDualFilterIterations;
+	TFloat32     dualFilterOffset;
+
+	// Bloom
+	TFloat32     bloomStrength;
+	TFloat32     bloomThreshold;
+	TFloat32     bloomPixelation;
+	TFloat32     bloomIntensity;
+	TFloat32     bloomOriginalIntensity;
+	TFloat32     bloomSaturation;
+	TFloat32     bloomOriginalSaturation;
+	EBlurBackend bloomBlurBackend;
+	TInt32       bloomDualFilterIterations;
+
+	// Gameboy
+	TFloat32    gameboyPixels;
+	TFloat32    gameboyColourDepth;
+	SColourRGBA gameboyColour;
+};
+
+
+//-----------------------------------------------------------------------------
+// Plans
+//-----------------------------------------------------------------------------
+
+// Way a step of a plan is rendered
+enum EPostProcessKernel
+{
+	KernelTechnique,       // Single pass of the post-process technique
+	KernelDualFilterBlur,  // Dual filter blur in both directions, then upsample pass
+	KernelBloomGaussian,   // Bloom selection, horizontal and vertical gaussian blur, then bloom pass
+	KernelBloomDualFilter, // Bloom selection, dual filter blur, then bloom pass
+};
+
+// Buffers post-processes read from and render to. The scene arrives in the second scene buffer
+enum EPostProcessBuffer
+{
+	SceneBuffer, SceneBuffer2, BackBuffer,
+};
+
+// Single step in a plan
+struct SPostProcessStep
+{
+	PostProcesses      postProcess;
+	EPostProcessKernel kernel;
+	EPostProcessBuffer source; // Always one of the scene buffers
+	EPostProcessBuffer target; // Scene buffer other than the source, or the back buffer for the last step
+};
+
+// Compiled form of a preset's chain
+struct SPostProcessPlan
+{
+	vector<SPostProcessStep> steps;
+
+	TUInt32 numElided; // Post-processes in the chain that needed no pass
+	TUInt32 numFused;  // Post-processes merged into the pass of the previous post-process
+};
+
+
+//-----------------------------------------------------------------------------
+// Presets
+//-----------------------------------------------------------------------------
+
+struct SPostProcessPreset
+{
+	string                name;
+	vector<PostProcesses> chain;
+	SPostProcessSettings  settings;
+	SPostProcessPlan      plan; // Compiled from the chain and settings, see CompilePostProcessPlan
+};
+
+// Compile the preset's chain into its plan. Must be called whenever the chain or blur backends change
+void CompilePostProcessPlan( SPostProcessPreset* preset );
+
+// Save / load a preset in the binary form. The plan is compiled on load. Return false on failure
+bool SavePostProcessPreset( const SPostProcessPreset& preset, const string& fileName );
+bool LoadPostProcessPreset( const string& fileName, SPostProcessPreset* preset );
+
+// Save / load a preset in the text form. The plan is compiled on load. Return false on failure
+bool SavePostProcessPresetText( const SPostProcessPreset& preset, const string& fileName );
+bool LoadPostProcessPresetText( const string& fileName, SPostProcessPreset* preset );
+
+
+} // namespace gen
@@ -0,0 +1,396 @@
+/***************************************************************************************
+	ProceduralMaps.cpp
+
+	Procedural generation of the special purpose post-processing maps
+****************************************************************************************/
+
+#include <emmintrin.h> // SSE2
+
+#include "Utility.h"
+#include "BaseMath.h"
+#include "ProceduralMaps.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Noise helpers
+//-----------------------------------------------------------------------------
+
+// Integer hash constants
+const TUInt32 HashX    = 0x27d4eb2d;
+const TUInt32 HashY    = 0x165667b1;
+const TUInt32 HashMix1 = 0x2c1b3c6d;
+const TUInt32 HashMix2 = 0x297a2d39;
+
+// Hash of a lattice point and seed
+inline TUInt32 Hash( TUInt32 x, TUInt32 y, TUInt32 seed )
+{
+	TUInt32 h = x * HashX ^ y * HashY ^ seed;
+	h ^= h >> 15;
+	h *= HashMix1;
+	h ^= h >> 12;
+	return h;
+}
+
+// Hash a seed with an extra value (octave, time slice)
+inline TUInt32 HashSeed( TUInt32 seed, TUInt32 value )
+{
+	TUInt32 h = (seed + value) * HashMix2;
+	h ^= h >> 16;
+	h *= HashMix1;
+	return h ^ (h >> 13);
+}
+
+// Quintic fade curve, smooth interpolation between lattice points
+inline TFloat32 Fade( TFloat32 t )
+{
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// Dot product of offset (x, y) with one of eight gradients selected by the hash
+inline TFloat32 Gradient( TUInt32 h, TFloat32 x, TFloat32 y )
+{
+	TFloat32 u = (h & 4) ? x : y;
+	TFloat32 v = (h & 4) ? y : x;
+	return ((h & 1) ? -u : u) + ((h & 2) ? -0.5f * v : 0.5f * v);
+}
+
+// Gradient noise at (x, y), where x and y are in lattice units (0 to period). Wraps at the period so the noise tiles
+TFloat32 GradientNoise( TFloat32 x, TFloat32 y, TUInt32 period, TUInt32 seed )
+{
+	TUInt32 ix0 = static_cast<TUInt32>(x);
+	TUInt32 iy0 = static_cast<TUInt32>(y);
+	TFloat32 fx = x - ix0;
+	TFloat32 fy = y - iy0;
+	TUInt32 ix1 = (ix0 + 1 == period) ? 0 : ix0 + 1;
+	TUInt32 iy1 = (iy0 + 1 == period) ? 0 : iy0 + 1;
+
+	TFloat32 n00 = Gradient( Hash( ix0, iy0, seed ), fx,        fy );
+	TFloat32 n10 = Gradient( Hash( ix1, iy0, seed ), fx - 1.0f, fy );
+	TFloat32 n01 = Gradient( Hash( ix0, iy1, seed ), fx,        fy - 1.0f );
+	TFloat32 n11 = Gradient( Hash( ix1, iy1, seed ), fx - 1.0f, fy - 1.0f );
+
+	TFloat32 u = Fade( fx );
+	TFloat32 v = Fade( fy );
+	TFloat32 nx0 = n00 + (n10 - n00) * u;
+	TFloat32 nx1 = n01 + (n11 - n01) * u;
+	return nx0 + (nx1 - nx0) * v;
+}
+
+
+//-----------------------------------------------------------------------------
+// SSE2 versions of noise helpers - four x values at a time
+//-----------------------------------------------------------------------------
+
+// SSE2 has no 32-bit low multiply, build one from two 32x32->64 multiplies
+inline __m128i MulLo32( __m128i a, __m128i b )
+{
+	__m128i even = _mm_mul_epu32( a, b );
+	__m128i odd  = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), _mm_srli_epi64( b, 32 ) );
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE(0, 0, 2, 0) ),
+	                           _mm_shuffle_epi32( odd,  _MM_SHUFFLE(0, 0, 2, 0) ) );
+}
+
+// See Hash above, y is pre-multiplied and combined with the seed as it is the same for all four
+inline __m128i Hash4( __m128i x, __m128i ySeed )
+{
+	__m128i h = _mm_xor_si128( MulLo32( x, _mm_set1_epi32( HashX ) ), ySeed );
+	h = _mm_xor_si128( h, _mm_srli_epi32( h, 15 ) );
+	h = MulLo32( h, _mm_set1_epi32( HashMix1 ) );
+	return _mm_xor_si128( h, _mm_srli_epi32( h, 12 ) );
+}
+
+inline __m128 Fade4( __m128 t )
+{
+	__m128 f = _mm_add_ps( _mm_mul_ps( t, _mm_set1_ps( 6.0f ) ), _mm_set1_ps( -15.0f ) );
+	f = _mm_add_ps( _mm_mul_ps( t, f ), _mm_set1_ps( 10.0f ) );
+	return _mm_mul_ps( _mm_mul_ps( _mm_mul_ps( t, t ), t ), f );
+}
+
+// See Gradient above. Branchless - bits of the hash select and negate the components
+inline __m128 Gradient4( __m128i h, __m128 x, __m128 y )
+{
+	const __m128i signBit = _mm_set1_epi32( 0x80000000 );
+	__m128 swap = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( h, _mm_set1_epi32( 4 ) ), _mm_set1_epi32( 4 ) ) );
+	__m128 u = _mm_or_ps( _mm_and_ps( swap, x ), _mm_andnot_ps( swap, y ) );
+	__m128 v = _mm_or_ps( _mm_and_ps( swap, y ), _mm_andnot_ps( swap, x ) );
+	u = _mm_xor_ps( u, _mm_castsi128_ps( _mm_slli_epi32( h, 31 ) ) );
+	v = _mm_xor_ps( _mm_mul_ps( v, _mm_set1_ps( 0.5f ) ),
+	                _mm_castsi128_ps( _mm_and_si128( _mm_slli_epi32( h, 30 ), signBit ) ) );
+	return _mm_add_ps( u, v );
+}
+
+// Add amplitude * noise to a row of outputs. The row has the given y in lattice units, x steps by xStep lattice units per pixel
+void AddNoiseRow( TFloat32* row, TUInt32 width, TFloat32 xStep, TFloat32 y, TUInt32 period, TUInt32 seed, TFloat32 amplitude )
+{
+	// Values for the row shared by all pixels
+	TUInt32 iy0 = static_cast<TUInt32>(y);
+	TUInt32 iy1 = (iy0 + 1 == period) ? 0 : iy0 + 1;
+	TFloat32 fy = y - iy0;
+
+	__m128i ySeed0 = _mm_set1_epi32( iy0 * HashY ^ seed );
+	__m128i ySeed1 = _mm_set1_epi32( iy1 * HashY ^ seed );
+	__m128  fy0 = _mm_set1_ps( fy );
+	__m128  fy1 = _mm_set1_ps( fy - 1.0f );
+	__m128  v   = _mm_set1_ps( Fade( fy ) );
+	__m128  one = _mm_set1_ps( 1.0f );
+	__m128i periodInt = _mm_set1_epi32( period );
+	__m128  amp = _mm_set1_ps( amplitude );
+
+	TUInt32 pixel = 0;
+	for (; pixel + 4 <= width; pixel += 4)
+	{
+		__m128 x = _mm_mul_ps( _mm_add_ps( _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f ), _mm_set1_ps( static_cast<TFloat32>(pixel) ) ),
+		                       _mm_set1_ps( xStep ) );
+		__m128i ix0 = _mm_cvttps_epi32( x ); // x is never negative so truncation is floor
+		__m128i ix1 = _mm_add_epi32( ix0, _mm_set1_epi32( 1 ) );
+		ix1 = _mm_andnot_si128( _mm_cmpeq_epi32( ix1, periodInt ), ix1 ); // Wrap to 0 at the period
+		__m128 fx0 = _mm_sub_ps( x, _mm_cvtepi32_ps( ix0 ) );
+		__m128 fx1 = _mm_sub_ps( fx0, one );
+
+		__m128 n00 = Gradient4( Hash4( ix0, ySeed0 ), fx0, fy0 );
+		__m128 n10 = Gradient4( Hash4( ix1, ySeed0 ), fx1, fy0 );
+		__m128 n01 = Gradient4( Hash4( ix0, ySeed1 ), fx0, fy1 );
+		__m128 n11 = Gradient4( Hash4( ix1, ySeed1 ), fx1, fy1 );
+
+		__m128 u = Fade4( fx0 );
+		__m128 nx0 = _mm_add_ps( n00, _mm_mul_ps( _mm_sub_ps( n10, n00 ), u ) );
+		__m128 nx1 = _mm_add_ps( n01, _mm_mul_ps( _mm_sub_ps( n11, n01 ), u ) );
+		__m128 n   = _mm_add_ps( nx0, _mm_mul_ps( _mm_sub_ps( nx1, nx0 ), v ) );
+
+		_mm_storeu_ps( row + pixel, _mm_add_ps( _mm_loadu_ps( row + pixel ), _mm_mul_ps( n, amp ) ) );
+	}
+
+	// Remaining pixels if width is not a multiple of 4
+	for (; pixel < width; ++pixel)
+	{
+		row[pixel] += amplitude * GradientNoise( (pixel + 0.5f) * xStep, y, period, seed );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Generation
+//-----------------------------------------------------------------------------
+
+// Default settings to give maps similar to the original textures
+SProceduralMapSettings DefaultProceduralMapSettings( EProceduralMap map )
+{
+	SProceduralMapSettings settings;
+	switch (map)
+	{
+		case ProceduralNoise:
+			settings.frequency = 64;
+			settings.octaves   = 3;
+			settings.gain      = 0.7f;
+			settings.strength  = 1.5f;
+			settings.seed      = 1;
+			break;
+		case ProceduralBurn:
+			settings.frequency = 4;
+			settings.octaves   = 5;
+			settings.gain      = 0.5f;
+			settings.strength  = 1.2f;
+			settings.seed      = 2;
+			break;
+		default: // ProceduralDistort
+			settings.frequency = 8;
+			settings.octaves   = 3;
+			settings.gain      = 0.5f;
+			settings.strength  = 0.015f;
+			settings.seed      = 3;
+			break;
+	}
+	return settings;
+}
+
+// Generate the fBm noise for a width x height map into the given array of floats (roughly -1 to 1)
+void GenerateFBmNoise( const SProceduralMapSettings& settings, TUInt32 width, TUInt32 height, TFloat32 time,
+                       TFloat32* noise )
+{
+	for (TUInt32 i = 0; i < width * height; ++i)
+	{
+		noise[i] = 0.0f;
+	}
+
+	// Time blends between two unrelated slices of noise
+	TFloat32 timeSlice = Floor( time );
+	TFloat32 timeBlend = Fade( time - timeSlice );
+	TUInt32 slice = static_cast<TUInt32>(static_cast<TInt32>(timeSlice));
+
+	TFloat32 amplitude = 1.0f;
+	TUInt32 period = Max( settings.frequency, 1u );
+	for (TUInt32 octave = 0; octave < settings.octaves; ++octave)
+	{
+		TFloat32 xStep = static_cast<TFloat32>(period) / width;
+		TFloat32 yStep = static_cast<TFloat32>(period) / height;
+		TUInt32 seed0 = HashSeed( HashSeed( settings.seed, octave ), slice );
+		TUInt32 seed1 = HashSeed( HashSeed( settings.seed, octave ), slice + 1 );
+
+		for (TUInt32 y = 0; y < height; ++y)
+		{
+			TFloat32* row = noise + y * width;
+			if (timeBlend < 1.0f)
+			{
+				AddNoiseRow( row, width, xStep, (y + 0.5f) * yStep, period, seed0, amplitude * (1.0f - timeBlend) );
+			}
+			if (timeBlend > 0.0f)
+			{
+				AddNoiseRow( row, width, xStep, (y + 0.5f) * yStep, period, seed1, amplitude * timeBlend );
+			}
+		}
+
+		amplitude *= settings.gain;
+		period *= 2;
+	}
+}
+
+// Convert 0->1 value to a byte, clamping out of range values
+inline TUInt8 ToByte( TFloat32 x )
+{
+	return static_cast<TUInt8>(Min( Max( x, 0.0f ), 1.0f ) * 255.0f + 0.5f);
+}
+
+// Generate the given map into an array of width x height RGBA (8-bits each) pixels
+void GenerateProceduralMap( EProceduralMap map, const SProceduralMapSettings& settings, TUInt32 width, TUInt32 height,
+                            TFloat32 time, TFloat32* noise, TUInt8* pixels )
+{
+	GenerateFBmNoise( settings, width, height, time, noise );
+
+	// Gradient is measured in UV space so the maps look the same at any resolution
+	TFloat32 gradientScaleX = 0.5f * width * settings.strength;
+	TFloat32 gradientScaleY = 0.5f * height * settings.strength;
+
+	for (TUInt32 y = 0; y < height; ++y)
+	{
+		const TFloat32* row  = noise + y * width;
+		const TFloat32* rowU = noise + ((y + height - 1) % height) * width; // Wrap at the edges as the map tiles
+		const TFloat32* rowD = noise + ((y + 1) % height) * width;
+		TUInt8* pixel = pixels + y * width * 4;
+		for (TUInt32 x = 0; x < width; ++x, pixel += 4)
+		{
+			TUInt32 xL = (x + width - 1) % width;
+			TUInt32 xR = (x + 1) % width;
+			switch (map)
+			{
+				case ProceduralNoise:
+				{
+					TUInt8 grey = ToByte( row[x] * settings.strength * 0.5f + 0.5f );
+					pixel[0] = pixel[1] = pixel[2] = grey;
+					pixel[3] = 255;
+					break;
+				}
+				case ProceduralBurn:
+				{
+					// Burn level in red, crinkle direction taken from slope of the burn level
+					pixel[0] = ToByte( row[x] * settings.strength * 0.5f + 0.5f );
+					pixel[1] = ToByte( (rowD[x] - rowU[x]) * gradientScaleY * 0.1f + 0.5f );
+					pixel[2] = 0;
+					pixel[3] = 255;
+					break;
+				}
+				default: // ProceduralDistort
+				{
+					// Slope of the noise as a 2D vector in red & green
+					pixel[0] = ToByte( (row[xR] - row[xL]) * gradientScaleX + 0.5f );
+					pixel[1] = ToByte( (rowD[x] - rowU[x]) * gradientScaleY + 0.5f );
+					pixel[2] = 255;
+					pixel[3] = 255;
+					break;
+				}
+			}
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Animation
+//-----------------------------------------------------------------------------
+
+CProceduralMapAnimator::CProceduralMapAnimator( EProceduralMap map, const SProceduralMapSettings& settings,
+                                                TUInt32 width, TUInt32 height )
+{
+	m_Map = map;
+	m_Settings = settings;
+	m_Width = width;
+	m_Height = height;
+
+	m_Noise.resize( width * height );
+	for (int buffer = 0; buffer < 3; ++buffer)
+	{
+		m_Pixels[buffer].resize( width * height * 4 );
+	}
+	m_WriteBuffer = 0;
+	m_ReadyBuffer = 1;
+	m_ReadBuffer = 2;
+	m_FrameReady = false;
+
+	m_RequestTime = 0.0f;
+	m_Requested = false;
+	m_Quit = false;
+
+	m_Thread = thread( &CProceduralMapAnimator::Run, this );
+}
+
+CProceduralMapAnimator::~CProceduralMapAnimator()
+{
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_Quit = true;
+	}
+	m_Request.notify_one();
+	m_Thread.join();
+}
+
+// Request that the map is generated for the given time. Replaces any request not yet started
+void CProceduralMapAnimator::RequestFrame( TFloat32 time )
+{
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_RequestTime = time;
+		m_Requested = true;
+	}
+	m_Request.notify_one();
+}
+
+// Returns the pixels of the most recently completed frame if there has been one since the last call, otherwise NULL
+const TUInt8* CProceduralMapAnimator::FetchFrame()
+{
+	lock_guard<mutex> lock( m_Mutex );
+	if (!m_FrameReady)
+	{
+		return NULL;
+	}
+	Swap( m_ReadyBuffer, m_ReadBuffer );
+	m_FrameReady = false;
+	return &m_Pixels[m_ReadBuffer][0];
+}
+
+// Worker thread function - generate frames as they are requested
+void CProceduralMapAnimator::Run()
+{
+	unique_lock<mutex> lock( m_Mutex );
+	while (true)
+	{
+		m_Request.wait( lock, [this] { return m_Requested || m_Quit; } );
+		if (m_Quit)
+		{
+			break;
+		}
+		TFloat32 time = m_RequestTime;
+		m_Requested = false;
+
+		// Only the worker uses the write buffer, so generate without holding the lock
+		lock.unlock();
+		GenerateProceduralMap( m_Map, m_Settings, m_Width, m_Height, time, &m_Noise[0], &m_Pixels[m_WriteBuffer][0] );
+		lock.lock();
+
+		Swap( m_WriteBuffer, m_ReadyBuffer );
+		m_FrameReady = true;
+	}
+}
+
+
+} // namespace gen
@@ -0,0 +1,138 @@
+/***************************************************************************************
+	ProceduralMaps.h
+
+	Procedural generation of the special purpose post-processing maps (noise, burn and
+	distort). Uses tileable gradient noise summed over octaves (fBm), calculated four
+	pixels at a time with SSE2. Maps can be generated once at any resolution or
+	animated in the background on a worker thread
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Map types and settings
+//-----------------------------------------------------------------------------
+
+// Maps that can be generated, matching the textures the post-processes previously loaded from file
+enum EProceduralMap
+{
+	ProceduralNoise,   // Grey noise, red channel used by PPGreyNoise
+	ProceduralBurn,    // Burn level in red, red & green used as crinkle vector by PPBurn
+	ProceduralDistort, // Gradient of a noise height map in red & green, used as distortion vector by PPDistort
+	NumProceduralMaps
+};
+
+// Noise settings for a procedural map
+struct SProceduralMapSettings
+{
+	TUInt32  frequency; // Noise cells across the map for the first octave, integer so the map tiles
+	TUInt32  octaves;   // Number of octaves summed, each double the frequency of the previous
+	TFloat32 gain;      // Amplitude of each octave relative to the previous
+	TFloat32 strength;  // Scale applied to the noise (or to the gradient for distort maps)
+	TUInt32  seed;      // Different seeds give unrelated noise
+};
+
+// Default settings to give maps similar to the original textures
+SProceduralMapSettings DefaultProceduralMapSettings( EProceduralMap map );
+
+
+//-----------------------------------------------------------------------------
+// Generation
+//-----------------------------------------------------------------------------
+
+// Generate the fBm noise for a width x height map into the given array of floats (roughly -1 to 1). The
+// time selects a slice of the noise, noise changes smoothly as time increases (whole numbers are distinct)
+void GenerateFBmNoise( const SProceduralMapSettings& settings, TUInt32 width, TUInt32 height, TFloat32 time,
+                       TFloat32* noise );
+
+// Generate the given map into an array of width x height RGBA (8-bits each) pixels. The noise array is working
+// space of width x height floats, passed in to avoid allocating it each call
+void GenerateProceduralMap( EProceduralMap map, const SProceduralMapSettings& settings, TUInt32 width, TUInt32 height,
+                            TFloat32 time, TFloat32* noise, TUInt8* pixels );
+
+
+//-----------------------------------------------------------------------------
+// Animation
+//-----------------------------------------------------------------------------
+
+// Regenerates a procedural map on a worker thread. The main thread requests a new frame for a given time and
+// picks up the most recently completed frame whenever one is ready. Triple buffered so neither thread waits
+class CProceduralMapAnimator
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	CProceduralMapAnimator( EProceduralMap map, const SProceduralMapSettings& settings, TUInt32 width, TUInt32 height );
+	~CProceduralMapAnimator();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CProceduralMapAnimator( const CProceduralMapAnimator& );
+	CProceduralMapAnimator& operator=( const CProceduralMapAnimator& );
+
+public:
+	/////////////////////////////////////
+	//	Public interface
+
+	TUInt32 GetWidth()
+	{
+		return m_Width;
+	}
+	TUInt32 GetHeight()
+	{
+		return m_Height;
+	}
+
+	// Request that the map is generated for the given time. Replaces any request not yet started
+	void RequestFrame( TFloat32 time );
+
+	// Returns the pixels of the most recently completed frame if there has been one since the last call, otherwise
+	// NULL. The pixels remain valid until the next call
+	const TUInt8* FetchFrame();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Worker thread function
+	void Run();
+
+	EProceduralMap         m_Map;
+	SProceduralMapSettings m_Settings;
+	TUInt32                m_Width;
+	TUInt32                m_Height;
+
+	// Noise working space (worker only) and three pixel buffers: the one being written by the worker, the one
+	// most recently completed and the one being read by the main thread
+	vector<TFloat32> m_Noise;
+	vector<TUInt8>   m_Pixels[3];
+	TUInt32          m_WriteBuffer;
+	TUInt32          m_ReadyBuffer;
+	TUInt32          m_ReadBuffer;
+	bool             m_FrameReady;
+
+	// Requests from the main thread
+	TFloat32 m_RequestTime;
+	bool     m_Requested;
+	bool     m_Quit;
+
+	mutex              m_Mutex;
+	condition_variable m_Request;
+	thread             m_Thread;
+};
+
+
+} // namespace gen
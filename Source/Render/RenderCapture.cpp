@@ -0,0 +1,1034 @@
+/***************************************************************************************
+	RenderCapture.cpp
+
+	Frame capture and replay of the render device calls
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RenderCapture.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// File layout
+//-----------------------------------------------------------------------------
+
+const char CaptureIdentifier[4] = { 'R', 'C', 'A', 'P' };
+const TUInt16 CaptureVersion = 2; // Version 2 added buffer updates and instanced draws (renumbering the calls)
+const TUInt32 CaptureHeaderSize = 4 + 2 + 4 + 4;
+
+// Ids are numbered from 1 over the whole capturing session. A replayed id past this is taken as corrupt rather than
+// growing the object table to match
+const TUInt32 MaxReplayObjectId = 1 << 20;
+
+// Largest texture width or height replayed, so the size of the pixels cannot overflow
+const TUInt32 MaxReplayTextureSize = 16384;
+
+
+//-----------------------------------------------------------------------------
+// Capture construction
+//-----------------------------------------------------------------------------
+
+CRenderCapture::CRenderCapture( IRenderDevice* device )
+{
+	m_Device = device;
+	m_NextId = 1;
+	m_NumCapturedCalls = 0;
+	m_CaptureSize = 0;
+	m_File = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Capture
+//-----------------------------------------------------------------------------
+
+// Start writing calls to the given file, beginning with the objects currently alive and the current contents of
+// their buffers and textures. Returns false on failure
+bool CRenderCapture::BeginCapture( const string& fileName )
+{
+	lock_guard<mutex> lock( m_Mutex );
+	if (m_File) return false;
+	m_File = fopen( fileName.c_str(), "wb" );
+	if (!m_File) return false;
+
+	// Header, the size of the setup records is filled in below
+	TUInt32 backBufferId = NewObjectId( m_Device->GetBackBuffer() );
+	m_Record.assign( CaptureIdentifier, CaptureIdentifier + 4 );
+	m_Record.push_back( static_cast<TUInt8>(CaptureVersion) );
+	m_Record.push_back( static_cast<TUInt8>(CaptureVersion >> 8) );
+	Write( backBufferId );
+	Write( 0 );
+	m_Capture = m_Record;
+
+	// Recreate the live objects in the order they were created, with the current contents of buffers and textures
+	vector<TUInt8> contents;
+	for (map<TUInt32, SObject>::iterator object = m_Objects.begin(); object != m_Objects.end(); ++object)
+	{
+		const SObject& live = object->second;
+		m_Capture.insert( m_Capture.end(), live.record.begin(), live.record.end() );
+		if (live.contentsSize)
+		{
+			contents.resize( live.contentsSize );
+			bool read = (live.record[0] == CallCreateBuffer) ?
+			            m_Device->ReadBuffer( static_cast<SRenderBuffer*>(live.handle), &contents[0], live.contentsSize ) :
+			            m_Device->ReadTexture( static_cast<SRenderResource*>(live.handle), &contents[0] );
+			if (!read) contents.assign( live.contentsSize, 0 ); // Device cannot read back (e.g. null device), replays start with zeros
+			m_Capture.insert( m_Capture.end(), contents.begin(), contents.end() );
+		}
+	}
+	TUInt32 setupSize = static_cast<TUInt32>(m_Capture.size()) - CaptureHeaderSize;
+	for (TUInt32 i = 0; i < 4; ++i)
+	{
+		m_Capture[CaptureHeaderSize - 4 + i] = static_cast<TUInt8>(setupSize >> (i * 8));
+	}
+
+	m_NumCapturedCalls = 0;
+	return true;
+}
+
+// Finish writing the capture file. Returns false if the file could not be written
+bool CRenderCapture::EndCapture()
+{
+	lock_guard<mutex> lock( m_Mutex );
+	if (!m_File) return false;
+
+	bool success = fwrite( &m_Capture[0], 1, m_Capture.size(), m_File ) == m_Capture.size();
+	success = (fclose( m_File ) == 0) && success;
+	m_File = 0;
+
+	m_CaptureSize = static_cast<TUInt32>(m_Capture.size());
+	m_Capture.clear();
+	return success;
+}
+
+
+//-----------------------------------------------------------------------------
+// Records
+//-----------------------------------------------------------------------------
+
+// Start a record for a call, in m_Record
+void CRenderCapture::BeginRecord( ERenderDeviceCall call )
+{
+	m_Record.clear();
+	m_Record.push_back( static_cast<TUInt8>(call) );
+}
+
+// Append values to m_Record
+void CRenderCapture::Write( TUInt32 value )
+{
+	for (TUInt32 i = 0; i < 4; ++i)
+	{
+		m_Record.push_back( static_cast<TUInt8>(value >> (i * 8)) );
+	}
+}
+
+void CRenderCapture::Write( const void* data, TUInt32 size )
+{
+	const TUInt8* bytes = static_cast<const TUInt8*>(data);
+	m_Record.insert( m_Record.end(), bytes, bytes + size );
+}
+
+void CRenderCapture::Write( const string& text )
+{
+	Write( static_cast<TUInt32>(text.length()) );
+	Write( text.c_str(), static_cast<TUInt32>(text.length()) );
+}
+
+void CRenderCapture::WriteObject( void* handle )
+{
+	if (!handle)
+	{
+		Write( 0 );
+		return;
+	}
+
+	// Objects created before the capture device was in use are unknown, they get an id but are not recreated
+	map<void*, TUInt32>::iterator id = m_ObjectIds.find( handle );
+	Write( (id != m_ObjectIds.end()) ? id->second : NewObjectId( handle ) );
+}
+
+// Finish the record in m_Record, writing it to the capture if capturing
+void CRenderCapture::EndRecord()
+{
+	if (m_File)
+	{
+		m_Capture.insert( m_Capture.end(), m_Record.begin(), m_Record.end() );
+		++m_NumCapturedCalls;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Objects
+//-----------------------------------------------------------------------------
+
+// Give a new object an id and keep the record just written to recreate it, optionally owned by an effect or
+// followed by contents. Returns the id
+TUInt32 CRenderCapture::AddObject( void* handle, TUInt32 owner /*= 0*/, TUInt32 contentsSize /*= 0*/ )
+{
+	TUInt32 id = NewObjectId( handle );
+	SObject& object = m_Objects[id];
+	object.handle = handle;
+	object.owner = owner;
+	object.contentsSize = contentsSize;
+	object.record = m_Record;
+	return id;
+}
+
+TUInt32 CRenderCapture::NewObjectId( void* handle )
+{
+	map<void*, TUInt32>::iterator id = m_ObjectIds.find( handle );
+	if (id != m_ObjectIds.end()) return id->second;
+
+	m_ObjectIds[handle] = m_NextId;
+	return m_NextId++;
+}
+
+// Forget an object (and any objects it owns)
+void CRenderCapture::RemoveObject( void* handle )
+{
+	map<void*, TUInt32>::iterator id = m_ObjectIds.find( handle );
+	if (id == m_ObjectIds.end()) return;
+	TUInt32 ownerId = id->second;
+	m_ObjectIds.erase( id );
+	m_Objects.erase( ownerId );
+
+	map<TUInt32, SObject>::iterator object = m_Objects.begin();
+	while (object != m_Objects.end())
+	{
+		if (object->second.owner == ownerId)
+		{
+			m_ObjectIds.erase( object->second.handle );
+			m_Objects.erase( object++ );
+		}
+		else
+		{
+			++object;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Buffers and input layouts
+//-----------------------------------------------------------------------------
+
+SRenderBuffer* CRenderCapture::CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size )
+{
+	SRenderBuffer* buffer = m_Device->CreateBuffer( type, data, size );
+	if (!buffer) return 0;
+
+	// The contents are only written when capturing, later captures read them back from the device
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallCreateBuffer );
+	Write( NewObjectId( buffer ) );
+	Write( type );
+	Write( size );
+	AddObject( buffer, 0, size );
+	if (!m_File) return buffer;
+	if (data)
+	{
+		Write( data, size );
+	}
+	else
+	{
+		m_Record.resize( m_Record.size() + size, 0 ); // Contents not given, replays start with zeros
+	}
+	EndRecord();
+	return buffer;
+}
+
+void CRenderCapture::ReleaseBuffer( SRenderBuffer* buffer )
+{
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallReleaseBuffer );
+	WriteObject( buffer );
+	EndRecord();
+	RemoveObject( buffer );
+	m_Device->ReleaseBuffer( buffer );
+}
+
+void CRenderCapture::UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size )
+{
+	m_Device->UpdateBuffer( buffer, data, size );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallUpdateBuffer );
+	WriteObject( buffer );
+	Write( size );
+	Write( data, size );
+	EndRecord();
+}
+
+SRenderInputLayout* CRenderCapture::CreateInputLayout( const SVertexElement* elements, TUInt32 numElements,
+                                                       SRenderTechnique* technique )
+{
+	SRenderInputLayout* layout = m_Device->CreateInputLayout( elements, numElements, technique );
+	if (!layout) return 0;
+
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallCreateInputLayout );
+	Write( NewObjectId( layout ) );
+	WriteObject( technique );
+	Write( numElements );
+	for (TUInt32 elt = 0; elt < numElements; ++elt)
+	{
+		Write( string( elements[elt].semanticName ) );
+		Write( elements[elt].semanticIndex );
+		Write( elements[elt].format );
+		Write( elements[elt].offset );
+		Write( elements[elt].slot );
+		Write( elements[elt].instanceStep );
+	}
+	AddObject( layout );
+	EndRecord();
+	return layout;
+}
+
+void CRenderCapture::ReleaseInputLayout( SRenderInputLayout* layout )
+{
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallReleaseInputLayout );
+	WriteObject( layout );
+	EndRecord();
+	RemoveObject( layout );
+	m_Device->ReleaseInputLayout( layout );
+}
+
+
+//-----------------------------------------------------------------------------
+// Textures and render targets
+//-----------------------------------------------------------------------------
+
+SRenderResource* CRenderCapture::CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps )
+{
+	SRenderResource* texture = m_Device->CreateTexture( width, height, pixels, mipMaps );
+	if (!texture) return 0;
+
+	// The pixels are only written when capturing, later captures read them back from the device
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallCreateTexture );
+	Write( NewObjectId( texture ) );
+	Write( width );
+	Write( height );
+	Write( mipMaps ? 1 : 0 );
+	AddObject( texture, 0, width * height * 4 );
+	if (!m_File) return texture;
+	Write( pixels, width * height * 4 );
+	EndRecord();
+	return texture;
+}
+
+SRenderResource* CRenderCapture::LoadTexture( const string& fileName )
+{
+	SRenderResource* texture = m_Device->LoadTexture( fileName );
+	if (!texture) return 0;
+
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallLoadTexture );
+	Write( NewObjectId( texture ) );
+	Write( fileName );
+	AddObject( texture );
+	EndRecord();
+	return texture;
+}
+
+void CRenderCapture::UpdateTexture( SRenderResource* texture, const void* pixels )
+{
+	m_Device->UpdateTexture( texture, pixels );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+
+	// The size of the pixels is kept with the texture, only textures created through the capture device are recorded
+	map<void*, TUInt32>::iterator id = m_ObjectIds.find( texture );
+	if (id == m_ObjectIds.end()) return;
+	map<TUInt32, SObject>::iterator object = m_Objects.find( id->second );
+	if (object == m_Objects.end() || object->second.record[0] != CallCreateTexture) return;
+	TUInt32 size = object->second.contentsSize;
+
+	BeginRecord( CallUpdateTexture );
+	WriteObject( texture );
+	Write( size );
+	Write( pixels, size );
+	EndRecord();
+}
+
+bool CRenderCapture::CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource )
+{
+	if (!m_Device->CreateRenderTarget( width, height, target, resource )) return false;
+
+	// The target's record creates both objects, the resource belongs to the target
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallCreateRenderTarget );
+	Write( NewObjectId( *target ) );
+	Write( NewObjectId( *resource ) );
+	Write( width );
+	Write( height );
+	TUInt32 targetId = AddObject( *target );
+	m_Record.clear();
+	AddObject( *resource, targetId );
+	m_Record = m_Objects[targetId].record;
+	EndRecord();
+	return true;
+}
+
+void CRenderCapture::ReleaseResource( SRenderResource* resource )
+{
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallReleaseResource );
+	WriteObject( resource );
+	EndRecord();
+	RemoveObject( resource );
+	m_Device->ReleaseResource( resource );
+}
+
+void CRenderCapture::ReleaseRenderTarget( SRenderTarget* target )
+{
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallReleaseRenderTarget );
+	WriteObject( target );
+	EndRecord();
+	RemoveObject( target );
+	m_Device->ReleaseRenderTarget( target );
+}
+
+SRenderTarget* CRenderCapture::GetBackBuffer()
+{
+	return m_Device->GetBackBuffer();
+}
+
+
+//-----------------------------------------------------------------------------
+// Effects
+//-----------------------------------------------------------------------------
+
+SRenderEffect* CRenderCapture::LoadEffect( const string& fileName )
+{
+	SRenderEffect* effect = m_Device->LoadEffect( fileName );
+	if (!effect) return 0;
+
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallLoadEffect );
+	Write( NewObjectId( effect ) );
+	Write( fileName );
+	AddObject( effect );
+	EndRecord();
+	return effect;
+}
+
+void CRenderCapture::ReleaseEffect( SRenderEffect* effect )
+{
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallReleaseEffect );
+	WriteObject( effect );
+	EndRecord();
+	RemoveObject( effect );
+	m_Device->ReleaseEffect( effect );
+}
+
+// Techniques and variables are recorded the first time they are found, later look ups return the same object. May be
+// called from any thread so always locked
+SRenderTechnique* CRenderCapture::GetTechnique( SRenderEffect* effect, const string& name )
+{
+	SRenderTechnique* technique = m_Device->GetTechnique( effect, name );
+	if (!technique) return technique;
+	lock_guard<mutex> lock( m_Mutex );
+	if (m_ObjectIds.count( technique )) return technique;
+
+	BeginRecord( CallGetTechnique );
+	Write( NewObjectId( technique ) );
+	WriteObject( effect );
+	Write( name );
+	AddObject( technique, m_ObjectIds[effect] );
+	EndRecord();
+	return technique;
+}
+
+SRenderVariable* CRenderCapture::GetVariable( SRenderEffect* effect, const string& name )
+{
+	SRenderVariable* variable = m_Device->GetVariable( effect, name );
+	if (!variable) return variable;
+	lock_guard<mutex> lock( m_Mutex );
+	if (m_ObjectIds.count( variable )) return variable;
+
+	BeginRecord( CallGetVariable );
+	Write( NewObjectId( variable ) );
+	WriteObject( effect );
+	Write( name );
+	AddObject( variable, m_ObjectIds[effect] );
+	EndRecord();
+	return variable;
+}
+
+void CRenderCapture::SetVariable( SRenderVariable* variable, const void* data, TUInt32 size )
+{
+	m_Device->SetVariable( variable, data, size );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetVariable );
+	WriteObject( variable );
+	Write( size );
+	Write( data, size );
+	EndRecord();
+}
+
+void CRenderCapture::SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix )
+{
+	m_Device->SetMatrixVariable( variable, matrix );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetMatrixVariable );
+	WriteObject( variable );
+	Write( matrix, 16 * sizeof(TFloat32) );
+	EndRecord();
+}
+
+void CRenderCapture::SetResourceVariable( SRenderVariable* variable, SRenderResource* resource )
+{
+	m_Device->SetResourceVariable( variable, resource );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetResourceVariable );
+	WriteObject( variable );
+	WriteObject( resource );
+	EndRecord();
+}
+
+// Queries are not recorded, they may be made from any thread (see CRenderCommandList)
+bool CRenderCapture::ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size )
+{
+	return m_Device->ReadBuffer( buffer, data, size );
+}
+
+bool CRenderCapture::ReadTexture( SRenderResource* texture, void* pixels )
+{
+	return m_Device->ReadTexture( texture, pixels );
+}
+
+TUInt32 CRenderCapture::GetNumPasses( SRenderTechnique* technique )
+{
+	return m_Device->GetNumPasses( technique );
+}
+
+void CRenderCapture::ApplyPass( SRenderTechnique* technique, TUInt32 pass )
+{
+	m_Device->ApplyPass( technique, pass );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallApplyPass );
+	WriteObject( technique );
+	Write( pass );
+	EndRecord();
+}
+
+
+//-----------------------------------------------------------------------------
+// Rendering
+//-----------------------------------------------------------------------------
+
+void CRenderCapture::SetRenderTarget( SRenderTarget* target, bool depthBuffer )
+{
+	m_Device->SetRenderTarget( target, depthBuffer );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetRenderTarget );
+	WriteObject( target );
+	Write( depthBuffer ? 1 : 0 );
+	EndRecord();
+}
+
+void CRenderCapture::ClearRenderTarget( SRenderTarget* target, const TFloat32* colour )
+{
+	m_Device->ClearRenderTarget( target, colour );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallClearRenderTarget );
+	WriteObject( target );
+	Write( colour, 4 * sizeof(TFloat32) );
+	EndRecord();
+}
+
+void CRenderCapture::ClearDepthBuffer()
+{
+	m_Device->ClearDepthBuffer();
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallClearDepthBuffer );
+	EndRecord();
+}
+
+void CRenderCapture::SetViewport( TUInt32 width, TUInt32 height )
+{
+	m_Device->SetViewport( width, height );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetViewport );
+	Write( width );
+	Write( height );
+	EndRecord();
+}
+
+void CRenderCapture::SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize )
+{
+	m_Device->SetVertexBuffer( slot, buffer, vertexSize );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetVertexBuffer );
+	Write( slot );
+	WriteObject( buffer );
+	Write( vertexSize );
+	EndRecord();
+}
+
+void CRenderCapture::SetIndexBuffer( SRenderBuffer* buffer )
+{
+	m_Device->SetIndexBuffer( buffer );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetIndexBuffer );
+	WriteObject( buffer );
+	EndRecord();
+}
+
+void CRenderCapture::SetInputLayout( SRenderInputLayout* layout )
+{
+	m_Device->SetInputLayout( layout );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetInputLayout );
+	WriteObject( layout );
+	EndRecord();
+}
+
+void CRenderCapture::SetPrimitiveTopology( EPrimitiveTopology topology )
+{
+	m_Device->SetPrimitiveTopology( topology );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallSetPrimitiveTopology );
+	Write( topology );
+	EndRecord();
+}
+
+void CRenderCapture::Draw( TUInt32 numVertices, TUInt32 startVertex )
+{
+	m_Device->Draw( numVertices, startVertex );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallDraw );
+	Write( numVertices );
+	Write( startVertex );
+	EndRecord();
+}
+
+void CRenderCapture::DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex )
+{
+	m_Device->DrawIndexed( numIndices, startIndex, baseVertex );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallDrawIndexed );
+	Write( numIndices );
+	Write( startIndex );
+	Write( static_cast<TUInt32>(baseVertex) );
+	EndRecord();
+}
+
+void CRenderCapture::DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex,
+                                           TInt32 baseVertex, TUInt32 startInstance )
+{
+	m_Device->DrawIndexedInstanced( numIndices, numInstances, startIndex, baseVertex, startInstance );
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallDrawIndexedInstanced );
+	Write( numIndices );
+	Write( numInstances );
+	Write( startIndex );
+	Write( static_cast<TUInt32>(baseVertex) );
+	Write( startInstance );
+	EndRecord();
+}
+
+void CRenderCapture::Present()
+{
+	m_Device->Present();
+	if (!m_File) return;
+	lock_guard<mutex> lock( m_Mutex );
+	BeginRecord( CallPresent );
+	EndRecord();
+}
+
+
+//-----------------------------------------------------------------------------
+// Replay
+//-----------------------------------------------------------------------------
+
+CRenderCaptureReplay::CRenderCaptureReplay()
+{
+	m_Device = 0;
+	m_SetupStart = m_FrameStart = 0;
+	m_BackBufferId = 0;
+	m_NumFrameCalls = 0;
+	m_Pos = m_End = 0;
+}
+
+// Load a capture file. Returns false on failure
+bool CRenderCaptureReplay::Load( const string& fileName )
+{
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if (!file) return false;
+	m_Data.clear();
+	TUInt8 buffer[4096];
+	size_t numRead;
+	while ((numRead = fread( buffer, 1, sizeof(buffer), file )) > 0)
+	{
+		m_Data.insert( m_Data.end(), buffer, buffer + numRead );
+	}
+	fclose( file );
+
+	// Header
+	if (m_Data.size() < CaptureHeaderSize || memcmp( &m_Data[0], CaptureIdentifier, 4 ) != 0) return false;
+	TUInt16 version = m_Data[4] | (m_Data[5] << 8);
+	if (version != CaptureVersion) return false; // Earlier versions numbered the calls differently
+	m_Pos = 6;
+	m_End = CaptureHeaderSize;
+	TUInt32 setupSize;
+	Read( &m_BackBufferId );
+	Read( &setupSize );
+	if (m_BackBufferId >= MaxReplayObjectId) return false;
+	m_SetupStart = CaptureHeaderSize;
+	m_FrameStart = m_SetupStart + setupSize;
+	return m_FrameStart <= m_Data.size();
+}
+
+// Create the objects alive at the start of the capture on the given device. Returns false if the capture is corrupt
+bool CRenderCaptureReplay::CreateObjects( IRenderDevice* device )
+{
+	m_Device = device;
+	m_Objects.clear();
+	SetObject( m_BackBufferId, device->GetBackBuffer() );
+	TUInt32 numCalls;
+	return ReplayRecords( m_SetupStart, m_FrameStart, &numCalls );
+}
+
+// Submit the captured frame to the device the objects were created on. Can be repeated. Returns false if the
+// capture is corrupt
+bool CRenderCaptureReplay::ReplayFrame()
+{
+	if (!m_Device) return false;
+	return ReplayRecords( m_FrameStart, static_cast<TUInt32>(m_Data.size()), &m_NumFrameCalls );
+}
+
+// Remember the object created for an id
+void CRenderCaptureReplay::SetObject( TUInt32 id, void* object )
+{
+	if (id >= m_Objects.size()) m_Objects.resize( id + 1, 0 );
+	m_Objects[id] = object;
+}
+
+
+// Read values from the capture data, returning false if past the end of the range
+bool CRenderCaptureReplay::Read( TUInt32* value )
+{
+	if (m_End - m_Pos < 4) return false;
+	*value = m_Data[m_Pos] | (m_Data[m_Pos + 1] << 8) | (m_Data[m_Pos + 2] << 16) | (m_Data[m_Pos + 3] << 24);
+	m_Pos += 4;
+	return true;
+}
+
+// Read the id of an object about to be created, returning false if it is out of range
+bool CRenderCaptureReplay::ReadNewId( TUInt32* id )
+{
+	return Read( id ) && *id < MaxReplayObjectId;
+}
+
+bool CRenderCaptureReplay::Read( const TUInt8** data, TUInt32 size )
+{
+	if (m_End - m_Pos < size) return false;
+	*data = &m_Data[0] + m_Pos;
+	m_Pos += size;
+	return true;
+}
+
+bool CRenderCaptureReplay::Read( string* text )
+{
+	TUInt32 length;
+	const TUInt8* chars;
+	if (!Read( &length ) || !Read( &chars, length )) return false;
+	text->assign( reinterpret_cast<const char*>(chars), length );
+	return true;
+}
+
+
+// Replay records from the given range of the capture data
+bool CRenderCaptureReplay::ReplayRecords( TUInt32 start, TUInt32 end, TUInt32* numCalls )
+{
+	m_Pos = start;
+	m_End = end;
+	*numCalls = 0;
+
+	// Names for input layouts must stay alive while the layout is created
+	vector<string> semanticNames;
+	vector<SVertexElement> elements;
+
+	while (m_Pos < m_End)
+	{
+		ERenderDeviceCall call = static_cast<ERenderDeviceCall>(m_Data[m_Pos++]);
+		++(*numCalls);
+
+		TUInt32 id, a, b, c;
+		const TUInt8* data;
+		string name;
+		switch (call)
+		{
+			case CallCreateBuffer:
+			{
+				if (!ReadNewId( &id ) || !Read( &a ) || !Read( &b ) || !Read( &data, b )) return false;
+				SetObject( id, m_Device->CreateBuffer( static_cast<ERenderBufferType>(a), data, b ) );
+				break;
+			}
+			case CallReleaseBuffer:
+			{
+				SRenderBuffer* buffer;
+				if (!ReadObject( &buffer )) return false;
+				m_Device->ReleaseBuffer( buffer );
+				break;
+			}
+			case CallUpdateBuffer:
+			{
+				SRenderBuffer* buffer;
+				if (!ReadObject( &buffer ) || !Read( &a ) || !Read( &data, a )) return false;
+				m_Device->UpdateBuffer( buffer, data, a );
+				break;
+			}
+			case CallCreateInputLayout:
+			{
+				SRenderTechnique* technique;
+				if (!ReadNewId( &id ) || !ReadObject( &technique ) || !Read( &a )) return false;
+				semanticNames.resize( a );
+				elements.resize( a );
+				for (TUInt32 elt = 0; elt < a; ++elt)
+				{
+					TUInt32 format;
+					if (!Read( &semanticNames[elt] ) || !Read( &elements[elt].semanticIndex ) || !Read( &format ) ||
+					    !Read( &elements[elt].offset ) || !Read( &elements[elt].slot ) || !Read( &elements[elt].instanceStep ))
+					{
+						return false;
+					}
+					elements[elt].format = static_cast<EVertexFormat>(format);
+				}
+				for (TUInt32 elt = 0; elt < a; ++elt)
+				{
+					elements[elt].semanticName = semanticNames[elt].c_str();
+				}
+				SetObject( id, m_Device->CreateInputLayout( a ? &elements[0] : 0, a, technique ) );
+				break;
+			}
+			case CallReleaseInputLayout:
+			{
+				SRenderInputLayout* layout;
+				if (!ReadObject( &layout )) return false;
+				m_Device->ReleaseInputLayout( layout );
+				break;
+			}
+
+			case CallCreateTexture:
+			{
+				if (!ReadNewId( &id ) || !Read( &a ) || !Read( &b ) || !Read( &c ) ||
+				    a > MaxReplayTextureSize || b > MaxReplayTextureSize || !Read( &data, a * b * 4 ))
+				{
+					return false;
+				}
+				SetObject( id, m_Device->CreateTexture( a, b, data, c != 0 ) );
+				break;
+			}
+			case CallLoadTexture:
+			{
+				if (!ReadNewId( &id ) || !Read( &name )) return false;
+				SetObject( id, m_Device->LoadTexture( name ) );
+				break;
+			}
+			case CallUpdateTexture:
+			{
+				SRenderResource* texture;
+				if (!ReadObject( &texture ) || !Read( &a ) || !Read( &data, a )) return false;
+				m_Device->UpdateTexture( texture, data );
+				break;
+			}
+			case CallCreateRenderTarget:
+			{
+				TUInt32 resourceId;
+				if (!ReadNewId( &id ) || !ReadNewId( &resourceId ) || !Read( &a ) || !Read( &b )) return false;
+				SRenderTarget* target = 0;
+				SRenderResource* resource = 0;
+				m_Device->CreateRenderTarget( a, b, &target, &resource );
+				SetObject( id, target );
+				SetObject( resourceId, resource );
+				break;
+			}
+			case CallReleaseResource:
+			{
+				SRenderResource* resource;
+				if (!ReadObject( &resource )) return false;
+				m_Device->ReleaseResource( resource );
+				break;
+			}
+			case CallReleaseRenderTarget:
+			{
+				SRenderTarget* target;
+				if (!ReadObject( &target )) return false;
+				m_Device->ReleaseRenderTarget( target );
+				break;
+			}
+
+			case CallLoadEffect:
+			{
+				if (!ReadNewId( &id ) || !Read( &name )) return false;
+				SetObject( id, m_Device->LoadEffect( name ) );
+				break;
+			}
+			case CallReleaseEffect:
+			{
+				SRenderEffect* effect;
+				if (!ReadObject( &effect )) return false;
+				m_Device->ReleaseEffect( effect );
+				break;
+			}
+			case CallGetTechnique:
+			{
+				SRenderEffect* effect;
+				if (!ReadNewId( &id ) || !ReadObject( &effect ) || !Read( &name )) return false;
+				SetObject( id, m_Device->GetTechnique( effect, name ) );
+				break;
+			}
+			case CallGetVariable:
+			{
+				SRenderEffect* effect;
+				if (!ReadNewId( &id ) || !ReadObject( &effect ) || !Read( &name )) return false;
+				SetObject( id, m_Device->GetVariable( effect, name ) );
+				break;
+			}
+			case CallSetVariable:
+			{
+				SRenderVariable* variable;
+				if (!ReadObject( &variable ) || !Read( &a ) || !Read( &data, a )) return false;
+				m_Device->SetVariable( variable, data, a );
+				break;
+			}
+			case CallSetMatrixVariable:
+			{
+				// Copy out of the byte stream to keep the floats aligned
+				SRenderVariable* variable;
+				TFloat32 matrix[16];
+				if (!ReadObject( &variable ) || !Read( &data, sizeof(matrix) )) return false;
+				memcpy( matrix, data, sizeof(matrix) );
+				m_Device->SetMatrixVariable( variable, matrix );
+				break;
+			}
+			case CallSetResourceVariable:
+			{
+				SRenderVariable* variable;
+				SRenderResource* resource;
+				if (!ReadObject( &variable ) || !ReadObject( &resource )) return false;
+				m_Device->SetResourceVariable( variable, resource );
+				break;
+			}
+			case CallApplyPass:
+			{
+				SRenderTechnique* technique;
+				if (!ReadObject( &technique ) || !Read( &a )) return false;
+				m_Device->ApplyPass( technique, a );
+				break;
+			}
+
+			case CallSetRenderTarget:
+			{
+				SRenderTarget* target;
+				if (!ReadObject( &target ) || !Read( &a )) return false;
+				m_Device->SetRenderTarget( target, a != 0 );
+				break;
+			}
+			case CallClearRenderTarget:
+			{
+				SRenderTarget* target;
+				TFloat32 colour[4];
+				if (!ReadObject( &target ) || !Read( &data, sizeof(colour) )) return false;
+				memcpy( colour, data, sizeof(colour) );
+				m_Device->ClearRenderTarget( target, colour );
+				break;
+			}
+			case CallClearDepthBuffer:
+			{
+				m_Device->ClearDepthBuffer();
+				break;
+			}
+			case CallSetViewport:
+			{
+				if (!Read( &a ) || !Read( &b )) return false;
+				m_Device->SetViewport( a, b );
+				break;
+			}
+			case CallSetVertexBuffer:
+			{
+				SRenderBuffer* buffer;
+				if (!Read( &a ) || !ReadObject( &buffer ) || !Read( &b )) return false;
+				m_Device->SetVertexBuffer( a, buffer, b );
+				break;
+			}
+			case CallSetIndexBuffer:
+			{
+				SRenderBuffer* buffer;
+				if (!ReadObject( &buffer )) return false;
+				m_Device->SetIndexBuffer( buffer );
+				break;
+			}
+			case CallSetInputLayout:
+			{
+				SRenderInputLayout* layout;
+				if (!ReadObject( &layout )) return false;
+				m_Device->SetInputLayout( layout );
+				break;
+			}
+			case CallSetPrimitiveTopology:
+			{
+				if (!Read( &a )) return false;
+				m_Device->SetPrimitiveTopology( static_cast<EPrimitiveTopology>(a) );
+				break;
+			}
+			case CallDraw:
+			{
+				if (!Read( &a ) || !Read( &b )) return false;
+				m_Device->Draw( a, b );
+				break;
+			}
+			case CallDrawIndexed:
+			{
+				if (!Read( &a ) || !Read( &b ) || !Read( &c )) return false;
+				m_Device->DrawIndexed( a, b, static_cast<TInt32>(c) );
+				break;
+			}
+			case CallDrawIndexedInstanced:
+			{
+				TUInt32 d, e;
+				if (!Read( &a ) || !Read( &b ) || !Read( &c ) || !Read( &d ) || !Read( &e )) return false;
+				m_Device->DrawIndexedInstanced( a, b, c, static_cast<TInt32>(d), e );
+				break;
+			}
+			case CallPresent:
+			{
+				m_Device->Present();
+				break;
+			}
+
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+
+} // namespace gen
@@ -0,0 +1,259 @@
+/***************************************************************************************
+	RenderCapture.h
+
+	Frame capture. The capture device sits in front of another render device, passing all
+	calls through to it. While capturing, every call is also written to a compact binary
+	file, preceded by the creation of every device object alive at the start of the
+	capture. Only how each object was created is kept between captures - buffer and
+	texture contents are read back from the device when a capture begins. A capture can
+	be replayed on any device - the null device gives the call counts and submission cost
+	of a real frame offline. Does not depend on D3D, also builds on GCC / Clang platforms
+	(see the ReplayCapture tool)
+
+	File layout (little-endian): "RCAP" identifier, 16-bit version, 32-bit id of the back
+	buffer, 32-bit size of the setup records, then the setup records, then the frame
+	records. Each record is an 8-bit ERenderDeviceCall followed by its arguments. Device
+	objects are referred to by 32-bit ids, 0 for NULL
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+using namespace std;
+
+#include "Defines.h"
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Capture
+//-----------------------------------------------------------------------------
+
+class CRenderCapture : public IRenderDevice
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	// Pass calls through to the given device, which must outlive the capture device. All objects must be created
+	// through the capture device for them to be included in captures. Queries may come from any thread (see
+	// CRenderCommandList), all other calls must come from the thread that owns the device
+	CRenderCapture( IRenderDevice* device );
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CRenderCapture( const CRenderCapture& );
+	CRenderCapture& operator=( const CRenderCapture& );
+
+public:
+	/////////////////////////////////////
+	//	Capture
+
+	// Start writing calls to the given file, beginning with the objects currently alive and the current contents of
+	// their buffers and textures. Returns false on failure
+	bool BeginCapture( const string& fileName );
+
+	// Finish writing the capture file. Returns false if the file could not be written
+	bool EndCapture();
+
+	bool IsCapturing()
+	{
+		return m_File != 0;
+	}
+
+	// Number of calls and the size (in bytes) of the last capture
+	TUInt32 GetNumCapturedCalls()
+	{
+		return m_NumCapturedCalls;
+	}
+	TUInt32 GetCaptureSize()
+	{
+		return m_CaptureSize;
+	}
+
+
+	/////////////////////////////////////
+	//	Device interface
+
+	SRenderBuffer* CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size );
+	void ReleaseBuffer( SRenderBuffer* buffer );
+	void UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size );
+	bool ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size );
+	SRenderInputLayout* CreateInputLayout( const SVertexElement* elements, TUInt32 numElements, SRenderTechnique* technique );
+	void ReleaseInputLayout( SRenderInputLayout* layout );
+
+	SRenderResource* CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps );
+	SRenderResource* LoadTexture( const string& fileName );
+	void UpdateTexture( SRenderResource* texture, const void* pixels );
+	bool ReadTexture( SRenderResource* texture, void* pixels );
+	bool CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource );
+	void ReleaseResource( SRenderResource* resource );
+	void ReleaseRenderTarget( SRenderTarget* target );
+	SRenderTarget* GetBackBuffer();
+
+	SRenderEffect* LoadEffect( const string& fileName );
+	void ReleaseEffect( SRenderEffect* effect );
+	SRenderTechnique* GetTechnique( SRenderEffect* effect, const string& name );
+	SRenderVariable* GetVariable( SRenderEffect* effect, const string& name );
+	void SetVariable( SRenderVariable* variable, const void* data, TUInt32 size );
+	void SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix );
+	void SetResourceVariable( SRenderVariable* variable, SRenderResource* resource );
+	TUInt32 GetNumPasses( SRenderTechnique* technique );
+	void ApplyPass( SRenderTechnique* technique, TUInt32 pass );
+
+	void SetRenderTarget( SRenderTarget* target, bool depthBuffer );
+	void ClearRenderTarget( SRenderTarget* target, const TFloat32* colour );
+	void ClearDepthBuffer();
+	void SetViewport( TUInt32 width, TUInt32 height );
+	void SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize );
+	void SetIndexBuffer( SRenderBuffer* buffer );
+	void SetInputLayout( SRenderInputLayout* layout );
+	void SetPrimitiveTopology( EPrimitiveTopology topology );
+	void Draw( TUInt32 numVertices, TUInt32 startVertex );
+	void DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex );
+	void DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+	                           TUInt32 startInstance );
+	void Present();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Live device object, with the record that recreates it in a capture. Buffer and texture records are missing
+	// their contents, which are read from the device when a capture begins
+	struct SObject
+	{
+		void*          handle;
+		TUInt32        owner;        // Id of effect owning a technique or variable, 0 otherwise
+		TUInt32        contentsSize; // Size of the buffer or texture contents following the record, 0 otherwise
+		vector<TUInt8> record;
+	};
+
+	// Start a record for a call, in m_Record
+	void BeginRecord( ERenderDeviceCall call );
+
+	// Append values to m_Record
+	void Write( TUInt32 value );
+	void Write( const void* data, TUInt32 size );
+	void Write( const string& text );
+	void WriteObject( void* handle );
+
+	// Finish the record in m_Record, writing it to the capture if capturing
+	void EndRecord();
+
+	// Give a new object an id and keep the record just written to recreate it, optionally owned by an effect or
+	// followed by contents. Returns the id
+	TUInt32 AddObject( void* handle, TUInt32 owner = 0, TUInt32 contentsSize = 0 );
+	TUInt32 NewObjectId( void* handle );
+
+	// Forget an object (and any objects it owns)
+	void RemoveObject( void* handle );
+
+
+	IRenderDevice* m_Device;
+
+	// Locked while using the objects, the record or the capture. Queries from other threads add techniques and
+	// variables, calls from the device's own thread only lock when creating or releasing objects or capturing
+	mutex m_Mutex;
+
+	// Live objects by id - ids increase so objects are recreated in the order they were created
+	map<TUInt32, SObject> m_Objects;
+	map<void*, TUInt32>   m_ObjectIds;
+	TUInt32               m_NextId;
+
+	// Record being written, and the capture so far
+	vector<TUInt8> m_Record;
+	vector<TUInt8> m_Capture;
+	TUInt32        m_NumCapturedCalls;
+	TUInt32        m_CaptureSize;
+	FILE*          m_File;
+};
+
+
+//-----------------------------------------------------------------------------
+// Replay
+//-----------------------------------------------------------------------------
+
+class CRenderCaptureReplay
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	CRenderCaptureReplay();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CRenderCaptureReplay( const CRenderCaptureReplay& );
+	CRenderCaptureReplay& operator=( const CRenderCaptureReplay& );
+
+public:
+	/////////////////////////////////////
+	//	Replay
+
+	// Load a capture file. Returns false on failure
+	bool Load( const string& fileName );
+
+	// Create the objects alive at the start of the capture on the given device. Returns false if the capture is
+	// corrupt
+	bool CreateObjects( IRenderDevice* device );
+
+	// Submit the captured frame to the device the objects were created on. Can be repeated. Returns false if the
+	// capture is corrupt
+	bool ReplayFrame();
+
+	// Number of calls in the captured frame (valid after the first replay)
+	TUInt32 GetNumFrameCalls()
+	{
+		return m_NumFrameCalls;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Replay records from the given range of the capture data
+	bool ReplayRecords( TUInt32 start, TUInt32 end, TUInt32* numCalls );
+
+	// Read values from the capture data, returning false if past the end of the range
+	bool Read( TUInt32* value );
+	bool Read( const TUInt8** data, TUInt32 size );
+	bool Read( string* text );
+	template <class T> bool ReadObject( T** object )
+	{
+		TUInt32 id;
+		if (!Read( &id ) || (id != 0 && id >= m_Objects.size())) return false;
+		*object = reinterpret_cast<T*>(m_Objects[id]);
+		return true;
+	}
+
+	// Read the id of an object about to be created, returning false if it is out of range
+	bool ReadNewId( TUInt32* id );
+
+	// Remember the object created for an id
+	void SetObject( TUInt32 id, void* object );
+
+	IRenderDevice* m_Device;
+
+	vector<TUInt8> m_Data;
+	TUInt32        m_SetupStart;
+	TUInt32        m_FrameStart;
+	TUInt32        m_BackBufferId;
+
+	vector<void*> m_Objects; // Indexed by id
+	TUInt32       m_NumFrameCalls;
+
+	// Read position and end of the range being replayed
+	TUInt32 m_Pos;
+	TUInt32 m_End;
+};
+
+
+} // namespace gen
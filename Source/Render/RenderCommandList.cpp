@@ -0,0 +1,338 @@
+/***************************************************************************************
+	RenderCommandList.cpp
+
+	Render device that records calls into a list to be replayed on another device later
+****************************************************************************************/
+
+#include <string.h>
+#include "RenderCommandList.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Recording
+//-----------------------------------------------------------------------------
+
+CRenderCommandList::CRenderCommandList()
+{
+	m_Device = 0;
+}
+
+// Empty the list and start recording calls for the given device
+void CRenderCommandList::Begin( IRenderDevice* device )
+{
+	m_Device = device;
+	m_Commands.clear(); // Capacity is kept, so after the first few frames recording does not allocate
+	m_Data.clear();
+}
+
+// Add a command to the list, returning it for the arguments to be filled in
+CRenderCommandList::SCommand& CRenderCommandList::Record( ERenderDeviceCall call, void* object /*= 0*/, void* object2 /*= 0*/ )
+{
+	m_Commands.resize( m_Commands.size() + 1 );
+	SCommand& command = m_Commands.back();
+	command.call = call;
+	command.object = object;
+	command.object2 = object2;
+	return command;
+}
+
+// Copy data into the data buffer, returning its offset. Kept 4-byte aligned so matrices and colours can be read in place
+TUInt32 CRenderCommandList::RecordData( const void* data, TUInt32 size )
+{
+	TUInt32 offset = static_cast<TUInt32>(m_Data.size());
+	m_Data.resize( offset + ((size + 3) & ~3u) );
+	memcpy( &m_Data[offset], data, size );
+	return offset;
+}
+
+
+//-----------------------------------------------------------------------------
+// Replay
+//-----------------------------------------------------------------------------
+
+// Submit the recorded calls to a device, in the order they were recorded
+void CRenderCommandList::Replay( IRenderDevice* device )
+{
+	for (TUInt32 i = 0; i < m_Commands.size(); ++i)
+	{
+		const SCommand& command = m_Commands[i];
+		const TUInt32* args = command.args;
+		switch (command.call)
+		{
+			case CallUpdateBuffer:
+				device->UpdateBuffer( static_cast<SRenderBuffer*>(command.object), &m_Data[args[0]], args[1] );
+				break;
+			case CallSetVariable:
+				device->SetVariable( static_cast<SRenderVariable*>(command.object), &m_Data[args[0]], args[1] );
+				break;
+			case CallSetMatrixVariable:
+				device->SetMatrixVariable( static_cast<SRenderVariable*>(command.object),
+				                           reinterpret_cast<const TFloat32*>(&m_Data[args[0]]) );
+				break;
+			case CallSetResourceVariable:
+				device->SetResourceVariable( static_cast<SRenderVariable*>(command.object), static_cast<SRenderResource*>(command.object2) );
+				break;
+			case CallApplyPass:
+				device->ApplyPass( static_cast<SRenderTechnique*>(command.object), args[0] );
+				break;
+
+			case CallSetRenderTarget:
+				device->SetRenderTarget( static_cast<SRenderTarget*>(command.object), args[0] != 0 );
+				break;
+			case CallClearRenderTarget:
+				device->ClearRenderTarget( static_cast<SRenderTarget*>(command.object), reinterpret_cast<const TFloat32*>(&m_Data[args[0]]) );
+				break;
+			case CallClearDepthBuffer:
+				device->ClearDepthBuffer();
+				break;
+			case CallSetViewport:
+				device->SetViewport( args[0], args[1] );
+				break;
+
+			case CallSetVertexBuffer:
+				device->SetVertexBuffer( args[0], static_cast<SRenderBuffer*>(command.object), args[1] );
+				break;
+			case CallSetIndexBuffer:
+				device->SetIndexBuffer( static_cast<SRenderBuffer*>(command.object) );
+				break;
+			case CallSetInputLayout:
+				device->SetInputLayout( static_cast<SRenderInputLayout*>(command.object) );
+				break;
+			case CallSetPrimitiveTopology:
+				device->SetPrimitiveTopology( static_cast<EPrimitiveTopology>(args[0]) );
+				break;
+			case CallDraw:
+				device->Draw( args[0], args[1] );
+				break;
+			case CallDrawIndexed:
+				device->DrawIndexed( args[0], args[1], static_cast<TInt32>(args[2]) );
+				break;
+			case CallDrawIndexedInstanced:
+			{
+				// Last two arguments did not fit in the command
+				const TUInt32* extraArgs = reinterpret_cast<const TUInt32*>(&m_Data[args[2]]);
+				device->DrawIndexedInstanced( args[0], args[1], extraArgs[0], static_cast<TInt32>(extraArgs[1]), extraArgs[2] );
+				break;
+			}
+			case CallPresent:
+				device->Present();
+				break;
+
+			default: // Other calls are not recorded
+				break;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Calls passed straight to the device
+//-----------------------------------------------------------------------------
+
+SRenderBuffer* CRenderCommandList::CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size )
+{
+	return m_Device->CreateBuffer( type, data, size );
+}
+
+void CRenderCommandList::ReleaseBuffer( SRenderBuffer* buffer )
+{
+	m_Device->ReleaseBuffer( buffer );
+}
+
+// Reads do not see updates recorded in the list but not yet replayed
+bool CRenderCommandList::ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size )
+{
+	return m_Device->ReadBuffer( buffer, data, size );
+}
+
+SRenderInputLayout* CRenderCommandList::CreateInputLayout( const SVertexElement* elements, TUInt32 numElements,
+                                                           SRenderTechnique* technique )
+{
+	return m_Device->CreateInputLayout( elements, numElements, technique );
+}
+
+void CRenderCommandList::ReleaseInputLayout( SRenderInputLayout* layout )
+{
+	m_Device->ReleaseInputLayout( layout );
+}
+
+SRenderResource* CRenderCommandList::CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps )
+{
+	return m_Device->CreateTexture( width, height, pixels, mipMaps );
+}
+
+SRenderResource* CRenderCommandList::LoadTexture( const string& fileName )
+{
+	return m_Device->LoadTexture( fileName );
+}
+
+void CRenderCommandList::UpdateTexture( SRenderResource* texture, const void* pixels )
+{
+	m_Device->UpdateTexture( texture, pixels );
+}
+
+bool CRenderCommandList::ReadTexture( SRenderResource* texture, void* pixels )
+{
+	return m_Device->ReadTexture( texture, pixels );
+}
+
+bool CRenderCommandList::CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource )
+{
+	return m_Device->CreateRenderTarget( width, height, target, resource );
+}
+
+void CRenderCommandList::ReleaseResource( SRenderResource* resource )
+{
+	m_Device->ReleaseResource( resource );
+}
+
+void CRenderCommandList::ReleaseRenderTarget( SRenderTarget* target )
+{
+	m_Device->ReleaseRenderTarget( target );
+}
+
+SRenderTarget* CRenderCommandList::GetBackBuffer()
+{
+	return m_Device->GetBackBuffer();
+}
+
+SRenderEffect* CRenderCommandList::LoadEffect( const string& fileName )
+{
+	return m_Device->LoadEffect( fileName );
+}
+
+void CRenderCommandList::ReleaseEffect( SRenderEffect* effect )
+{
+	m_Device->ReleaseEffect( effect );
+}
+
+SRenderTechnique* CRenderCommandList::GetTechnique( SRenderEffect* effect, const string& name )
+{
+	return m_Device->GetTechnique( effect, name );
+}
+
+SRenderVariable* CRenderCommandList::GetVariable( SRenderEffect* effect, const string& name )
+{
+	return m_Device->GetVariable( effect, name );
+}
+
+TUInt32 CRenderCommandList::GetNumPasses( SRenderTechnique* technique )
+{
+	return m_Device->GetNumPasses( technique );
+}
+
+
+//-----------------------------------------------------------------------------
+// Recorded calls
+//-----------------------------------------------------------------------------
+
+// Buffer contents are recorded as they must change at the same point in the call order
+void CRenderCommandList::UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size )
+{
+	SCommand& command = Record( CallUpdateBuffer, buffer );
+	command.args[0] = RecordData( data, size );
+	command.args[1] = size;
+}
+
+void CRenderCommandList::SetVariable( SRenderVariable* variable, const void* data, TUInt32 size )
+{
+	SCommand& command = Record( CallSetVariable, variable );
+	command.args[0] = RecordData( data, size );
+	command.args[1] = size;
+}
+
+void CRenderCommandList::SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix )
+{
+	SCommand& command = Record( CallSetMatrixVariable, variable );
+	command.args[0] = RecordData( matrix, 16 * sizeof(TFloat32) );
+}
+
+void CRenderCommandList::SetResourceVariable( SRenderVariable* variable, SRenderResource* resource )
+{
+	Record( CallSetResourceVariable, variable, resource );
+}
+
+void CRenderCommandList::ApplyPass( SRenderTechnique* technique, TUInt32 pass )
+{
+	Record( CallApplyPass, technique ).args[0] = pass;
+}
+
+void CRenderCommandList::SetRenderTarget( SRenderTarget* target, bool depthBuffer )
+{
+	Record( CallSetRenderTarget, target ).args[0] = depthBuffer ? 1 : 0;
+}
+
+void CRenderCommandList::ClearRenderTarget( SRenderTarget* target, const TFloat32* colour )
+{
+	SCommand& command = Record( CallClearRenderTarget, target );
+	command.args[0] = RecordData( colour, 4 * sizeof(TFloat32) );
+}
+
+void CRenderCommandList::ClearDepthBuffer()
+{
+	Record( CallClearDepthBuffer );
+}
+
+void CRenderCommandList::SetViewport( TUInt32 width, TUInt32 height )
+{
+	SCommand& command = Record( CallSetViewport );
+	command.args[0] = width;
+	command.args[1] = height;
+}
+
+void CRenderCommandList::SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize )
+{
+	SCommand& command = Record( CallSetVertexBuffer, buffer );
+	command.args[0] = slot;
+	command.args[1] = vertexSize;
+}
+
+void CRenderCommandList::SetIndexBuffer( SRenderBuffer* buffer )
+{
+	Record( CallSetIndexBuffer, buffer );
+}
+
+void CRenderCommandList::SetInputLayout( SRenderInputLayout* layout )
+{
+	Record( CallSetInputLayout, layout );
+}
+
+void CRenderCommandList::SetPrimitiveTopology( EPrimitiveTopology topology )
+{
+	Record( CallSetPrimitiveTopology ).args[0] = topology;
+}
+
+void CRenderCommandList::Draw( TUInt32 numVertices, TUInt32 startVertex )
+{
+	SCommand& command = Record( CallDraw );
+	command.args[0] = numVertices;
+	command.args[1] = startVertex;
+}
+
+void CRenderCommandList::DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex )
+{
+	SCommand& command = Record( CallDrawIndexed );
+	command.args[0] = numIndices;
+	command.args[1] = startIndex;
+	command.args[2] = static_cast<TUInt32>(baseVertex);
+}
+
+void CRenderCommandList::DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex,
+                                               TInt32 baseVertex, TUInt32 startInstance )
+{
+	TUInt32 extraArgs[3] = { startIndex, static_cast<TUInt32>(baseVertex), startInstance };
+	SCommand& command = Record( CallDrawIndexedInstanced );
+	command.args[0] = numIndices;
+	command.args[1] = numInstances;
+	command.args[2] = RecordData( extraArgs, sizeof(extraArgs) );
+}
+
+void CRenderCommandList::Present()
+{
+	Record( CallPresent );
+}
+
+
+} // namespace gen
@@ -0,0 +1,129 @@
+/***************************************************************************************
+	RenderCommandList.h
+
+	Render device that records calls into a list to be replayed on another device later.
+	Several threads can each record their own list at the same time, the lists are then
+	replayed in a fixed order on the thread that owns the real device, giving the same
+	calls as if everything had been submitted from one thread
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+class CRenderCommandList : public IRenderDevice
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	CRenderCommandList();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CRenderCommandList( const CRenderCommandList& );
+	CRenderCommandList& operator=( const CRenderCommandList& );
+
+public:
+	/////////////////////////////////////
+	//	Recording
+
+	// Empty the list and start recording calls for the given device. Queries (techniques, variables, passes, back
+	// buffer) are answered by the device immediately, so it must allow them from the recording thread. Creation,
+	// loading and release of device objects are also passed straight to the device and are not recorded, they
+	// should only be used when recording on the thread that owns the device
+	void Begin( IRenderDevice* device );
+
+	// Submit the recorded calls to a device, in the order they were recorded. The list is unchanged so can be
+	// replayed again
+	void Replay( IRenderDevice* device );
+
+	// Number of calls recorded and the size of the data recorded with them (variable values, matrices, colours,
+	// buffer contents)
+	TUInt32 GetNumCommands()
+	{
+		return static_cast<TUInt32>(m_Commands.size());
+	}
+	TUInt32 GetDataSize()
+	{
+		return static_cast<TUInt32>(m_Data.size());
+	}
+
+
+	/////////////////////////////////////
+	//	Device interface
+
+	SRenderBuffer* CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size );
+	void ReleaseBuffer( SRenderBuffer* buffer );
+	void UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size );
+	bool ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size );
+	SRenderInputLayout* CreateInputLayout( const SVertexElement* elements, TUInt32 numElements, SRenderTechnique* technique );
+	void ReleaseInputLayout( SRenderInputLayout* layout );
+
+	SRenderResource* CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps );
+	SRenderResource* LoadTexture( const string& fileName );
+	void UpdateTexture( SRenderResource* texture, const void* pixels );
+	bool ReadTexture( SRenderResource* texture, void* pixels );
+	bool CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource );
+	void ReleaseResource( SRenderResource* resource );
+	void ReleaseRenderTarget( SRenderTarget* target );
+	SRenderTarget* GetBackBuffer();
+
+	SRenderEffect* LoadEffect( const string& fileName );
+	void ReleaseEffect( SRenderEffect* effect );
+	SRenderTechnique* GetTechnique( SRenderEffect* effect, const string& name );
+	SRenderVariable* GetVariable( SRenderEffect* effect, const string& name );
+	void SetVariable( SRenderVariable* variable, const void* data, TUInt32 size );
+	void SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix );
+	void SetResourceVariable( SRenderVariable* variable, SRenderResource* resource );
+	TUInt32 GetNumPasses( SRenderTechnique* technique );
+	void ApplyPass( SRenderTechnique* technique, TUInt32 pass );
+
+	void SetRenderTarget( SRenderTarget* target, bool depthBuffer );
+	void ClearRenderTarget( SRenderTarget* target, const TFloat32* colour );
+	void ClearDepthBuffer();
+	void SetViewport( TUInt32 width, TUInt32 height );
+	void SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize );
+	void SetIndexBuffer( SRenderBuffer* buffer );
+	void SetInputLayout( SRenderInputLayout* layout );
+	void SetPrimitiveTopology( EPrimitiveTopology topology );
+	void Draw( TUInt32 numVertices, TUInt32 startVertex );
+	void DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex );
+	void DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+	                           TUInt32 startInstance );
+	void Present();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// A recorded call. Handles are held untyped, any values passed by pointer are copied into the data buffer
+	struct SCommand
+	{
+		ERenderDeviceCall call;
+		void*             object;  // Handle the call acts on (variable, technique, buffer etc.)
+		void*             object2; // Second handle (resource set to a variable)
+		TUInt32           args[3]; // Integer arguments, meaning depends on the call
+	};
+
+	// Add a command to the list, returning it for the arguments to be filled in
+	SCommand& Record( ERenderDeviceCall call, void* object = 0, void* object2 = 0 );
+
+	// Copy data into the data buffer, returning its offset
+	TUInt32 RecordData( const void* data, TUInt32 size );
+
+	IRenderDevice*   m_Device;
+	vector<SCommand> m_Commands;
+	vector<TUInt8>   m_Data;
+};
+
+
+} // namespace gen
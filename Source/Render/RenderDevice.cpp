@@ -0,0 +1,24 @@
+/***************************************************************************************
+	RenderDevice.cpp
+
+	Thin interface over the graphics device - shared definitions
+****************************************************************************************/
+
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+const char* RenderDeviceCallNames[NumRenderDeviceCalls] =
+{
+	"CreateBuffer", "UpdateBuffer", "ReleaseBuffer", "CreateInputLayout", "ReleaseInputLayout",
+	"CreateTexture", "LoadTexture", "UpdateTexture", "CreateRenderTarget", "ReleaseResource", "ReleaseRenderTarget",
+	"LoadEffect", "ReleaseEffect", "GetTechnique", "GetVariable",
+	"SetVariable", "SetMatrixVariable", "SetResourceVariable", "ApplyPass",
+	"SetRenderTarget", "ClearRenderTarget", "ClearDepthBuffer", "SetViewport",
+	"SetVertexBuffer", "SetIndexBuffer", "SetInputLayout", "SetPrimitiveTopology",
+	"Draw", "DrawIndexed", "DrawIndexedInstanced", "Present",
+};
+
+
+} // namespace gen
@@ -0,0 +1,209 @@
+/***************************************************************************************
+	RenderDevice.h
+
+	Thin interface over the graphics device used by the scene and post-processing code:
+	buffers, input layouts, textures / render targets, effects and their variables, and
+	draw calls. The D3D10 backend passes calls straight through to the device, the null
+	backend (RenderDeviceNull.h) does no rendering and only counts calls and bytes, so the
+	CPU cost of submitting a frame can be measured without a GPU.
+
+	Device objects are referred to through opaque handles. Each backend decides what a
+	handle points to (the D3D10 backend uses the D3D10 interface pointers themselves) and
+	a NULL handle is never a valid object
+****************************************************************************************/
+
+#pragma once
+
+#include <string>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Handles and types
+//-----------------------------------------------------------------------------
+
+// Opaque handles to device objects
+struct SRenderBuffer;      // Vertex or index buffer
+struct SRenderInputLayout; // Layout of the vertex data for a technique
+struct SRenderTarget;      // Texture that can be rendered to (or the back buffer)
+struct SRenderResource;    // Texture that can be read by shaders
+struct SRenderEffect;      // Compiled effect file
+struct SRenderTechnique;   // Technique in an effect
+struct SRenderVariable;    // Shader variable in an effect
+
+// Kinds of buffer
+enum ERenderBufferType
+{
+	VertexBuffer,
+	IndexBuffer,    // 16-bit indices
+	InstanceBuffer, // Vertex buffer for per-instance data, rewritten by the CPU (see UpdateBuffer)
+};
+
+// Primitive types
+enum EPrimitiveTopology
+{
+	TriangleList,
+	TriangleStrip,
+};
+
+// Format of a vertex element
+enum EVertexFormat
+{
+	VertexFloat2,
+	VertexFloat3,
+	VertexFloat4,
+	VertexUByte4,     // Four 8-bit unsigned integers (e.g. blend indices)
+	VertexUByte4Norm, // Four 8-bit values mapped to 0->1 (e.g. colours)
+};
+
+// Description of a single element of a vertex (position, normal, UVs etc.)
+struct SVertexElement
+{
+	const char*   semanticName;  // Semantic in HLSL (what is this data for)
+	TUInt32       semanticIndex; // Index to add to semantic, when using multiple of the same type, e.g. TEXCOORD0, TEXCOORD1
+	EVertexFormat format;
+	TUInt32       offset;        // Offset of element from start of vertex data
+	TUInt32       slot;          // Vertex buffer holding the element
+	TUInt32       instanceStep;  // 0 for per-vertex data, otherwise the element is per-instance and steps every this many instances
+};
+
+
+//-----------------------------------------------------------------------------
+// Calls
+//-----------------------------------------------------------------------------
+
+// Device calls, used by backends that record or count calls
+enum ERenderDeviceCall
+{
+	CallCreateBuffer, CallUpdateBuffer, CallReleaseBuffer, CallCreateInputLayout, CallReleaseInputLayout,
+	CallCreateTexture, CallLoadTexture, CallUpdateTexture, CallCreateRenderTarget, CallReleaseResource, CallReleaseRenderTarget,
+	CallLoadEffect, CallReleaseEffect, CallGetTechnique, CallGetVariable,
+	CallSetVariable, CallSetMatrixVariable, CallSetResourceVariable, CallApplyPass,
+	CallSetRenderTarget, CallClearRenderTarget, CallClearDepthBuffer, CallSetViewport,
+	CallSetVertexBuffer, CallSetIndexBuffer, CallSetInputLayout, CallSetPrimitiveTopology,
+	CallDraw, CallDrawIndexed, CallDrawIndexedInstanced, CallPresent,
+	NumRenderDeviceCalls
+};
+extern const char* RenderDeviceCallNames[NumRenderDeviceCalls];
+
+
+//-----------------------------------------------------------------------------
+// Device interface
+//-----------------------------------------------------------------------------
+
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	/////////////////////////////////////
+	// Buffers and input layouts
+
+	// Create a vertex or index buffer filled with the given data. Returns NULL on failure. The data may be NULL for
+	// an instance buffer
+	virtual SRenderBuffer* CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size ) = 0;
+	virtual void ReleaseBuffer( SRenderBuffer* buffer ) = 0;
+
+	// Replace the start of the contents of an instance buffer, the rest of the buffer becomes undefined. Draws
+	// already submitted still use the previous contents
+	virtual void UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size ) = 0;
+
+	// Copy the current contents of a buffer into memory. Waits for the GPU, so only for tools such as frame capture.
+	// Returns false if the contents cannot be read
+	virtual bool ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size ) = 0;
+
+	// Create the layout of vertices with the given elements, for use with the given technique (and any other technique
+	// with the same vertex input). Returns NULL on failure
+	virtual SRenderInputLayout* CreateInputLayout( const SVertexElement* elements, TUInt32 numElements,
+	                                               SRenderTechnique* technique ) = 0;
+	virtual void ReleaseInputLayout( SRenderInputLayout* layout ) = 0;
+
+
+	/////////////////////////////////////
+	// Textures and render targets
+
+	// Create an RGBA (8-bits each) texture filled with the given pixels, optionally with a full chain of mip-maps
+	// generated from them. Returns NULL on failure
+	virtual SRenderResource* CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps ) = 0;
+
+	// Load a texture from file. Returns NULL on failure
+	virtual SRenderResource* LoadTexture( const string& fileName ) = 0;
+
+	// Replace the pixels of a texture created with CreateTexture, regenerating any mip-maps
+	virtual void UpdateTexture( SRenderResource* texture, const void* pixels ) = 0;
+
+	// Copy the current pixels of a texture created with CreateTexture (the top mip-map) into memory. Waits for the
+	// GPU like ReadBuffer. Returns false if the pixels cannot be read
+	virtual bool ReadTexture( SRenderResource* texture, void* pixels ) = 0;
+
+	// Create an RGBA (8-bits each) texture that can be rendered to then used in shaders. Returns false on failure
+	virtual bool CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource ) = 0;
+
+	virtual void ReleaseResource( SRenderResource* resource ) = 0;
+	virtual void ReleaseRenderTarget( SRenderTarget* target ) = 0;
+
+	// The back buffer presented to the display
+	virtual SRenderTarget* GetBackBuffer() = 0;
+
+
+	/////////////////////////////////////
+	// Effects
+
+	// Load and compile an effect file. Displays any compile errors and returns NULL on failure
+	virtual SRenderEffect* LoadEffect( const string& fileName ) = 0;
+	virtual void ReleaseEffect( SRenderEffect* effect ) = 0;
+
+	// Find a technique or variable in an effect by name. Returns NULL if there is no such technique or variable
+	virtual SRenderTechnique* GetTechnique( SRenderEffect* effect, const string& name ) = 0;
+	virtual SRenderVariable* GetVariable( SRenderEffect* effect, const string& name ) = 0;
+
+	// Set the value of a variable. Matrices are passed as 16 floats (row-major, as CMatrix4x4), the effect's layout
+	// of the matrix is dealt with by the backend. Setting a NULL variable does nothing, so variables missing from an
+	// effect can be set without checking
+	virtual void SetVariable( SRenderVariable* variable, const void* data, TUInt32 size ) = 0;
+	virtual void SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix ) = 0;
+	virtual void SetResourceVariable( SRenderVariable* variable, SRenderResource* resource ) = 0;
+	void SetFloatVariable( SRenderVariable* variable, TFloat32 value )
+	{
+		SetVariable( variable, &value, sizeof(value) );
+	}
+
+	// Number of passes in a technique, and apply one of the passes (its shaders, states and current variable values)
+	virtual TUInt32 GetNumPasses( SRenderTechnique* technique ) = 0;
+	virtual void ApplyPass( SRenderTechnique* technique, TUInt32 pass ) = 0;
+
+
+	/////////////////////////////////////
+	// Rendering
+
+	// Select the target to render to, optionally with the depth buffer (only if the target is the back buffer size)
+	virtual void SetRenderTarget( SRenderTarget* target, bool depthBuffer ) = 0;
+	virtual void ClearRenderTarget( SRenderTarget* target, const TFloat32* colour ) = 0;
+	virtual void ClearDepthBuffer() = 0;
+	virtual void SetViewport( TUInt32 width, TUInt32 height ) = 0;
+
+	// Select geometry. A NULL input layout is used when shaders generate their own vertices
+	virtual void SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize ) = 0;
+	virtual void SetIndexBuffer( SRenderBuffer* buffer ) = 0;
+	virtual void SetInputLayout( SRenderInputLayout* layout ) = 0;
+	virtual void SetPrimitiveTopology( EPrimitiveTopology topology ) = 0;
+
+	// Draw with the current geometry, shaders and render target
+	virtual void Draw( TUInt32 numVertices, TUInt32 startVertex ) = 0;
+	virtual void DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex ) = 0;
+
+	// Draw several instances of the current geometry. Per-instance vertex elements (see SVertexElement) start from
+	// the given instance in their buffers
+	virtual void DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+	                                   TUInt32 startInstance ) = 0;
+
+	// Present the back buffer to the display
+	virtual void Present() = 0;
+};
+
+
+} // namespace gen
@@ -0,0 +1,431 @@
+/***************************************************************************************
+	RenderDeviceD3D10.cpp
+
+	Render device passing calls through to a D3D10 device
+****************************************************************************************/
+
+#include "RenderDeviceD3D10.h"
+
+namespace gen
+{
+
+// Convert between handles and the D3D10 interfaces they point to
+template <class T, class H> T* D3D10Object( H* handle )
+{
+	return reinterpret_cast<T*>(handle);
+}
+template <class H, class T> H* D3D10Handle( T* object )
+{
+	return reinterpret_cast<H*>(object);
+}
+
+// D3D10 formats for vertex element formats
+const DXGI_FORMAT VertexFormats[] =
+{
+	DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT,
+	DXGI_FORMAT_R8G8B8A8_UINT, DXGI_FORMAT_R8G8B8A8_UNORM,
+};
+
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+
+CD3D10RenderDevice::CD3D10RenderDevice( ID3D10Device* device, IDXGISwapChain* swapChain, ID3D10RenderTargetView* backBuffer,
+                                        ID3D10DepthStencilView* depthBuffer )
+{
+	m_Device = device;
+	m_SwapChain = swapChain;
+	m_BackBuffer = backBuffer;
+	m_DepthBuffer = depthBuffer;
+}
+
+
+//-----------------------------------------------------------------------------
+// Buffers and input layouts
+//-----------------------------------------------------------------------------
+
+SRenderBuffer* CD3D10RenderDevice::CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size )
+{
+	D3D10_BUFFER_DESC bufferDesc;
+	bufferDesc.BindFlags = (type == IndexBuffer) ? D3D10_BIND_INDEX_BUFFER : D3D10_BIND_VERTEX_BUFFER;
+	bufferDesc.ByteWidth = size;
+	bufferDesc.MiscFlags = 0;
+	if (type == InstanceBuffer)
+	{
+		bufferDesc.Usage = D3D10_USAGE_DYNAMIC; // Rewritten by the CPU
+		bufferDesc.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+	}
+	else
+	{
+		bufferDesc.Usage = D3D10_USAGE_DEFAULT; // Not a dynamic buffer
+		bufferDesc.CPUAccessFlags = 0;   // Indicates that CPU won't access this buffer at all after creation
+	}
+	D3D10_SUBRESOURCE_DATA initData; // Initial data
+	initData.pSysMem = data;
+
+	ID3D10Buffer* buffer;
+	if (FAILED( m_Device->CreateBuffer( &bufferDesc, data ? &initData : NULL, &buffer ) )) return NULL;
+	return D3D10Handle<SRenderBuffer>( buffer );
+}
+
+// Discarding the old contents lets the GPU carry on using them for draws already submitted
+void CD3D10RenderDevice::UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size )
+{
+	void* mapped;
+	if (FAILED( D3D10Object<ID3D10Buffer>( buffer )->Map( D3D10_MAP_WRITE_DISCARD, 0, &mapped ) )) return;
+	memcpy( mapped, data, size );
+	D3D10Object<ID3D10Buffer>( buffer )->Unmap();
+}
+
+// Buffers are not readable by the CPU, so copy to a temporary staging buffer and read that
+bool CD3D10RenderDevice::ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size )
+{
+	D3D10_BUFFER_DESC bufferDesc;
+	D3D10Object<ID3D10Buffer>( buffer )->GetDesc( &bufferDesc );
+	if (size > bufferDesc.ByteWidth) return false;
+	bufferDesc.Usage = D3D10_USAGE_STAGING;
+	bufferDesc.BindFlags = 0;
+	bufferDesc.CPUAccessFlags = D3D10_CPU_ACCESS_READ;
+	bufferDesc.MiscFlags = 0;
+
+	ID3D10Buffer* staging;
+	if (FAILED( m_Device->CreateBuffer( &bufferDesc, NULL, &staging ) )) return false;
+	m_Device->CopyResource( staging, D3D10Object<ID3D10Buffer>( buffer ) );
+	void* mapped;
+	bool success = SUCCEEDED( staging->Map( D3D10_MAP_READ, 0, &mapped ) );
+	if (success)
+	{
+		memcpy( data, mapped, size );
+		staging->Unmap();
+	}
+	staging->Release();
+	return success;
+}
+
+void CD3D10RenderDevice::ReleaseBuffer( SRenderBuffer* buffer )
+{
+	if (buffer) D3D10Object<ID3D10Buffer>( buffer )->Release();
+}
+
+SRenderInputLayout* CD3D10RenderDevice::CreateInputLayout( const SVertexElement* elements, TUInt32 numElements,
+                                                           SRenderTechnique* technique )
+{
+	const TUInt32 MaxElements = 64;
+	if (numElements > MaxElements) return NULL;
+
+	D3D10_INPUT_ELEMENT_DESC elementDescs[MaxElements];
+	for (TUInt32 elt = 0; elt < numElements; ++elt)
+	{
+		elementDescs[elt].SemanticName = elements[elt].semanticName;
+		elementDescs[elt].SemanticIndex = elements[elt].semanticIndex;
+		elementDescs[elt].Format = VertexFormats[elements[elt].format];
+		elementDescs[elt].InputSlot = elements[elt].slot;
+		elementDescs[elt].AlignedByteOffset = elements[elt].offset;
+		elementDescs[elt].InputSlotClass = elements[elt].instanceStep ? D3D10_INPUT_PER_INSTANCE_DATA : D3D10_INPUT_PER_VERTEX_DATA;
+		elementDescs[elt].InstanceDataStepRate = elements[elt].instanceStep;
+	}
+
+	// The layout is checked against the vertex input of the technique's first pass
+	D3D10_PASS_DESC passDesc;
+	D3D10Object<ID3D10EffectTechnique>( technique )->GetPassByIndex( 0 )->GetDesc( &passDesc );
+	ID3D10InputLayout* layout;
+	if (FAILED( m_Device->CreateInputLayout( elementDescs, numElements, passDesc.pIAInputSignature,
+	                                         passDesc.IAInputSignatureSize, &layout ) )) return NULL;
+	return D3D10Handle<SRenderInputLayout>( layout );
+}
+
+void CD3D10RenderDevice::ReleaseInputLayout( SRenderInputLayout* layout )
+{
+	if (layout) D3D10Object<ID3D10InputLayout>( layout )->Release();
+}
+
+
+//-----------------------------------------------------------------------------
+// Textures and render targets
+//-----------------------------------------------------------------------------
+
+SRenderResource* CD3D10RenderDevice::CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps )
+{
+	D3D10_TEXTURE2D_DESC textureDesc;
+	textureDesc.Width  = width;
+	textureDesc.Height = height;
+	textureDesc.MipLevels = mipMaps ? 0 : 1; // Full mip chain, created with GenerateMips
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D10_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D10_BIND_SHADER_RESOURCE | (mipMaps ? D3D10_BIND_RENDER_TARGET : 0); // Render target needed for GenerateMips
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = mipMaps ? D3D10_RESOURCE_MISC_GENERATE_MIPS : 0;
+
+	ID3D10Texture2D* texture;
+	ID3D10ShaderResourceView* view;
+	if (FAILED( m_Device->CreateTexture2D( &textureDesc, NULL, &texture ) )) return NULL;
+	HRESULT hr = m_Device->CreateShaderResourceView( texture, NULL, &view );
+	texture->Release(); // The view keeps the texture alive
+	if (FAILED( hr )) return NULL;
+
+	SRenderResource* resource = D3D10Handle<SRenderResource>( view );
+	UpdateTexture( resource, pixels );
+	return resource;
+}
+
+SRenderResource* CD3D10RenderDevice::LoadTexture( const string& fileName )
+{
+	ID3D10ShaderResourceView* view;
+	if (FAILED( D3DX10CreateShaderResourceViewFromFile( m_Device, fileName.c_str(), NULL, NULL, &view, NULL ) )) return NULL;
+	return D3D10Handle<SRenderResource>( view );
+}
+
+void CD3D10RenderDevice::UpdateTexture( SRenderResource* texture, const void* pixels )
+{
+	ID3D10ShaderResourceView* view = D3D10Object<ID3D10ShaderResourceView>( texture );
+	ID3D10Resource* resource;
+	view->GetResource( &resource );
+	D3D10_TEXTURE2D_DESC textureDesc;
+	static_cast<ID3D10Texture2D*>(resource)->GetDesc( &textureDesc );
+
+	m_Device->UpdateSubresource( resource, 0, NULL, pixels, textureDesc.Width * 4, 0 );
+	if (textureDesc.MiscFlags & D3D10_RESOURCE_MISC_GENERATE_MIPS)
+	{
+		m_Device->GenerateMips( view );
+	}
+	resource->Release();
+}
+
+// Copies the top mip-map to a temporary staging texture and reads that, a row at a time as the mapped rows may be
+// padded
+bool CD3D10RenderDevice::ReadTexture( SRenderResource* texture, void* pixels )
+{
+	ID3D10Resource* resource;
+	D3D10Object<ID3D10ShaderResourceView>( texture )->GetResource( &resource );
+	D3D10_TEXTURE2D_DESC textureDesc;
+	static_cast<ID3D10Texture2D*>(resource)->GetDesc( &textureDesc );
+	textureDesc.MipLevels = 1;
+	textureDesc.Usage = D3D10_USAGE_STAGING;
+	textureDesc.BindFlags = 0;
+	textureDesc.CPUAccessFlags = D3D10_CPU_ACCESS_READ;
+	textureDesc.MiscFlags = 0;
+
+	ID3D10Texture2D* staging;
+	if (FAILED( m_Device->CreateTexture2D( &textureDesc, NULL, &staging ) ))
+	{
+		resource->Release();
+		return false;
+	}
+	m_Device->CopySubresourceRegion( staging, 0, 0, 0, 0, resource, 0, NULL );
+	resource->Release();
+
+	D3D10_MAPPED_TEXTURE2D mapped;
+	bool success = SUCCEEDED( staging->Map( 0, D3D10_MAP_READ, 0, &mapped ) );
+	if (success)
+	{
+		TUInt32 rowSize = textureDesc.Width * 4;
+		for (TUInt32 row = 0; row < textureDesc.Height; ++row)
+		{
+			memcpy( static_cast<TUInt8*>(pixels) + row * rowSize, static_cast<TUInt8*>(mapped.pData) + row * mapped.RowPitch,
+			        rowSize );
+		}
+		staging->Unmap( 0 );
+	}
+	staging->Release();
+	return success;
+}
+
+bool CD3D10RenderDevice::CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource )
+{
+	D3D10_TEXTURE2D_DESC textureDesc;
+	textureDesc.Width  = width;
+	textureDesc.Height = height;
+	textureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we will have to render every level)
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D10_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D10_BIND_RENDER_TARGET | D3D10_BIND_SHADER_RESOURCE; // Use texture as render target, and pass it to shaders
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	// Get a "view" of the texture as a render target, and a shader-resource view to pass the texture to shaders
+	ID3D10Texture2D* texture;
+	ID3D10RenderTargetView* targetView = NULL;
+	ID3D10ShaderResourceView* resourceView = NULL;
+	if (FAILED( m_Device->CreateTexture2D( &textureDesc, NULL, &texture ) )) return false;
+	bool success = SUCCEEDED( m_Device->CreateRenderTargetView( texture, NULL, &targetView ) ) &&
+	               SUCCEEDED( m_Device->CreateShaderResourceView( texture, NULL, &resourceView ) );
+	texture->Release(); // The views keep the texture alive
+	if (!success)
+	{
+		if (targetView) targetView->Release();
+		return false;
+	}
+
+	*target = D3D10Handle<SRenderTarget>( targetView );
+	*resource = D3D10Handle<SRenderResource>( resourceView );
+	return true;
+}
+
+void CD3D10RenderDevice::ReleaseResource( SRenderResource* resource )
+{
+	if (resource) D3D10Object<ID3D10ShaderResourceView>( resource )->Release();
+}
+
+void CD3D10RenderDevice::ReleaseRenderTarget( SRenderTarget* target )
+{
+	if (target) D3D10Object<ID3D10RenderTargetView>( target )->Release();
+}
+
+SRenderTarget* CD3D10RenderDevice::GetBackBuffer()
+{
+	return D3D10Handle<SRenderTarget>( m_BackBuffer );
+}
+
+
+//-----------------------------------------------------------------------------
+// Effects
+//-----------------------------------------------------------------------------
+
+SRenderEffect* CD3D10RenderDevice::LoadEffect( const string& fileName )
+{
+	ID3D10Blob* pErrors; // This strangely typed variable collects any errors when compiling the effect file
+	DWORD dwShaderFlags = D3D10_SHADER_ENABLE_STRICTNESS; // These "flags" are used to set the compiler options
+
+	ID3D10Effect* effect;
+	if( FAILED( D3DX10CreateEffectFromFile( fileName.c_str(), NULL, NULL, "fx_4_0", dwShaderFlags, 0, m_Device, NULL, NULL, &effect, &pErrors, NULL ) ))
+	{
+		if (pErrors != 0)  MessageBox( NULL, reinterpret_cast<char*>(pErrors->GetBufferPointer()), "Error", MB_OK ); // Compiler error: display error message
+		else               MessageBox( NULL, "Error loading FX file. Ensure your FX file is in the same folder as this executable.", "Error", MB_OK );  // No error message - probably file not found
+		return NULL;
+	}
+	return D3D10Handle<SRenderEffect>( effect );
+}
+
+void CD3D10RenderDevice::ReleaseEffect( SRenderEffect* effect )
+{
+	if (effect) D3D10Object<ID3D10Effect>( effect )->Release();
+}
+
+SRenderTechnique* CD3D10RenderDevice::GetTechnique( SRenderEffect* effect, const string& name )
+{
+	ID3D10EffectTechnique* technique = D3D10Object<ID3D10Effect>( effect )->GetTechniqueByName( name.c_str() );
+	return technique->IsValid() ? D3D10Handle<SRenderTechnique>( technique ) : NULL;
+}
+
+SRenderVariable* CD3D10RenderDevice::GetVariable( SRenderEffect* effect, const string& name )
+{
+	ID3D10EffectVariable* variable = D3D10Object<ID3D10Effect>( effect )->GetVariableByName( name.c_str() );
+	return variable->IsValid() ? D3D10Handle<SRenderVariable>( variable ) : NULL;
+}
+
+void CD3D10RenderDevice::SetVariable( SRenderVariable* variable, const void* data, TUInt32 size )
+{
+	if (!variable) return;
+	D3D10Object<ID3D10EffectVariable>( variable )->SetRawValue( const_cast<void*>(data), 0, size );
+}
+
+void CD3D10RenderDevice::SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix )
+{
+	if (!variable) return;
+	D3D10Object<ID3D10EffectVariable>( variable )->AsMatrix()->SetMatrix( const_cast<TFloat32*>(matrix) );
+}
+
+void CD3D10RenderDevice::SetResourceVariable( SRenderVariable* variable, SRenderResource* resource )
+{
+	if (!variable) return;
+	D3D10Object<ID3D10EffectVariable>( variable )->AsShaderResource()->SetResource( D3D10Object<ID3D10ShaderResourceView>( resource ) );
+}
+
+TUInt32 CD3D10RenderDevice::GetNumPasses( SRenderTechnique* technique )
+{
+	D3D10_TECHNIQUE_DESC techDesc;
+	D3D10Object<ID3D10EffectTechnique>( technique )->GetDesc( &techDesc );
+	return techDesc.Passes;
+}
+
+void CD3D10RenderDevice::ApplyPass( SRenderTechnique* technique, TUInt32 pass )
+{
+	D3D10Object<ID3D10EffectTechnique>( technique )->GetPassByIndex( pass )->Apply( 0 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Rendering
+//-----------------------------------------------------------------------------
+
+void CD3D10RenderDevice::SetRenderTarget( SRenderTarget* target, bool depthBuffer )
+{
+	ID3D10RenderTargetView* targetView = D3D10Object<ID3D10RenderTargetView>( target );
+	m_Device->OMSetRenderTargets( 1, &targetView, depthBuffer ? m_DepthBuffer : NULL );
+}
+
+void CD3D10RenderDevice::ClearRenderTarget( SRenderTarget* target, const TFloat32* colour )
+{
+	m_Device->ClearRenderTargetView( D3D10Object<ID3D10RenderTargetView>( target ), colour );
+}
+
+void CD3D10RenderDevice::ClearDepthBuffer()
+{
+	m_Device->ClearDepthStencilView( m_DepthBuffer, D3D10_CLEAR_DEPTH, 1.0f, 0 );
+}
+
+void CD3D10RenderDevice::SetViewport( TUInt32 width, TUInt32 height )
+{
+	D3D10_VIEWPORT vp;
+	vp.Width  = width;
+	vp.Height = height;
+	vp.MinDepth = 0.0f;
+	vp.MaxDepth = 1.0f;
+	vp.TopLeftX = 0;
+	vp.TopLeftY = 0;
+	m_Device->RSSetViewports( 1, &vp );
+}
+
+void CD3D10RenderDevice::SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize )
+{
+	ID3D10Buffer* vertexBuffer = D3D10Object<ID3D10Buffer>( buffer );
+	UINT stride = vertexSize;
+	UINT offset = 0;
+	m_Device->IASetVertexBuffers( slot, 1, &vertexBuffer, &stride, &offset );
+}
+
+void CD3D10RenderDevice::SetIndexBuffer( SRenderBuffer* buffer )
+{
+	m_Device->IASetIndexBuffer( D3D10Object<ID3D10Buffer>( buffer ), DXGI_FORMAT_R16_UINT, 0 );
+}
+
+void CD3D10RenderDevice::SetInputLayout( SRenderInputLayout* layout )
+{
+	m_Device->IASetInputLayout( D3D10Object<ID3D10InputLayout>( layout ) );
+}
+
+void CD3D10RenderDevice::SetPrimitiveTopology( EPrimitiveTopology topology )
+{
+	m_Device->IASetPrimitiveTopology( (topology == TriangleList) ? D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST : D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP );
+}
+
+void CD3D10RenderDevice::Draw( TUInt32 numVertices, TUInt32 startVertex )
+{
+	m_Device->Draw( numVertices, startVertex );
+}
+
+void CD3D10RenderDevice::DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex )
+{
+	m_Device->DrawIndexed( numIndices, startIndex, baseVertex );
+}
+
+void CD3D10RenderDevice::DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex,
+                                               TInt32 baseVertex, TUInt32 startInstance )
+{
+	m_Device->DrawIndexedInstanced( numIndices, numInstances, startIndex, baseVertex, startInstance );
+}
+
+void CD3D10RenderDevice::Present()
+{
+	m_SwapChain->Present( 0, 0 );
+}
+
+
+} // namespace gen
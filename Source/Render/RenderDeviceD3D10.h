@@ -0,0 +1,91 @@
+/***************************************************************************************
+	RenderDeviceD3D10.h
+
+	Render device passing calls through to a D3D10 device. Handles are the D3D10 interface
+	pointers themselves (e.g. an SRenderBuffer* is an ID3D10Buffer*)
+****************************************************************************************/
+
+#pragma once
+
+#include <d3d10.h>
+#include <d3dx10.h>
+
+#include "Defines.h"
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+class CD3D10RenderDevice : public IRenderDevice
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	// Wraps the given device, presenting with the given swap chain. The back buffer and depth buffer views are owned
+	// by the caller
+	CD3D10RenderDevice( ID3D10Device* device, IDXGISwapChain* swapChain, ID3D10RenderTargetView* backBuffer,
+	                    ID3D10DepthStencilView* depthBuffer );
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CD3D10RenderDevice( const CD3D10RenderDevice& );
+	CD3D10RenderDevice& operator=( const CD3D10RenderDevice& );
+
+public:
+	/////////////////////////////////////
+	//	Device interface
+
+	SRenderBuffer* CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size );
+	void ReleaseBuffer( SRenderBuffer* buffer );
+	void UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size );
+	bool ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size );
+	SRenderInputLayout* CreateInputLayout( const SVertexElement* elements, TUInt32 numElements, SRenderTechnique* technique );
+	void ReleaseInputLayout( SRenderInputLayout* layout );
+
+	SRenderResource* CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps );
+	SRenderResource* LoadTexture( const string& fileName );
+	void UpdateTexture( SRenderResource* texture, const void* pixels );
+	bool ReadTexture( SRenderResource* texture, void* pixels );
+	bool CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource );
+	void ReleaseResource( SRenderResource* resource );
+	void ReleaseRenderTarget( SRenderTarget* target );
+	SRenderTarget* GetBackBuffer();
+
+	SRenderEffect* LoadEffect( const string& fileName );
+	void ReleaseEffect( SRenderEffect* effect );
+	SRenderTechnique* GetTechnique( SRenderEffect* effect, const string& name );
+	SRenderVariable* GetVariable( SRenderEffect* effect, const string& name );
+	void SetVariable( SRenderVariable* variable, const void* data, TUInt32 size );
+	void SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix );
+	void SetResourceVariable( SRenderVariable* variable, SRenderResource* resource );
+	TUInt32 GetNumPasses( SRenderTechnique* technique );
+	void ApplyPass( SRenderTechnique* technique, TUInt32 pass );
+
+	void SetRenderTarget( SRenderTarget* target, bool depthBuffer );
+	void ClearRenderTarget( SRenderTarget* target, const TFloat32* colour );
+	void ClearDepthBuffer();
+	void SetViewport( TUInt32 width, TUInt32 height );
+	void SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize );
+	void SetIndexBuffer( SRenderBuffer* buffer );
+	void SetInputLayout( SRenderInputLayout* layout );
+	void SetPrimitiveTopology( EPrimitiveTopology topology );
+	void Draw( TUInt32 numVertices, TUInt32 startVertex );
+	void DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex );
+	void DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+	                           TUInt32 startInstance );
+	void Present();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	ID3D10Device*           m_Device;
+	IDXGISwapChain*         m_SwapChain;
+	ID3D10RenderTargetView* m_BackBuffer;
+	ID3D10DepthStencilView* m_DepthBuffer;
+};
+
+
+} // namespace gen
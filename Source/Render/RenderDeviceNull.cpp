@@ -0,0 +1,267 @@
+/***************************************************************************************
+	RenderDeviceNull.cpp
+
+	Render device that does no rendering, only counts calls and bytes
+****************************************************************************************/
+
+#include "RenderDeviceNull.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+
+CNullRenderDevice::CNullRenderDevice()
+{
+	m_NextHandle = 0;
+	m_BackBuffer = NewHandle<SRenderTarget>();
+	ResetStats();
+}
+
+
+//-----------------------------------------------------------------------------
+// Buffers and input layouts
+//-----------------------------------------------------------------------------
+
+SRenderBuffer* CNullRenderDevice::CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size )
+{
+	++m_NumCalls[CallCreateBuffer];
+	m_NumBytes += size;
+	return NewHandle<SRenderBuffer>();
+}
+
+void CNullRenderDevice::ReleaseBuffer( SRenderBuffer* buffer )
+{
+	++m_NumCalls[CallReleaseBuffer];
+}
+
+void CNullRenderDevice::UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size )
+{
+	++m_NumCalls[CallUpdateBuffer];
+	m_NumBytes += size;
+}
+
+// No contents are kept, so there is nothing to read
+bool CNullRenderDevice::ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size )
+{
+	return false;
+}
+
+SRenderInputLayout* CNullRenderDevice::CreateInputLayout( const SVertexElement* elements, TUInt32 numElements,
+                                                          SRenderTechnique* technique )
+{
+	++m_NumCalls[CallCreateInputLayout];
+	return NewHandle<SRenderInputLayout>();
+}
+
+void CNullRenderDevice::ReleaseInputLayout( SRenderInputLayout* layout )
+{
+	++m_NumCalls[CallReleaseInputLayout];
+}
+
+
+//-----------------------------------------------------------------------------
+// Textures and render targets
+//-----------------------------------------------------------------------------
+
+SRenderResource* CNullRenderDevice::CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps )
+{
+	++m_NumCalls[CallCreateTexture];
+	m_NumBytes += width * height * 4;
+	return NewHandle<SRenderResource>();
+}
+
+SRenderResource* CNullRenderDevice::LoadTexture( const string& fileName )
+{
+	++m_NumCalls[CallLoadTexture];
+	return NewHandle<SRenderResource>();
+}
+
+void CNullRenderDevice::UpdateTexture( SRenderResource* texture, const void* pixels )
+{
+	++m_NumCalls[CallUpdateTexture];
+}
+
+bool CNullRenderDevice::ReadTexture( SRenderResource* texture, void* pixels )
+{
+	return false;
+}
+
+bool CNullRenderDevice::CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource )
+{
+	++m_NumCalls[CallCreateRenderTarget];
+	*target = NewHandle<SRenderTarget>();
+	*resource = NewHandle<SRenderResource>();
+	return true;
+}
+
+void CNullRenderDevice::ReleaseResource( SRenderResource* resource )
+{
+	++m_NumCalls[CallReleaseResource];
+}
+
+void CNullRenderDevice::ReleaseRenderTarget( SRenderTarget* target )
+{
+	++m_NumCalls[CallReleaseRenderTarget];
+}
+
+SRenderTarget* CNullRenderDevice::GetBackBuffer()
+{
+	return m_BackBuffer;
+}
+
+
+//-----------------------------------------------------------------------------
+// Effects
+//-----------------------------------------------------------------------------
+
+SRenderEffect* CNullRenderDevice::LoadEffect( const string& fileName )
+{
+	++m_NumCalls[CallLoadEffect];
+	return NewHandle<SRenderEffect>();
+}
+
+void CNullRenderDevice::ReleaseEffect( SRenderEffect* effect )
+{
+	++m_NumCalls[CallReleaseEffect];
+}
+
+// Every technique and variable exists in the null device
+SRenderTechnique* CNullRenderDevice::GetTechnique( SRenderEffect* effect, const string& name )
+{
+	++m_NumCalls[CallGetTechnique];
+	return NewHandle<SRenderTechnique>();
+}
+
+SRenderVariable* CNullRenderDevice::GetVariable( SRenderEffect* effect, const string& name )
+{
+	++m_NumCalls[CallGetVariable];
+	return NewHandle<SRenderVariable>();
+}
+
+void CNullRenderDevice::SetVariable( SRenderVariable* variable, const void* data, TUInt32 size )
+{
+	++m_NumCalls[CallSetVariable];
+	m_NumBytes += size;
+}
+
+void CNullRenderDevice::SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix )
+{
+	++m_NumCalls[CallSetMatrixVariable];
+	m_NumBytes += 16 * sizeof(TFloat32);
+}
+
+void CNullRenderDevice::SetResourceVariable( SRenderVariable* variable, SRenderResource* resource )
+{
+	++m_NumCalls[CallSetResourceVariable];
+}
+
+// All techniques have a single pass in the null device
+TUInt32 CNullRenderDevice::GetNumPasses( SRenderTechnique* technique )
+{
+	return 1;
+}
+
+void CNullRenderDevice::ApplyPass( SRenderTechnique* technique, TUInt32 pass )
+{
+	++m_NumCalls[CallApplyPass];
+}
+
+
+//-----------------------------------------------------------------------------
+// Rendering
+//-----------------------------------------------------------------------------
+
+void CNullRenderDevice::SetRenderTarget( SRenderTarget* target, bool depthBuffer )
+{
+	++m_NumCalls[CallSetRenderTarget];
+}
+
+void CNullRenderDevice::ClearRenderTarget( SRenderTarget* target, const TFloat32* colour )
+{
+	++m_NumCalls[CallClearRenderTarget];
+}
+
+void CNullRenderDevice::ClearDepthBuffer()
+{
+	++m_NumCalls[CallClearDepthBuffer];
+}
+
+void CNullRenderDevice::SetViewport( TUInt32 width, TUInt32 height )
+{
+	++m_NumCalls[CallSetViewport];
+}
+
+void CNullRenderDevice::SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize )
+{
+	++m_NumCalls[CallSetVertexBuffer];
+}
+
+void CNullRenderDevice::SetIndexBuffer( SRenderBuffer* buffer )
+{
+	++m_NumCalls[CallSetIndexBuffer];
+}
+
+void CNullRenderDevice::SetInputLayout( SRenderInputLayout* layout )
+{
+	++m_NumCalls[CallSetInputLayout];
+}
+
+void CNullRenderDevice::SetPrimitiveTopology( EPrimitiveTopology topology )
+{
+	++m_NumCalls[CallSetPrimitiveTopology];
+}
+
+void CNullRenderDevice::Draw( TUInt32 numVertices, TUInt32 startVertex )
+{
+	++m_NumCalls[CallDraw];
+	m_NumVerticesDrawn += numVertices;
+}
+
+void CNullRenderDevice::DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex )
+{
+	++m_NumCalls[CallDrawIndexed];
+	m_NumVerticesDrawn += numIndices;
+}
+
+void CNullRenderDevice::DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex,
+                                              TInt32 baseVertex, TUInt32 startInstance )
+{
+	++m_NumCalls[CallDrawIndexedInstanced];
+	m_NumVerticesDrawn += static_cast<TUInt64>(numIndices) * numInstances;
+}
+
+void CNullRenderDevice::Present()
+{
+	++m_NumCalls[CallPresent];
+}
+
+
+//-----------------------------------------------------------------------------
+// Statistics
+//-----------------------------------------------------------------------------
+
+TUInt32 CNullRenderDevice::GetTotalCalls()
+{
+	TUInt32 total = 0;
+	for (TUInt32 call = 0; call < NumRenderDeviceCalls; ++call)
+	{
+		total += m_NumCalls[call];
+	}
+	return total;
+}
+
+void CNullRenderDevice::ResetStats()
+{
+	for (TUInt32 call = 0; call < NumRenderDeviceCalls; ++call)
+	{
+		m_NumCalls[call] = 0;
+	}
+	m_NumBytes = 0;
+	m_NumVerticesDrawn = 0;
+}
+
+
+} // namespace gen
@@ -0,0 +1,121 @@
+/***************************************************************************************
+	RenderDeviceNull.h
+
+	Render device that does no rendering. Counts the calls made and the bytes that would be
+	sent to the device, so the CPU cost of submitting a frame can be measured without a GPU.
+	Does not depend on D3D, also builds on GCC / Clang platforms
+****************************************************************************************/
+
+#pragma once
+
+#include "Defines.h"
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+class CNullRenderDevice : public IRenderDevice
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	CNullRenderDevice();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CNullRenderDevice( const CNullRenderDevice& );
+	CNullRenderDevice& operator=( const CNullRenderDevice& );
+
+public:
+	/////////////////////////////////////
+	//	Device interface
+
+	SRenderBuffer* CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size );
+	void ReleaseBuffer( SRenderBuffer* buffer );
+	void UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size );
+	bool ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size );
+	SRenderInputLayout* CreateInputLayout( const SVertexElement* elements, TUInt32 numElements, SRenderTechnique* technique );
+	void ReleaseInputLayout( SRenderInputLayout* layout );
+
+	SRenderResource* CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps );
+	SRenderResource* LoadTexture( const string& fileName );
+	void UpdateTexture( SRenderResource* texture, const void* pixels );
+	bool ReadTexture( SRenderResource* texture, void* pixels );
+	bool CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource );
+	void ReleaseResource( SRenderResource* resource );
+	void ReleaseRenderTarget( SRenderTarget* target );
+	SRenderTarget* GetBackBuffer();
+
+	SRenderEffect* LoadEffect( const string& fileName );
+	void ReleaseEffect( SRenderEffect* effect );
+	SRenderTechnique* GetTechnique( SRenderEffect* effect, const string& name );
+	SRenderVariable* GetVariable( SRenderEffect* effect, const string& name );
+	void SetVariable( SRenderVariable* variable, const void* data, TUInt32 size );
+	void SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix );
+	void SetResourceVariable( SRenderVariable* variable, SRenderResource* resource );
+	TUInt32 GetNumPasses( SRenderTechnique* technique );
+	void ApplyPass( SRenderTechnique* technique, TUInt32 pass );
+
+	void SetRenderTarget( SRenderTarget* target, bool depthBuffer );
+	void ClearRenderTarget( SRenderTarget* target, const TFloat32* colour );
+	void ClearDepthBuffer();
+	void SetViewport( TUInt32 width, TUInt32 height );
+	void SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize );
+	void SetIndexBuffer( SRenderBuffer* buffer );
+	void SetInputLayout( SRenderInputLayout* layout );
+	void SetPrimitiveTopology( EPrimitiveTopology topology );
+	void Draw( TUInt32 numVertices, TUInt32 startVertex );
+	void DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex );
+	void DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+	                           TUInt32 startInstance );
+	void Present();
+
+
+	/////////////////////////////////////
+	//	Statistics
+
+	// Number of calls of the given type since the last reset
+	TUInt32 GetNumCalls( ERenderDeviceCall call )
+	{
+		return m_NumCalls[call];
+	}
+
+	// Total number of calls since the last reset
+	TUInt32 GetTotalCalls();
+
+	// Bytes of data passed to the device (buffer / texture contents and variable values) since the last reset
+	TUInt64 GetNumBytes()
+	{
+		return m_NumBytes;
+	}
+
+	// Vertices processed by draw calls (indices for indexed draws) since the last reset
+	TUInt64 GetNumVerticesDrawn()
+	{
+		return m_NumVerticesDrawn;
+	}
+
+	void ResetStats();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Create a new handle - every object gets a different non-zero value that is never dereferenced
+	template <class T> T* NewHandle()
+	{
+		return reinterpret_cast<T*>(++m_NextHandle);
+	}
+
+	size_t  m_NextHandle;
+	SRenderTarget* m_BackBuffer;
+
+	TUInt32 m_NumCalls[NumRenderDeviceCalls];
+	TUInt64 m_NumBytes;
+	TUInt64 m_NumVerticesDrawn;
+};
+
+
+} // namespace gen
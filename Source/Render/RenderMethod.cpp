@@ -6,7 +6,9 @@
 ****************************************************************************************/
 
 #include "RenderMethod.h"
-#include "MathDX.h"
+#include "RenderDevice.h"
+#include "CVector2.h"
+#include "CRandom.h"
 
 namespace gen
 {
@@ -17,7 +19,7 @@ namespace gen
 
 // Get reference to global variables from another source file
 // Not good practice - these functions should be part of a class with this as a member
-extern ID3D10Device* g_pd3dDevice;
+extern IRenderDevice* RenderDevice;
 
 // Folders used for meshes/textures and effect file
 extern const string MediaFolder;
@@ -32,51 +34,54 @@ float updateTime;
 // Variables to connect C++ code to HLSL shaders
 
 // Effects / techniques
-ID3D10Effect* Effect = NULL;
+SRenderEffect* Effect = NULL;
+
+// World matrices for instanced techniques
+SRenderBuffer* InstanceMatrixBuffer = NULL;
 
 // Additional textures used by post-processes
-extern ID3D10ShaderResourceView* NoiseMap;
+extern SRenderResource* NoiseMap;
 
 // Matrices / camera
-ID3D10EffectMatrixVariable* WorldMatrixVar = NULL;
-ID3D10EffectMatrixVariable* ViewMatrixVar = NULL;
-ID3D10EffectMatrixVariable* ProjMatrixVar = NULL;
-ID3D10EffectMatrixVariable* ViewProjMatrixVar = NULL;
-ID3D10EffectVectorVariable* CameraPosVar = NULL;
+SRenderVariable* WorldMatrixVar = NULL;
+SRenderVariable* ViewMatrixVar = NULL;
+SRenderVariable* ProjMatrixVar = NULL;
+SRenderVariable* ViewProjMatrixVar = NULL;
+SRenderVariable* CameraPosVar = NULL;
 
 // Lighting
-ID3D10EffectVectorVariable* Light1PosVar = NULL;
-ID3D10EffectVectorVariable* Light1ColourVar = NULL;
-ID3D10EffectVectorVariable* Light2PosVar = NULL;
-ID3D10EffectVectorVariable* Light2ColourVar = NULL;
-ID3D10EffectVectorVariable* AmbientColourVar = NULL;
+SRenderVariable* Light1PosVar = NULL;
+SRenderVariable* Light1ColourVar = NULL;
+SRenderVariable* Light2PosVar = NULL;
+SRenderVariable* Light2ColourVar = NULL;
+SRenderVariable* AmbientColourVar = NULL;
 
 // Material colour
-ID3D10EffectVectorVariable* DiffuseColourVar = NULL;
-ID3D10EffectVectorVariable* SpecularColourVar = NULL;
-ID3D10EffectScalarVariable* SpecularPowerVar = NULL;
+SRenderVariable* DiffuseColourVar = NULL;
+SRenderVariable* SpecularColourVar = NULL;
+SRenderVariable* SpecularPowerVar = NULL;
 
 // Textures
-ID3D10EffectShaderResourceVariable* DiffuseMapVar = NULL;
-ID3D10EffectShaderResourceVariable* DiffuseMap2Var = NULL; // Second diffuse map for special techniques
-ID3D10EffectShaderResourceVariable* NormalMapVar = NULL;
+SRenderVariable* DiffuseMapVar = NULL;
+SRenderVariable* DiffuseMap2Var = NULL; // Second diffuse map for special techniques
+SRenderVariable* NormalMapVar = NULL;
 
 // Scene texture used for post-processing materials (passed over from the main post process code via the SetSceneTexture function)
-ID3D10EffectShaderResourceVariable* SceneTexturePolyVar = NULL;
-ID3D10EffectShaderResourceVariable* PolyPostProcessMapVar = NULL; // Single shader variable used for the three maps above (noise, burn, distort). Only one is needed at a time
-ID3D10EffectScalarVariable* ViewportWidthVar = NULL; // Dimensions of the viewport needed to help access the scene texture (see poly post-processing shaders)
-ID3D10EffectScalarVariable* ViewportHeightVar = NULL;
+SRenderVariable* SceneTexturePolyVar = NULL;
+SRenderVariable* PolyPostProcessMapVar = NULL; // Single shader variable used for the three maps above (noise, burn, distort). Only one is needed at a time
+SRenderVariable* ViewportWidthVar = NULL; // Dimensions of the viewport needed to help access the scene texture (see poly post-processing shaders)
+SRenderVariable* ViewportHeightVar = NULL;
 
 // Other
-ID3D10EffectScalarVariable* ParallaxDepthVar = NULL;
+SRenderVariable* ParallaxDepthVar = NULL;
 
 // retro settings
-ID3D10EffectScalarVariable* PolyPixelationVar = NULL;
-ID3D10EffectScalarVariable* PolyColourPalletVar = NULL;
+SRenderVariable* PolyPixelationVar = NULL;
+SRenderVariable* PolyColourPalletVar = NULL;
 
 // noise
-ID3D10EffectVectorVariable* PolyNoiseScaleVar = NULL;
-ID3D10EffectVectorVariable* PolyNoiseOffsetVar = NULL;
+SRenderVariable* PolyNoiseScaleVar = NULL;
+SRenderVariable* PolyNoiseOffsetVar = NULL;
 
 //-----------------------------------------------------------------------------
 // Render Method Specifications
@@ -85,13 +90,13 @@ ID3D10EffectVectorVariable* PolyNoiseOffsetVar = NULL;
 // Prototypes for shader initialisation functions in array below
 // The functions are defined using a function pointer type (PShaderFn in RenderMethod.h)
 // These functions must all have the same style of prototype as shown above
-void RM_TransformColour( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
-void RM_TransformTex( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
-void RM_TransformTexColour( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
-void RM_TransformMaterial( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
-void RM_TransformTexMaterial( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
-void RM_NormalMapping( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
-void RM_ParallaxMapping( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
+void RM_TransformColour( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
+void RM_TransformTex( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
+void RM_TransformTexColour( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
+void RM_TransformMaterial( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
+void RM_TransformTexMaterial( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
+void RM_NormalMapping( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
+void RM_ParallaxMapping( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
 
 
 
@@ -101,20 +106,23 @@ void RM_ParallaxMapping( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, fl
 //
 //**|PPPOLY|*** One new render method at the end for a post-processed material (PPTint), it is handled almost exactly like other materials except with 
 // the Post-Process bool set true, which indicates this material will be rendered in a second pass - see the PostProcessPoly.cpp code
+//
+// Methods with an instanced technique can draw many instances of the same geometry at once (see CRenderQueue::Submit). Methods
+// whose pixel shaders use the world matrix (normal / parallax mapping and the post-processed materials) are not instanced
 SRenderMethod RenderMethods[NumRenderMethods] =
 {
-//	|Technique name|  |Method init fn|         |Num Tex|  |Tangents|  |Post-Process|  |for internal use|   |Method Name|
-	"PlainColour",     RM_TransformColour,      0,         false,      false,          0,                // PlainColour   
-	"TexColour",       RM_TransformTexColour,   1,         false,      false,          0,                // PlainTexture  
-	"PixelLit",        RM_TransformMaterial,    0,         false,      false,          0,                // PixelLit      
-	"PixelLitTex",     RM_TransformTexMaterial, 1,         false,      false,          0,                // PixelLitTex   
-	"NormalMapping",   RM_NormalMapping,        2,         true,       false,          0,                // NormalMap     
-	"ParallaxMapping", RM_ParallaxMapping,      2,         true,       false,          0,                // ParallaxMap   
-	"PPTintPoly",      RM_TransformColour,      0,         false,      true,           0,                // PPTint        
-	"PPCutGlassPoly",  RM_ParallaxMapping,      2,         true,       true,           0,                // CutGlass      
-	"PPRetroPoly",     RM_TransformColour,      0,         false,      true,           0,                // Retro      
-	"PPInvertPoly",    RM_TransformColour,      0,         false,      true,           0,                // Invert colours      
-	"PPGrayNoisePoly", RM_TransformColour,      0,         false,      true,           0,                // Gray noise      
+//	|Technique name|  |Instanced technique name|  |Method init fn|         |Num Tex|  |Tangents|  |Post-Process|  |for internal use|   |Method Name|
+	"PlainColour",     "PlainColourInstanced",     RM_TransformColour,      0,         false,      false,          0, 0,             // PlainColour   
+	"TexColour",       "TexColourInstanced",       RM_TransformTexColour,   1,         false,      false,          0, 0,             // PlainTexture  
+	"PixelLit",        "PixelLitInstanced",        RM_TransformMaterial,    0,         false,      false,          0, 0,             // PixelLit      
+	"PixelLitTex",     "PixelLitTexInstanced",     RM_TransformTexMaterial, 1,         false,      false,          0, 0,             // PixelLitTex   
+	"NormalMapping",   "",                         RM_NormalMapping,        2,         true,       false,          0, 0,             // NormalMap     
+	"ParallaxMapping", "",                         RM_ParallaxMapping,      2,         true,       false,          0, 0,             // ParallaxMap   
+	"PPTintPoly",      "",                         RM_TransformColour,      0,         false,      true,           0, 0,             // PPTint        
+	"PPCutGlassPoly",  "",                         RM_ParallaxMapping,      2,         true,       true,           0, 0,             // CutGlass      
+	"PPRetroPoly",     "",                         RM_TransformColour,      0,         false,      true,           0, 0,             // Retro      
+	"PPInvertPoly",    "",                         RM_TransformColour,      0,         false,      true,           0, 0,             // Invert colours      
+	"PPGrayNoisePoly", "",                         RM_TransformColour,      0,         false,      true,           0, 0,             // Gray noise      
 };
 
 
@@ -205,17 +213,36 @@ bool RenderMethodIsPostProcess( ERenderMethod method )
 }
 
 // Return the .fx file technique used by given render method
-ID3D10EffectTechnique* GetRenderMethodTechnique( ERenderMethod method )
+SRenderTechnique* GetRenderMethodTechnique( ERenderMethod method )
 {
 	return RenderMethods[method].technique;
 }
 
-// Use the given method for rendering
-void SetRenderMethod( ERenderMethod method, D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower,
-                      ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+// Return the .fx file technique used to render many instances with the given render method in one draw. Returns NULL if
+// the method cannot be instanced
+SRenderTechnique* GetRenderMethodInstancedTechnique( ERenderMethod method )
+{
+	return RenderMethods[method].instancedTechnique;
+}
+
+// Return the instance buffer, holding up to MaxRenderInstances world matrices
+SRenderBuffer* GetRenderInstanceBuffer()
+{
+	return InstanceMatrixBuffer;
+}
+
+// Set the textures used by the given method. Textures are shared by all methods so only need setting when they change
+void SetRenderMethodTextures( IRenderDevice* device, ERenderMethod method, SRenderResource* const* textures )
+{
+	if (RenderMethods[method].numTextures > 0) device->SetResourceVariable( DiffuseMapVar, textures[0] );
+	if (RenderMethods[method].numTextures > 1) device->SetResourceVariable( NormalMapVar, textures[1] );
+}
+
+// Set the per-object shader constants for the given method (world matrix and material)
+void SetRenderMethodConstants( IRenderDevice* device, ERenderMethod method, const SColourRGBA* diffuseColour,
+                               const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	// Initialise shader constants and other render settings
-	RenderMethods[method].setupFn( diffuseColour, specularColour, specularPower, textures, worldMatrix );
+	RenderMethods[method].setupFn( device, diffuseColour, specularColour, specularPower, worldMatrix );
 }
 
 
@@ -226,58 +253,61 @@ void SetRenderMethod( ERenderMethod method, D3DXCOLOR* diffuseColour, D3DXCOLOR*
 // Initialise general method data
 bool InitialiseMethods()
 {
-	ID3D10Blob* pErrors; // This strangely typed variable collects any errors when compiling the effect file
-	DWORD dwShaderFlags = D3D10_SHADER_ENABLE_STRICTNESS; // These "flags" are used to set the compiler options
-
 	// Load and compile the effect file
 	string fullFileName = ShaderFolder + "Scene.fx";
-	if( FAILED( D3DX10CreateEffectFromFile( fullFileName.c_str(), NULL, NULL, "fx_4_0", dwShaderFlags, 0, g_pd3dDevice, NULL, NULL, &Effect, &pErrors, NULL ) ))
+	Effect = RenderDevice->LoadEffect( fullFileName );
+	if (!Effect)
 	{
-		if (pErrors != 0)  MessageBox( NULL, reinterpret_cast<char*>(pErrors->GetBufferPointer()), "Error", MB_OK ); // Compiler error: display error message
-		else               MessageBox( NULL, "Error loading FX file. Ensure your FX file is in the same folder as this executable.", "Error", MB_OK );  // No error message - probably file not found
 		return false;
 	}
 
 	// Access matrix / camera shader variables
-	WorldMatrixVar    = Effect->GetVariableByName( "WorldMatrix"    )->AsMatrix();
-	ViewMatrixVar     = Effect->GetVariableByName( "ViewMatrix"     )->AsMatrix();
-	ProjMatrixVar     = Effect->GetVariableByName( "ProjMatrix"     )->AsMatrix();
-	ViewProjMatrixVar = Effect->GetVariableByName( "ViewProjMatrix" )->AsMatrix();
-	CameraPosVar      = Effect->GetVariableByName( "CameraPos"     )->AsVector();
+	WorldMatrixVar    = RenderDevice->GetVariable( Effect, "WorldMatrix" );
+	ViewMatrixVar     = RenderDevice->GetVariable( Effect, "ViewMatrix" );
+	ProjMatrixVar     = RenderDevice->GetVariable( Effect, "ProjMatrix" );
+	ViewProjMatrixVar = RenderDevice->GetVariable( Effect, "ViewProjMatrix" );
+	CameraPosVar      = RenderDevice->GetVariable( Effect, "CameraPos" );
 
 	// Access lighting shader variables
-	Light1PosVar     = Effect->GetVariableByName( "Light1Pos"     )->AsVector();
-	Light1ColourVar  = Effect->GetVariableByName( "Light1Colour"  )->AsVector();
-	Light2PosVar     = Effect->GetVariableByName( "Light2Pos"     )->AsVector();
-	Light2ColourVar  = Effect->GetVariableByName( "Light2Colour"  )->AsVector();
-	AmbientColourVar = Effect->GetVariableByName( "AmbientColour" )->AsVector();
+	Light1PosVar     = RenderDevice->GetVariable( Effect, "Light1Pos" );
+	Light1ColourVar  = RenderDevice->GetVariable( Effect, "Light1Colour" );
+	Light2PosVar     = RenderDevice->GetVariable( Effect, "Light2Pos" );
+	Light2ColourVar  = RenderDevice->GetVariable( Effect, "Light2Colour" );
+	AmbientColourVar = RenderDevice->GetVariable( Effect, "AmbientColour" );
 
 	// Access material colour shader variables
-	DiffuseColourVar  = Effect->GetVariableByName( "DiffuseColour" )->AsVector();
-	SpecularColourVar = Effect->GetVariableByName( "SpecularColour" )->AsVector();
-	SpecularPowerVar  = Effect->GetVariableByName( "SpecularPower" )->AsScalar();
+	DiffuseColourVar  = RenderDevice->GetVariable( Effect, "DiffuseColour" );
+	SpecularColourVar = RenderDevice->GetVariable( Effect, "SpecularColour" );
+	SpecularPowerVar  = RenderDevice->GetVariable( Effect, "SpecularPower" );
 
 	// Access texture shader variables (not referred to as textures - any GPU memory accessed in a shader is a "Shader Resource")
-	DiffuseMapVar       = Effect->GetVariableByName( "DiffuseMap" )->AsShaderResource();
-	DiffuseMap2Var      = Effect->GetVariableByName( "DiffuseMap2" )->AsShaderResource();
-	NormalMapVar        = Effect->GetVariableByName( "NormalMap"  )->AsShaderResource();
+	DiffuseMapVar       = RenderDevice->GetVariable( Effect, "DiffuseMap" );
+	DiffuseMap2Var      = RenderDevice->GetVariable( Effect, "DiffuseMap2" );
+	NormalMapVar        = RenderDevice->GetVariable( Effect, "NormalMap" );
 
 	// Polygon post-processing variables
-	SceneTexturePolyVar   = Effect->GetVariableByName( "SceneTexture" )->AsShaderResource();
-	PolyPostProcessMapVar = Effect->GetVariableByName( "PostProcessMap" )->AsShaderResource();
-	ViewportWidthVar      = Effect->GetVariableByName( "ViewportWidth" )->AsScalar();
-	ViewportHeightVar     = Effect->GetVariableByName( "ViewportHeight" )->AsScalar();
+	SceneTexturePolyVar   = RenderDevice->GetVariable( Effect, "SceneTexture" );
+	PolyPostProcessMapVar = RenderDevice->GetVariable( Effect, "PostProcessMap" );
+	ViewportWidthVar      = RenderDevice->GetVariable( Effect, "ViewportWidth" );
+	ViewportHeightVar     = RenderDevice->GetVariable( Effect, "ViewportHeight" );
 
 	// Access to other shader variables
-	ParallaxDepthVar = Effect->GetVariableByName( "ParallaxDepth" )->AsScalar();
+	ParallaxDepthVar = RenderDevice->GetVariable( Effect, "ParallaxDepth" );
 
 	// Retro variables
-	PolyPixelationVar   = Effect->GetVariableByName("Pixelation")->AsScalar();
-	PolyColourPalletVar = Effect->GetVariableByName("ColourPallet")->AsScalar();
+	PolyPixelationVar   = RenderDevice->GetVariable( Effect, "Pixelation" );
+	PolyColourPalletVar = RenderDevice->GetVariable( Effect, "ColourPallet" );
 
 	// noise
-	PolyNoiseScaleVar  = Effect->GetVariableByName("NoiseScale")->AsVector();
-	PolyNoiseOffsetVar = Effect->GetVariableByName("NoiseOffset")->AsVector();
+	PolyNoiseScaleVar  = RenderDevice->GetVariable( Effect, "NoiseScale" );
+	PolyNoiseOffsetVar = RenderDevice->GetVariable( Effect, "NoiseOffset" );
+
+	// Instance buffer, contents are written each frame
+	InstanceMatrixBuffer = RenderDevice->CreateBuffer( InstanceBuffer, NULL, MaxRenderInstances * sizeof(CMatrix4x4) );
+	if (!InstanceMatrixBuffer)
+	{
+		return false;
+	}
 
 	return true;
 }
@@ -288,14 +318,24 @@ bool PrepareMethod( ERenderMethod method )
 	// Initialise the technique for this method if it hasn't been already
 	if (!RenderMethods[method].technique)
 	{
-		RenderMethods[method].technique = Effect->GetTechniqueByName( RenderMethods[method].techniqueName.c_str() );
-		if (!RenderMethods[method].technique->IsValid())
+		RenderMethods[method].technique = RenderDevice->GetTechnique( Effect, RenderMethods[method].techniqueName );
+		if (!RenderMethods[method].technique)
 		{
 			string errorMsg = "Error selecting technique " + RenderMethods[method].techniqueName;
 			SystemMessageBox( errorMsg.c_str(), "Shader Error" );
 			return false;
 		}
 	}
+	if (!RenderMethods[method].instancedTechnique && !RenderMethods[method].instancedTechniqueName.empty())
+	{
+		RenderMethods[method].instancedTechnique = RenderDevice->GetTechnique( Effect, RenderMethods[method].instancedTechniqueName );
+		if (!RenderMethods[method].instancedTechnique)
+		{
+			string errorMsg = "Error selecting technique " + RenderMethods[method].instancedTechniqueName;
+			SystemMessageBox( errorMsg.c_str(), "Shader Error" );
+			return false;
+		}
+	}
 
 	return true;
 }
@@ -303,7 +343,9 @@ bool PrepareMethod( ERenderMethod method )
 // Releases the DirectX data associated with all render methods
 void ReleaseMethods()
 {
-	if (Effect) Effect->Release();
+	if (InstanceMatrixBuffer) RenderDevice->ReleaseBuffer( InstanceMatrixBuffer );
+	InstanceMatrixBuffer = NULL;
+	RenderDevice->ReleaseEffect( Effect );
 }
 
 
@@ -314,17 +356,16 @@ void ReleaseMethods()
 // Set the ambient light colour used for all methods
 void SetAmbientLight( const SColourRGBA& ambientColour )
 {
-	SColourRGBA ambient = ambientColour; // Can't pass constant parameter to SetRawValue function
-	AmbientColourVar->SetRawValue( &ambient, 0, 12 );
+	RenderDevice->SetVariable( AmbientColourVar, &ambientColour, 12 );
 }
 
 // Set the light list to use for all methods
 void SetLights( CLight** lights )
 {
-	Light1PosVar->   SetRawValue( &lights[0]->GetPosition(), 0, 12 );  // Send 3 floats (12 bytes) from C++ light position variable (x,y,z) to shader counterpart (middle parameter is unused) 
-	Light2PosVar->   SetRawValue( &lights[1]->GetPosition(), 0, 12 );
-	Light1ColourVar->SetRawValue( &lights[0]->GetColour(), 0, 12 );
-	Light2ColourVar->SetRawValue( &lights[1]->GetColour(), 0, 12 );
+	RenderDevice->SetVariable( Light1PosVar,    &lights[0]->GetPosition(), 12 );  // Send 3 floats (12 bytes) from C++ light position variable (x,y,z) to shader counterpart
+	RenderDevice->SetVariable( Light2PosVar,    &lights[1]->GetPosition(), 12 );
+	RenderDevice->SetVariable( Light1ColourVar, &lights[0]->GetColour(), 12 );
+	RenderDevice->SetVariable( Light2ColourVar, &lights[1]->GetColour(), 12 );
 }
 
 // Set the camera to use for all methods
@@ -332,35 +373,37 @@ void SetCamera( CCamera* camera )
 {
 	CMatrix4x4 viewMatrix = camera->GetViewMatrix();
 	CMatrix4x4 projMatrix = camera->GetProjMatrix();
-	ViewMatrixVar->SetMatrix( &viewMatrix.e00 );
-	ProjMatrixVar->SetMatrix( &projMatrix.e00 );
-	CameraPosVar->SetRawValue( &camera->Position(), 0, 12 );
+	RenderDevice->SetMatrixVariable( ViewMatrixVar, &viewMatrix.e00 );
+	RenderDevice->SetMatrixVariable( ProjMatrixVar, &projMatrix.e00 );
+	RenderDevice->SetVariable( CameraPosVar, &camera->Position(), 12 );
 }
 
 // Set the scene texture / viewport dimensions used for post-processing material shaders - called from post-processing code
-void SetSceneTexture( ID3D10ShaderResourceView* sceneShaderResource, int ViewportWidth, int ViewportHeight )
+void SetSceneTexture( SRenderResource* sceneShaderResource, int ViewportWidth, int ViewportHeight )
 {
-	SceneTexturePolyVar->SetResource( sceneShaderResource );
-	ViewportWidthVar->SetFloat( static_cast<float>(ViewportWidth) );
-	ViewportHeightVar->SetFloat( static_cast<float>(ViewportHeight) );
+	RenderDevice->SetResourceVariable( SceneTexturePolyVar, sceneShaderResource );
+	RenderDevice->SetFloatVariable( ViewportWidthVar, static_cast<float>(ViewportWidth) );
+	RenderDevice->SetFloatVariable( ViewportHeightVar, static_cast<float>(ViewportHeight) );
 
 	// Set noise texture
-	PolyPostProcessMapVar->SetResource(NoiseMap);
+	RenderDevice->SetResourceVariable( PolyPostProcessMapVar, NoiseMap );
 
 	// update
-	PolyPixelationVar->SetFloat(128.0f);
-	PolyColourPalletVar->SetFloat(4.0f);
+	RenderDevice->SetFloatVariable( PolyPixelationVar, 128.0f );
+	RenderDevice->SetFloatVariable( PolyColourPalletVar, 4.0f );
 
 	const float GrainSize = 140; // Fineness of the noise grain
 	CVector2 NoiseScale = CVector2(ViewportWidth / GrainSize, ViewportHeight / GrainSize);
-	PolyNoiseScaleVar->SetRawValue(&NoiseScale, 0, 8);
+	RenderDevice->SetVariable( PolyNoiseScaleVar, &NoiseScale, 8 );
 
 	// The offset is randomised to give a constantly changing noise effect (like tv static)
-	CVector2 RandomUVs = CVector2(Random(-1, 1), Random(-1, 1)) * updateTime;/*FILTER - 2 random UVs please*/
-	PolyNoiseOffsetVar->SetRawValue(&RandomUVs, 0, 8);
+	CVector2 RandomUVs;
+	ThreadRandom().FillFloats(&RandomUVs.x, 2, -1.0f, 1.0f);
+	RandomUVs *= updateTime;
+	RenderDevice->SetVariable( PolyNoiseOffsetVar, &RandomUVs, 8 );
 
 	// Set noise texture
-	PolyPostProcessMapVar->SetResource(NoiseMap);
+	RenderDevice->SetResourceVariable( PolyPostProcessMapVar, NoiseMap );
 }
 
 
@@ -369,67 +412,60 @@ void SetSceneTexture( ID3D10ShaderResourceView* sceneShaderResource, int Viewpor
 //-----------------------------------------------------------------------------
 
 // Pass world matrix and diffuse colour to shaders
-void RM_TransformColour( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+void RM_TransformColour( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-	DiffuseColourVar->SetRawValue( *diffuseColour, 0, 12 );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
+	device->SetVariable( DiffuseColourVar, diffuseColour, 12 );
 }
 
-// Pass world matrix and diffuse texture map to shaders
-void RM_TransformTex( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+// Pass world matrix to shaders (diffuse texture map is set by SetRenderMethodTextures)
+void RM_TransformTex( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-    DiffuseMapVar->SetResource( textures[0] );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
 }
 
-// Pass world matrix, diffuse texture map and diffuse colour to shaders
-void RM_TransformTexColour( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+// Pass world matrix and diffuse colour to shaders, with diffuse texture map
+void RM_TransformTexColour( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-	DiffuseColourVar->SetRawValue( *diffuseColour, 0, 12 );
-    DiffuseMapVar->SetResource( textures[0] );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
+	device->SetVariable( DiffuseColourVar, diffuseColour, 12 );
 }
 
 // Pass world matrix and full material colours to shaders
-void RM_TransformMaterial( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+void RM_TransformMaterial( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-	DiffuseColourVar->SetRawValue( *diffuseColour, 0, 12 );
-	SpecularColourVar->SetRawValue( *specularColour, 0, 12 );
-	SpecularPowerVar->SetFloat( specularPower );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
+	device->SetVariable( DiffuseColourVar, diffuseColour, 12 );
+	device->SetVariable( SpecularColourVar, specularColour, 12 );
+	device->SetFloatVariable( SpecularPowerVar, specularPower );
 }
 
-// Pass world matrix, diffuse texture map and full material colours to shaders
-void RM_TransformTexMaterial( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+// Pass world matrix and full material colours to shaders, with diffuse texture map
+void RM_TransformTexMaterial( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-	DiffuseColourVar->SetRawValue( *diffuseColour, 0, 12 );
-	SpecularColourVar->SetRawValue( *specularColour, 0, 12 );
-	SpecularPowerVar->SetFloat( specularPower );
-    DiffuseMapVar->SetResource( textures[0] );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
+	device->SetVariable( DiffuseColourVar, diffuseColour, 12 );
+	device->SetVariable( SpecularColourVar, specularColour, 12 );
+	device->SetFloatVariable( SpecularPowerVar, specularPower );
 }
 
-// Pass world matrix, diffuse and normal map and full material colours to shaders
-void RM_NormalMapping( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+// Pass world matrix and full material colours to shaders, with diffuse and normal map
+void RM_NormalMapping( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-	DiffuseColourVar->SetRawValue( *diffuseColour, 0, 12 );
-	SpecularColourVar->SetRawValue( *specularColour, 0, 12 );
-	SpecularPowerVar->SetFloat( specularPower );
-    DiffuseMapVar->SetResource( textures[0] );
-    NormalMapVar->SetResource( textures[1] );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
+	device->SetVariable( DiffuseColourVar, diffuseColour, 12 );
+	device->SetVariable( SpecularColourVar, specularColour, 12 );
+	device->SetFloatVariable( SpecularPowerVar, specularPower );
 }
 
-// Pass world matrix, diffuse and normal map and full material colours to shaders, also set parallax depth
-void RM_ParallaxMapping( D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix )
+// Pass world matrix and full material colours to shaders, with diffuse and normal map, also set parallax depth
+void RM_ParallaxMapping( IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix )
 {
-	WorldMatrixVar->SetMatrix( &worldMatrix->e00 );
-	DiffuseColourVar->SetRawValue( *diffuseColour, 0, 12 );
-	SpecularColourVar->SetRawValue( *specularColour, 0, 12 );
-	SpecularPowerVar->SetFloat( specularPower );
-    DiffuseMapVar->SetResource( textures[0] );
-    NormalMapVar->SetResource( textures[1] );
-	ParallaxDepthVar->SetFloat( 0.1f );
+	device->SetMatrixVariable( WorldMatrixVar, &worldMatrix->e00 );
+	device->SetVariable( DiffuseColourVar, diffuseColour, 12 );
+	device->SetVariable( SpecularColourVar, specularColour, 12 );
+	device->SetFloatVariable( SpecularPowerVar, specularPower );
+	device->SetFloatVariable( ParallaxDepthVar, 0.1f );
 }
 
 void UpdateTimeVar(float fr) { updateTime = fr; }
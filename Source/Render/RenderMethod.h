@@ -10,10 +10,9 @@
 #include <string>
 using namespace std;
 
-#include <d3d10.h>
-#include <d3dx10.h>
-
 #include "Defines.h"
+#include "Colour.h"
+#include "RenderDevice.h"
 #include "CMatrix4x4.h"
 #include "Camera.h"
 #include "Light.h"
@@ -44,8 +43,9 @@ enum ERenderMethod
 };
 
 
-// Pointer to a function to initialise a render method - typically sets shader constants
-typedef void (*PRenderMethodFn)(D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower, ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix);
+// Pointer to a function to initialise a render method - sets the per-object shader constants (textures are set
+// separately, see SetRenderMethodTextures)
+typedef void (*PRenderMethodFn)(IRenderDevice* device, const SColourRGBA* diffuseColour, const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix);
 
 // Structure defining a rendering method - defines vertex and pixel shader source files,
 // initialisation functions, number of textures used and the structure of the vertex elements
@@ -53,6 +53,7 @@ typedef void (*PRenderMethodFn)(D3DXCOLOR* diffuseColour, D3DXCOLOR* specularCol
 struct SRenderMethod
 {
 	string                 techniqueName; // Name of technique in fx file for this render method
+	string                 instancedTechniqueName; // Name of technique taking world matrices per-instance, empty if the method cannot be instanced
 	PRenderMethodFn        setupFn;       // Function pointer to custom setup for render method (e.g. to set shader constants)
 	
 	unsigned int           numTextures;   // How many textures used by the methods (diffuse map, normal map etc.)
@@ -60,10 +61,15 @@ struct SRenderMethod
 
 	bool                   isPostProcess; //**** Whether this render method is a post-process or not. Post process methods are rendered in a second pass (see main code)
 
-	ID3D10EffectTechnique* technique;     // Pointer to actual technique
+	SRenderTechnique*      technique;     // Pointer to actual technique
+	SRenderTechnique*      instancedTechnique; // Pointer to instanced technique, NULL if none
 };
 
 
+// Maximum number of instances (world matrices) in the instance buffer each frame
+const TUInt32 MaxRenderInstances = 4096;
+
+
 
 //-----------------------------------------------------------------------------
 // Render method usage / information
@@ -91,11 +97,23 @@ bool RenderMethodUsesTangents( ERenderMethod method );
 bool RenderMethodIsPostProcess( ERenderMethod method );
 
 // Return the .fx file technique used by given render method
-ID3D10EffectTechnique* GetRenderMethodTechnique( ERenderMethod method );
+SRenderTechnique* GetRenderMethodTechnique( ERenderMethod method );
+
+// Return the .fx file technique used to render many instances with the given render method in one draw, with the world
+// matrices in the instance buffer. Returns NULL if the method cannot be instanced
+SRenderTechnique* GetRenderMethodInstancedTechnique( ERenderMethod method );
+
+// Return the instance buffer, holding up to MaxRenderInstances world matrices. Vertex data for slot 1 of instanced
+// techniques, filled each frame before rendering
+SRenderBuffer* GetRenderInstanceBuffer();
+
+// Set the textures used by the given method. Textures are shared by all methods so only need setting when they change
+void SetRenderMethodTextures( IRenderDevice* device, ERenderMethod method, SRenderResource* const* textures );
 
-// Use the given method for rendering
-void SetRenderMethod( ERenderMethod method, D3DXCOLOR* diffuseColour, D3DXCOLOR* specularColour, float specularPower,
-                      ID3D10ShaderResourceView** textures, CMatrix4x4* worldMatrix );
+// Set the per-object shader constants for the given method (world matrix and material). Rendering calls go to the
+// given device (which may be recording them for later, so must be the same device the geometry is drawn with)
+void SetRenderMethodConstants( IRenderDevice* device, ERenderMethod method, const SColourRGBA* diffuseColour,
+                               const SColourRGBA* specularColour, float specularPower, CMatrix4x4* worldMatrix );
 
 
 //-----------------------------------------------------------------------------
@@ -126,7 +144,7 @@ void SetLights( CLight** lights );
 void SetCamera( CCamera* camera );
 
 // Set the scene texture / viewport dimensions used for post-processing material shaders - called from post-processing code
-void SetSceneTexture( ID3D10ShaderResourceView* sceneShaderResource, int ViewportWidth, int ViewportHeight );
+void SetSceneTexture( SRenderResource* sceneShaderResource, int ViewportWidth, int ViewportHeight );
 
 void UpdateTimeVar(float fr);
 } // namespace gen
\ No newline at end of file
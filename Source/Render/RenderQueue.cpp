@@ -0,0 +1,301 @@
+/***************************************************************************************
+	RenderQueue.cpp
+
+	Render queue with radix sorted 64-bit keys
+****************************************************************************************/
+
+#include <map>
+#include <string.h>
+using namespace std;
+
+#include "RenderQueue.h"
+#include "RenderMethod.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Sort key layout
+//-----------------------------------------------------------------------------
+
+const TUInt32 KeyPassShift       = 62;
+const TUInt32 KeyMethodShift     = 56;
+const TUInt32 KeyTextureSetShift = 44;
+const TUInt32 KeyMaterialShift   = 34;
+const TUInt32 KeyGeometryShift   = 22;
+const TUInt32 KeyLodShift        = 20;
+const TUInt32 KeyDepthShift      = 4;
+
+const TUInt32 KeyMethodMask     = 0x3f;
+const TUInt32 KeyTextureSetMask = 0xfff;
+const TUInt32 KeyMaterialMask   = 0x3ff;
+const TUInt32 KeyGeometryMask   = 0xfff;
+const TUInt32 KeyLodMask        = 0x3;
+const TUInt32 KeyDepthMax       = 0xffff;
+
+
+//-----------------------------------------------------------------------------
+// Sort key ids
+//-----------------------------------------------------------------------------
+
+// Texture sets seen so far
+map<vector<SRenderResource*>, TUInt32> TextureSetIds;
+
+TUInt32 NextMaterialId = 0;
+TUInt32 NextGeometryId = 0;
+
+// Return the id for a set of textures, the same set always gets the same id
+TUInt32 GetRenderTextureSetId( SRenderResource** textures, TUInt32 numTextures )
+{
+	vector<SRenderResource*> textureSet( textures, textures + numTextures );
+	map<vector<SRenderResource*>, TUInt32>::iterator id = TextureSetIds.find( textureSet );
+	if (id != TextureSetIds.end()) return id->second;
+
+	TUInt32 newId = static_cast<TUInt32>(TextureSetIds.size()) & KeyTextureSetMask;
+	TextureSetIds[textureSet] = newId;
+	return newId;
+}
+
+// Return a new id for a material or sub-mesh geometry (vertex layout and buffers)
+TUInt32 NewRenderMaterialId()
+{
+	return NextMaterialId++ & KeyMaterialMask;
+}
+
+TUInt32 NewRenderGeometryId()
+{
+	return NextGeometryId++ & KeyGeometryMask;
+}
+
+
+//-----------------------------------------------------------------------------
+// Building the queue
+//-----------------------------------------------------------------------------
+
+CRenderQueue::CRenderQueue()
+{
+	m_CameraPos = CVector3::kOrigin;
+	m_CameraDir = CVector3( 0.0f, 0.0f, 1.0f );
+	m_DepthScale = 0.0f;
+	m_NumPostProcessItems = 0;
+	m_NumInstances = 0;
+}
+
+// Empty the queue ready for a new frame viewed from the given camera (used for depth sorting)
+void CRenderQueue::Clear( CCamera* camera )
+{
+	m_Items.clear();
+	m_Entries.clear();
+	m_NumPostProcessItems = 0;
+	m_NumInstances = 0;
+
+	m_CameraPos = camera->Position();
+	m_CameraDir = Normalise( camera->Matrix().ZAxis() );
+	m_DepthScale = 1.0f / camera->GetFarClip();
+}
+
+// Add a sub-mesh to the queue, for the normal or post-processed pass
+void CRenderQueue::Add( const SRenderItem& item, bool postProcess )
+{
+	// Depth of the sub-mesh origin, more precision is given to nearby depths. Opaque geometry is sorted front-to-back,
+	// post-processed materials (which read the scene behind them) back-to-front
+	TFloat32 depth = Dot( item.worldMatrix->Position() - m_CameraPos, m_CameraDir ) * m_DepthScale;
+	TUInt32 depthKey = (depth <= 0.0f) ? 0 : (depth >= 1.0f) ? KeyDepthMax :
+	                   static_cast<TUInt32>(Sqrt( depth ) * KeyDepthMax);
+	if (postProcess) depthKey = KeyDepthMax - depthKey;
+
+	SSortEntry entry;
+	entry.key = (static_cast<TUInt64>(postProcess ? 1 : 0) << KeyPassShift) |
+	            (static_cast<TUInt64>(item.material->renderMethod & KeyMethodMask) << KeyMethodShift) |
+	            (static_cast<TUInt64>(item.material->textureSetId) << KeyTextureSetShift) |
+	            (static_cast<TUInt64>(item.material->materialId) << KeyMaterialShift) |
+	            (static_cast<TUInt64>(item.subMesh->geometryId) << KeyGeometryShift) |
+	            (static_cast<TUInt64>(item.lod & KeyLodMask) << KeyLodShift) |
+	            (static_cast<TUInt64>(depthKey) << KeyDepthShift);
+	entry.item = static_cast<TUInt32>(m_Items.size());
+
+	m_Items.push_back( item );
+	m_Entries.push_back( entry );
+	if (postProcess) ++m_NumPostProcessItems;
+}
+
+// Add all the items from another queue, after those already added (the other queue must use the same camera)
+void CRenderQueue::Append( const CRenderQueue& queue )
+{
+	TUInt32 offset = static_cast<TUInt32>(m_Items.size());
+	m_Items.insert( m_Items.end(), queue.m_Items.begin(), queue.m_Items.end() );
+	for (TUInt32 i = 0; i < queue.m_Entries.size(); ++i)
+	{
+		SSortEntry entry = queue.m_Entries[i];
+		entry.item += offset;
+		m_Entries.push_back( entry );
+	}
+	m_NumPostProcessItems += queue.m_NumPostProcessItems;
+}
+
+// Sort the items into key order with a least significant digit radix sort, 8 bits at a time. Digits that are the
+// same in every key (e.g. the unused bits) are skipped. The sort is stable, items with equal keys stay in the order
+// they were added
+void CRenderQueue::Sort()
+{
+	TUInt32 numEntries = static_cast<TUInt32>(m_Entries.size());
+	if (numEntries < 2) return;
+	m_SortBuffer.resize( numEntries );
+
+	SSortEntry* source = &m_Entries[0];
+	SSortEntry* target = &m_SortBuffer[0];
+	for (TUInt32 shift = 0; shift < 64; shift += 8)
+	{
+		TUInt32 counts[256] = { 0 };
+		for (TUInt32 i = 0; i < numEntries; ++i)
+		{
+			++counts[(source[i].key >> shift) & 0xff];
+		}
+		if (counts[(source[0].key >> shift) & 0xff] == numEntries) continue;
+
+		TUInt32 offsets[256];
+		TUInt32 offset = 0;
+		for (TUInt32 digit = 0; digit < 256; ++digit)
+		{
+			offsets[digit] = offset;
+			offset += counts[digit];
+		}
+		for (TUInt32 i = 0; i < numEntries; ++i)
+		{
+			target[offsets[(source[i].key >> shift) & 0xff]++] = source[i];
+		}
+
+		SSortEntry* swap = source;
+		source = target;
+		target = swap;
+	}
+
+	// Result must end up in the entries
+	if (source != &m_Entries[0])
+	{
+		m_Entries.swap( m_SortBuffer );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Submission
+//-----------------------------------------------------------------------------
+
+// Write the world matrices of the sorted items to the instance buffer, must be called after sorting and before
+// submission. Instance i in the buffer is sorted item i, so any run of items can be drawn from the buffer without
+// knowing where runs start. Does nothing if there are no runs of the same sub-mesh to instance
+void CRenderQueue::UploadInstances( IRenderDevice* device )
+{
+	m_NumInstances = 0;
+	TUInt32 numEntries = Min( static_cast<TUInt32>(m_Entries.size()), MaxRenderInstances );
+	bool hasRuns = false;
+	for (TUInt32 i = 1; i < numEntries && !hasRuns; ++i)
+	{
+		const SRenderItem& item = m_Items[m_Entries[i].item];
+		const SRenderItem& lastItem = m_Items[m_Entries[i - 1].item];
+		hasRuns = item.subMesh->instancedLayout && item.subMesh == lastItem.subMesh && item.lod == lastItem.lod;
+	}
+	if (!hasRuns) return;
+
+	m_InstanceMatrices.resize( numEntries );
+	for (TUInt32 i = 0; i < numEntries; ++i)
+	{
+		m_InstanceMatrices[i] = *m_Items[m_Entries[i].item].worldMatrix;
+	}
+	device->UpdateBuffer( GetRenderInstanceBuffer(), &m_InstanceMatrices[0], numEntries * sizeof(CMatrix4x4) );
+	m_NumInstances = numEntries;
+}
+
+// Render the sorted items in the given range (first to last-1) to a device. The device state is set in full for
+// the first item, so ranges can be submitted to different devices (e.g. command lists recorded in parallel). Runs of
+// the same sub-mesh that were uploaded to the instance buffer are drawn with one instanced draw
+void CRenderQueue::Submit( IRenderDevice* device, TUInt32 first, TUInt32 last )
+{
+	if (first >= last) return;
+
+	// All geometry is triangle lists
+	device->SetPrimitiveTopology( TriangleList );
+
+	const CMesh::SSubMeshDX*      currentSubMesh = 0;
+	TUInt32                       currentLod = 0;
+	const CMesh::SMeshMaterialDX* currentMaterial = 0;
+	SRenderInputLayout*           currentLayout = 0;
+	bool                          instanceBufferSet = false;
+	for (TUInt32 i = first; i < last; ++i)
+	{
+		const SRenderItem& item = m_Items[m_Entries[i].item];
+		const CMesh::SMeshMaterialDX& material = *item.material;
+		const CMesh::SSubMeshDX& subMesh = *item.subMesh;
+
+		// Length of the run of this sub-mesh at this level of detail (it always has the same material) that can be
+		// drawn instanced
+		TUInt32 numInstances = 1;
+		if (subMesh.instancedLayout)
+		{
+			TUInt32 runEnd = Min( last, m_NumInstances );
+			while (i + numInstances < runEnd && m_Items[m_Entries[i + numInstances].item].subMesh == item.subMesh &&
+			       m_Items[m_Entries[i + numInstances].item].lod == item.lod)
+			{
+				++numInstances;
+			}
+		}
+
+		// Textures are shared by all techniques, only set them when the set changes (compare the textures themselves,
+		// texture set ids may wrap)
+		if (!currentMaterial || material.numTextures != currentMaterial->numTextures ||
+		    memcmp( material.textures, currentMaterial->textures, material.numTextures * sizeof(SRenderResource*) ) != 0)
+		{
+			SetRenderMethodTextures( device, material.renderMethod, material.textures );
+		}
+		currentMaterial = item.material;
+
+		// Geometry, only when it changes (instances of the same mesh share it, levels of detail share the vertices)
+		if (item.subMesh != currentSubMesh)
+		{
+			device->SetVertexBuffer( 0, subMesh.vertexBuffer, subMesh.vertexSize );
+			device->SetIndexBuffer( subMesh.indexBuffers[item.lod] );
+			currentSubMesh = item.subMesh;
+			currentLod = item.lod;
+		}
+		else if (item.lod != currentLod)
+		{
+			device->SetIndexBuffer( subMesh.indexBuffers[item.lod] );
+			currentLod = item.lod;
+		}
+		SRenderInputLayout* layout = (numInstances > 1) ? subMesh.instancedLayout : subMesh.vertexLayout;
+		if (layout != currentLayout)
+		{
+			device->SetInputLayout( layout );
+			currentLayout = layout;
+		}
+		if (numInstances > 1 && !instanceBufferSet)
+		{
+			device->SetVertexBuffer( 1, GetRenderInstanceBuffer(), sizeof(CMatrix4x4) );
+			instanceBufferSet = true;
+		}
+
+		// Per-object constants, then the passes of the technique (applying a pass uploads the constants). Instanced
+		// techniques ignore the world matrix constant and read each instance's matrix from the instance buffer
+		SetRenderMethodConstants( device, material.renderMethod, &material.diffuseColour, &material.specularColour,
+		                          material.specularPower, item.worldMatrix );
+		SRenderTechnique* technique = (numInstances > 1) ? GetRenderMethodInstancedTechnique( material.renderMethod ) :
+		                                                   GetRenderMethodTechnique( material.renderMethod );
+		TUInt32 numPasses = device->GetNumPasses( technique );
+		for (TUInt32 p = 0; p < numPasses; ++p)
+		{
+			device->ApplyPass( technique, p );
+			if (numInstances > 1)
+			{
+				device->DrawIndexedInstanced( subMesh.numIndices[item.lod], numInstances, 0, 0, i );
+			}
+			else
+			{
+				device->DrawIndexed( subMesh.numIndices[item.lod], 0, 0 );
+			}
+		}
+		i += numInstances - 1;
+	}
+}
+
+} // namespace gen
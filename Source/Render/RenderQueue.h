@@ -0,0 +1,144 @@
+/***************************************************************************************
+	RenderQueue.h
+
+	Render queue. Visible sub-meshes are added to the queue each frame with a 64-bit sort
+	key, the keys are radix sorted, then the sub-meshes are submitted in key order, only
+	setting the technique, textures and geometry when they change from the previous
+	sub-mesh. Instances of the same mesh end up next to each other so share nearly all
+	their state. Within the same state, opaque geometry is sorted front-to-back (to reject
+	hidden pixels early) and post-processed materials back-to-front
+
+	Runs of the same sub-mesh in the sorted queue are drawn with a single instanced draw
+	where the render method allows, their world matrices are uploaded to the instance
+	buffer (see RenderMethod.h) in sorted order once the queue is sorted
+
+	Sort key, most significant first:
+		pass (2 bits) | render method (6) | texture set (12) | material (10) |
+		geometry (12) | level of detail (2) | depth (16) | unused (4)
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CMatrix4x4.h"
+#include "RenderDevice.h"
+#include "Mesh.h"
+#include "Camera.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Sort key ids
+//-----------------------------------------------------------------------------
+
+// Ids used in the sort keys are allocated when meshes are loaded. Ids wrap when they exceed the bits in the key,
+// which only makes the sort slightly less effective
+
+// Return the id for a set of textures, the same set always gets the same id
+TUInt32 GetRenderTextureSetId( SRenderResource** textures, TUInt32 numTextures );
+
+// Return a new id for a material or sub-mesh geometry (vertex layout and buffers)
+TUInt32 NewRenderMaterialId();
+TUInt32 NewRenderGeometryId();
+
+
+//-----------------------------------------------------------------------------
+// Render queue
+//-----------------------------------------------------------------------------
+
+// Sub-mesh to render
+struct SRenderItem
+{
+	const CMesh::SSubMeshDX*      subMesh;
+	const CMesh::SMeshMaterialDX* material;
+	CMatrix4x4*                   worldMatrix;
+	TUInt32                       lod;         // Level of detail of the sub-mesh to draw
+};
+
+class CRenderQueue
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	CRenderQueue();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CRenderQueue( const CRenderQueue& );
+	CRenderQueue& operator=( const CRenderQueue& );
+
+public:
+	/////////////////////////////////////
+	//	Building the queue
+
+	// Empty the queue ready for a new frame viewed from the given camera (used for depth sorting)
+	void Clear( CCamera* camera );
+
+	// Add a sub-mesh to the queue, for the normal or post-processed pass
+	void Add( const SRenderItem& item, bool postProcess );
+
+	// Add all the items from another queue, after those already added (the other queue must use the same camera)
+	void Append( const CRenderQueue& queue );
+
+	// Sort the items into key order. The sort is stable, items with equal keys stay in the order they were added
+	void Sort();
+
+
+	/////////////////////////////////////
+	//	Submission
+
+	TUInt32 GetNumItems()
+	{
+		return static_cast<TUInt32>(m_Items.size());
+	}
+
+	// Get the range of sorted items (first to last-1) in the normal or post-processed pass. Normal items sort first
+	void GetPassRange( bool postProcess, TUInt32* first, TUInt32* last )
+	{
+		TUInt32 numNormal = static_cast<TUInt32>(m_Items.size()) - m_NumPostProcessItems;
+		*first = postProcess ? numNormal : 0;
+		*last  = postProcess ? static_cast<TUInt32>(m_Items.size()) : numNormal;
+	}
+
+	// Write the world matrices of the sorted items to the instance buffer, must be called after sorting and before
+	// submission. Does nothing if there are no runs of the same sub-mesh to instance
+	void UploadInstances( IRenderDevice* device );
+
+	// Render the sorted items in the given range (first to last-1) to a device. The device state is set in full for
+	// the first item, so ranges can be submitted to different devices (e.g. command lists recorded in parallel)
+	void Submit( IRenderDevice* device, TUInt32 first, TUInt32 last );
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Key and the item it sorts
+	struct SSortEntry
+	{
+		TUInt64 key;
+		TUInt32 item;
+	};
+
+	vector<SRenderItem> m_Items;
+	vector<SSortEntry>  m_Entries;
+	vector<SSortEntry>  m_SortBuffer; // Kept between frames to avoid reallocation
+	TUInt32             m_NumPostProcessItems;
+
+	// World matrices of the first sorted items, in sorted order, as uploaded to the instance buffer
+	vector<CMatrix4x4> m_InstanceMatrices;
+	TUInt32            m_NumInstances;
+
+	// Camera position and direction for depth, and scale to fit depths into the key
+	CVector3 m_CameraPos;
+	CVector3 m_CameraDir;
+	TFloat32 m_DepthScale;
+};
+
+
+} // namespace gen
@@ -0,0 +1,353 @@
+/***************************************************************************************
+	RenderStats.cpp
+
+	Render device that collects statistics for each frame
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RenderStats.h"
+
+namespace gen
+{
+
+//-----------------------------------------------------------------------------
+// Hashing
+//-----------------------------------------------------------------------------
+
+// FNV-1a hash of some data, continuing from a previous hash
+TUInt64 HashRenderData( const void* data, TUInt32 size, TUInt64 hash = 14695981039346656037ULL )
+{
+	const TUInt8* bytes = static_cast<const TUInt8*>(data);
+	for (TUInt32 i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+
+CRenderStats::CRenderStats( IRenderDevice* device )
+{
+	m_Device = device;
+
+	for (TUInt32 slot = 0; slot < MaxVertexSlots; ++slot)
+	{
+		m_VertexBuffers[slot] = 0;
+	}
+	m_IndexBuffer = 0;
+	m_InputLayout = 0;
+	m_Topology = TriangleList;
+	m_RenderTarget = 0;
+	m_Technique = 0;
+	m_Pass = 0;
+	m_MatrixHash = 0;
+
+	memset( &m_Frame, 0, sizeof(m_Frame) );
+	m_LastFrame = m_Frame;
+	m_NextHistory = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Statistics
+//-----------------------------------------------------------------------------
+
+// Write the recent frames to a CSV file, one line per frame. Returns false on failure
+bool CRenderStats::Export( const string& fileName )
+{
+	FILE* file = fopen( fileName.c_str(), "wt" );
+	if (!file) return false;
+
+	fprintf( file, "Frame,Draws,Instanced Draws,Triangles,State Changes,Redundant State Changes,Constant Updates,"
+	               "Duplicate Draws\n" );
+	for (TUInt32 frame = 0; frame < m_History.size(); ++frame)
+	{
+		const SRenderFrameStats& stats = m_History[(m_NextHistory + frame) % m_History.size()];
+		fprintf( file, "%u,%u,%u,%llu,%u,%u,%u,%u\n", frame, stats.draws, stats.instancedDraws, stats.triangles, stats.stateChanges,
+		         stats.redundantStateChanges, stats.constantUpdates, stats.duplicateDraws );
+	}
+
+	return fclose( file ) == 0;
+}
+
+// Count a state change, redundant if the state was unchanged
+void CRenderStats::CountStateChange( bool changed )
+{
+	++m_Frame.stateChanges;
+	if (!changed) ++m_Frame.redundantStateChanges;
+}
+
+// Count a draw, checking if it repeats an earlier draw this frame
+void CRenderStats::CountDraw( TUInt32 numVertices, TUInt32 numInstances, TUInt32 start, TInt32 baseVertex,
+                              TUInt32 startInstance, bool indexed )
+{
+	++m_Frame.draws;
+	if (numInstances > 1) ++m_Frame.instancedDraws;
+	if (m_Topology == TriangleList)
+	{
+		m_Frame.triangles += static_cast<TUInt64>(numVertices / 3) * numInstances;
+	}
+	else if (numVertices >= 3)
+	{
+		m_Frame.triangles += static_cast<TUInt64>(numVertices - 2) * numInstances;
+	}
+
+	// Draws are the same if they use the same geometry, pass, target and matrices. Textures and other variables
+	// are ignored, a repeat with only those changed is still worth a look
+	TUInt64 hash = HashRenderData( m_VertexBuffers, sizeof(m_VertexBuffers) );
+	hash = HashRenderData( &m_IndexBuffer, sizeof(m_IndexBuffer), hash );
+	hash = HashRenderData( &m_InputLayout, sizeof(m_InputLayout), hash );
+	hash = HashRenderData( &m_RenderTarget, sizeof(m_RenderTarget), hash );
+	hash = HashRenderData( &m_Technique, sizeof(m_Technique), hash );
+	hash = HashRenderData( &m_Pass, sizeof(m_Pass), hash );
+	hash = HashRenderData( &m_MatrixHash, sizeof(m_MatrixHash), hash );
+	TUInt32 draw[6] = { numVertices, numInstances, start, static_cast<TUInt32>(baseVertex), startInstance, indexed ? 1u : 0u };
+	hash = HashRenderData( draw, sizeof(draw), hash );
+	if (!m_Draws.insert( hash ).second)
+	{
+		++m_Frame.duplicateDraws;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Buffers, textures and effects - passed through
+//-----------------------------------------------------------------------------
+
+SRenderBuffer* CRenderStats::CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size )
+{
+	return m_Device->CreateBuffer( type, data, size );
+}
+
+void CRenderStats::ReleaseBuffer( SRenderBuffer* buffer )
+{
+	m_Device->ReleaseBuffer( buffer );
+}
+
+void CRenderStats::UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size )
+{
+	m_Device->UpdateBuffer( buffer, data, size );
+}
+
+bool CRenderStats::ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size )
+{
+	return m_Device->ReadBuffer( buffer, data, size );
+}
+
+SRenderInputLayout* CRenderStats::CreateInputLayout( const SVertexElement* elements, TUInt32 numElements,
+                                                     SRenderTechnique* technique )
+{
+	return m_Device->CreateInputLayout( elements, numElements, technique );
+}
+
+void CRenderStats::ReleaseInputLayout( SRenderInputLayout* layout )
+{
+	m_Device->ReleaseInputLayout( layout );
+}
+
+SRenderResource* CRenderStats::CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps )
+{
+	return m_Device->CreateTexture( width, height, pixels, mipMaps );
+}
+
+SRenderResource* CRenderStats::LoadTexture( const string& fileName )
+{
+	return m_Device->LoadTexture( fileName );
+}
+
+void CRenderStats::UpdateTexture( SRenderResource* texture, const void* pixels )
+{
+	m_Device->UpdateTexture( texture, pixels );
+}
+
+bool CRenderStats::ReadTexture( SRenderResource* texture, void* pixels )
+{
+	return m_Device->ReadTexture( texture, pixels );
+}
+
+bool CRenderStats::CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource )
+{
+	return m_Device->CreateRenderTarget( width, height, target, resource );
+}
+
+void CRenderStats::ReleaseResource( SRenderResource* resource )
+{
+	m_Device->ReleaseResource( resource );
+}
+
+void CRenderStats::ReleaseRenderTarget( SRenderTarget* target )
+{
+	m_Device->ReleaseRenderTarget( target );
+}
+
+SRenderTarget* CRenderStats::GetBackBuffer()
+{
+	return m_Device->GetBackBuffer();
+}
+
+SRenderEffect* CRenderStats::LoadEffect( const string& fileName )
+{
+	return m_Device->LoadEffect( fileName );
+}
+
+void CRenderStats::ReleaseEffect( SRenderEffect* effect )
+{
+	m_Device->ReleaseEffect( effect );
+}
+
+SRenderTechnique* CRenderStats::GetTechnique( SRenderEffect* effect, const string& name )
+{
+	return m_Device->GetTechnique( effect, name );
+}
+
+SRenderVariable* CRenderStats::GetVariable( SRenderEffect* effect, const string& name )
+{
+	return m_Device->GetVariable( effect, name );
+}
+
+TUInt32 CRenderStats::GetNumPasses( SRenderTechnique* technique )
+{
+	return m_Device->GetNumPasses( technique );
+}
+
+
+//-----------------------------------------------------------------------------
+// Counted calls
+//-----------------------------------------------------------------------------
+
+void CRenderStats::SetVariable( SRenderVariable* variable, const void* data, TUInt32 size )
+{
+	++m_Frame.constantUpdates;
+	m_Device->SetVariable( variable, data, size );
+}
+
+void CRenderStats::SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix )
+{
+	++m_Frame.constantUpdates;
+
+	TUInt64 hash = HashRenderData( &variable, sizeof(variable), HashRenderData( matrix, 16 * sizeof(TFloat32) ) );
+	TUInt64& oldHash = m_MatrixHashes[variable];
+	m_MatrixHash ^= oldHash ^ hash;
+	oldHash = hash;
+
+	m_Device->SetMatrixVariable( variable, matrix );
+}
+
+void CRenderStats::SetResourceVariable( SRenderVariable* variable, SRenderResource* resource )
+{
+	SRenderResource*& current = m_Resources[variable];
+	CountStateChange( current != resource );
+	current = resource;
+	m_Device->SetResourceVariable( variable, resource );
+}
+
+void CRenderStats::ApplyPass( SRenderTechnique* technique, TUInt32 pass )
+{
+	// Applying a pass also uploads any changed variables, so is never redundant to the device, but is counted as a
+	// redundant state change if the pass itself is unchanged
+	CountStateChange( technique != m_Technique || pass != m_Pass );
+	m_Technique = technique;
+	m_Pass = pass;
+	m_Device->ApplyPass( technique, pass );
+}
+
+void CRenderStats::SetRenderTarget( SRenderTarget* target, bool depthBuffer )
+{
+	CountStateChange( target != m_RenderTarget );
+	m_RenderTarget = target;
+	m_Device->SetRenderTarget( target, depthBuffer );
+}
+
+void CRenderStats::ClearRenderTarget( SRenderTarget* target, const TFloat32* colour )
+{
+	m_Device->ClearRenderTarget( target, colour );
+}
+
+void CRenderStats::ClearDepthBuffer()
+{
+	m_Device->ClearDepthBuffer();
+}
+
+void CRenderStats::SetViewport( TUInt32 width, TUInt32 height )
+{
+	m_Device->SetViewport( width, height );
+}
+
+void CRenderStats::SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize )
+{
+	if (slot < MaxVertexSlots)
+	{
+		CountStateChange( buffer != m_VertexBuffers[slot] );
+		m_VertexBuffers[slot] = buffer;
+	}
+	m_Device->SetVertexBuffer( slot, buffer, vertexSize );
+}
+
+void CRenderStats::SetIndexBuffer( SRenderBuffer* buffer )
+{
+	CountStateChange( buffer != m_IndexBuffer );
+	m_IndexBuffer = buffer;
+	m_Device->SetIndexBuffer( buffer );
+}
+
+void CRenderStats::SetInputLayout( SRenderInputLayout* layout )
+{
+	CountStateChange( layout != m_InputLayout );
+	m_InputLayout = layout;
+	m_Device->SetInputLayout( layout );
+}
+
+void CRenderStats::SetPrimitiveTopology( EPrimitiveTopology topology )
+{
+	CountStateChange( topology != m_Topology );
+	m_Topology = topology;
+	m_Device->SetPrimitiveTopology( topology );
+}
+
+void CRenderStats::Draw( TUInt32 numVertices, TUInt32 startVertex )
+{
+	CountDraw( numVertices, 1, startVertex, 0, 0, false );
+	m_Device->Draw( numVertices, startVertex );
+}
+
+void CRenderStats::DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex )
+{
+	CountDraw( numIndices, 1, startIndex, baseVertex, 0, true );
+	m_Device->DrawIndexed( numIndices, startIndex, baseVertex );
+}
+
+void CRenderStats::DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+                                         TUInt32 startInstance )
+{
+	CountDraw( numIndices, numInstances, startIndex, baseVertex, startInstance, true );
+	m_Device->DrawIndexedInstanced( numIndices, numInstances, startIndex, baseVertex, startInstance );
+}
+
+// End of the frame - keep its statistics and start the next
+void CRenderStats::Present()
+{
+	m_Device->Present();
+
+	m_LastFrame = m_Frame;
+	if (m_History.size() < HistorySize)
+	{
+		m_History.push_back( m_Frame );
+	}
+	else
+	{
+		m_History[m_NextHistory] = m_Frame;
+		m_NextHistory = (m_NextHistory + 1) % HistorySize;
+	}
+
+	memset( &m_Frame, 0, sizeof(m_Frame) );
+	m_Draws.clear();
+}
+
+
+} // namespace gen
@@ -0,0 +1,157 @@
+/***************************************************************************************
+	RenderStats.h
+
+	Render device that collects statistics for each frame then passes the calls on to
+	another device: draws, triangles, state changes (and those that set the state already
+	current) and constant updates. Draws that repeat an earlier draw in the same frame -
+	the same geometry, technique pass and matrices - are counted as duplicates, catching
+	wasted submissions automatically. A frame ends at Present
+****************************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+using namespace std;
+
+#include "Defines.h"
+#include "RenderDevice.h"
+
+namespace gen
+{
+
+// Statistics for one frame
+struct SRenderFrameStats
+{
+	TUInt32 draws;
+	TUInt32 instancedDraws;        // Draws of several instances at once (also counted in draws)
+	TUInt64 triangles;
+	TUInt32 stateChanges;          // Calls that changed the geometry, pass, render target or a texture
+	TUInt32 redundantStateChanges; // Calls that set the state that was already current
+	TUInt32 constantUpdates;       // Variables and matrices set
+	TUInt32 duplicateDraws;        // Draws identical to an earlier draw in the frame
+};
+
+
+class CRenderStats : public IRenderDevice
+{
+public:
+	/////////////////////////////////////
+	//	Constructors/Destructors
+
+	// Pass calls through to the given device, which must outlive this device
+	CRenderStats( IRenderDevice* device );
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CRenderStats( const CRenderStats& );
+	CRenderStats& operator=( const CRenderStats& );
+
+public:
+	/////////////////////////////////////
+	//	Statistics
+
+	// Statistics for the last complete frame
+	const SRenderFrameStats& GetLastFrame()
+	{
+		return m_LastFrame;
+	}
+
+	// Statistics for recent frames, oldest first
+	const vector<SRenderFrameStats>& GetHistory()
+	{
+		return m_History;
+	}
+
+	// Write the recent frames to a CSV file, one line per frame. Returns false on failure
+	bool Export( const string& fileName );
+
+
+	/////////////////////////////////////
+	//	Device interface
+
+	SRenderBuffer* CreateBuffer( ERenderBufferType type, const void* data, TUInt32 size );
+	void ReleaseBuffer( SRenderBuffer* buffer );
+	void UpdateBuffer( SRenderBuffer* buffer, const void* data, TUInt32 size );
+	bool ReadBuffer( SRenderBuffer* buffer, void* data, TUInt32 size );
+	SRenderInputLayout* CreateInputLayout( const SVertexElement* elements, TUInt32 numElements, SRenderTechnique* technique );
+	void ReleaseInputLayout( SRenderInputLayout* layout );
+
+	SRenderResource* CreateTexture( TUInt32 width, TUInt32 height, const void* pixels, bool mipMaps );
+	SRenderResource* LoadTexture( const string& fileName );
+	void UpdateTexture( SRenderResource* texture, const void* pixels );
+	bool ReadTexture( SRenderResource* texture, void* pixels );
+	bool CreateRenderTarget( TUInt32 width, TUInt32 height, SRenderTarget** target, SRenderResource** resource );
+	void ReleaseResource( SRenderResource* resource );
+	void ReleaseRenderTarget( SRenderTarget* target );
+	SRenderTarget* GetBackBuffer();
+
+	SRenderEffect* LoadEffect( const string& fileName );
+	void ReleaseEffect( SRenderEffect* effect );
+	SRenderTechnique* GetTechnique( SRenderEffect* effect, const string& name );
+	SRenderVariable* GetVariable( SRenderEffect* effect, const string& name );
+	void SetVariable( SRenderVariable* variable, const void* data, TUInt32 size );
+	void SetMatrixVariable( SRenderVariable* variable, const TFloat32* matrix );
+	void SetResourceVariable( SRenderVariable* variable, SRenderResource* resource );
+	TUInt32 GetNumPasses( SRenderTechnique* technique );
+	void ApplyPass( SRenderTechnique* technique, TUInt32 pass );
+
+	void SetRenderTarget( SRenderTarget* target, bool depthBuffer );
+	void ClearRenderTarget( SRenderTarget* target, const TFloat32* colour );
+	void ClearDepthBuffer();
+	void SetViewport( TUInt32 width, TUInt32 height );
+	void SetVertexBuffer( TUInt32 slot, SRenderBuffer* buffer, TUInt32 vertexSize );
+	void SetIndexBuffer( SRenderBuffer* buffer );
+	void SetInputLayout( SRenderInputLayout* layout );
+	void SetPrimitiveTopology( EPrimitiveTopology topology );
+	void Draw( TUInt32 numVertices, TUInt32 startVertex );
+	void DrawIndexed( TUInt32 numIndices, TUInt32 startIndex, TInt32 baseVertex );
+	void DrawIndexedInstanced( TUInt32 numIndices, TUInt32 numInstances, TUInt32 startIndex, TInt32 baseVertex,
+	                           TUInt32 startInstance );
+	void Present();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Count a state change, redundant if the state was unchanged
+	void CountStateChange( bool changed );
+
+	// Count a draw, checking if it repeats an earlier draw this frame
+	void CountDraw( TUInt32 numVertices, TUInt32 numInstances, TUInt32 start, TInt32 baseVertex, TUInt32 startInstance,
+	                bool indexed );
+
+	static const TUInt32 MaxVertexSlots = 4;
+	static const TUInt32 HistorySize = 600;
+
+	IRenderDevice* m_Device;
+
+	// Current state
+	SRenderBuffer*      m_VertexBuffers[MaxVertexSlots];
+	SRenderBuffer*      m_IndexBuffer;
+	SRenderInputLayout* m_InputLayout;
+	EPrimitiveTopology  m_Topology;
+	SRenderTarget*      m_RenderTarget;
+	SRenderTechnique*   m_Technique;
+	TUInt32             m_Pass;
+	map<SRenderVariable*, SRenderResource*> m_Resources;
+
+	// Hash of the value of each matrix variable, and of all of them together (xor of each), so draws with the same
+	// geometry but different matrices are not duplicates
+	map<SRenderVariable*, TUInt64> m_MatrixHashes;
+	TUInt64                        m_MatrixHash;
+
+	// Hashes of the draws made this frame
+	set<TUInt64> m_Draws;
+
+	SRenderFrameStats         m_Frame;
+	SRenderFrameStats         m_LastFrame;
+	vector<SRenderFrameStats> m_History;
+	TUInt32                   m_NextHistory; // Oldest entry once the history is full
+};
+
+
+} // namespace gen
@@ -91,6 +91,15 @@ struct VS_NORMALMAP_INPUT
 	float2 UV      : TEXCOORD0;
 };
 
+// Per-instance data for instanced rendering, the rows of the world matrix come from a second vertex buffer
+struct VS_INSTANCE_INPUT
+{
+    float4 World0  : WORLD0;
+    float4 World1  : WORLD1;
+    float4 World2  : WORLD2;
+    float4 World3  : WORLD3;
+};
+
 
 // Minimum vertex shader output 
 struct VS_BASIC_OUTPUT
@@ -141,29 +150,40 @@ struct VS_NORMALMAP_OUTPUT
 
 // Basic vertex shader to transform 3D model vertices to 2D only
 //
-VS_BASIC_OUTPUT VSTransformOnly( VS_INPUT vIn )
+VS_BASIC_OUTPUT TransformOnlyVertex( VS_INPUT vIn, float4x4 worldMatrix )
 {
 	VS_BASIC_OUTPUT vOut;
 	
 	// Transform the input model vertex position into world space, then view space, then 2D projection space
 	float4 modelPos = float4(vIn.Pos, 1.0f); // Promote to 1x4 so we can multiply by 4x4 matrix, put 1.0 in 4th element for a point (0.0 for a vector)
-	float4 worldPos = mul( modelPos, WorldMatrix );
+	float4 worldPos = mul( modelPos, worldMatrix );
 	float4 viewPos  = mul( worldPos, ViewMatrix );
 	vOut.ProjPos    = mul( viewPos,  ProjMatrix );
 
 	return vOut;
 }
 
+VS_BASIC_OUTPUT VSTransformOnly( VS_INPUT vIn )
+{
+	return TransformOnlyVertex( vIn, WorldMatrix );
+}
+
+// Instanced version, world matrix comes from the instance data
+VS_BASIC_OUTPUT VSTransformOnlyInstanced( VS_INPUT vIn, VS_INSTANCE_INPUT iIn )
+{
+	return TransformOnlyVertex( vIn, float4x4( iIn.World0, iIn.World1, iIn.World2, iIn.World3 ) );
+}
+
 
 // Basic vertex shader to transform 3D model vertices to 2D and pass UVs to the pixel shader
 //
-VS_TEX_OUTPUT VSTransformTex( VS_INPUT vIn )
+VS_TEX_OUTPUT TransformTexVertex( VS_INPUT vIn, float4x4 worldMatrix )
 {
 	VS_TEX_OUTPUT vOut;
 	
 	// Transform the input model vertex position into world space, then view space, then 2D projection space
 	float4 modelPos = float4(vIn.Pos, 1.0f); // Promote to 1x4 so we can multiply by 4x4 matrix, put 1.0 in 4th element for a point (0.0 for a vector)
-	float4 worldPos = mul( modelPos, WorldMatrix );
+	float4 worldPos = mul( modelPos, worldMatrix );
 	float4 viewPos  = mul( worldPos, ViewMatrix );
 	vOut.ProjPos    = mul( viewPos,  ProjMatrix );
 	
@@ -173,10 +193,21 @@ VS_TEX_OUTPUT VSTransformTex( VS_INPUT vIn )
 	return vOut;
 }
 
+VS_TEX_OUTPUT VSTransformTex( VS_INPUT vIn )
+{
+	return TransformTexVertex( vIn, WorldMatrix );
+}
+
+// Instanced version, world matrix comes from the instance data
+VS_TEX_OUTPUT VSTransformTexInstanced( VS_INPUT vIn, VS_INSTANCE_INPUT iIn )
+{
+	return TransformTexVertex( vIn, float4x4( iIn.World0, iIn.World1, iIn.World2, iIn.World3 ) );
+}
+
 
 // Standard vertex shader for pixel-lit untextured models
 //
-VS_LIGHTING_OUTPUT VSPixelLit( VS_INPUT vIn )
+VS_LIGHTING_OUTPUT PixelLitVertex( VS_INPUT vIn, float4x4 worldMatrix )
 {
 	VS_LIGHTING_OUTPUT vOut;
 
@@ -185,8 +216,8 @@ VS_LIGHTING_OUTPUT VSPixelLit( VS_INPUT vIn )
 	float4 modelNormal = float4(vIn.Normal, 0.0f);
 
 	// Transform model vertex position and normal to world space
-	float4 worldPos    = mul( modelPos,    WorldMatrix );
-	float3 worldNormal = mul( modelNormal, WorldMatrix );
+	float4 worldPos    = mul( modelPos,    worldMatrix );
+	float3 worldNormal = mul( modelNormal, worldMatrix );
 
 	// Pass world space position & normal to pixel shader for lighting calculations
    	vOut.WorldPos    = worldPos.xyz;
@@ -199,9 +230,20 @@ VS_LIGHTING_OUTPUT VSPixelLit( VS_INPUT vIn )
 	return vOut;
 }
 
+VS_LIGHTING_OUTPUT VSPixelLit( VS_INPUT vIn )
+{
+	return PixelLitVertex( vIn, WorldMatrix );
+}
+
+// Instanced version, world matrix comes from the instance data
+VS_LIGHTING_OUTPUT VSPixelLitInstanced( VS_INPUT vIn, VS_INSTANCE_INPUT iIn )
+{
+	return PixelLitVertex( vIn, float4x4( iIn.World0, iIn.World1, iIn.World2, iIn.World3 ) );
+}
+
 // Standard vertex shader for pixel-lit textured models
 //
-VS_LIGHTINGTEX_OUTPUT VSPixelLitTex( VS_INPUT vIn )
+VS_LIGHTINGTEX_OUTPUT PixelLitTexVertex( VS_INPUT vIn, float4x4 worldMatrix )
 {
 	VS_LIGHTINGTEX_OUTPUT vOut;
 
@@ -210,8 +252,8 @@ VS_LIGHTINGTEX_OUTPUT VSPixelLitTex( VS_INPUT vIn )
 	float4 modelNormal = float4(vIn.Normal, 0.0f);
 
 	// Transform model vertex position and normal to world space
-	float4 worldPos    = mul( modelPos,    WorldMatrix );
-	float3 worldNormal = mul( modelNormal, WorldMatrix );
+	float4 worldPos    = mul( modelPos,    worldMatrix );
+	float3 worldNormal = mul( modelNormal, worldMatrix );
 
 	// Pass world space position & normal to pixel shader for lighting calculations
    	vOut.WorldPos    = worldPos.xyz;
@@ -227,6 +269,17 @@ VS_LIGHTINGTEX_OUTPUT VSPixelLitTex( VS_INPUT vIn )
 	return vOut;
 }
 
+VS_LIGHTINGTEX_OUTPUT VSPixelLitTex( VS_INPUT vIn )
+{
+	return PixelLitTexVertex( vIn, WorldMatrix );
+}
+
+// Instanced version, world matrix comes from the instance data
+VS_LIGHTINGTEX_OUTPUT VSPixelLitTexInstanced( VS_INPUT vIn, VS_INSTANCE_INPUT iIn )
+{
+	return PixelLitTexVertex( vIn, float4x4( iIn.World0, iIn.World1, iIn.World2, iIn.World3 ) );
+}
+
 
 // Vertex shader for normal-mapped models
 //
@@ -666,6 +719,68 @@ technique10 PixelLitTex
 	}
 }
 
+// Instanced versions of the techniques above, for many instances of the same geometry in one draw. World matrices are
+// per-instance vertex data. Only techniques whose pixel shaders do not use the world matrix can be instanced
+technique10 PlainColourInstanced
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_4_0, VSTransformOnlyInstanced() ) );
+        SetGeometryShader( NULL );                                   
+        SetPixelShader( CompileShader( ps_4_0, PSPlainColour() ) );
+
+		// Switch off blending states
+		SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+		SetRasterizerState( CullBack ); 
+		SetDepthStencilState( DepthWritesOn, 0 );
+	}
+}
+
+technique10 TexColourInstanced
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_4_0, VSTransformTexInstanced() ) );
+        SetGeometryShader( NULL );                                   
+        SetPixelShader( CompileShader( ps_4_0, PSTexColour() ) );
+
+		// Switch off blending states
+		SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+		SetRasterizerState( CullBack ); 
+		SetDepthStencilState( DepthWritesOn, 0 );
+	}
+}
+
+technique10 PixelLitInstanced
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_4_0, VSPixelLitInstanced() ) );
+        SetGeometryShader( NULL );                                   
+        SetPixelShader( CompileShader( ps_4_0, PSPixelLit() ) );
+
+		// Switch off blending states
+		SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+		SetRasterizerState( CullBack ); 
+		SetDepthStencilState( DepthWritesOn, 0 );
+	}
+}
+
+technique10 PixelLitTexInstanced
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_4_0, VSPixelLitTexInstanced() ) );
+        SetGeometryShader( NULL );                                   
+        SetPixelShader( CompileShader( ps_4_0, PSPixelLitTex() ) );
+
+		// Switch off blending states
+		SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+		SetRasterizerState( CullBack ); 
+		SetDepthStencilState( DepthWritesOn, 0 );
+	}
+}
+
 // Normal Mapping
 technique10 NormalMapping
 {
@@ -5,9 +5,12 @@
 	Camera class implementation
 ********************************************/
 
-#include <d3dx9.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+	#include <immintrin.h> // AVX2 / AVX-512
+#else
+	#include <xmmintrin.h> // SSE
+#endif
 #include "CVector4.h"
-#include "MathDX.h"
 #include "Camera.h"
 
 namespace gen
@@ -47,9 +50,15 @@ void CCamera::CalculateMatrices()
     // a perpsective transform, we need the field of view, the viewport 
 	// aspect ratio, and the near and far clipping planes (which define at
     // what distances geometry should be no longer be rendered).
+	// Left-handed, depth mapped to 0 (near) to 1 (far), the same matrix as D3DXMatrixPerspectiveFovLH
 	TFloat32 fovY = ATan(Tan( m_FOV * 0.5f ) / m_Aspect) * 2.0f; // Need fovY, storing fovX
-    D3DXMatrixPerspectiveFovLH( ToD3DXMATRIXPtr(&m_MatProj), fovY, m_Aspect,
-	                            m_NearClip, m_FarClip );
+	TFloat32 yScale = 1.0f / Tan( fovY * 0.5f );
+	TFloat32 xScale = yScale / m_Aspect;
+	TFloat32 depthScale = m_FarClip / (m_FarClip - m_NearClip);
+	m_MatProj = CMatrix4x4( xScale, 0.0f,   0.0f,                      0.0f,
+	                        0.0f,   yScale, 0.0f,                      0.0f,
+	                        0.0f,   0.0f,   depthScale,                1.0f,
+	                        0.0f,   0.0f,   -m_NearClip * depthScale,  0.0f );
 
 	// Combine the view and projection matrix into a single matrix - this will
 	// be passed to vertex shaders (more efficient this way)
@@ -207,6 +216,15 @@ void CCamera::CalculateFrustrumPlanes()
 	CVector3 bottomPoint = m_FrustumPts[0] - cameraUp * apertureHalfHeight; 
 	m_FrustumVecs[5] = Cross( cameraRight, bottomPoint - cameraPos );
 	m_FrustumVecs[5].Normalise();
+
+	// Plane equations for batch testing
+	for (int plane = 0; plane < 6; ++plane)
+	{
+		m_PlaneNormalsX[plane] = m_FrustumVecs[plane].x;
+		m_PlaneNormalsY[plane] = m_FrustumVecs[plane].y;
+		m_PlaneNormalsZ[plane] = m_FrustumVecs[plane].z;
+		m_PlaneDistances[plane] = -Dot( m_FrustumPts[plane], m_FrustumVecs[plane] );
+	}
 }
 
 
@@ -252,4 +270,148 @@ bool CCamera::AABBInFrustum( const CVector3& AABBMin, const CVector3& AABBMax )
 }
 
 
+// Test if a sphere is visible in the viewing frustum, only testing the planes in the given mask.
+// Clears the bits of planes the sphere is entirely inside
+bool CCamera::SphereInFrustum( const CVector3& Centre, TFloat32 Radius, TUInt32* PlaneMask )
+{
+	for (int plane = 0; plane < 6; ++plane)
+	{
+		if (!(*PlaneMask & (1 << plane))) continue;
+
+		// Outside the plane if the centre is further away than the radius, entirely inside if it is
+		// further inside than the radius
+		TFloat32 distance = Dot( Centre - m_FrustumPts[plane], m_FrustumVecs[plane] );
+		if (distance > Radius)
+		{
+			return false;
+		}
+		if (distance < -Radius)
+		{
+			*PlaneMask &= ~(1 << plane);
+		}
+	}
+	return true;
+}
+
+// Test if a bounding box is visible in the viewing frustum, only testing the planes in the given
+// mask. Clears the bits of planes the box is entirely inside
+bool CCamera::AABBInFrustum( const CVector3& AABBMin, const CVector3& AABBMax, TUInt32* PlaneMask )
+{
+	for (int plane = 0; plane < 6; ++plane)
+	{
+		if (!(*PlaneMask & (1 << plane))) continue;
+
+		// Get points of bounding box nearest and furthest from the plane (as above)
+		CVector3 nearPoint, farPoint;
+		bool positiveX = m_FrustumVecs[plane].x >= 0;
+		bool positiveY = m_FrustumVecs[plane].y >= 0;
+		bool positiveZ = m_FrustumVecs[plane].z >= 0;
+		nearPoint.x = positiveX ? AABBMin.x : AABBMax.x;
+		nearPoint.y = positiveY ? AABBMin.y : AABBMax.y;
+		nearPoint.z = positiveZ ? AABBMin.z : AABBMax.z;
+		farPoint.x = positiveX ? AABBMax.x : AABBMin.x;
+		farPoint.y = positiveY ? AABBMax.y : AABBMin.y;
+		farPoint.z = positiveZ ? AABBMax.z : AABBMin.z;
+
+		// Box is outside if the nearest point is outside the plane, entirely inside if the furthest
+		// point is inside
+		if (Dot( nearPoint - m_FrustumPts[plane], m_FrustumVecs[plane] ) > 0)
+		{
+			return false;
+		}
+		if (Dot( farPoint - m_FrustumPts[plane], m_FrustumVecs[plane] ) <= 0)
+		{
+			*PlaneMask &= ~(1 << plane);
+		}
+	}
+	return true;
+}
+
+
+// Test a batch of spheres against the viewing frustum, given as separate arrays of centre
+// components and radii. Visibility is written as a bitmask, bit n of Visible[i] for sphere i*32+n.
+// A sphere is outside if its centre is further outside any plane than its radius. Every path multiplies and adds
+// separately in the same order (no fused multiply-add), so all give exactly the same results
+void CCamera::SpheresInFrustum( const TFloat32* CentresX, const TFloat32* CentresY, const TFloat32* CentresZ,
+                                const TFloat32* Radii, TUInt32 NumSpheres, TUInt32* Visible )
+{
+	TUInt32 sphere = 0;
+#if defined(__AVX512F__)
+	// 16 spheres at a time, the comparisons give a bitmask directly
+	for (; sphere + 16 <= NumSpheres; sphere += 16)
+	{
+		__m512 x = _mm512_loadu_ps( CentresX + sphere );
+		__m512 y = _mm512_loadu_ps( CentresY + sphere );
+		__m512 z = _mm512_loadu_ps( CentresZ + sphere );
+		__m512 radius = _mm512_loadu_ps( Radii + sphere );
+		__mmask16 outside = 0;
+		for (int plane = 0; plane < 6; ++plane)
+		{
+			__m512 distance = _mm512_mul_ps( x, _mm512_set1_ps( m_PlaneNormalsX[plane] ) );
+			distance = _mm512_add_ps( distance, _mm512_mul_ps( y, _mm512_set1_ps( m_PlaneNormalsY[plane] ) ) );
+			distance = _mm512_add_ps( distance, _mm512_mul_ps( z, _mm512_set1_ps( m_PlaneNormalsZ[plane] ) ) );
+			distance = _mm512_add_ps( distance, _mm512_set1_ps( m_PlaneDistances[plane] ) );
+			outside |= _mm512_cmp_ps_mask( distance, radius, _CMP_GT_OQ );
+		}
+		if ((sphere & 31) == 0) Visible[sphere >> 5] = 0;
+		Visible[sphere >> 5] |= static_cast<TUInt32>(static_cast<TUInt16>(~outside)) << (sphere & 31);
+	}
+#elif defined(__AVX2__)
+	// 8 spheres at a time
+	for (; sphere + 8 <= NumSpheres; sphere += 8)
+	{
+		__m256 x = _mm256_loadu_ps( CentresX + sphere );
+		__m256 y = _mm256_loadu_ps( CentresY + sphere );
+		__m256 z = _mm256_loadu_ps( CentresZ + sphere );
+		__m256 radius = _mm256_loadu_ps( Radii + sphere );
+		__m256 outside = _mm256_setzero_ps();
+		for (int plane = 0; plane < 6; ++plane)
+		{
+			__m256 distance = _mm256_mul_ps( x, _mm256_set1_ps( m_PlaneNormalsX[plane] ) );
+			distance = _mm256_add_ps( distance, _mm256_mul_ps( y, _mm256_set1_ps( m_PlaneNormalsY[plane] ) ) );
+			distance = _mm256_add_ps( distance, _mm256_mul_ps( z, _mm256_set1_ps( m_PlaneNormalsZ[plane] ) ) );
+			distance = _mm256_add_ps( distance, _mm256_set1_ps( m_PlaneDistances[plane] ) );
+			outside = _mm256_or_ps( outside, _mm256_cmp_ps( distance, radius, _CMP_GT_OQ ) );
+		}
+		if ((sphere & 31) == 0) Visible[sphere >> 5] = 0;
+		Visible[sphere >> 5] |= static_cast<TUInt32>(~_mm256_movemask_ps( outside ) & 0xff) << (sphere & 31);
+	}
+#else
+	// 4 spheres at a time with SSE2
+	for (; sphere + 4 <= NumSpheres; sphere += 4)
+	{
+		__m128 x = _mm_loadu_ps( CentresX + sphere );
+		__m128 y = _mm_loadu_ps( CentresY + sphere );
+		__m128 z = _mm_loadu_ps( CentresZ + sphere );
+		__m128 radius = _mm_loadu_ps( Radii + sphere );
+		__m128 outside = _mm_setzero_ps();
+		for (int plane = 0; plane < 6; ++plane)
+		{
+			__m128 distance = _mm_mul_ps( x, _mm_set1_ps( m_PlaneNormalsX[plane] ) );
+			distance = _mm_add_ps( distance, _mm_mul_ps( y, _mm_set1_ps( m_PlaneNormalsY[plane] ) ) );
+			distance = _mm_add_ps( distance, _mm_mul_ps( z, _mm_set1_ps( m_PlaneNormalsZ[plane] ) ) );
+			distance = _mm_add_ps( distance, _mm_set1_ps( m_PlaneDistances[plane] ) );
+			outside = _mm_or_ps( outside, _mm_cmpgt_ps( distance, radius ) );
+		}
+		if ((sphere & 31) == 0) Visible[sphere >> 5] = 0;
+		Visible[sphere >> 5] |= static_cast<TUInt32>(~_mm_movemask_ps( outside ) & 0xf) << (sphere & 31);
+	}
+#endif
+
+	// Remaining spheres one at a time
+	for (; sphere < NumSpheres; ++sphere)
+	{
+		bool visible = true;
+		for (int plane = 0; plane < 6; ++plane)
+		{
+			TFloat32 distance = CentresX[sphere] * m_PlaneNormalsX[plane] + CentresY[sphere] * m_PlaneNormalsY[plane] +
+			                    CentresZ[sphere] * m_PlaneNormalsZ[plane] + m_PlaneDistances[plane];
+			if (distance > Radii[sphere]) visible = false;
+		}
+		if ((sphere & 31) == 0) Visible[sphere >> 5] = 0;
+		if (visible) Visible[sphere >> 5] |= 1u << (sphere & 31);
+	}
+}
+
+
 } // namespace gen
\ No newline at end of file
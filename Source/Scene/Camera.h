@@ -140,6 +140,21 @@ public:
 	// an extensive discussion of view frustum clipping including the method used here
 	bool AABBInFrustum( const CVector3& AABBMin, const CVector3& AABBMax );
 
+	// Versions of the above that only test the planes in a mask (bit n for plane n, AllFrustumPlanes for all), and
+	// clear the bits of planes the sphere / box is entirely inside. Objects within the box (e.g. in a hierarchy of
+	// bounding volumes) need only be tested against the planes left in the mask, and not at all if it becomes 0
+	static const TUInt32 AllFrustumPlanes = 0x3f;
+	bool SphereInFrustum( const CVector3& Centre, TFloat32 Radius, TUInt32* PlaneMask );
+	bool AABBInFrustum( const CVector3& AABBMin, const CVector3& AABBMax, TUInt32* PlaneMask );
+
+	// Test a batch of spheres against the viewing frustum. Sphere centres and radii are given as separate arrays
+	// (structure of arrays), and visibility is written as a bitmask - bit n of Visible[i] is set if sphere i*32+n
+	// is visible (Visible must hold (NumSpheres+31)/32 values). Tests 16 spheres at once with AVX-512, 8 with AVX2
+	// and 4 with SSE2, against plane equations. Each width gives exactly the same results, but they may differ from
+	// SphereInFrustum for spheres just touching a plane, due to rounding
+	void SpheresInFrustum( const TFloat32* CentresX, const TFloat32* CentresY, const TFloat32* CentresZ,
+	                       const TFloat32* Radii, TUInt32 NumSpheres, TUInt32* Visible );
+
 
 private:
 	// Current positioning matrix
@@ -155,6 +170,13 @@ private:
 	// Aspect ratio of the viewport = Width / Height
 	TFloat32 m_Aspect;
 
+	// Frustum planes as plane equations (normal.point + d = distance outside the plane), one array per component for
+	// batch testing
+	TFloat32 m_PlaneNormalsX[6];
+	TFloat32 m_PlaneNormalsY[6];
+	TFloat32 m_PlaneNormalsZ[6];
+	TFloat32 m_PlaneDistances[6];
+
 	// Current view and projection matrices
 	CMatrix4x4 m_MatView;
 	CMatrix4x4 m_MatProj;
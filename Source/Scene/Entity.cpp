@@ -15,12 +15,13 @@ namespace gen
 -------------------------------------------------------------------------------------------
 -----------------------------------------------------------------------------------------*/
 
-// Base entity constructor, needs pointer to common template data and UID, may also pass 
-// name, initial position, rotation and scaling. Set up positional matrices for the entity
+// Base entity constructor, needs pointer to common template data, UID and the store to keep its matrices in, may also
+// pass name, initial position, rotation and scaling. Set up positional matrices for the entity
 CEntity::CEntity
 (
 	CEntityTemplate* entityTemplate,
 	TEntityUID       UID,
+	CTransformStore* transforms,
 	const string&    name /*=""*/,
 	const CVector3&  position /*= CVector3::kOrigin*/, 
 	const CVector3&  rotation /*= CVector3( 0.0f, 0.0f, 0.0f )*/,
@@ -30,42 +31,55 @@ CEntity::CEntity
 	m_Template = entityTemplate;
 	m_UID = UID;
 	m_Name = name;
+	m_Lod = 0;
 
-	// Allocate space for matrices
-	TUInt32 numNodes = m_Template->Mesh()->GetNumNodes();
-	m_RelMatrices = new CMatrix4x4[numNodes];
-	m_Matrices = new CMatrix4x4[numNodes];
+	// Allocate slots for matrices, nodes are stored depth-first so each parent is in an earlier slot
+	CMesh* mesh = m_Template->Mesh();
+	TUInt32 numNodes = mesh->GetNumNodes();
+	m_Transforms = transforms;
+	m_FirstNode = m_Transforms->Allocate( numNodes );
 
-	// Set initial matrices from mesh defaults
+	// Set initial matrices and hierarchy from mesh defaults
 	for (TUInt32 node = 0; node < numNodes; ++node)
 	{
-		m_RelMatrices[node] = m_Template->Mesh()->GetNode( node ).positionMatrix;
+		m_Transforms->RelMatrix( m_FirstNode + node ) = mesh->GetNode( node ).positionMatrix;
+		if (node > 0)
+		{
+			m_Transforms->SetParent( m_FirstNode + node, m_FirstNode + mesh->GetNode( node ).parent );
+		}
 	}
 
 	// Override root matrix with constructor parameters
-	m_RelMatrices[0] = CMatrix4x4( position, rotation, kZXY, scale );
+	m_Transforms->RelMatrix( m_FirstNode ) = CMatrix4x4( position, rotation, kZXY, scale );
 }
 
 
-// Render the model from the given camera
-// May request to render either normal or post-processed materials in the entity (defaults to normal)
-void CEntity::Render( CCamera* camera, bool postProcess /*= false*/ )
+// Add the entity to a render queue for rendering from the given camera, both its normal and post-processed materials.
+// The render matrices must have been interpolated
+void CEntity::AddToRenderQueue( CRenderQueue* queue, CCamera* camera, bool cull /*= true*/ )
 {
-	// Get pointer to mesh to simplify code
-	CMesh* Mesh = m_Template->Mesh();
-
-	// Calculate absolute matrices from relative node matrices & node heirarchy
-	m_Matrices[0] = m_RelMatrices[0];
-	TUInt32 numNodes = Mesh->GetNumNodes();
-	for (TUInt32 node = 1; node < numNodes; ++node)
-	{
-		m_Matrices[node] = m_RelMatrices[node] * m_Matrices[Mesh->GetNode( node ).parent];
-	}
 	// Incorporate any bone<->mesh offsets (only relevant for skinning)
 	// Don't need this step for this exercise
 
-	// Render with absolute matrices
-	Mesh->Render( m_Matrices, camera, postProcess );
+	// Queue with the interpolated absolute matrices, at a level of detail chosen from the entity's size on screen
+	m_Template->Mesh()->AddToRenderQueue( queue, m_Transforms->GetRenderMatrices( m_FirstNode ), camera, cull, &m_Lod );
+}
+
+// Rasterize the entity's mesh into an occlusion culler's depth buffer
+void CEntity::RasterizeOccluder( COcclusionCuller* culler )
+{
+	m_Template->Mesh()->RasterizeOccluder( culler, m_Transforms->GetRenderMatrices( m_FirstNode ) );
+}
+
+// Bounding sphere of the entity in the world, from its (root) matrix and its mesh's bounding radius
+void CEntity::GetBoundingSphere( CVector3* centre, TFloat32* radius )
+{
+	// The root node has no parent, so its relative matrix is its world matrix, even before the absolute matrices
+	// are updated
+	const CMatrix4x4& matrix = GetMatrix();
+	CVector3 scale = matrix.GetScale();
+	*centre = matrix.Position();
+	*radius = m_Template->Mesh()->BoundingRadius() * Max( scale.x, Max( scale.y, scale.z ) );
 }
 
 
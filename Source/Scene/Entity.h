@@ -14,6 +14,7 @@ using namespace std;
 #include "CMatrix4x4.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "TransformStore.h"
 
 namespace gen
 {
@@ -21,10 +22,21 @@ namespace gen
 /////////////////////////////////////
 //	Public types
 
-// An entity UID is just a 32 bit value
+// An entity UID is a 32 bit handle: the index of the entity's slot in the entity manager (low bits) and the
+// generation of that slot (high bits). A slot's generation increases each time its entity is destroyed, so a UID
+// kept after its entity is destroyed no longer matches, even once the slot is reused by another entity
 typedef TUInt32 TEntityUID;
 const TEntityUID SystemUID = 0xffffffff;
 
+const TUInt32 EntityUIDIndexBits = 20; // Up to about a million entities (the highest index is never used)
+const TUInt32 EntityUIDIndexMask = (1 << EntityUIDIndexBits) - 1;
+
+// Slot index of a UID
+inline TUInt32 EntityUIDIndex( TEntityUID UID )
+{
+	return UID & EntityUIDIndexMask;
+}
+
 
 /*-----------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------
@@ -46,6 +58,7 @@ public:
 	{
 		m_Type = type;
 		m_Name = name;
+		m_Occluder = false;
 
 		// Load mesh
 		m_Mesh = new CMesh();
@@ -57,6 +70,16 @@ public:
 		}
 	}
 
+	// Constructor for a template using an already created mesh (e.g. generated geometry), the template takes
+	// ownership of the mesh
+	CEntityTemplate( const string& type, const string& name, CMesh* mesh )
+	{
+		m_Type = type;
+		m_Name = name;
+		m_Occluder = false;
+		m_Mesh = mesh;
+	}
+
 	// Destructor - base class destructors should always be virtual
 	virtual ~CEntityTemplate()
 	{
@@ -91,6 +114,21 @@ public:
 		return m_Mesh;
 	}
 
+	// Entities of occluder templates are large and solid, and are drawn into the occlusion culling depth buffer
+	bool IsOccluder()
+	{
+		return m_Occluder;
+	}
+
+
+	/////////////////////////////////////
+	//	Setters
+
+	void SetOccluder( bool occluder )
+	{
+		m_Occluder = occluder;
+	}
+
 
 /////////////////////////////////////
 //	Private interface
@@ -102,6 +140,9 @@ private:
 
 	// The mesh representing this entity
 	CMesh* m_Mesh;
+
+	// Whether entities of this template hide others in occlusion culling
+	bool m_Occluder;
 };
 
 
@@ -113,19 +154,21 @@ private:
 -----------------------------------------------------------------------------------------*/
 
 // Base entity holds a pointer to its template data and the current position as a set of
-// matrices. The entity can be rendered but its update function does nothing - base class
-// entities are assumed to be static scene elements
+// matrices (kept in a transform store shared by all entities). The entity can be rendered but
+// its update function does nothing - base class entities are assumed to be static scene elements
 class CEntity
 {
 /////////////////////////////////////
 //	Constructors/Destructors
 public:
-	// Base entity constructor, needs pointer to common template data and UID, may also pass 
-	// name, initial position, rotation and scaling. Set up positional matrices for the entity
+	// Base entity constructor, needs pointer to common template data, UID and the store to keep
+	// its matrices in, may also pass name, initial position, rotation and scaling. Set up
+	// positional matrices for the entity
 	CEntity
 	(
 		CEntityTemplate* entityTemplate,
 		TEntityUID       UID,
+		CTransformStore* transforms,
 		const string&    name = "",
 		const CVector3&  position = CVector3::kOrigin, 
 		const CVector3&  rotation = CVector3( 0.0f, 0.0f, 0.0f ),
@@ -135,8 +178,7 @@ public:
 	// Destructor - base class destructors should always be virtual
 	virtual ~CEntity()
 	{
-		delete[] m_Matrices;
-		delete[] m_RelMatrices;
+		m_Transforms->Free( m_FirstNode, m_Template->Mesh()->GetNumNodes() );
 	}
 
 private:
@@ -171,14 +213,25 @@ public:
 	/////////////////////////////////////
 	// Matrix access
 
-	// Direct access to position and matrix
+	// Direct access to position and matrix. These may be written through, so they mark the node's absolute matrix
+	// (and those of its descendants) to be recalculated - use GetPosition / GetMatrix to only read
 	CVector3& Position( TUInt32 node = 0 )
 	{
-		return m_RelMatrices[node].Position();
+		return m_Transforms->RelMatrix( m_FirstNode + node ).Position();
 	}
 	CMatrix4x4& Matrix( TUInt32 node = 0 )
 	{
-		return m_RelMatrices[node];
+		return m_Transforms->RelMatrix( m_FirstNode + node );
+	}
+
+	// Read-only access to position and matrix
+	const CVector3& GetPosition( TUInt32 node = 0 )
+	{
+		return GetMatrix( node ).Position();
+	}
+	const CMatrix4x4& GetMatrix( TUInt32 node = 0 )
+	{
+		return m_Transforms->GetRelMatrix( m_FirstNode + node );
 	}
 
 
@@ -190,9 +243,43 @@ public:
 	// Virtual function, base version does nothing
 	virtual bool Update( TFloat32 updateTime ) { return true; }
 	
-	// Render the entity from the given camera
-	// May request to render either normal or post-processed materials in the entity (defaults to normal)
-	void Render( CCamera* camera, bool postProcess = false );
+	// Bounding sphere of the entity in the world, from its (root) matrix and its mesh's bounding radius
+	void GetBoundingSphere( CVector3* centre, TFloat32* radius );
+
+	// Return true if the entity's absolute matrix has been recalculated since the transform store's moved flags were
+	// last cleared
+	bool IsMoved()
+	{
+		return m_Transforms->IsMoved( m_FirstNode );
+	}
+
+	// Position of the entity before the latest simulation step, from the transform store's snapshot
+	const CVector3& GetPreviousPosition()
+	{
+		return m_Transforms->GetPreviousSnapshotMatrix( m_FirstNode ).Position();
+	}
+
+	// World matrix of a node for rendering, interpolated between the transform store's snapshots before and after
+	// the latest simulation step
+	CMatrix4x4 GetInterpolatedMatrix( TUInt32 node = 0 )
+	{
+		return m_Transforms->GetInterpolatedMatrix( m_FirstNode + node );
+	}
+
+	// Interpolate the render matrices of all the entity's nodes, before it is queued or rasterized
+	void InterpolateMatrices()
+	{
+		m_Transforms->InterpolateMatrices( m_FirstNode, m_Template->Mesh()->GetNumNodes() );
+	}
+
+	// Add the entity to a render queue for rendering from the given camera, both its normal and post-processed
+	// materials. The render matrices must have been interpolated. Pass cull as false if the entity is already known
+	// to be visible
+	void AddToRenderQueue( CRenderQueue* queue, CCamera* camera, bool cull = true );
+
+	// Rasterize the entity's mesh into an occlusion culler's depth buffer. The render matrices must have been
+	// interpolated
+	void RasterizeOccluder( COcclusionCuller* culler );
 
 
 /////////////////////////////////////
@@ -206,9 +293,14 @@ private:
 	TEntityUID  m_UID;
 	string      m_Name;
 
-	// Relative and absolute world matrices for each node in the template's mesh
-	CMatrix4x4* m_RelMatrices; // Dynamically allocated arrays
-	CMatrix4x4* m_Matrices;
+	// Relative and absolute world matrices for each node in the template's mesh are held in the transform store,
+	// in a range of slots starting at m_FirstNode
+	CTransformStore* m_Transforms;
+	TUInt32          m_FirstNode;
+
+	// Level of detail the entity's mesh was last rendered at, so the level only changes once the entity's size on
+	// screen is well past the switching point
+	TUInt32 m_Lod;
 };
 
 
@@ -0,0 +1,420 @@
+/*******************************************
+	EntityBVH.cpp
+
+	Bounding volume hierarchy of entity
+	bounding spheres for frustum culling
+********************************************/
+
+#include <algorithm>
+using namespace std;
+
+#include "EntityBVH.h"
+
+namespace gen
+{
+
+const TFloat32 CEntityBVH::FatMarginScale = 0.25f;
+const TFloat32 CEntityBVH::MinFatMargin = 0.5f;
+
+// Component-wise minimum and maximum of two vectors
+static CVector3 MinVector( const CVector3& a, const CVector3& b )
+{
+	return CVector3( Min( a.x, b.x ), Min( a.y, b.y ), Min( a.z, b.z ) );
+}
+static CVector3 MaxVector( const CVector3& a, const CVector3& b )
+{
+	return CVector3( Max( a.x, b.x ), Max( a.y, b.y ), Max( a.z, b.z ) );
+}
+
+
+/////////////////////////////////////
+// Constructors/Destructors
+
+CEntityBVH::CEntityBVH()
+{
+	m_Root = NoNode;
+	m_FreeNodes = NoNode;
+	m_NumLeaves = 0;
+	m_NumInserted = 0;
+	m_NumNodesVisited = 0;
+}
+
+
+/////////////////////////////////////
+// Items
+
+// Add an item with the given bounding sphere, returning its leaf node
+TUInt32 CEntityBVH::Insert( TUInt32 item, const CVector3& centre, TFloat32 radius )
+{
+	TUInt32 leaf = AllocateNode();
+	SNode& node = m_Nodes[leaf];
+	node.left = NoNode;
+	node.right = item;
+	node.centre = centre;
+	node.radius = radius;
+	TFloat32 fatRadius = radius + Max( radius * FatMarginScale, MinFatMargin );
+	node.boxMin = centre - CVector3( fatRadius, fatRadius, fatRadius );
+	node.boxMax = centre + CVector3( fatRadius, fatRadius, fatRadius );
+
+	InsertLeaf( leaf );
+	++m_NumLeaves;
+	++m_NumInserted;
+	return leaf;
+}
+
+// Remove the item in a leaf node
+void CEntityBVH::Remove( TUInt32 leaf )
+{
+	RemoveLeaf( leaf );
+	FreeNode( leaf );
+	--m_NumLeaves;
+}
+
+// Update the bounding sphere of the item in a leaf node. The tree only changes if the sphere leaves the leaf's fat
+// box
+void CEntityBVH::Move( TUInt32 leaf, const CVector3& centre, TFloat32 radius )
+{
+	SNode& node = m_Nodes[leaf];
+	node.centre = centre;
+	node.radius = radius;
+	if (centre.x - radius >= node.boxMin.x && centre.x + radius <= node.boxMax.x &&
+	    centre.y - radius >= node.boxMin.y && centre.y + radius <= node.boxMax.y &&
+	    centre.z - radius >= node.boxMin.z && centre.z + radius <= node.boxMax.z)
+	{
+		return;
+	}
+
+	// Reinsert with a new fat box - the leaf keeps its index
+	RemoveLeaf( leaf );
+	TFloat32 fatRadius = radius + Max( radius * FatMarginScale, MinFatMargin );
+	m_Nodes[leaf].boxMin = centre - CVector3( fatRadius, fatRadius, fatRadius );
+	m_Nodes[leaf].boxMax = centre + CVector3( fatRadius, fatRadius, fatRadius );
+	InsertLeaf( leaf );
+}
+
+// Remove all items
+void CEntityBVH::Clear()
+{
+	m_Nodes.clear();
+	m_Root = NoNode;
+	m_FreeNodes = NoNode;
+	m_NumLeaves = 0;
+	m_NumInserted = 0;
+}
+
+
+/////////////////////////////////////
+// Tree structure
+
+// Half the surface area of a box - enough to compare costs
+TFloat32 CEntityBVH::HalfArea( const CVector3& boxMin, const CVector3& boxMax )
+{
+	CVector3 size = boxMax - boxMin;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Get a node from the free list, or a new one
+TUInt32 CEntityBVH::AllocateNode()
+{
+	TUInt32 node;
+	if (m_FreeNodes != NoNode)
+	{
+		node = m_FreeNodes;
+		m_FreeNodes = m_Nodes[node].parent;
+	}
+	else
+	{
+		node = static_cast<TUInt32>(m_Nodes.size());
+		m_Nodes.push_back( SNode() );
+	}
+	m_Nodes[node].parent = NoNode;
+	return node;
+}
+
+void CEntityBVH::FreeNode( TUInt32 node )
+{
+	m_Nodes[node].parent = m_FreeNodes;
+	m_FreeNodes = node;
+}
+
+// Link a leaf into the tree next to the node that increases the total surface area least
+void CEntityBVH::InsertLeaf( TUInt32 leaf )
+{
+	if (m_Root == NoNode)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].parent = NoNode;
+		return;
+	}
+
+	// Walk down the tree choosing the child whose box grows least. Stop when making a new parent here is cheaper -
+	// the cost is the area of the new parent plus the growth of the boxes above it
+	CVector3 leafMin = m_Nodes[leaf].boxMin;
+	CVector3 leafMax = m_Nodes[leaf].boxMax;
+	TUInt32 sibling = m_Root;
+	while (!IsLeaf( sibling ))
+	{
+		const SNode& node = m_Nodes[sibling];
+		TFloat32 area = HalfArea( node.boxMin, node.boxMax );
+		TFloat32 combinedArea = HalfArea( MinVector( node.boxMin, leafMin ), MaxVector( node.boxMax, leafMax ) );
+		TFloat32 cost = 2.0f * combinedArea;
+		TFloat32 inheritedCost = 2.0f * (combinedArea - area);
+
+		TFloat32 childCosts[2];
+		TUInt32 children[2] = { node.left, node.right };
+		for (TUInt32 c = 0; c < 2; ++c)
+		{
+			const SNode& child = m_Nodes[children[c]];
+			TFloat32 childArea = HalfArea( MinVector( child.boxMin, leafMin ), MaxVector( child.boxMax, leafMax ) );
+			if (!IsLeaf( children[c] )) childArea -= HalfArea( child.boxMin, child.boxMax );
+			childCosts[c] = childArea + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1]) break;
+		sibling = (childCosts[0] <= childCosts[1]) ? children[0] : children[1];
+	}
+
+	// New parent of the sibling and the leaf, in the sibling's place
+	TUInt32 oldParent = m_Nodes[sibling].parent;
+	TUInt32 newParent = AllocateNode();
+	SNode& parentNode = m_Nodes[newParent];
+	parentNode.parent = oldParent;
+	parentNode.left = sibling;
+	parentNode.right = leaf;
+	parentNode.boxMin = MinVector( m_Nodes[sibling].boxMin, leafMin );
+	parentNode.boxMax = MaxVector( m_Nodes[sibling].boxMax, leafMax );
+	m_Nodes[sibling].parent = newParent;
+	m_Nodes[leaf].parent = newParent;
+
+	if (oldParent == NoNode)
+	{
+		m_Root = newParent;
+	}
+	else
+	{
+		if (m_Nodes[oldParent].left == sibling) m_Nodes[oldParent].left = newParent;
+		else                                    m_Nodes[oldParent].right = newParent;
+		Refit( oldParent );
+	}
+}
+
+// Unlink a leaf from the tree, its sibling takes the place of their parent
+void CEntityBVH::RemoveLeaf( TUInt32 leaf )
+{
+	if (leaf == m_Root)
+	{
+		m_Root = NoNode;
+		return;
+	}
+
+	TUInt32 parent = m_Nodes[leaf].parent;
+	TUInt32 grandParent = m_Nodes[parent].parent;
+	TUInt32 sibling = (m_Nodes[parent].left == leaf) ? m_Nodes[parent].right : m_Nodes[parent].left;
+
+	m_Nodes[sibling].parent = grandParent;
+	if (grandParent == NoNode)
+	{
+		m_Root = sibling;
+	}
+	else
+	{
+		if (m_Nodes[grandParent].left == parent) m_Nodes[grandParent].left = sibling;
+		else                                     m_Nodes[grandParent].right = sibling;
+		Refit( grandParent );
+	}
+	FreeNode( parent );
+}
+
+// Recalculate the boxes of a node and its ancestors from their children
+void CEntityBVH::Refit( TUInt32 node )
+{
+	while (node != NoNode)
+	{
+		SNode& refitNode = m_Nodes[node];
+		refitNode.boxMin = MinVector( m_Nodes[refitNode.left].boxMin, m_Nodes[refitNode.right].boxMin );
+		refitNode.boxMax = MaxVector( m_Nodes[refitNode.left].boxMax, m_Nodes[refitNode.right].boxMax );
+		node = refitNode.parent;
+	}
+}
+
+
+/////////////////////////////////////
+// Building
+
+// Rebuild the tree over the current items using the surface area heuristic
+void CEntityBVH::Rebuild()
+{
+	m_NumInserted = 0;
+	if (m_Root == NoNode) return;
+
+	// Collect the leaves and free the internal nodes
+	m_BuildLeaves.clear();
+	m_QueryStack.clear();
+	SQueryEntry root = { m_Root, 0 };
+	m_QueryStack.push_back( root );
+	while (!m_QueryStack.empty())
+	{
+		TUInt32 node = m_QueryStack.back().node;
+		m_QueryStack.pop_back();
+		if (IsLeaf( node ))
+		{
+			m_BuildLeaves.push_back( node );
+		}
+		else
+		{
+			SQueryEntry left = { m_Nodes[node].left, 0 };
+			SQueryEntry right = { m_Nodes[node].right, 0 };
+			m_QueryStack.push_back( left );
+			m_QueryStack.push_back( right );
+			FreeNode( node );
+		}
+	}
+
+	m_Root = Build( 0, static_cast<TUInt32>(m_BuildLeaves.size()), 0 );
+	m_Nodes[m_Root].parent = NoNode;
+}
+
+// Build a subtree over a range of the leaves in m_BuildLeaves (first to last-1), returning its root node
+TUInt32 CEntityBVH::Build( TUInt32 first, TUInt32 last, TUInt32 depth )
+{
+	if (last - first == 1) return m_BuildLeaves[first];
+
+	// Split along the longest axis of the box around the leaf centres
+	CVector3 centreMin = m_Nodes[m_BuildLeaves[first]].centre;
+	CVector3 centreMax = centreMin;
+	for (TUInt32 i = first + 1; i < last; ++i)
+	{
+		centreMin = MinVector( centreMin, m_Nodes[m_BuildLeaves[i]].centre );
+		centreMax = MaxVector( centreMax, m_Nodes[m_BuildLeaves[i]].centre );
+	}
+	CVector3 extent = centreMax - centreMin;
+	TUInt32 axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+
+	TUInt32 mid = first;
+	if (extent[axis] > 0.0f && depth < MaxSAHDepth)
+	{
+		// Bin the leaves by centre, then find the split between bins with the lowest cost: the area of each side
+		// times the number of leaves in it
+		TFloat32 binScale = NumSAHBins / extent[axis] * 0.9999f;
+		TUInt32  binCounts[NumSAHBins] = { 0 };
+		CVector3 binMins[NumSAHBins];
+		CVector3 binMaxs[NumSAHBins];
+		for (TUInt32 i = first; i < last; ++i)
+		{
+			const SNode& leaf = m_Nodes[m_BuildLeaves[i]];
+			TUInt32 bin = static_cast<TUInt32>((leaf.centre[axis] - centreMin[axis]) * binScale);
+			binMins[bin] = binCounts[bin] ? MinVector( binMins[bin], leaf.boxMin ) : leaf.boxMin;
+			binMaxs[bin] = binCounts[bin] ? MaxVector( binMaxs[bin], leaf.boxMax ) : leaf.boxMax;
+			++binCounts[bin];
+		}
+
+		// Costs of the bins to the right of each split, sweeping from the right
+		TFloat32 rightCosts[NumSAHBins];
+		TUInt32 count = 0;
+		CVector3 boxMin, boxMax;
+		for (TUInt32 bin = NumSAHBins - 1; bin > 0; --bin)
+		{
+			if (binCounts[bin])
+			{
+				boxMin = count ? MinVector( boxMin, binMins[bin] ) : binMins[bin];
+				boxMax = count ? MaxVector( boxMax, binMaxs[bin] ) : binMaxs[bin];
+				count += binCounts[bin];
+			}
+			rightCosts[bin] = count ? count * HalfArea( boxMin, boxMax ) : 0.0f;
+		}
+
+		// Sweep from the left for the best split (split n puts bins before n on the left)
+		TUInt32 bestSplit = 0;
+		TFloat32 bestCost = 0.0f;
+		count = 0;
+		for (TUInt32 split = 1; split < NumSAHBins; ++split)
+		{
+			TUInt32 bin = split - 1;
+			if (binCounts[bin])
+			{
+				boxMin = count ? MinVector( boxMin, binMins[bin] ) : binMins[bin];
+				boxMax = count ? MaxVector( boxMax, binMaxs[bin] ) : binMaxs[bin];
+				count += binCounts[bin];
+			}
+			if (count == 0 || count == last - first) continue;
+			TFloat32 cost = count * HalfArea( boxMin, boxMax ) + rightCosts[split];
+			if (bestSplit == 0 || cost < bestCost)
+			{
+				bestSplit = split;
+				bestCost = cost;
+			}
+		}
+
+		if (bestSplit > 0)
+		{
+			TUInt32* split = partition( &m_BuildLeaves[first], &m_BuildLeaves[0] + last, [&]( TUInt32 leaf )
+			{
+				return static_cast<TUInt32>((m_Nodes[leaf].centre[axis] - centreMin[axis]) * binScale) < bestSplit;
+			} );
+			mid = static_cast<TUInt32>(split - &m_BuildLeaves[0]);
+		}
+	}
+
+	// Split at the median if the leaves could not be separated (e.g. all at the same point), or the tree is
+	// getting unbalanced
+	if (mid == first || mid == last)
+	{
+		mid = (first + last) / 2;
+		nth_element( &m_BuildLeaves[first], &m_BuildLeaves[mid], &m_BuildLeaves[0] + last,
+		             [&]( TUInt32 a, TUInt32 b ) { return m_Nodes[a].centre[axis] < m_Nodes[b].centre[axis]; } );
+	}
+
+	TUInt32 left = Build( first, mid, depth + 1 );
+	TUInt32 right = Build( mid, last, depth + 1 );
+	TUInt32 node = AllocateNode();
+	SNode& newNode = m_Nodes[node];
+	newNode.left = left;
+	newNode.right = right;
+	newNode.boxMin = MinVector( m_Nodes[left].boxMin, m_Nodes[right].boxMin );
+	newNode.boxMax = MaxVector( m_Nodes[left].boxMax, m_Nodes[right].boxMax );
+	m_Nodes[left].parent = node;
+	m_Nodes[right].parent = node;
+	return node;
+}
+
+
+/////////////////////////////////////
+// Queries
+
+// Find the items whose bounding spheres are visible from the given camera, replacing the contents of the vector
+void CEntityBVH::FindVisible( CCamera* camera, vector<TUInt32>* items )
+{
+	items->clear();
+	m_NumNodesVisited = 0;
+	if (m_Root == NoNode) return;
+
+	m_QueryStack.clear();
+	SQueryEntry root = { m_Root, CCamera::AllFrustumPlanes };
+	m_QueryStack.push_back( root );
+	while (!m_QueryStack.empty())
+	{
+		SQueryEntry entry = m_QueryStack.back();
+		m_QueryStack.pop_back();
+		++m_NumNodesVisited;
+		const SNode& node = m_Nodes[entry.node];
+
+		// Test against the planes the parent's box was not entirely inside - leaves test their exact sphere
+		if (node.left == NoNode)
+		{
+			if (entry.planeMask == 0 || camera->SphereInFrustum( node.centre, node.radius, &entry.planeMask ))
+			{
+				items->push_back( node.right );
+			}
+		}
+		else if (entry.planeMask == 0 || camera->AABBInFrustum( node.boxMin, node.boxMax, &entry.planeMask ))
+		{
+			SQueryEntry left = { node.left, entry.planeMask };
+			SQueryEntry right = { node.right, entry.planeMask };
+			m_QueryStack.push_back( right );
+			m_QueryStack.push_back( left );
+		}
+	}
+}
+
+
+} // namespace gen
@@ -0,0 +1,165 @@
+/*******************************************
+	EntityBVH.h
+
+	Bounding volume hierarchy of entity
+	bounding spheres for frustum culling
+********************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "Camera.h"
+
+namespace gen
+{
+
+// A binary tree of axis-aligned bounding boxes. Each leaf holds the bounding sphere of one item (an entity UID) in
+// a slightly enlarged ("fat") box, so small movements don't change the tree. Items that move out of their fat box
+// are removed and reinserted, with the boxes above refitted. The whole tree is rebuilt top-down using the surface
+// area heuristic (SAH) after many insertions, e.g. when a level of static entities is loaded. Frustum queries test
+// boxes against the camera planes, passing the planes still to be tested down the tree, so the contents of boxes
+// entirely inside the frustum are accepted without further tests
+class CEntityBVH
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CEntityBVH();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CEntityBVH( const CEntityBVH& );
+	CEntityBVH& operator=( const CEntityBVH& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Node index used for no node
+	static const TUInt32 NoNode = 0xffffffff;
+
+	/////////////////////////////////////
+	// Items
+
+	// Add an item with the given bounding sphere, returning its leaf node
+	TUInt32 Insert( TUInt32 item, const CVector3& centre, TFloat32 radius );
+
+	// Remove the item in a leaf node
+	void Remove( TUInt32 leaf );
+
+	// Update the bounding sphere of the item in a leaf node. The tree only changes if the sphere leaves the leaf's
+	// fat box
+	void Move( TUInt32 leaf, const CVector3& centre, TFloat32 radius );
+
+	// Remove all items
+	void Clear();
+
+
+	/////////////////////////////////////
+	// Building
+
+	// Return true if enough items have been inserted since the last rebuild for the tree to be worth rebuilding
+	bool NeedsRebuild()
+	{
+		return m_NumInserted > MinInsertsForRebuild && m_NumInserted > m_NumLeaves / 4;
+	}
+
+	// Rebuild the tree over the current items using the surface area heuristic
+	void Rebuild();
+
+
+	/////////////////////////////////////
+	// Queries
+
+	// Find the items whose bounding spheres are visible from the given camera, replacing the contents of the vector.
+	// Gives the same items as testing every bounding sphere against the camera frustum
+	void FindVisible( CCamera* camera, vector<TUInt32>* items );
+
+	// Number of items, and the number of nodes visited by the last query
+	TUInt32 GetNumItems()
+	{
+		return m_NumLeaves;
+	}
+	TUInt32 GetNumNodesVisited()
+	{
+		return m_NumNodesVisited;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Leaf boxes are enlarged by this fraction of the sphere radius plus a minimum in world units
+	static const TFloat32 FatMarginScale;
+	static const TFloat32 MinFatMargin;
+
+	// Fewest insertions since the last build to consider a rebuild
+	static const TUInt32 MinInsertsForRebuild = 64;
+
+	// Number of bins used to find the best SAH split, and the deepest recursion before splitting at the median
+	static const TUInt32 NumSAHBins = 16;
+	static const TUInt32 MaxSAHDepth = 48;
+
+	// A node of the tree. Internal nodes have two children, leaves have no left child and hold their item and the
+	// item's exact bounding sphere. Free nodes are linked through their parent
+	struct SNode
+	{
+		CVector3 boxMin;
+		TUInt32  parent;
+		CVector3 boxMax;
+		TUInt32  left;
+		TUInt32  right;  // Item for leaves
+		CVector3 centre; // Leaves only
+		TFloat32 radius;
+	};
+
+	// Node being visited by a query, with the frustum planes its box still needs testing against
+	struct SQueryEntry
+	{
+		TUInt32 node;
+		TUInt32 planeMask;
+	};
+
+	bool IsLeaf( TUInt32 node )
+	{
+		return m_Nodes[node].left == NoNode;
+	}
+
+	// Half the surface area of a box - enough to compare costs
+	static TFloat32 HalfArea( const CVector3& boxMin, const CVector3& boxMax );
+
+	// Get a node from the free list, or a new one
+	TUInt32 AllocateNode();
+	void FreeNode( TUInt32 node );
+
+	// Link a leaf into the tree next to the node that increases the total surface area least, or unlink it
+	void InsertLeaf( TUInt32 leaf );
+	void RemoveLeaf( TUInt32 leaf );
+
+	// Recalculate the boxes of a node and its ancestors from their children
+	void Refit( TUInt32 node );
+
+	// Build a subtree over a range of the leaves in m_BuildLeaves (first to last-1), returning its root node
+	TUInt32 Build( TUInt32 first, TUInt32 last, TUInt32 depth );
+
+	vector<SNode> m_Nodes;
+	TUInt32       m_Root;
+	TUInt32       m_FreeNodes;
+	TUInt32       m_NumLeaves;
+	TUInt32       m_NumInserted; // Leaves inserted since the last rebuild
+
+	// Working memory kept between calls
+	vector<TUInt32>     m_BuildLeaves;
+	vector<SQueryEntry> m_QueryStack;
+
+	TUInt32 m_NumNodesVisited;
+};
+
+
+} // namespace gen
@@ -0,0 +1,159 @@
+/*******************************************
+	EntityGrid.cpp
+
+	Uniform spatial hash grid of entity
+	positions for range queries
+********************************************/
+
+#include <math.h>
+
+#include "EntityGrid.h"
+
+namespace gen
+{
+
+/////////////////////////////////////
+// Constructors/Destructors
+
+// Grid with cells of the given size, hashed into the given number of buckets (rounded up to a power of 2)
+CEntityGrid::CEntityGrid( TFloat32 cellSize /*= 32.0f*/, TUInt32 numBuckets /*= 4096*/ )
+{
+	m_InvCellSize = 1.0f / cellSize;
+
+	TUInt32 size = 1;
+	while (size < numBuckets) size *= 2;
+	m_Buckets.resize( size );
+	m_NumEntities = 0;
+}
+
+
+/////////////////////////////////////
+// Entities
+
+// Add an entry to the bucket of its cell
+void CEntityGrid::AddEntry( const SEntry& entry )
+{
+	TUInt32 bucket = CellBucket( entry.cellX, entry.cellY, entry.cellZ );
+	SLocation& location = m_Locations[EntityUIDIndex( entry.UID )];
+	location.bucket = bucket;
+	location.index = static_cast<TUInt32>(m_Buckets[bucket].size());
+	m_Buckets[bucket].push_back( entry );
+}
+
+// Add an entity at the given position
+void CEntityGrid::Insert( TEntityUID UID, const CVector3& position )
+{
+	TUInt32 slot = EntityUIDIndex( UID );
+	if (slot >= m_Locations.size())
+	{
+		SLocation noLocation = { NoBucket, 0 };
+		m_Locations.resize( slot + 1, noLocation );
+	}
+
+	SEntry entry = { UID, CellCoord( position.x ), CellCoord( position.y ), CellCoord( position.z ), position };
+	AddEntry( entry );
+	++m_NumEntities;
+}
+
+// Remove an entity
+void CEntityGrid::Remove( TEntityUID UID )
+{
+	SLocation& location = m_Locations[EntityUIDIndex( UID )];
+	if (location.bucket == NoBucket) return;
+
+	// Move the last entry of the bucket into the entity's place
+	vector<SEntry>& entries = m_Buckets[location.bucket];
+	entries[location.index] = entries.back();
+	m_Locations[EntityUIDIndex( entries[location.index].UID )].index = location.index;
+	entries.pop_back();
+
+	location.bucket = NoBucket;
+	--m_NumEntities;
+}
+
+// Update the position of an entity, moving it to another bucket only if it has left its cell
+void CEntityGrid::Move( TEntityUID UID, const CVector3& position )
+{
+	SLocation& location = m_Locations[EntityUIDIndex( UID )];
+	SEntry& entry = m_Buckets[location.bucket][location.index];
+	TInt32 cellX = CellCoord( position.x );
+	TInt32 cellY = CellCoord( position.y );
+	TInt32 cellZ = CellCoord( position.z );
+	if (cellX == entry.cellX && cellY == entry.cellY && cellZ == entry.cellZ)
+	{
+		entry.position = position;
+		return;
+	}
+
+	SEntry moved = { UID, cellX, cellY, cellZ, position };
+	Remove( UID );
+	AddEntry( moved );
+	++m_NumEntities;
+}
+
+// Remove all entities
+void CEntityGrid::Clear()
+{
+	for (TUInt32 bucket = 0; bucket < m_Buckets.size(); ++bucket)
+	{
+		m_Buckets[bucket].clear();
+	}
+	m_Locations.clear();
+	m_NumEntities = 0;
+}
+
+
+/////////////////////////////////////
+// Queries
+
+// Find the entities whose positions are within the given distance of a point, adding their UIDs to the vector
+void CEntityGrid::FindInRadius( const CVector3& centre, TFloat32 radius, vector<TEntityUID>* UIDs )
+{
+	TFloat32 radiusSquared = radius * radius;
+
+	// A sphere covering more cells than there are buckets would visit buckets more than once, test every bucket
+	// once instead. Checked before finding the cells, whose coordinates may not fit in an integer for a huge radius
+	TFloat32 cellsAcross = 2.0f * radius * m_InvCellSize + 2.0f;
+	if (cellsAcross * cellsAcross * cellsAcross >= m_Buckets.size())
+	{
+		for (TUInt32 bucket = 0; bucket < m_Buckets.size(); ++bucket)
+		{
+			FindInBucket( bucket, 0, 0, 0, true, centre, radiusSquared, UIDs );
+		}
+		return;
+	}
+
+	TInt32 minX = CellCoord( centre.x - radius ), maxX = CellCoord( centre.x + radius );
+	TInt32 minY = CellCoord( centre.y - radius ), maxY = CellCoord( centre.y + radius );
+	TInt32 minZ = CellCoord( centre.z - radius ), maxZ = CellCoord( centre.z + radius );
+	for (TInt32 cellZ = minZ; cellZ <= maxZ; ++cellZ)
+	{
+		for (TInt32 cellY = minY; cellY <= maxY; ++cellY)
+		{
+			for (TInt32 cellX = minX; cellX <= maxX; ++cellX)
+			{
+				FindInBucket( CellBucket( cellX, cellY, cellZ ), cellX, cellY, cellZ, false, centre, radiusSquared,
+				              UIDs );
+			}
+		}
+	}
+}
+
+// Test the entries of a bucket against a sphere, only those in the given cell unless testing all cells
+void CEntityGrid::FindInBucket( TUInt32 bucket, TInt32 cellX, TInt32 cellY, TInt32 cellZ, bool allCells,
+                                const CVector3& centre, TFloat32 radiusSquared, vector<TEntityUID>* UIDs )
+{
+	const vector<SEntry>& entries = m_Buckets[bucket];
+	for (TUInt32 entry = 0; entry < entries.size(); ++entry)
+	{
+		const SEntry& candidate = entries[entry];
+		if (!allCells && (candidate.cellX != cellX || candidate.cellY != cellY || candidate.cellZ != cellZ)) continue;
+		if ((candidate.position - centre).LengthSquared() <= radiusSquared)
+		{
+			UIDs->push_back( candidate.UID );
+		}
+	}
+}
+
+
+} // namespace gen
@@ -0,0 +1,125 @@
+/*******************************************
+	EntityGrid.h
+
+	Uniform spatial hash grid of entity
+	positions for range queries
+********************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "Entity.h"
+
+namespace gen
+{
+
+// Space is divided into cubic cells of a fixed size, and each entity is kept in the cell holding its position. Cells
+// are not stored individually - each cell's coordinates are hashed to one of a fixed number of buckets, so the grid
+// covers unlimited space in fixed memory and only buckets holding entities use any. A bucket holds the entities of
+// every cell hashed to it, each entry keeps its cell coordinates so entities of other cells are skipped. Entities
+// are moved incrementally: an entity that stays in its cell only has its position updated, otherwise it is moved
+// from one bucket to another. A radius query visits only the cells overlapping the sphere's bounding box (or every
+// bucket once, if that is fewer). Queries only read the grid, so may run on several threads at once while it isn't
+// being changed
+class CEntityGrid
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	// Grid with cells of the given size, hashed into the given number of buckets (rounded up to a power of 2)
+	CEntityGrid( TFloat32 cellSize = 32.0f, TUInt32 numBuckets = 4096 );
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CEntityGrid( const CEntityGrid& );
+	CEntityGrid& operator=( const CEntityGrid& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	/////////////////////////////////////
+	// Entities
+
+	// Add an entity at the given position
+	void Insert( TEntityUID UID, const CVector3& position );
+
+	// Remove an entity
+	void Remove( TEntityUID UID );
+
+	// Update the position of an entity, moving it to another bucket only if it has left its cell
+	void Move( TEntityUID UID, const CVector3& position );
+
+	// Remove all entities
+	void Clear();
+
+
+	/////////////////////////////////////
+	// Queries
+
+	// Find the entities whose positions are within the given distance of a point, adding their UIDs to the vector
+	void FindInRadius( const CVector3& centre, TFloat32 radius, vector<TEntityUID>* UIDs );
+
+	// Number of entities in the grid
+	TUInt32 GetNumEntities()
+	{
+		return m_NumEntities;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// An entity in a bucket, with the coordinates of its cell and its position
+	struct SEntry
+	{
+		TEntityUID UID;
+		TInt32     cellX, cellY, cellZ;
+		CVector3   position;
+	};
+
+	// Bucket and index in the bucket of each entity, by UID slot index
+	struct SLocation
+	{
+		TUInt32 bucket;
+		TUInt32 index;
+	};
+	static const TUInt32 NoBucket = 0xffffffff;
+
+	// Cell coordinate of a position coordinate
+	TInt32 CellCoord( TFloat32 coord )
+	{
+		return static_cast<TInt32>(floorf( coord * m_InvCellSize ));
+	}
+
+	// Bucket holding a cell
+	TUInt32 CellBucket( TInt32 cellX, TInt32 cellY, TInt32 cellZ )
+	{
+		TUInt32 hash = (static_cast<TUInt32>(cellX) * 73856093u) ^ (static_cast<TUInt32>(cellY) * 19349663u) ^
+		               (static_cast<TUInt32>(cellZ) * 83492791u);
+		return hash & (static_cast<TUInt32>(m_Buckets.size()) - 1);
+	}
+
+	// Add an entry to the bucket of its cell
+	void AddEntry( const SEntry& entry );
+
+	// Test the entries of a bucket against a sphere, only those in the given cell unless testing all cells
+	void FindInBucket( TUInt32 bucket, TInt32 cellX, TInt32 cellY, TInt32 cellZ, bool allCells,
+	                   const CVector3& centre, TFloat32 radiusSquared, vector<TEntityUID>* UIDs );
+
+	// Reciprocal of the cell size
+	TFloat32 m_InvCellSize;
+
+	vector< vector<SEntry> > m_Buckets;
+	vector<SLocation>        m_Locations;
+	TUInt32                  m_NumEntities;
+};
+
+
+} // namespace gen
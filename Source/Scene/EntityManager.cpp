@@ -5,31 +5,69 @@
 	destruction
 ********************************************/
 
+#include <new>
+#include <algorithm>
+#include <functional>
+
 #include "EntityManager.h"
+#include "Messenger.h"
 
 namespace gen
 {
 
+// Rendering calls go to this device - a command list is recorded for it when rendering in parallel
+extern IRenderDevice* RenderDevice;
+
+// Messages for an entity are discarded when it is destroyed
+extern CMessenger Messenger;
+
+// Fewest entities worth updating or queuing in a separate job - smaller ranges cost more to hand out than they save
+const TUInt32 MinEntitiesPerJob = 256;
+
+// Fewest queued sub-meshes worth recording in a separate command list - smaller ranges cost more to hand out and replay
+// than they save
+const TUInt32 MinEntitiesPerCommandList = 256;
+
+// Most occluders drawn into the occlusion culling depth buffer each frame
+const TUInt32 MaxOccluders = 32;
+
+
 /////////////////////////////////////
 // Constructors/Destructors
 
-// Constructor reserves space for entities and UID hash map, also sets first UID
-CEntityManager::CEntityManager()
+// Constructor reserves space for entities and UID slots
+CEntityManager::CEntityManager() :
+	m_TemplatePool( sizeof(CEntityTemplate), 16 ),
+	m_EntityPool( sizeof(CEntity) ),
+	m_PlanetPool( sizeof(CPlanetEntity) )
 {
-	// Initialise list of entities and UID hash map
+	// Initialise list of entities and UID slot map
 	m_Entities.reserve( 1024 );
-	m_EntityUIDMap = new CHashTable<TEntityUID, TUInt32>( 2048, JOneAtATimeHash ); 
-
-	// Set first entity UID that will be used
-	m_NextUID = 0;
-
-	m_IsEnumerating = false;
+	m_Slots.reserve( 1024 );
+	m_FirstFreeSlot = NoSlot;
+	m_LastFreeSlot = NoSlot;
+	m_HierarchicalCulling = true;
+	m_OcclusionCulling = true;
+
+	// Render on the calling thread until given a job system
+	m_JobSystem = 0;
+	m_NumCommandListsUsed = 0;
+	m_NumCommandsRecorded = 0;
 }
 
 // Destructor removes all entities
 CEntityManager::~CEntityManager()
 {
 	DestroyAllEntities();
+
+	for (TUInt32 list = 0; list < m_CommandLists.size(); ++list)
+	{
+		delete m_CommandLists[list];
+	}
+	for (TUInt32 queue = 0; queue < m_ThreadQueues.size(); ++queue)
+	{
+		delete m_ThreadQueues[queue];
+	}
 }
 
 
@@ -46,7 +84,7 @@ CEntityTemplate* CEntityManager::CreateTemplate
 )
 {
 	// Create new entity template
-	CEntityTemplate* newTemplate = new CEntityTemplate( type, name, mesh );
+	CEntityTemplate* newTemplate = new (m_TemplatePool.Allocate()) CEntityTemplate( type, name, mesh );
 
 	// Add the template name / template pointer pair to the map
     m_Templates[name] = newTemplate;
@@ -54,6 +92,20 @@ CEntityTemplate* CEntityManager::CreateTemplate
 	return newTemplate;
 }
 
+// Create a base entity template with the given type and name using an already created mesh, the
+// template takes ownership of the mesh. Returns the new entity template pointer
+CEntityTemplate* CEntityManager::CreateTemplate
+(
+	const string& type,
+	const string& name,
+	CMesh*        mesh
+)
+{
+	CEntityTemplate* newTemplate = new (m_TemplatePool.Allocate()) CEntityTemplate( type, name, mesh );
+	m_Templates[name] = newTemplate;
+	return newTemplate;
+}
+
 // Destroy the given template (name) - returns true if the template existed and was destroyed
 bool CEntityManager::DestroyTemplate( const string& name )
 {
@@ -66,7 +118,8 @@ bool CEntityManager::DestroyTemplate( const string& name )
 	}
 
 	// Delete the template and remove the map entry
-	delete entityTemplate->second;
+	entityTemplate->second->~CEntityTemplate();
+	m_TemplatePool.Free( entityTemplate->second );
 	m_Templates.erase( entityTemplate );
 	return true;
 }
@@ -79,7 +132,8 @@ void CEntityManager::DestroyAllTemplates()
 		TTemplateIter entityTemplate = m_Templates.begin();
 		while (entityTemplate != m_Templates.end())
 		{
-			delete entityTemplate->second;
+			entityTemplate->second->~CEntityTemplate();
+			m_TemplatePool.Free( entityTemplate->second );
 			++entityTemplate;
 		};
 		m_Templates.clear();
@@ -104,20 +158,13 @@ TEntityUID CEntityManager::CreateEntity
 	// Get template associated with the template name
 	CEntityTemplate* entityTemplate = GetTemplate( templateName );
 
-	// Create new entity with next UID
-	CEntity* newEntity = new CEntity( entityTemplate, m_NextUID, name, position, rotation, scale );
-
-	// Get vector index for new entity and add it to vector
-	TUInt32 entityIndex = static_cast<TUInt32>(m_Entities.size());
-	m_Entities.push_back( newEntity );
-
-	// Add mapping from UID to entity index into hash map
-	m_EntityUIDMap->SetKeyValue( m_NextUID, entityIndex );
-	
-	m_IsEnumerating = false; // Cancel any entity enumeration (entity list has changed)
+	// Create new entity with a new UID and add it to the entity list
+	TEntityUID UID = NewUID();
+	if (UID == SystemUID) return SystemUID;
+	AddEntity( new (m_EntityPool.Allocate()) CEntity( entityTemplate, UID, &m_Transforms, name, position, rotation,
+	                                                  scale ), &m_EntityPool );
 
-	// Return UID of new entity then increase it ready for next entity
-	return m_NextUID++;
+	return UID;
 }
 
 // Create a planet, requires a planet template name, may supply entity name and position
@@ -135,48 +182,49 @@ TEntityUID CEntityManager::CreatePlanet
 	// Get planet template associated with the template name
 	CEntityTemplate* planetTemplate = GetTemplate( templateName );
 
-	// Create new planet entity with next UID
-	CPlanetEntity* newEntity =
-		new CPlanetEntity( planetTemplate, m_NextUID, name, spinSpeed, position, rotation, scale );
+	// Create new planet entity with a new UID and add it to the entity list
+	TEntityUID UID = NewUID();
+	if (UID == SystemUID) return SystemUID;
+	AddEntity( new (m_PlanetPool.Allocate()) CPlanetEntity( planetTemplate, UID, &m_Transforms, name, spinSpeed,
+	                                                        position, rotation, scale ), &m_PlanetPool );
 
-	// Get vector index for new entity and add it to vector
-	TUInt32 entityIndex = static_cast<int>(m_Entities.size());
-	m_Entities.push_back( newEntity );
-
-	// Add mapping from UID to entity index into hash map
-	m_EntityUIDMap->SetKeyValue( m_NextUID, entityIndex );
-	
-	m_IsEnumerating = false; // Cancel any entity enumeration (entity list has changed)
-
-	// Return UID of new entity then increase it ready for next entity
-	return m_NextUID++;
+	return UID;
 }
 
 // Destroy the given entity - returns true if the entity existed and was destroyed
 bool CEntityManager::DestroyEntity( TEntityUID UID )
 {
 	// Find the vector index of the given UID
-	TUInt32 entityIndex;
-	if (!m_EntityUIDMap->LookUpKey( UID, &entityIndex ))
+	if (!GetEntity( UID ))
 	{
 		// Quit if not found
 		return false;
 	}
+	TUInt32 entityIndex = m_Slots[EntityUIDIndex( UID )].entityIndex;
 
-	// Delete the given entity and remove from UID map
-	delete m_Entities[entityIndex];
-	m_EntityUIDMap->RemoveKey( UID );
+	// Delete the given entity, removing it from the indexes and culling hierarchy, and free its UID slot
+	RemoveFromIndexes( m_Entities[entityIndex] );
+	m_BVH.Remove( m_Slots[EntityUIDIndex( UID )].cullingLeaf );
+	m_Grid.Remove( UID );
+	DeleteEntity( m_Entities[entityIndex] );
+	FreeUID( UID );
 
 	// If not removing last entity...
 	if (entityIndex != m_Entities.size() - 1)
 	{
-		// ...put the last entity into the empty entity slot and update UID map
+		// ...put the last entity into the empty entity slot and update its UID slot
 		m_Entities[entityIndex] = m_Entities.back();
-		m_EntityUIDMap->SetKeyValue( m_Entities.back()->GetUID(), entityIndex );
+		m_Slots[EntityUIDIndex( m_Entities.back()->GetUID() )].entityIndex = entityIndex;
+		m_BoundsX[entityIndex] = m_BoundsX.back();
+		m_BoundsY[entityIndex] = m_BoundsY.back();
+		m_BoundsZ[entityIndex] = m_BoundsZ.back();
+		m_BoundsRadius[entityIndex] = m_BoundsRadius.back();
 	}
 	m_Entities.pop_back(); // Remove last entity
-
-	m_IsEnumerating = false; // Cancel any entity enumeration (entity list has changed)
+	m_BoundsX.pop_back();
+	m_BoundsY.pop_back();
+	m_BoundsZ.pop_back();
+	m_BoundsRadius.pop_back();
 	return true;
 }
 
@@ -184,50 +232,538 @@ bool CEntityManager::DestroyEntity( TEntityUID UID )
 // Destroy all entities held by the manager
 void CEntityManager::DestroyAllEntities()
 {
-	m_EntityUIDMap->RemoveAllKeys();
 	while (m_Entities.size())
 	{
-		delete m_Entities.back();
+		TEntityUID UID = m_Entities.back()->GetUID();
+		DeleteEntity( m_Entities.back() );
+		FreeUID( UID );
 		m_Entities.pop_back();
 	}
+	for (TUInt32 index = 0; index < NumEntityIndexes; ++index)
+	{
+		m_Indexes[index].clear();
+	}
+	m_BVH.Clear();
+	m_Grid.Clear();
+	m_BoundsX.clear();
+	m_BoundsY.clear();
+	m_BoundsZ.clear();
+	m_BoundsRadius.clear();
+}
+
 
-	m_IsEnumerating = false; // Cancel any entity enumeration (entity list has changed)
+/////////////////////////////////////
+// UID slots
+
+// Take a slot for a new entity, returning the entity's UID or SystemUID if all slots are used
+TEntityUID CEntityManager::NewUID()
+{
+	TUInt32 slot;
+	if (m_FirstFreeSlot != NoSlot)
+	{
+		slot = m_FirstFreeSlot;
+		m_FirstFreeSlot = m_Slots[slot].entityIndex;
+		if (m_FirstFreeSlot == NoSlot) m_LastFreeSlot = NoSlot;
+	}
+	else
+	{
+		// The highest index is not used so no UID can equal SystemUID
+		slot = static_cast<TUInt32>(m_Slots.size());
+		if (slot >= EntityUIDIndexMask) return SystemUID;
+		SEntitySlot newSlot = { 0, NoSlot, 0, CEntityBVH::NoNode };
+		m_Slots.push_back( newSlot );
+	}
+
+	// Keep the generation in the slot, replacing the invalid index of a free slot with the slot's own index
+	m_Slots[slot].UID = (m_Slots[slot].UID & ~EntityUIDIndexMask) | slot;
+	return m_Slots[slot].UID;
+}
+
+// Add a new entity, created with a UID from NewUID in memory from the given pool, to the entity list
+void CEntityManager::AddEntity( CEntity* entity, CPoolAllocator* pool )
+{
+	SEntitySlot& slot = m_Slots[EntityUIDIndex( entity->GetUID() )];
+	slot.entityIndex = static_cast<TUInt32>(m_Entities.size());
+	slot.pool = pool;
+	m_Entities.push_back( entity );
+	AddToIndexes( entity );
+
+	CVector3 centre;
+	TFloat32 radius;
+	entity->GetBoundingSphere( &centre, &radius );
+	slot.cullingLeaf = m_BVH.Insert( entity->GetUID(), centre, radius );
+	m_Grid.Insert( entity->GetUID(), centre );
+	m_BoundsX.push_back( centre.x );
+	m_BoundsY.push_back( centre.y );
+	m_BoundsZ.push_back( centre.z );
+	m_BoundsRadius.push_back( radius );
+}
+
+// Update the bounding sphere of the entity at the given index in the bounds arrays and culling hierarchy, and its
+// position in the grid
+void CEntityManager::UpdateEntityBounds( TUInt32 entityIndex )
+{
+	CEntity* entity = m_Entities[entityIndex];
+	CVector3 centre;
+	TFloat32 radius;
+	entity->GetBoundingSphere( &centre, &radius );
+	m_Grid.Move( entity->GetUID(), centre );
+
+	// The entity is rendered anywhere between its positions before and after the latest simulation step, so the
+	// sphere is widened to cover both
+	CVector3 movement = entity->GetPreviousPosition() - centre;
+	centre += movement * 0.5f;
+	radius += movement.Length() * 0.5f;
+
+	m_BoundsX[entityIndex] = centre.x;
+	m_BoundsY[entityIndex] = centre.y;
+	m_BoundsZ[entityIndex] = centre.z;
+	m_BoundsRadius[entityIndex] = radius;
+	m_BVH.Move( m_Slots[EntityUIDIndex( entity->GetUID() )].cullingLeaf, centre, radius );
+}
+
+// Remove the entities hidden behind occluders from the visible entities
+void CEntityManager::CullOccludedEntities( CCamera* camera )
+{
+	// Choose the visible occluders that are largest on screen (bounding radius over distance), a few large
+	// occluders hide most of what will be hidden and drawing more costs more than it saves
+	m_Occluders.clear();
+	CVector3 cameraPos = camera->Position();
+	for (TUInt32 entity = 0; entity < m_VisibleEntities.size(); ++entity)
+	{
+		TUInt32 entityIndex = m_Slots[EntityUIDIndex( m_VisibleEntities[entity] )].entityIndex;
+		CEntity* occluder = m_Entities[entityIndex];
+		if (occluder->Template()->IsOccluder())
+		{
+			CVector3 centre( m_BoundsX[entityIndex], m_BoundsY[entityIndex], m_BoundsZ[entityIndex] );
+			TFloat32 distance = Max( cameraPos.DistanceTo( centre ), camera->GetNearClip() );
+			m_Occluders.push_back( make_pair( m_BoundsRadius[entityIndex] / distance, occluder ) );
+		}
+	}
+	if (m_Occluders.size() > MaxOccluders)
+	{
+		nth_element( m_Occluders.begin(), m_Occluders.begin() + MaxOccluders, m_Occluders.end(),
+		             greater< pair<TFloat32, CEntity*> >() );
+		m_Occluders.resize( MaxOccluders );
+	}
+
+	m_OcclusionCuller.Begin( camera->GetViewProjMatrix() );
+	for (TUInt32 occluder = 0; occluder < m_Occluders.size(); ++occluder)
+	{
+		m_Occluders[occluder].second->RasterizeOccluder( &m_OcclusionCuller );
+	}
+	m_OcclusionCuller.End();
+
+	// Test the bounding sphere of every visible entity, keeping the visible ones in order. Occluders are tested too,
+	// their own depths can't hide them but other occluders can
+	TUInt32 numVisible = 0;
+	for (TUInt32 entity = 0; entity < m_VisibleEntities.size(); ++entity)
+	{
+		TEntityUID UID = m_VisibleEntities[entity];
+		TUInt32 entityIndex = m_Slots[EntityUIDIndex( UID )].entityIndex;
+		CVector3 centre( m_BoundsX[entityIndex], m_BoundsY[entityIndex], m_BoundsZ[entityIndex] );
+		if (m_OcclusionCuller.IsSphereVisible( centre, m_BoundsRadius[entityIndex] ))
+		{
+			m_VisibleEntities[numVisible++] = UID;
+		}
+	}
+	m_VisibleEntities.resize( numVisible );
+}
+
+// Destroy an entity and return its memory to the pool it came from, before its UID slot is freed
+void CEntityManager::DeleteEntity( CEntity* entity )
+{
+	CPoolAllocator* pool = m_Slots[EntityUIDIndex( entity->GetUID() )].pool;
+	Messenger.ReleaseMailbox( entity->GetUID() );
+	entity->~CEntity();
+	pool->Free( entity );
+}
+
+// Free the slot of an entity being destroyed, its UID becomes invalid
+void CEntityManager::FreeUID( TEntityUID UID )
+{
+	// Increase the generation (wrapping in the high bits) and give an invalid index until the slot is reused
+	TUInt32 slot = EntityUIDIndex( UID );
+	m_Slots[slot].UID = ((UID & ~EntityUIDIndexMask) + (1 << EntityUIDIndexBits)) | EntityUIDIndexMask;
+	m_Slots[slot].entityIndex = NoSlot;
+
+	// Add to the end of the free list
+	if (m_LastFreeSlot != NoSlot)
+	{
+		m_Slots[m_LastFreeSlot].entityIndex = slot;
+	}
+	else
+	{
+		m_FirstFreeSlot = slot;
+	}
+	m_LastFreeSlot = slot;
+}
+
+
+/////////////////////////////////////
+// Entity queries
+
+// Return the entity with the given name & optionally the given template name & template type
+CEntity* CEntityManager::GetEntity( const string& name, const string& templateName /*= ""*/,
+                                    const string& templateType /*= ""*/ )
+{
+	for (TEntityUID UID : FindEntitiesByName( name ))
+	{
+		CEntity* entity = GetEntity( UID );
+		if (EntityMatches( entity, "", templateName, templateType ))
+		{
+			return entity;
+		}
+	}
+	return 0;
+}
+
+// Return the UIDs of entities matching the given name, template name and template type. An empty string indicates
+// to match anything in this field. If more than one field is given, the shortest of their index entries is filtered
+// into the given vector, which the span then refers to
+SEntityUIDSpan CEntityManager::FindEntities( const string& name, const string& templateName,
+                                             const string& templateType, vector<TEntityUID>* results )
+{
+	const string* keys[NumEntityIndexes] = { &name, &templateName, &templateType };
+
+	// Find the shortest index entry of the fields given
+	TUInt32 numKeys = 0;
+	SEntityUIDSpan shortest = { 0, 0 };
+	for (TUInt32 index = 0; index < NumEntityIndexes; ++index)
+	{
+		if (keys[index]->length() == 0) continue;
+		SEntityUIDSpan span = FindInIndex( static_cast<EEntityIndex>(index), *keys[index] );
+		if (numKeys == 0 || span.size() < shortest.size()) shortest = span;
+		++numKeys;
+	}
+	if (numKeys == 1) return shortest;
+
+	// No fields given matches all entities, otherwise check the other fields of each entity in the shortest entry
+	results->clear();
+	if (numKeys == 0)
+	{
+		for (TUInt32 entity = 0; entity < m_Entities.size(); ++entity)
+		{
+			results->push_back( m_Entities[entity]->GetUID() );
+		}
+	}
+	else
+	{
+		for (TEntityUID UID : shortest)
+		{
+			if (EntityMatches( GetEntity( UID ), name, templateName, templateType ))
+			{
+				results->push_back( UID );
+			}
+		}
+	}
+	SEntityUIDSpan span = { 0, 0 };
+	if (!results->empty())
+	{
+		span.first = &(*results)[0];
+		span.last = span.first + results->size();
+	}
+	return span;
+}
+
+
+/////////////////////////////////////
+// Entity indexes
+
+// Key of an entity in one of the entity indexes
+const string& CEntityManager::GetIndexKey( CEntity* entity, EEntityIndex index )
+{
+	switch (index)
+	{
+		case IndexName:     return entity->GetName();
+		case IndexTemplate: return entity->Template()->GetName();
+		default:            return entity->Template()->GetType();
+	}
+}
+
+// Add an entity to all the entity indexes
+void CEntityManager::AddToIndexes( CEntity* entity )
+{
+	SEntitySlot& slot = m_Slots[EntityUIDIndex( entity->GetUID() )];
+	for (TUInt32 index = 0; index < NumEntityIndexes; ++index)
+	{
+		vector<TEntityUID>& UIDs = m_Indexes[index][GetIndexKey( entity, static_cast<EEntityIndex>(index) )];
+		slot.indexPositions[index] = static_cast<TUInt32>(UIDs.size());
+		UIDs.push_back( entity->GetUID() );
+	}
+}
+
+// Remove an entity from all the entity indexes
+void CEntityManager::RemoveFromIndexes( CEntity* entity )
+{
+	SEntitySlot& slot = m_Slots[EntityUIDIndex( entity->GetUID() )];
+	for (TUInt32 index = 0; index < NumEntityIndexes; ++index)
+	{
+		// Move the last UID with the same key into the entity's position
+		TEntityIndex::iterator entry = m_Indexes[index].find( GetIndexKey( entity, static_cast<EEntityIndex>(index) ) );
+		vector<TEntityUID>& UIDs = entry->second;
+		TUInt32 position = slot.indexPositions[index];
+		UIDs[position] = UIDs.back();
+		m_Slots[EntityUIDIndex( UIDs[position] )].indexPositions[index] = position;
+		UIDs.pop_back();
+		if (UIDs.empty())
+		{
+			m_Indexes[index].erase( entry );
+		}
+	}
+}
+
+// Return the UIDs with the given key in an entity index
+SEntityUIDSpan CEntityManager::FindInIndex( EEntityIndex index, const string& key )
+{
+	SEntityUIDSpan span = { 0, 0 };
+	TEntityIndex::iterator entry = m_Indexes[index].find( key );
+	if (entry != m_Indexes[index].end())
+	{
+		span.first = &entry->second[0];
+		span.last = span.first + entry->second.size();
+	}
+	return span;
+}
+
+// Return true if an entity matches the given name, template name and template type, empty strings match anything
+bool CEntityManager::EntityMatches( CEntity* entity, const string& name, const string& templateName,
+                                    const string& templateType )
+{
+	return (name.length() == 0 || entity->GetName() == name) &&
+	       (templateName.length() == 0 || entity->Template()->GetName() == templateName) &&
+	       (templateType.length() == 0 || entity->Template()->GetType() == templateType);
 }
 
 
 /////////////////////////////////////
 // Update / Rendering
 
-// Call all entity update functions. Pass the time since last update
+// Call all entity update functions for one simulation step, then update the matrices of entities that moved. Pass the
+// time of the step
 void CEntityManager::UpdateAllEntities( float updateTime )
 {
-	TUInt32 entity = 0;
-	while (entity < m_Entities.size())
+	// Keep the matrices from before the step, the renderer interpolates from them
+	m_Transforms.SaveMatrices();
+
+	// Update in parallel jobs, but only if there are enough entities to make it worthwhile
+	TUInt32 numEntities = static_cast<TUInt32>(m_Entities.size());
+	TUInt32 numJobs = 0;
+	if (m_JobSystem)
+	{
+		numJobs = Min( m_JobSystem->GetNumThreads(), numEntities / MinEntitiesPerJob );
+	}
+
+	if (numJobs <= 1)
+	{
+		for (TUInt32 entity = 0; entity < numEntities; ++entity)
+		{
+			// Update entity, if it returns false, then destroy it once all entities are updated
+			if (!m_Entities[entity]->Update( updateTime ))
+			{
+				m_DestroyedEntities.push_back( m_Entities[entity]->GetUID() );
+			}
+		}
+	}
+	else
 	{
-		// Update entity, if it returns false, then destroy it
-		if (!m_Entities[entity]->Update( updateTime ))
+		while (m_ThreadDestroyedEntities.size() < numJobs)
 		{
-			DestroyEntity(m_Entities[entity]->GetUID());
+			m_ThreadDestroyedEntities.push_back( vector<TEntityUID>() );
 		}
-		else
+
+		// Each job updates a contiguous range of entities. Entities only write their own data and matrices when
+		// updated, and the entity list cannot change until all jobs are done because destruction is deferred.
+		// Messages are sent straight to the recipients' mailboxes from any job
+		m_JobSystem->Run( numJobs, [&]( TUInt32 job )
+		{
+			vector<TEntityUID>& destroyed = m_ThreadDestroyedEntities[job];
+			destroyed.clear();
+			TUInt32 first = numEntities * job / numJobs;
+			TUInt32 last  = numEntities * (job + 1) / numJobs;
+			for (TUInt32 entity = first; entity < last; ++entity)
+			{
+				if (!m_Entities[entity]->Update( updateTime ))
+				{
+					destroyed.push_back( m_Entities[entity]->GetUID() );
+				}
+			}
+		} );
+
+		for (TUInt32 job = 0; job < numJobs; ++job)
 		{
-			++entity;
+			m_DestroyedEntities.insert( m_DestroyedEntities.end(), m_ThreadDestroyedEntities[job].begin(),
+			                            m_ThreadDestroyedEntities[job].end() );
 		}
 	}
+
+	// Update the matrices of all entities that have moved in one pass over the transform store
+	m_Transforms.UpdateMatrices();
 }
 
-// Render all entities from the given camera
-// May request to render either normal or post-processed materials in the entities (defaults to normal)
-void CEntityManager::RenderAllEntities( CCamera* camera, bool postProcess /*= false*/ )
+// Hand the results of the simulation steps since the last call to the renderer
+void CEntityManager::TakeSnapshot()
+{
+	// Destroy the entities that asked to be in one batch, by UID as destruction moves entities in the list. An entity
+	// may have asked in more than one step, only the first destroys it
+	for (TUInt32 entity = 0; entity < m_DestroyedEntities.size(); ++entity)
+	{
+		DestroyEntity( m_DestroyedEntities[entity] );
+	}
+	m_DestroyedEntities.clear();
+
+	// Copy the matrices, then update the bounds of entities that have moved, rebuilding the culling hierarchy if
+	// many entities have been added since it was built
+	m_Transforms.TakeSnapshot();
+	for (TUInt32 entity = 0; entity < m_Entities.size(); ++entity)
+	{
+		if (m_Entities[entity]->IsMoved())
+		{
+			UpdateEntityBounds( entity );
+		}
+	}
+	m_Transforms.ClearMoved();
+	if (m_BVH.NeedsRebuild())
+	{
+		m_BVH.Rebuild();
+	}
+}
+
+// Cull all entities against the given camera, interpolate their matrices and queue their visible sub-meshes, both
+// normal and post-processed, for this frame's rendering
+void CEntityManager::QueueVisibleEntities( CCamera* camera )
 {
-	TEntityIter entity = m_Entities.begin();
-	while (entity != m_Entities.end())
+	// Find the visible entities - they need no further culling
+	if (m_HierarchicalCulling)
+	{
+		m_BVH.FindVisible( camera, &m_VisibleEntities );
+	}
+	else
 	{
-		(*entity)->Render( camera, postProcess );
-		++entity;
+		// Test all bounding spheres in SIMD batches, then collect the entities whose bits are set
+		TUInt32 numEntities = static_cast<TUInt32>(m_Entities.size());
+		m_VisibleEntities.clear();
+		m_VisibleBits.resize( (numEntities + 31) / 32 );
+		if (numEntities > 0)
+		{
+			camera->SpheresInFrustum( &m_BoundsX[0], &m_BoundsY[0], &m_BoundsZ[0], &m_BoundsRadius[0], numEntities,
+			                          &m_VisibleBits[0] );
+		}
+		for (TUInt32 word = 0; word < m_VisibleBits.size(); ++word)
+		{
+			TUInt32 bits = m_VisibleBits[word];
+			for (TUInt32 entity = word * 32; bits != 0; ++entity, bits >>= 1)
+			{
+				if (bits & 1) m_VisibleEntities.push_back( m_Entities[entity]->GetUID() );
+			}
+		}
+	}
+
+	// Interpolate the matrices of the visible entities between the simulation steps in the snapshot
+	for (TUInt32 entity = 0; entity < m_VisibleEntities.size(); ++entity)
+	{
+		GetEntity( m_VisibleEntities[entity] )->InterpolateMatrices();
+	}
+
+	// Remove the entities hidden behind occluders
+	if (m_OcclusionCulling)
+	{
+		CullOccludedEntities( camera );
+	}
+
+	// Queue in parallel jobs, but only if there are enough entities to make it worthwhile
+	TUInt32 numEntities = static_cast<TUInt32>(m_VisibleEntities.size());
+	TUInt32 numJobs = 0;
+	if (m_JobSystem)
+	{
+		numJobs = Min( m_JobSystem->GetNumThreads(), numEntities / MinEntitiesPerJob );
+	}
+
+	m_RenderQueue.Clear( camera );
+	if (numJobs <= 1)
+	{
+		for (TUInt32 entity = 0; entity < numEntities; ++entity)
+		{
+			GetEntity( m_VisibleEntities[entity] )->AddToRenderQueue( &m_RenderQueue, camera, false );
+		}
 	}
+	else
+	{
+		while (m_ThreadQueues.size() < numJobs)
+		{
+			m_ThreadQueues.push_back( new CRenderQueue );
+		}
+
+		// Each job queues a contiguous range of the visible entities into its own queue. Entities only write their own matrices
+		// when queued, so ranges can be queued at the same time. The queues are joined in range order and sorted
+		// with a stable sort, so the result is the same as queuing on one thread
+		m_JobSystem->Run( numJobs, [&]( TUInt32 job )
+		{
+			TUInt32 first = numEntities * job / numJobs;
+			TUInt32 last  = numEntities * (job + 1) / numJobs;
+			CRenderQueue* queue = m_ThreadQueues[job];
+			queue->Clear( camera );
+			for (TUInt32 entity = first; entity < last; ++entity)
+			{
+				GetEntity( m_VisibleEntities[entity] )->AddToRenderQueue( queue, camera, false );
+			}
+		} );
+		for (TUInt32 job = 0; job < numJobs; ++job)
+		{
+			m_RenderQueue.Append( *m_ThreadQueues[job] );
+		}
+	}
+
+	// Normal sub-meshes sort before post-processed ones, the instance buffer is filled for both passes
+	m_RenderQueue.Sort();
+	m_RenderQueue.UploadInstances( RenderDevice );
 }
 
+// Render the entities queued by QueueVisibleEntities this frame
+// May request to render either normal or post-processed materials in the entities (defaults to normal)
+void CEntityManager::RenderAllEntities( bool postProcess /*= false*/ )
+{
+	TUInt32 first, last;
+	m_RenderQueue.GetPassRange( postProcess, &first, &last );
+
+	// Use one command list per thread, but only if there are enough sub-meshes in the pass to make it worthwhile
+	TUInt32 numItems = last - first;
+	TUInt32 numLists = 0;
+	if (m_JobSystem)
+	{
+		numLists = Min( m_JobSystem->GetNumThreads(), numItems / MinEntitiesPerCommandList );
+	}
+	if (numLists <= 1)
+	{
+		m_RenderQueue.Submit( RenderDevice, first, last );
+		m_NumCommandListsUsed = 0;
+		m_NumCommandsRecorded = 0;
+		return;
+	}
+
+	while (m_CommandLists.size() < numLists)
+	{
+		m_CommandLists.push_back( new CRenderCommandList );
+	}
+
+	// Each job records a contiguous range of the sorted queue into its own command list
+	m_JobSystem->Run( numLists, [&]( TUInt32 list )
+	{
+		CRenderCommandList* commandList = m_CommandLists[list];
+		commandList->Begin( RenderDevice );
+		m_RenderQueue.Submit( commandList, first + numItems * list / numLists, first + numItems * (list + 1) / numLists );
+	} );
+
+	// Replay in range order, giving the same calls in the same order as submitting on one thread (except that
+	// state is set in full at the start of each range)
+	m_NumCommandListsUsed = numLists;
+	m_NumCommandsRecorded = 0;
+	for (TUInt32 list = 0; list < numLists; ++list)
+	{
+		m_CommandLists[list]->Replay( RenderDevice );
+		m_NumCommandsRecorded += m_CommandLists[list]->GetNumCommands();
+	}
+}
 
 } // namespace gen
 
@@ -8,19 +8,46 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
 using namespace std;
 
 #include "Defines.h"
-#include "CHashTable.h"
 #include "Entity.h"
 #include "PlanetEntity.h"
 #include "Camera.h"
+#include "JobSystem.h"
+#include "PoolAllocator.h"
+#include "RenderCommandList.h"
+#include "RenderQueue.h"
+#include "TransformStore.h"
+#include "EntityBVH.h"
+#include "EntityGrid.h"
+#include "OcclusionCuller.h"
 
 namespace gen
 {
 
+/////////////////////////////////////
+//	Public types
+
+// A contiguous range of entity UIDs returned by a query, usable in a range-based for. Only valid until the next
+// entity is created or destroyed (or the vector given to the query is changed)
+struct SEntityUIDSpan
+{
+	const TEntityUID* first;
+	const TEntityUID* last;
+
+	const TEntityUID* begin() const { return first; }
+	const TEntityUID* end() const   { return last; }
+	TUInt32 size() const            { return static_cast<TUInt32>(last - first); }
+	bool empty() const              { return first == last; }
+};
+
+
 // The entity manager is responsible for creation, update, rendering and deletion of
-// entities. It also manages UIDs for entities using a hash table
+// entities. It also manages UIDs for entities using a slot map. Templates and entities are
+// allocated from pools, so creating and destroying entities does not use the heap once the
+// pools have grown to hold the entities alive at once
 class CEntityManager
 {
 /////////////////////////////////////
@@ -48,13 +75,22 @@ public:
 
 	// Create a base entity template with the given type, name and mesh. Returns the new entity
 	// template pointer
-	CEntityTemplate* CEntityManager::CreateTemplate
+	CEntityTemplate* CreateTemplate
 	(
 		const string& type,
 		const string& name,
 		const string& mesh
 	);
 
+	// Create a base entity template with the given type and name using an already created mesh, the
+	// template takes ownership of the mesh. Returns the new entity template pointer
+	CEntityTemplate* CreateTemplate
+	(
+		const string& type,
+		const string& name,
+		CMesh*        mesh
+	);
+
 	// Note: Planets use the base template class, don't need a custom function
 
 	// Destroy the given template (name) - returns true if the template existed and was destroyed
@@ -68,7 +104,7 @@ public:
 	// Entity creation / destruction
 
 	// Create a base class entity - requires a template name, may supply entity name and position
-	// Returns the UID of the new entity
+	// Returns the UID of the new entity, or SystemUID if there are already the maximum number of entities
 	TEntityUID CreateEntity
 	(
 		const string&    templateName,
@@ -79,7 +115,7 @@ public:
 	);
 
 	// Create a planet, requires a planet template name, may supply entity name and position
-	// Returns the UID of the new entity
+	// Returns the UID of the new entity, or SystemUID if there are already the maximum number of entities
 	TEntityUID CreatePlanet
 	(
 		const string&   templateName,
@@ -126,95 +162,145 @@ public:
 		return m_Entities[index];
 	}
 
-	// Return the entity with the given UID
+	// Return the entity with the given UID, 0 if the entity has been destroyed
 	CEntity* GetEntity( TEntityUID UID )
 	{
-		// Find the entity UID in the entity hash map
-		TUInt32 entityIndex;
-		if (!m_EntityUIDMap->LookUpKey( UID, &entityIndex ))
+		// The slot holds the UID of its current entity - a free slot or a newer entity in the slot gives a
+		// different UID
+		TUInt32 slot = EntityUIDIndex( UID );
+		if (slot >= m_Slots.size() || m_Slots[slot].UID != UID)
 		{
 			return 0;
 		}
-		return m_Entities[entityIndex];
+		return m_Entities[m_Slots[slot].entityIndex];
 	}
 
 	// Return the entity with the given name & optionally the given template name & template type
 	CEntity* GetEntity( const string& name, const string& templateName = "",
-	                    const string& templateType = "" )
+	                    const string& templateType = "" );
+
+
+	/////////////////////////////////////
+	// Entity queries
+
+	// Return the UIDs of all entities with the given name, template name or template type, looked up in an index
+	// kept up to date as entities are created and destroyed
+	SEntityUIDSpan FindEntitiesByName( const string& name )
 	{
-		TEntityIter entity = m_Entities.begin();
-		while (entity != m_Entities.end())
-		{
-			if ((*entity)->GetName() == name && 
-				(templateName.length() == 0 || (*entity)->Template()->GetName() == templateName) &&
-				(templateType.length() == 0 || (*entity)->Template()->GetType() == templateType))
-			{
-				return (*entity);
-			}
-			++entity;
-		}
-		return 0;
+		return FindInIndex( IndexName, name );
+	}
+	SEntityUIDSpan FindEntitiesByTemplate( const string& templateName )
+	{
+		return FindInIndex( IndexTemplate, templateName );
+	}
+	SEntityUIDSpan FindEntitiesByType( const string& templateType )
+	{
+		return FindInIndex( IndexType, templateType );
 	}
 
+	// Return the UIDs of entities matching the given name, template name and template type. An empty string
+	// indicates to match anything in this field. If more than one field is given, the shortest of their index
+	// entries is filtered into the given vector, which the span then refers to. Queries hold no state in the
+	// manager, so any number may be used at once
+	SEntityUIDSpan FindEntities( const string& name, const string& templateName, const string& templateType,
+	                             vector<TEntityUID>* results );
+
+
+	/////////////////////////////////////
+	// Update / Rendering
 
-	// Begin an enumeration of entities matching given name, template name and template type
-	// An empty string indicates to match anything in this field (would be nice to support
-	// wildcards, e.g. match name of "Ship*")
-	void BeginEnumEntities( const string& name, const string& templateName,
-	                        const string& templateType = "" )
+	// Call all entity update functions for one simulation step - not the ideal method, OK for this example
+	// Pass the time of the step. Updates the absolute matrices of the entities that moved, keeping those from before
+	// the step to interpolate from. Entities whose update returns false are destroyed by the next TakeSnapshot. With
+	// a job system, the entities are updated in parallel - updates must only write to their own entity and send
+	// messages through the messenger. May run on a simulation thread while the renderer uses the snapshot, but not
+	// at the same time as TakeSnapshot or while entities are created or destroyed
+	void UpdateAllEntities( float updateTime );
+
+	// Hand the results of the simulation steps since the last call to the renderer, with the simulation stopped:
+	// destroy the entities that asked to be, copy the matrices before and after the latest step into the snapshot
+	// and update the bounds of entities that have moved. Also call after creating entities, before rendering them
+	void TakeSnapshot();
+
+	// Set how far the renderer interpolates from the snapshot before the latest simulation step (0) to the one after
+	// it (1)
+	void SetInterpolation( TFloat32 interpolation )
 	{
-		m_IsEnumerating = true;
-		m_EnumEntity = m_Entities.begin();
-		m_EnumName = name;
-		m_EnumTemplateName = templateName;
-		m_EnumTemplateType = templateType;
+		m_Transforms.SetInterpolation( interpolation );
 	}
 
-	// Finish enumerating entities (see above)
-	void EndEnumEntities()
+	// Visibility pass, once per frame before rendering: find the entities visible from the given camera, interpolate
+	// their matrices and queue their sub-meshes, normal and post-processed, sorted by state. Only uses the snapshot,
+	// so may run while the simulation is updating. With a job system, the entities are queued in parallel
+	void QueueVisibleEntities( CCamera* camera );
+
+	// Grid of entity positions for range queries such as broadcast messages. Positions are those of the last
+	// snapshot, and the grid only changes in TakeSnapshot or when entities are created or destroyed, so it may be
+	// queried by entity updates on any thread
+	CEntityGrid* GetEntityGrid()
 	{
-		m_IsEnumerating = false;
+		return &m_Grid;
 	}
 
-	// Return next entity matching parameters passed to a previous call to BeginEnumEntities
-	// Returns 0 if BeginEnumEntities not called or no more matching entities
-	CEntity* EnumEntity()
+	// Choose how QueueVisibleEntities finds visible entities: with the bounding volume hierarchy (the default), or a
+	// flat pass testing the bounding spheres of all entities in SIMD batches
+	void SetHierarchicalCulling( bool hierarchical )
 	{
-		if (!m_IsEnumerating)
-		{
-			return 0;
-		}
+		m_HierarchicalCulling = hierarchical;
+	}
 
-		while (m_EnumEntity != m_Entities.end())
-		{
-			if ((m_EnumName.length() == 0 || (*m_EnumEntity)->GetName() == m_EnumName) && 
-				(m_EnumTemplateName.length() == 0 ||
-				 (*m_EnumEntity)->Template()->GetName() == m_EnumTemplateName) &&
-				(m_EnumTemplateType.length() == 0 ||
-				 (*m_EnumEntity)->Template()->GetType() == m_EnumTemplateType))
-			{
-				CEntity* foundEntity = *m_EnumEntity;
-				++m_EnumEntity;
-				return foundEntity;
-			}
-			++m_EnumEntity;
-		}
-		
-		m_IsEnumerating = false;
-		return 0;
+	// Number of entities found visible by the last call to QueueVisibleEntities, and the number of hierarchy nodes
+	// visited to find them (0 for the flat pass)
+	TUInt32 GetNumVisibleEntities()
+	{
+		return static_cast<TUInt32>(m_VisibleEntities.size());
+	}
+	TUInt32 GetNumCullingNodesVisited()
+	{
+		return m_HierarchicalCulling ? m_BVH.GetNumNodesVisited() : 0;
 	}
 
+	// Choose whether QueueVisibleEntities also removes entities hidden behind occluder entities (on by default), by
+	// drawing the largest visible occluders into a software depth buffer
+	void SetOcclusionCulling( bool occlusion )
+	{
+		m_OcclusionCulling = occlusion;
+	}
 
-	/////////////////////////////////////
-	// Update / Rendering
+	// Number of occluders drawn by the last call to QueueVisibleEntities, and the number of entities found hidden
+	// behind them (not included in the visible entities)
+	TUInt32 GetNumOccluders()
+	{
+		return m_OcclusionCulling ? static_cast<TUInt32>(m_Occluders.size()) : 0;
+	}
+	TUInt32 GetNumOccludedEntities()
+	{
+		return m_OcclusionCulling ? m_OcclusionCuller.GetNumHidden() : 0;
+	}
 
-	// Call all entity update functions - not the ideal method, OK for this example
-	// Pass the time since last update
-	void UpdateAllEntities( float updateTime );
+	// Render the entities queued this frame by QueueVisibleEntities - not the ideal method, OK for this example
+	// May request to render either normal or post-processed materials in the entities (defaults to normal), only
+	// the sub-meshes in that pass are touched. With a job system, the pass is split into contiguous ranges that
+	// are recorded into command lists in parallel, then the lists are replayed in range order on this thread, so
+	// the result is deterministic
+	void RenderAllEntities( bool postProcess = false );
 
-	// Render all entities from point of view of given camera - not the ideal method, OK for this example
-	// May request to render either normal or post-processed materials in the entities (defaults to normal)
-	void RenderAllEntities( CCamera* camera, bool postProcess = false );
+	// Set the job system used to update entities and record rendering in parallel, or 0 to use the calling thread only
+	void SetJobSystem( CJobSystem* jobSystem )
+	{
+		m_JobSystem = jobSystem;
+	}
+
+	// Number of command lists used by the last call to RenderAllEntities (0 if entities were rendered directly),
+	// and the total commands recorded into them
+	TUInt32 GetNumCommandListsUsed()
+	{
+		return m_NumCommandListsUsed;
+	}
+	TUInt32 GetNumCommandsRecorded()
+	{
+		return m_NumCommandsRecorded;
+	}
 
 		
 /////////////////////////////////////
@@ -224,6 +310,31 @@ private:
 	/////////////////////////////////////
 	// Types
 
+	// Entity indexes, mapping a name, template name or template type to the UIDs of the entities with it
+	enum EEntityIndex
+	{
+		IndexName,
+		IndexTemplate,
+		IndexType,
+		NumEntityIndexes
+	};
+	typedef unordered_map< string, vector<TEntityUID> > TEntityIndex;
+
+	// A slot in the UID slot map. A used slot holds the UID of its entity, the entity's index in the entity list, the
+	// pool the entity was allocated from, its leaf in the bounding volume hierarchy and its position in each entity
+	// index (so it can be removed without a search). A free slot holds the UID its next
+	// entity will have but with an invalid index (so no UID matches it), and the next free slot instead of an entity
+	// index
+	struct SEntitySlot
+	{
+		TEntityUID UID;
+		TUInt32         entityIndex;
+		CPoolAllocator* pool;
+		TUInt32         cullingLeaf;
+		TUInt32         indexPositions[NumEntityIndexes];
+	};
+	static const TUInt32 NoSlot = 0xffffffff;
+
 	// Entity templates are held in a map, define some types for convenience
 	typedef map<string, CEntityTemplate*> TTemplates;
 	typedef TTemplates::iterator TTemplateIter;
@@ -233,12 +344,52 @@ private:
 	typedef TEntities::iterator TEntityIter;
 
 
+	/////////////////////////////////////
+	// Entity UIDs / Indexes
+
+	// Take a slot for a new entity, returning the entity's UID or SystemUID if all slots are used
+	TEntityUID NewUID();
+
+	// Add a new entity, created with a UID from NewUID in memory from the given pool, to the entity list
+	void AddEntity( CEntity* entity, CPoolAllocator* pool );
+
+	// Destroy an entity and return its memory to the pool it came from, before its UID slot is freed
+	void DeleteEntity( CEntity* entity );
+
+	// Update the bounding sphere of the entity at the given index in the bounds arrays and culling hierarchy, and its
+	// position in the grid
+	void UpdateEntityBounds( TUInt32 entityIndex );
+
+	// Remove the entities hidden behind occluders from the visible entities
+	void CullOccludedEntities( CCamera* camera );
+
+	// Free the slot of an entity being destroyed, its UID becomes invalid
+	void FreeUID( TEntityUID UID );
+
+	// Key of an entity in one of the entity indexes
+	static const string& GetIndexKey( CEntity* entity, EEntityIndex index );
+
+	// Add an entity to, or remove it from, all the entity indexes
+	void AddToIndexes( CEntity* entity );
+	void RemoveFromIndexes( CEntity* entity );
+
+	// Return the UIDs with the given key in an entity index
+	SEntityUIDSpan FindInIndex( EEntityIndex index, const string& key );
+
+	// Return true if an entity matches the given name, template name and template type, empty strings match anything
+	static bool EntityMatches( CEntity* entity, const string& name, const string& templateName,
+	                           const string& templateType );
+
+
 	/////////////////////////////////////
 	// Template Data
 
 	// The map of template names / templates
 	TTemplates m_Templates;
 
+	// Memory for templates
+	CPoolAllocator m_TemplatePool;
+
 
 	/////////////////////////////////////
 	// Entity Data
@@ -248,21 +399,65 @@ private:
 	// fill its space
 	TEntities m_Entities;
 
-	// A mapping from UIDs to indexes into the above array
-	CHashTable<TEntityUID, TUInt32>* m_EntityUIDMap;
+	// A mapping from UIDs to indexes into the above array. UIDs index the slots directly. Freed slots are reused
+	// oldest first, so a slot's generation (and UID) repeats as rarely as possible
+	vector<SEntitySlot> m_Slots;
+	TUInt32             m_FirstFreeSlot;
+	TUInt32             m_LastFreeSlot;
 
-	// Entity IDs are provided using a single increasing integer
-	TEntityUID m_NextUID;
+	// Indexes of entities by name, template name and template type
+	TEntityIndex m_Indexes[NumEntityIndexes];
+
+	// Memory for entities, one pool for each entity class
+	CPoolAllocator m_EntityPool;
+	CPoolAllocator m_PlanetPool;
+
+	// Node matrices of all entities
+	CTransformStore m_Transforms;
+
+	// Bounding spheres of the entities, in the same order as the entity list, one array per component for batch
+	// culling
+	vector<TFloat32> m_BoundsX;
+	vector<TFloat32> m_BoundsY;
+	vector<TFloat32> m_BoundsZ;
+	vector<TFloat32> m_BoundsRadius;
+
+	// Bounding volume hierarchy of entity bounding spheres for culling, and the UIDs of the entities found visible
+	// this frame. The flat culling pass writes one visibility bit per entity
+	CEntityBVH         m_BVH;
+	bool               m_HierarchicalCulling;
+	vector<TEntityUID> m_VisibleEntities;
+	vector<TUInt32>    m_VisibleBits;
+
+	// Spatial hash grid of entity positions
+	CEntityGrid m_Grid;
+
+	// Software depth buffer for occlusion culling, and the occluders drawn into it this frame (largest on screen
+	// first) with their approximate sizes on screen
+	COcclusionCuller                   m_OcclusionCuller;
+	bool                               m_OcclusionCulling;
+	vector< pair<TFloat32, CEntity*> > m_Occluders;
 
 
 	/////////////////////////////////////
-	// Data for Entity Enumeration
+	// Parallel Update / Rendering Data
+
+	// Job system to update entities and record their rendering with, 0 to use the calling thread only
+	CJobSystem* m_JobSystem;
+
+	// UIDs of entities to destroy at the next snapshot, and those found by each update job
+	vector<TEntityUID>           m_DestroyedEntities;
+	vector< vector<TEntityUID> > m_ThreadDestroyedEntities;
+
+	// Render queue sorting the visible sub-meshes by state
+	CRenderQueue m_RenderQueue;
+
+	// One command list and render queue per job, kept between frames to reuse their memory
+	vector<CRenderCommandList*> m_CommandLists;
+	vector<CRenderQueue*>       m_ThreadQueues;
 
-	bool        m_IsEnumerating;
-	TEntityIter m_EnumEntity;
-	string      m_EnumName;
-	string      m_EnumTemplateName;
-	string      m_EnumTemplateType;
+	TUInt32 m_NumCommandListsUsed;
+	TUInt32 m_NumCommandsRecorded;
 };
 
 
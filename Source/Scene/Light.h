@@ -24,11 +24,11 @@ public:
 
 
 	// Getters
-	CVector3 GetPosition()
+	const CVector3& GetPosition()
 	{
 		return m_Position;
 	}
-	SColourRGBA GetColour()
+	const SColourRGBA& GetColour()
 	{
 		return m_Colour;
 	}
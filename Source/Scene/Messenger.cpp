@@ -15,16 +15,81 @@ namespace gen
 // Define a single messenger object for the program
 CMessenger Messenger;
 
+// Recipients found for a broadcast, one list per thread so broadcasts can be sent from several threads at once
+static thread_local vector<TEntityUID> BroadcastRecipients;
+
+
+/////////////////////////////////////
+// Constructors/Destructors
+
+// Default constructor
+CMessenger::CMessenger()
+{
+	m_Grid = 0;
+	for (TUInt32 page = 0; page < NumMailboxPages; ++page)
+	{
+		m_Pages[page].store( 0, memory_order_relaxed );
+	}
+}
+
+// Destructor frees the mailboxes
+CMessenger::~CMessenger()
+{
+	for (TUInt32 page = 0; page < NumMailboxPages; ++page)
+	{
+		TMailboxPointer* mailboxes = m_Pages[page].load( memory_order_relaxed );
+		if (!mailboxes) continue;
+		for (TUInt32 mailbox = 0; mailbox < MailboxPageSize; ++mailbox)
+		{
+			delete mailboxes[mailbox].load( memory_order_relaxed );
+		}
+		delete[] mailboxes;
+	}
+	for (TUInt32 mailbox = 0; mailbox < m_FreeMailboxes.size(); ++mailbox)
+	{
+		delete m_FreeMailboxes[mailbox];
+	}
+}
+
 
 /////////////////////////////////////
 // Message sending/receiving
 
-// Send the given message to a particular UID, does not check if the UID exists
-void CMessenger::SendMessage( TEntityUID to, const SMessage& msg )
+// Send the given message to a particular UID, does not check if the UID exists. Returns false if the UID's mailbox is
+// full
+bool CMessenger::SendMessage( TEntityUID to, const SMessage& msg )
 {
-	// Simply insert the UID/message pair into the message map. It will be inserted next
-	// to any other pairs with the same UID
-	m_Messages.insert( UIDMsgPair( to, msg ) );
+	SMailbox* mailbox = GetMailbox( to, true );
+
+	// Claim the next position by advancing the send position, if its cell has been emptied by the recipient. The cell
+	// sequence is the position when the cell is free for it, one more once it holds the message for it and a whole
+	// ring later once the recipient has fetched it
+	TUInt32 position = mailbox->sendPosition.load( memory_order_relaxed );
+	SMailboxCell* cell;
+	while (true)
+	{
+		cell = &mailbox->cells[position & (MailboxSize - 1)];
+		TInt32 free = static_cast<TInt32>(cell->sequence.load( memory_order_acquire ) - position);
+		if (free == 0)
+		{
+			// Another sender may take the position first, then the position is updated to the latest
+			if (mailbox->sendPosition.compare_exchange_weak( position, position + 1, memory_order_relaxed )) break;
+		}
+		else if (free < 0)
+		{
+			// The recipient hasn't fetched the message a whole ring ago - mailbox full
+			return false;
+		}
+		else
+		{
+			position = mailbox->sendPosition.load( memory_order_relaxed );
+		}
+	}
+
+	cell->to = to;
+	cell->msg = msg;
+	cell->sequence.store( position + 1, memory_order_release );
+	return true;
 }
 
 
@@ -32,22 +97,150 @@ void CMessenger::SendMessage( TEntityUID to, const SMessage& msg )
 // pointer. Returns false if there are no messages for this UID
 bool CMessenger::FetchMessage( TEntityUID to, SMessage* msg )
 {
-	// Find the first message for this UID in the message map
-	TMessageIter itMessage = m_Messages.find( to );
+	SMailbox* mailbox = GetMailbox( to, false );
+	if (!mailbox) return false;
+
+	while (true)
+	{
+		// The cell at the fetch position holds a message once a sender has finished writing it
+		TUInt32 position = mailbox->fetchPosition;
+		SMailboxCell& cell = mailbox->cells[position & (MailboxSize - 1)];
+		if (cell.sequence.load( memory_order_acquire ) != position + 1)
+		{
+			return false;
+		}
+
+		// Free the cell for the sender a whole ring later
+		bool current = (cell.to == to);
+		if (current) *msg = cell.msg;
+		cell.sequence.store( position + MailboxSize, memory_order_release );
+		mailbox->fetchPosition = position + 1;
+
+		// Messages sent to an earlier entity in the same slot are discarded
+		if (current) return true;
+	}
+}
 
-	// See if no messages for this UID
-	if (itMessage == m_Messages.end())
+// Discard the messages for the given UID and recycle its mailbox, call when its entity is destroyed
+void CMessenger::ReleaseMailbox( TEntityUID UID )
+{
+	TMailboxPointer* mailboxes = m_Pages[EntityUIDIndex( UID ) / MailboxPageSize].load( memory_order_acquire );
+	if (!mailboxes) return;
+	SMailbox* mailbox = mailboxes[EntityUIDIndex( UID ) % MailboxPageSize].exchange( 0, memory_order_acq_rel );
+	if (mailbox)
 	{
-		return false;
+		RecycleMailbox( mailbox );
 	}
+}
 
-	// Return message, then delete it
-	*msg = itMessage->second;
-	m_Messages.erase( itMessage );
 
-	return true;
+/////////////////////////////////////
+// Broadcasting
+
+// Send the given message to every entity within the given distance of a point, other than the sender (msg.from).
+// Returns the number of entities sent the message
+TUInt32 CMessenger::BroadcastMessage( const CVector3& centre, TFloat32 radius, const SMessage& msg )
+{
+	if (!m_Grid) return 0;
+
+	// Only the grid cells overlapping the radius are searched
+	BroadcastRecipients.clear();
+	m_Grid->FindInRadius( centre, radius, &BroadcastRecipients );
+
+	TUInt32 numSent = 0;
+	for (TUInt32 recipient = 0; recipient < BroadcastRecipients.size(); ++recipient)
+	{
+		TEntityUID to = BroadcastRecipients[recipient];
+		if (to != msg.from && SendMessage( to, msg ))
+		{
+			++numSent;
+		}
+	}
+	return numSent;
 }
 
 
+/////////////////////////////////////
+// Mailboxes
+
+// Return the mailbox for the slot of the given UID, creating it (and its page) if create is true
+CMessenger::SMailbox* CMessenger::GetMailbox( TEntityUID UID, bool create )
+{
+	// Several senders may create the same page or mailbox at once, the first to store theirs wins and the others give
+	// theirs up
+	atomic<TMailboxPointer*>& page = m_Pages[EntityUIDIndex( UID ) / MailboxPageSize];
+	TMailboxPointer* mailboxes = page.load( memory_order_acquire );
+	if (!mailboxes)
+	{
+		if (!create) return 0;
+		TMailboxPointer* newMailboxes = new TMailboxPointer[MailboxPageSize];
+		for (TUInt32 mailbox = 0; mailbox < MailboxPageSize; ++mailbox)
+		{
+			newMailboxes[mailbox].store( 0, memory_order_relaxed );
+		}
+		if (page.compare_exchange_strong( mailboxes, newMailboxes, memory_order_acq_rel ))
+		{
+			mailboxes = newMailboxes;
+		}
+		else
+		{
+			delete[] newMailboxes;
+		}
+	}
+
+	TMailboxPointer& pointer = mailboxes[EntityUIDIndex( UID ) % MailboxPageSize];
+	SMailbox* mailbox = pointer.load( memory_order_acquire );
+	if (!mailbox && create)
+	{
+		SMailbox* newMailbox = NewMailbox();
+		if (pointer.compare_exchange_strong( mailbox, newMailbox, memory_order_acq_rel ))
+		{
+			mailbox = newMailbox;
+		}
+		else
+		{
+			RecycleMailbox( newMailbox );
+		}
+	}
+	return mailbox;
+}
+
+// Set a mailbox's positions to the start and free all its cells
+void CMessenger::EmptyMailbox( SMailbox* mailbox )
+{
+	mailbox->sendPosition.store( 0, memory_order_relaxed );
+	mailbox->fetchPosition = 0;
+	for (TUInt32 cell = 0; cell < MailboxSize; ++cell)
+	{
+		mailbox->cells[cell].sequence.store( cell, memory_order_relaxed );
+	}
+}
+
+// Take an empty mailbox from the recycled ones or allocate a new one
+CMessenger::SMailbox* CMessenger::NewMailbox()
+{
+	{
+		lock_guard<mutex> lock( m_FreeMutex );
+		if (!m_FreeMailboxes.empty())
+		{
+			SMailbox* mailbox = m_FreeMailboxes.back();
+			m_FreeMailboxes.pop_back();
+			return mailbox;
+		}
+	}
+
+	SMailbox* mailbox = new SMailbox;
+	EmptyMailbox( mailbox );
+	return mailbox;
+}
+
+// Empty a mailbox and keep it for reuse
+void CMessenger::RecycleMailbox( SMailbox* mailbox )
+{
+	EmptyMailbox( mailbox );
+	lock_guard<mutex> lock( m_FreeMutex );
+	m_FreeMailboxes.push_back( mailbox );
+}
+
 
 } // namespace gen
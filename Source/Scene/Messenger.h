@@ -6,11 +6,14 @@
 
 #pragma once
 
-#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
 using namespace std;
 
 #include "Defines.h"
 #include "Entity.h"
+#include "EntityGrid.h"
 
 namespace gen
 {
@@ -33,6 +36,9 @@ enum EMessageType
 // This isn't enforced by the language - use of the union is up to the programmer
 struct SMessage
 {
+	// Default constructor leaves the message uninitialised, the sender fills in the fields used
+	SMessage() {}
+
 	// Need to provide copy constructor and assignment operator because this structure contains a union
 	// The compiler does not know which of the union contents are in use so it cannot provide default versions
 	SMessage(const SMessage& o)
@@ -52,7 +58,8 @@ struct SMessage
 	{
 		struct
 		{
-			CVector3 pt;
+			TFloat32 pt[3]; // Point as floats, not a CVector3 - members of a union can't have constructors (on all
+			                // compilers), use CVector3( pt ) and CVector3::Set( pt )
 			TFloat32 distPt;
 		};
 		struct
@@ -65,16 +72,23 @@ struct SMessage
 
 
 // Messenger class allows the sending and receipt of messages between entities - addressed
-// by UID
+// by UID. Each recipient has a mailbox, a fixed size ring buffer of messages created the
+// first time it is sent a message, and recycled when its entity is destroyed. Messages may
+// be sent from any number of threads at once without locking, while the recipient fetches
+// them on its own thread. Messages from one sender to one recipient arrive in the order
+// sent, messages from different threads sent at the same time arrive in any order. Messages
+// may also be broadcast to all entities in range of a point, found in a grid of entity
+// positions
 class CMessenger
 {
 /////////////////////////////////////
 //	Constructors/Destructors
 public:
 	// Default constructor
-	CMessenger() {}
+	CMessenger();
 
-	// No destructor needed
+	// Destructor frees the mailboxes
+	~CMessenger();
 
 private:
 	// Disallow use of copy constructor and assignment operator (private and not defined)
@@ -89,28 +103,91 @@ public:
 	/////////////////////////////////////
 	// Message sending/receiving
 
-	// Send the given message to a particular UID, does not check if the UID exists
-	void SendMessage( TEntityUID to, const SMessage& msg );
+	// Send the given message to a particular UID, does not check if the UID exists. May be called
+	// from any thread. Returns false if the UID's mailbox is full, the message is not sent
+	bool SendMessage( TEntityUID to, const SMessage& msg );
 
 	// Fetch the next available message for the given UID, returns the message through the given 
-	// pointer. Returns false if there are no messages for this UID
+	// pointer. Returns false if there are no messages for this UID. Only one thread may fetch a
+	// UID's messages at a time (normally the thread updating the recipient)
 	bool FetchMessage( TEntityUID to, SMessage* msg );
 
+	// Discard the messages for the given UID and recycle its mailbox, call when its entity is
+	// destroyed. No messages may be sent to or fetched for the UID's slot at the same time
+	void ReleaseMailbox( TEntityUID UID );
+
+
+	/////////////////////////////////////
+	// Broadcasting
+
+	// Set the grid of entity positions used to find the recipients of broadcasts
+	void SetEntityGrid( CEntityGrid* grid )
+	{
+		m_Grid = grid;
+	}
+
+	// Send the given message to every entity within the given distance of a point, other than
+	// the sender (msg.from). May be called from any thread while the grid isn't changing.
+	// Returns the number of entities sent the message (those with full mailboxes are missed)
+	TUInt32 BroadcastMessage( const CVector3& centre, TFloat32 radius, const SMessage& msg );
+
 
 /////////////////////////////////////
 //	Private interface
 private:
 
-	// A multimap has properties similar to a hash map - mapping a key to a value. Here we
-	// have the key as an entity UID and the value as a message for that UID. The stored
-	// key/value pairs in a multimap are sorted by key, which means all the messages for a
-	// particular UID are together. Key look-up is somewhat slower than for a hash map though
-	// Define some types to make usage easier
-	typedef multimap<TEntityUID, SMessage> TMessages;
-	typedef TMessages::iterator TMessageIter;
-    typedef pair<TEntityUID, SMessage> UIDMsgPair; // The type stored by the multimap
+	// Most messages waiting for one recipient, a power of 2
+	static const TUInt32 MailboxSize = 64;
+
+	// Mailboxes are found by the slot index of the recipient's UID, through pages of mailbox
+	// pointers created as needed, so the directory is small until many slots are in use
+	static const TUInt32 MailboxPageSize = 1024;
+	static const TUInt32 NumMailboxPages = (EntityUIDIndexMask + MailboxPageSize) / MailboxPageSize;
+
+	// A message in a mailbox with its full recipient UID. Each cell's sequence number says
+	// whether it is free for the sender at a given position, or holds the message for the
+	// recipient at that position
+	struct SMailboxCell
+	{
+		atomic<TUInt32> sequence;
+		TEntityUID      to;
+		SMessage        msg;
+	};
+
+	// Bounded ring buffer with many senders and one recipient. Senders claim positions by
+	// advancing the send position, the recipient owns the fetch position
+	struct SMailbox
+	{
+		atomic<TUInt32> sendPosition;
+		TUInt32         fetchPosition;
+		SMailboxCell    cells[MailboxSize];
+	};
+
+	typedef atomic<SMailbox*> TMailboxPointer;
+
+	// Return the mailbox for the slot of the given UID, creating it (and its page) if create is
+	// true, otherwise returning 0 if there is none
+	SMailbox* GetMailbox( TEntityUID UID, bool create );
+
+	// Set a mailbox's positions to the start and free all its cells
+	static void EmptyMailbox( SMailbox* mailbox );
+
+	// Take an empty mailbox from the recycled ones or allocate a new one
+	SMailbox* NewMailbox();
+
+	// Empty a mailbox and keep it for reuse
+	void RecycleMailbox( SMailbox* mailbox );
+
+	// Pages of mailboxes by UID slot index, each an array of MailboxPageSize pointers
+	atomic<TMailboxPointer*> m_Pages[NumMailboxPages];
+
+	// Entity positions for broadcasts
+	CEntityGrid* m_Grid;
 
-	TMessages m_Messages;
+	// Mailboxes recycled from destroyed entities. Mailboxes are only taken when an entity is
+	// first sent a message, so a lock is fine here
+	vector<SMailbox*> m_FreeMailboxes;
+	mutex             m_FreeMutex;
 };
 
 
@@ -0,0 +1,285 @@
+/*******************************************
+	OcclusionCuller.cpp
+
+	Software occlusion culling with a low
+	resolution CPU depth buffer
+********************************************/
+
+#include <algorithm>
+#include <xmmintrin.h> // SSE
+
+#include "OcclusionCuller.h"
+
+namespace gen
+{
+
+/////////////////////////////////////
+// Constructors/Destructors
+
+COcclusionCuller::COcclusionCuller( TUInt32 width /*= 256*/, TUInt32 height /*= 128*/ )
+{
+	m_TilesX = Max( (width + TileSize - 1) / TileSize, 1u );
+	m_TilesY = Max( (height + TileSize - 1) / TileSize, 1u );
+	m_Width = m_TilesX * TileSize;
+	m_Height = m_TilesY * TileSize;
+	m_Depths.resize( m_Width * m_Height, 0.0f );
+	m_TileDepths.resize( m_TilesX * m_TilesY, 0.0f );
+
+	m_ViewProj = CMatrix4x4::kIdentity;
+	m_NumTrianglesRasterized = 0;
+	m_NumTests = 0;
+	m_NumHidden = 0;
+}
+
+
+/////////////////////////////////////
+// Occluders
+
+// Start a new frame viewed with the given view-projection matrix (D3D conventions), clearing the depth buffer
+void COcclusionCuller::Begin( const CMatrix4x4& viewProj )
+{
+	m_ViewProj = viewProj;
+	m_Depths.assign( m_Depths.size(), 0.0f );
+	m_TileDepths.assign( m_TileDepths.size(), 0.0f );
+	m_NumTrianglesRasterized = 0;
+	m_NumTests = 0;
+	m_NumHidden = 0;
+}
+
+// Rasterize indexed triangles into the depth buffer. Each vertex starts with its position, vertices are the given
+// number of bytes apart
+void COcclusionCuller::RasterizeTriangles( const TUInt8* vertices, TUInt32 vertexSize, const TUInt16* indices,
+                                           TUInt32 numTriangles, const CMatrix4x4& worldMatrix )
+{
+	CMatrix4x4 m = worldMatrix * m_ViewProj;
+
+	// Transform each triangle's vertices to clip space. Vertices shared between triangles are transformed again,
+	// occluders are simple meshes and this avoids a per-mesh transformed vertex array
+	for (TUInt32 triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		SClipVertex clip[3];
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			const CVector3& p = *reinterpret_cast<const CVector3*>(vertices + indices[triangle * 3 + corner] * vertexSize);
+			clip[corner].x = p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30;
+			clip[corner].y = p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31;
+			clip[corner].z = p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32;
+			clip[corner].w = p.x * m.e03 + p.y * m.e13 + p.z * m.e23 + m.e33;
+		}
+
+		// Reject triangles entirely outside one of the side planes, or behind the near plane
+		if ((clip[0].x >  clip[0].w && clip[1].x >  clip[1].w && clip[2].x >  clip[2].w) ||
+		    (clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+		    (clip[0].y >  clip[0].w && clip[1].y >  clip[1].w && clip[2].y >  clip[2].w) ||
+		    (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w) ||
+		    (clip[0].z < 0.0f && clip[1].z < 0.0f && clip[2].z < 0.0f))
+		{
+			continue;
+		}
+		ClipTriangle( &clip[0], &clip[1], &clip[2] );
+	}
+}
+
+// Clip a triangle to the near plane (z >= 0) and rasterize the one or two triangles that remain
+void COcclusionCuller::ClipTriangle( const SClipVertex* v0, const SClipVertex* v1, const SClipVertex* v2 )
+{
+	if (v0->z >= 0.0f && v1->z >= 0.0f && v2->z >= 0.0f)
+	{
+		RasterizeTriangle( *v0, *v1, *v2 );
+		return;
+	}
+
+	// Walk around the triangle keeping the vertices in front of the plane and adding a vertex where an edge crosses
+	// it, giving a polygon of three or four vertices
+	const SClipVertex* in[3] = { v0, v1, v2 };
+	SClipVertex out[4];
+	TUInt32 numOut = 0;
+	for (TUInt32 i = 0; i < 3; ++i)
+	{
+		const SClipVertex& a = *in[i];
+		const SClipVertex& b = *in[(i + 1) % 3];
+		if (a.z >= 0.0f)
+		{
+			out[numOut++] = a;
+		}
+		if ((a.z >= 0.0f) != (b.z >= 0.0f))
+		{
+			TFloat32 t = a.z / (a.z - b.z);
+			SClipVertex& v = out[numOut++];
+			v.x = a.x + (b.x - a.x) * t;
+			v.y = a.y + (b.y - a.y) * t;
+			v.z = 0.0f;
+			v.w = a.w + (b.w - a.w) * t;
+		}
+	}
+	for (TUInt32 i = 2; i < numOut; ++i)
+	{
+		RasterizeTriangle( out[0], out[i - 1], out[i] );
+	}
+}
+
+// Rasterize a triangle in front of the near plane
+void COcclusionCuller::RasterizeTriangle( const SClipVertex& v0, const SClipVertex& v1, const SClipVertex& v2 )
+{
+	// Screen position and 1/w of each vertex
+	const SClipVertex* v[3] = { &v0, &v1, &v2 };
+	TFloat32 x[3], y[3], invW[3];
+	for (TUInt32 i = 0; i < 3; ++i)
+	{
+		if (v[i]->w <= 0.0f) return; // Only if the projection has no near plane
+		invW[i] = 1.0f / v[i]->w;
+		x[i] = (v[i]->x * invW[i] * 0.5f + 0.5f) * m_Width;
+		y[i] = (0.5f - v[i]->y * invW[i] * 0.5f) * m_Height;
+	}
+
+	// Make the triangle wind the same way whichever way it faced, so the inside is where all edge functions are
+	// positive. Skip triangles with no area
+	TFloat32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area < 0.0f)
+	{
+		swap( x[1], x[2] );
+		swap( y[1], y[2] );
+		swap( invW[1], invW[2] );
+		area = -area;
+	}
+	if (area < 1e-6f) return;
+
+	// Bounding rectangle of the triangle on screen, starting on a group of 4 pixels
+	TFloat32 minX = Min( x[0], Min( x[1], x[2] ) );
+	TFloat32 maxX = Max( x[0], Max( x[1], x[2] ) );
+	TFloat32 minY = Min( y[0], Min( y[1], y[2] ) );
+	TFloat32 maxY = Max( y[0], Max( y[1], y[2] ) );
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height) return;
+	TUInt32 firstX = static_cast<TUInt32>(Max( minX, 0.0f )) & ~3u;
+	TUInt32 lastX  = static_cast<TUInt32>(Min( maxX, m_Width - 1.0f ));
+	TUInt32 firstY = static_cast<TUInt32>(Max( minY, 0.0f ));
+	TUInt32 lastY  = static_cast<TUInt32>(Min( maxY, m_Height - 1.0f ));
+	++m_NumTrianglesRasterized;
+
+	// Edge function for the edge opposite each vertex, a*x + b*y + c, and the plane of 1/w across the triangle
+	// (barycentric coordinates are the edge functions divided by the area)
+	TFloat32 a[3], b[3], c[3];
+	TFloat32 depthA = 0.0f, depthB = 0.0f, depthC = 0.0f;
+	TFloat32 invArea = 1.0f / area;
+	for (TUInt32 i = 0; i < 3; ++i)
+	{
+		TUInt32 i1 = (i + 1) % 3;
+		TUInt32 i2 = (i + 2) % 3;
+		a[i] = y[i1] - y[i2];
+		b[i] = x[i2] - x[i1];
+		c[i] = -(a[i] * x[i1] + b[i] * y[i1]);
+		depthA += a[i] * invW[i] * invArea;
+		depthB += b[i] * invW[i] * invArea;
+		depthC += c[i] * invW[i] * invArea;
+	}
+
+	// Four pixels at a time, testing the pixel centres. Covered pixels keep the nearest depth (largest 1/w)
+	__m128 zero = _mm_setzero_ps();
+	__m128 edgeA0 = _mm_set1_ps( a[0] ), edgeA1 = _mm_set1_ps( a[1] ), edgeA2 = _mm_set1_ps( a[2] );
+	__m128 planeA = _mm_set1_ps( depthA );
+	for (TUInt32 row = firstY; row <= lastY; ++row)
+	{
+		TFloat32 py = row + 0.5f;
+		__m128 edgeRow0 = _mm_set1_ps( b[0] * py + c[0] );
+		__m128 edgeRow1 = _mm_set1_ps( b[1] * py + c[1] );
+		__m128 edgeRow2 = _mm_set1_ps( b[2] * py + c[2] );
+		__m128 planeRow = _mm_set1_ps( depthB * py + depthC );
+		TFloat32* depths = &m_Depths[row * m_Width];
+		for (TUInt32 column = firstX; column <= lastX; column += 4)
+		{
+			__m128 px = _mm_add_ps( _mm_set1_ps( static_cast<TFloat32>(column) ), _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f ) );
+			__m128 edge0 = _mm_add_ps( _mm_mul_ps( edgeA0, px ), edgeRow0 );
+			__m128 edge1 = _mm_add_ps( _mm_mul_ps( edgeA1, px ), edgeRow1 );
+			__m128 edge2 = _mm_add_ps( _mm_mul_ps( edgeA2, px ), edgeRow2 );
+			__m128 covered = _mm_and_ps( _mm_cmpge_ps( edge0, zero ),
+			                             _mm_and_ps( _mm_cmpge_ps( edge1, zero ), _mm_cmpge_ps( edge2, zero ) ) );
+			if (_mm_movemask_ps( covered ) == 0) continue;
+
+			__m128 depth = _mm_add_ps( _mm_mul_ps( planeA, px ), planeRow );
+			__m128 current = _mm_loadu_ps( depths + column );
+			__m128 nearest = _mm_max_ps( current, depth );
+			_mm_storeu_ps( depths + column, _mm_or_ps( _mm_and_ps( covered, nearest ), _mm_andnot_ps( covered, current ) ) );
+		}
+	}
+}
+
+// Finish rasterizing occluders, reducing the depth buffer to the farthest depth (smallest 1/w) in each tile
+void COcclusionCuller::End()
+{
+	for (TUInt32 tileY = 0; tileY < m_TilesY; ++tileY)
+	{
+		for (TUInt32 tileX = 0; tileX < m_TilesX; ++tileX)
+		{
+			const TFloat32* depths = &m_Depths[tileY * TileSize * m_Width + tileX * TileSize];
+			__m128 farthest = _mm_loadu_ps( depths );
+			for (TUInt32 row = 0; row < TileSize; ++row, depths += m_Width)
+			{
+				for (TUInt32 column = 0; column < TileSize; column += 4)
+				{
+					farthest = _mm_min_ps( farthest, _mm_loadu_ps( depths + column ) );
+				}
+			}
+			farthest = _mm_min_ps( farthest, _mm_movehl_ps( farthest, farthest ) );
+			farthest = _mm_min_ss( farthest, _mm_shuffle_ps( farthest, farthest, 1 ) );
+			m_TileDepths[tileY * m_TilesX + tileX] = _mm_cvtss_f32( farthest );
+		}
+	}
+}
+
+
+/////////////////////////////////////
+// Tests
+
+// Return false if a world space axis-aligned bounding box is entirely hidden by the occluders
+bool COcclusionCuller::IsVisible( const CVector3& boxMin, const CVector3& boxMax )
+{
+	++m_NumTests;
+
+	// Project the corners of the box to find its rectangle on screen and its nearest depth. Boxes crossing the near
+	// plane are visible
+	TFloat32 minX = static_cast<TFloat32>(m_Width), maxX = 0.0f;
+	TFloat32 minY = static_cast<TFloat32>(m_Height), maxY = 0.0f;
+	TFloat32 minW = 0.0f;
+	const CMatrix4x4& m = m_ViewProj;
+	for (TUInt32 corner = 0; corner < 8; ++corner)
+	{
+		CVector3 p( (corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+		            (corner & 4) ? boxMax.z : boxMin.z );
+		TFloat32 z = p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32;
+		TFloat32 w = p.x * m.e03 + p.y * m.e13 + p.z * m.e23 + m.e33;
+		if (z < 0.0f || w <= 0.0f) return true;
+
+		TFloat32 invW = 1.0f / w;
+		TFloat32 x = ((p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30) * invW * 0.5f + 0.5f) * m_Width;
+		TFloat32 y = (0.5f - (p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31) * invW * 0.5f) * m_Height;
+		minX = Min( minX, x );
+		maxX = Max( maxX, x );
+		minY = Min( minY, y );
+		maxY = Max( maxY, y );
+		minW = (corner == 0) ? w : Min( minW, w );
+	}
+
+	// Boxes off the screen are left to frustum culling
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height) return true;
+
+	// Hidden if the nearest point of the box is behind the farthest occluder in every tile the rectangle touches
+	TFloat32 nearest = 1.0f / minW;
+	TUInt32 firstTileX = static_cast<TUInt32>(Max( minX, 0.0f )) / TileSize;
+	TUInt32 lastTileX  = static_cast<TUInt32>(Min( maxX, m_Width - 1.0f )) / TileSize;
+	TUInt32 firstTileY = static_cast<TUInt32>(Max( minY, 0.0f )) / TileSize;
+	TUInt32 lastTileY  = static_cast<TUInt32>(Min( maxY, m_Height - 1.0f )) / TileSize;
+	for (TUInt32 tileY = firstTileY; tileY <= lastTileY; ++tileY)
+	{
+		const TFloat32* tileDepths = &m_TileDepths[tileY * m_TilesX];
+		for (TUInt32 tileX = firstTileX; tileX <= lastTileX; ++tileX)
+		{
+			if (nearest >= tileDepths[tileX]) return true;
+		}
+	}
+
+	++m_NumHidden;
+	return false;
+}
+
+
+} // namespace gen
@@ -0,0 +1,146 @@
+/*******************************************
+	OcclusionCuller.h
+
+	Software occlusion culling with a low
+	resolution CPU depth buffer
+********************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+
+namespace gen
+{
+
+// A few large occluders (e.g. garages, walls) are rasterized each frame into a small depth buffer on the CPU, then
+// the bounds of other objects are tested against it, so objects hidden behind the occluders need not be submitted.
+// Triangles are rasterized four pixels at a time with SSE2: the edge functions give a coverage mask for the four
+// pixels, and depth is written only to the covered pixels. The buffer holds 1/w (reciprocal view depth), which is
+// linear in screen space and larger for nearer surfaces, cleared to 0 (infinitely far). After rasterizing, the
+// buffer is reduced to the farthest depth in each tile of pixels, and a bounding box is hidden if its nearest point
+// is behind the farthest occluder depth in every tile it covers. The test is conservative - a box that may be
+// visible is never reported hidden (apart from the approximation of rasterizing at low resolution). Does not depend
+// on D3D, so can be used and benchmarked on any platform (see the OcclusionBench tool)
+class COcclusionCuller
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	// Size of the depth buffer in pixels, the width is rounded up to a multiple of 4 and both are rounded up to a
+	// whole number of tiles
+	COcclusionCuller( TUInt32 width = 256, TUInt32 height = 128 );
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	COcclusionCuller( const COcclusionCuller& );
+	COcclusionCuller& operator=( const COcclusionCuller& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	/////////////////////////////////////
+	// Occluders
+
+	// Start a new frame viewed with the given view-projection matrix (D3D conventions), clearing the depth buffer
+	void Begin( const CMatrix4x4& viewProj );
+
+	// Rasterize indexed triangles into the depth buffer. Each vertex starts with its position, vertices are the given
+	// number of bytes apart. Triangles are rasterized whichever way they face and are clipped to the near plane
+	void RasterizeTriangles( const TUInt8* vertices, TUInt32 vertexSize, const TUInt16* indices, TUInt32 numTriangles,
+	                         const CMatrix4x4& worldMatrix );
+
+	// Finish rasterizing occluders, preparing the buffer for tests
+	void End();
+
+
+	/////////////////////////////////////
+	// Tests
+
+	// Return false if a world space axis-aligned bounding box is entirely hidden by the occluders
+	bool IsVisible( const CVector3& boxMin, const CVector3& boxMax );
+
+	// Return false if a bounding sphere is entirely hidden by the occluders (tests the box around it)
+	bool IsSphereVisible( const CVector3& centre, TFloat32 radius )
+	{
+		CVector3 extent( radius, radius, radius );
+		return IsVisible( centre - extent, centre + extent );
+	}
+
+
+	/////////////////////////////////////
+	// Getters
+
+	TUInt32 GetWidth()
+	{
+		return m_Width;
+	}
+	TUInt32 GetHeight()
+	{
+		return m_Height;
+	}
+
+	// Depth buffer (1/w of the nearest occluder, 0 where there is none), a row of pixels at a time
+	const TFloat32* GetDepths()
+	{
+		return &m_Depths[0];
+	}
+
+	// Triangles rasterized (after near clipping) since Begin, and the tests and hidden boxes since Begin
+	TUInt32 GetNumTrianglesRasterized()
+	{
+		return m_NumTrianglesRasterized;
+	}
+	TUInt32 GetNumTests()
+	{
+		return m_NumTests;
+	}
+	TUInt32 GetNumHidden()
+	{
+		return m_NumHidden;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Size of the tiles that the depth buffer is reduced to for tests, in pixels
+	static const TUInt32 TileSize = 8;
+
+	// Clip space vertex, x, y, z and w
+	struct SClipVertex
+	{
+		TFloat32 x, y, z, w;
+	};
+
+	// Clip a triangle to the near plane (z >= 0) and rasterize the one or two triangles that remain
+	void ClipTriangle( const SClipVertex* v0, const SClipVertex* v1, const SClipVertex* v2 );
+
+	// Rasterize a triangle in front of the near plane
+	void RasterizeTriangle( const SClipVertex& v0, const SClipVertex& v1, const SClipVertex& v2 );
+
+	TUInt32 m_Width;
+	TUInt32 m_Height;
+	TUInt32 m_TilesX;
+	TUInt32 m_TilesY;
+
+	// Depth buffer and the farthest depth in each tile, both as 1/w
+	vector<TFloat32> m_Depths;
+	vector<TFloat32> m_TileDepths;
+
+	CMatrix4x4 m_ViewProj;
+
+	TUInt32 m_NumTrianglesRasterized;
+	TUInt32 m_NumTests;
+	TUInt32 m_NumHidden;
+};
+
+
+} // namespace gen
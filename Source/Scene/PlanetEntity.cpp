@@ -18,12 +18,13 @@ CPlanetEntity::CPlanetEntity
 (
 	CEntityTemplate* planetTemplate,
 	TEntityUID       UID,
+	CTransformStore* transforms,
 	const string&    name /*= ""*/,
 	TFloat32         spinSpeed /*= kfPi*/,
 	const CVector3&  position /*= CVector3::kOrigin*/, 
 	const CVector3&  rotation /*= CVector3( 0.0f, 0.0f, 0.0f )*/,
 	const CVector3&  scale /*= CVector3( 1.0f, 1.0f, 1.0f )*/
-) : CEntity( planetTemplate, UID, name, position, rotation, scale )
+) : CEntity( planetTemplate, UID, transforms, name, position, rotation, scale )
 {
 	m_SpinSpeed = spinSpeed;
 }
@@ -39,6 +39,7 @@ public:
 	(
 		CEntityTemplate* planetTemplate,
 		TEntityUID       UID,
+		CTransformStore* transforms,
 		const string&    name = "",
 		TFloat32         spinSpeed = kfPi,
 		const CVector3&  position = CVector3::kOrigin, 
@@ -0,0 +1,277 @@
+/*******************************************
+	TransformStore.cpp
+
+	Contiguous storage of the node matrices
+	of all entities
+********************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "CQuatTransform.h"
+#include "TransformStore.h"
+
+namespace gen
+{
+
+/////////////////////////////////////
+// Constructors/Destructors
+
+CTransformStore::CTransformStore()
+{
+	m_RelMatrices = 0;
+	m_Matrices = 0;
+	m_Parents = 0;
+	m_Dirty = 0;
+	m_Moved = 0;
+	m_RelMatricesMemory = 0;
+	m_MatricesMemory = 0;
+
+	m_PrevMatrices = 0;
+	m_SnapshotMatrices = 0;
+	m_SnapshotPrevMatrices = 0;
+	m_RenderMatrices = 0;
+	m_PrevMatricesMemory = 0;
+	m_SnapshotMatricesMemory = 0;
+	m_SnapshotPrevMatricesMemory = 0;
+	m_RenderMatricesMemory = 0;
+
+	m_NumSlots = 0;
+	m_Capacity = 0;
+	m_NumUpdated = 0;
+
+	m_Stepped = false;
+	m_Interpolation = 1.0f;
+}
+
+CTransformStore::~CTransformStore()
+{
+	delete[] m_RelMatricesMemory;
+	delete[] m_MatricesMemory;
+	delete[] m_PrevMatricesMemory;
+	delete[] m_SnapshotMatricesMemory;
+	delete[] m_SnapshotPrevMatricesMemory;
+	delete[] m_RenderMatricesMemory;
+	delete[] m_Parents;
+	delete[] m_Dirty;
+	delete[] m_Moved;
+}
+
+
+/////////////////////////////////////
+// Allocation
+
+// Allocate an aligned matrix array, returning the aligned pointer and the block to delete in memory
+CMatrix4x4* CTransformStore::NewMatrices( TUInt32 numMatrices, TUInt8** memory )
+{
+	*memory = new TUInt8[numMatrices * sizeof(CMatrix4x4) + MatrixAlignment];
+	size_t address = reinterpret_cast<size_t>(*memory);
+	address = (address + MatrixAlignment - 1) & ~static_cast<size_t>(MatrixAlignment - 1);
+	return reinterpret_cast<CMatrix4x4*>(address);
+}
+
+// Replace a matrix array and its memory with a larger one holding the same matrices for the slots in use
+void CTransformStore::ResizeMatrices( CMatrix4x4** matrices, TUInt8** memory, TUInt32 capacity )
+{
+	TUInt8* newMemory;
+	CMatrix4x4* newMatrices = NewMatrices( capacity, &newMemory );
+	if (m_NumSlots > 0)
+	{
+		memcpy( static_cast<void*>(newMatrices), *matrices, m_NumSlots * sizeof(CMatrix4x4) );
+	}
+	delete[] *memory;
+	*matrices = newMatrices;
+	*memory = newMemory;
+}
+
+// Make room for at least the given number of slots
+void CTransformStore::Reserve( TUInt32 numSlots )
+{
+	if (numSlots <= m_Capacity) return;
+	TUInt32 capacity = Max( numSlots, m_Capacity * 2 );
+
+	ResizeMatrices( &m_RelMatrices, &m_RelMatricesMemory, capacity );
+	ResizeMatrices( &m_Matrices, &m_MatricesMemory, capacity );
+	ResizeMatrices( &m_PrevMatrices, &m_PrevMatricesMemory, capacity );
+	ResizeMatrices( &m_SnapshotMatrices, &m_SnapshotMatricesMemory, capacity );
+	ResizeMatrices( &m_SnapshotPrevMatrices, &m_SnapshotPrevMatricesMemory, capacity );
+	ResizeMatrices( &m_RenderMatrices, &m_RenderMatricesMemory, capacity );
+
+	TUInt32* parents = new TUInt32[capacity];
+	TUInt8* dirty = new TUInt8[capacity];
+	TUInt8* moved = new TUInt8[capacity];
+	if (m_NumSlots > 0)
+	{
+		memcpy( parents, m_Parents, m_NumSlots * sizeof(TUInt32) );
+		memcpy( dirty, m_Dirty, m_NumSlots );
+		memcpy( moved, m_Moved, m_NumSlots );
+	}
+	delete[] m_Parents;
+	delete[] m_Dirty;
+	delete[] m_Moved;
+	m_Parents = parents;
+	m_Dirty = dirty;
+	m_Moved = moved;
+	m_Capacity = capacity;
+}
+
+// Allocate a contiguous range of slots for the given number of nodes, returning the first slot. All nodes start as
+// roots with identity matrices, marked dirty
+TUInt32 CTransformStore::Allocate( TUInt32 numNodes )
+{
+	// Reuse a freed range of the same size if there is one, otherwise add a range at the end
+	TUInt32 first;
+	if (numNodes < m_FreeRanges.size() && !m_FreeRanges[numNodes].empty())
+	{
+		first = m_FreeRanges[numNodes].back();
+		m_FreeRanges[numNodes].pop_back();
+	}
+	else
+	{
+		first = m_NumSlots;
+		Reserve( m_NumSlots + numNodes );
+		m_NumSlots += numNodes;
+	}
+
+	for (TUInt32 slot = first; slot < first + numNodes; ++slot)
+	{
+		m_RelMatrices[slot] = CMatrix4x4::kIdentity;
+		m_Parents[slot] = NoParent;
+		m_Dirty[slot] = 1;
+		m_Moved[slot] = 0;
+	}
+	m_NewRanges.push_back( make_pair( first, numNodes ) );
+	return first;
+}
+
+// Free a range of slots previously allocated
+void CTransformStore::Free( TUInt32 firstSlot, TUInt32 numNodes )
+{
+	// Freed slots become clean roots, so the update pass skips over them
+	for (TUInt32 slot = firstSlot; slot < firstSlot + numNodes; ++slot)
+	{
+		m_Parents[slot] = NoParent;
+		m_Dirty[slot] = 0;
+	}
+
+	if (m_FreeRanges.size() <= numNodes)
+	{
+		m_FreeRanges.resize( numNodes + 1 );
+	}
+	m_FreeRanges[numNodes].push_back( firstSlot );
+}
+
+
+/////////////////////////////////////
+// Update
+
+// Recalculate the absolute matrices of dirty nodes and their descendants in one pass over the slots, starting at the
+// first dirty slot
+void CTransformStore::UpdateMatrices()
+{
+	m_NumUpdated = 0;
+	if (m_NumSlots == 0) return;
+
+	// The first dirty slot is found by scanning the flags rather than being tracked when nodes are marked, which
+	// would need every thread writing matrices to update a shared value
+	const TUInt8* firstDirty = static_cast<const TUInt8*>(memchr( m_Dirty, 1, m_NumSlots ));
+	if (!firstDirty) return;
+	TUInt32 first = static_cast<TUInt32>(firstDirty - m_Dirty);
+
+	// Parents come before their children, so a dirty parent has been recalculated (and stays marked dirty) by the
+	// time its children are reached
+	for (TUInt32 slot = first; slot < m_NumSlots; ++slot)
+	{
+		TUInt32 parent = m_Parents[slot];
+		if (parent == NoParent)
+		{
+			if (m_Dirty[slot])
+			{
+				m_Matrices[slot] = m_RelMatrices[slot];
+				m_Moved[slot] = 1;
+				++m_NumUpdated;
+			}
+		}
+		else if (m_Dirty[slot] || m_Dirty[parent])
+		{
+			m_Matrices[slot] = m_RelMatrices[slot] * m_Matrices[parent];
+			m_Dirty[slot] = 1;
+			m_Moved[slot] = 1;
+			++m_NumUpdated;
+		}
+	}
+
+	memset( &m_Dirty[first], 0, m_NumSlots - first );
+}
+
+
+/////////////////////////////////////
+// Simulation snapshots
+
+// Keep the absolute matrices from before a simulation step, call at the start of each step
+void CTransformStore::SaveMatrices()
+{
+	if (m_NumSlots > 0)
+	{
+		memcpy( static_cast<void*>(m_PrevMatrices), m_Matrices, m_NumSlots * sizeof(CMatrix4x4) );
+	}
+	m_Stepped = true;
+}
+
+// Copy the absolute matrices before and after the latest simulation step into the snapshot for rendering. Call while
+// the simulation is stopped
+void CTransformStore::TakeSnapshot()
+{
+	// Entities created since the last step have matrices not yet calculated
+	UpdateMatrices();
+	if (m_NumSlots == 0) return;
+
+	// The matrices saved at the start of the latest step become the earlier snapshot state. The simulation writes
+	// them all again at its next step, so the arrays are swapped rather than copied. With no step since the last
+	// snapshot, the earlier state is unchanged
+	if (m_Stepped)
+	{
+		swap( m_PrevMatrices, m_SnapshotPrevMatrices );
+		swap( m_PrevMatricesMemory, m_SnapshotPrevMatricesMemory );
+		m_Stepped = false;
+	}
+	memcpy( static_cast<void*>(m_SnapshotMatrices), m_Matrices, m_NumSlots * sizeof(CMatrix4x4) );
+
+	for (TUInt32 range = 0; range < m_NewRanges.size(); ++range)
+	{
+		TUInt32 first = m_NewRanges[range].first;
+		memcpy( static_cast<void*>(&m_SnapshotPrevMatrices[first]), &m_Matrices[first], m_NewRanges[range].second * sizeof(CMatrix4x4) );
+	}
+	m_NewRanges.clear();
+}
+
+// Interpolate the snapshot matrices of a range of nodes into their render matrices
+void CTransformStore::InterpolateMatrices( TUInt32 firstSlot, TUInt32 numNodes )
+{
+	for (TUInt32 slot = firstSlot; slot < firstSlot + numNodes; ++slot)
+	{
+		m_RenderMatrices[slot] = GetInterpolatedMatrix( slot );
+	}
+}
+
+// Return the interpolated matrix of a single node
+CMatrix4x4 CTransformStore::GetInterpolatedMatrix( TUInt32 slot )
+{
+	// Most nodes are still, so check for that before decomposing the matrices
+	const CMatrix4x4& previous = m_SnapshotPrevMatrices[slot];
+	const CMatrix4x4& current = m_SnapshotMatrices[slot];
+	if (memcmp( &previous, &current, sizeof(CMatrix4x4) ) == 0)
+	{
+		return current;
+	}
+
+	// Interpolate position and scale linearly and rotation with a slerp, so the matrix stays a rigid rotation
+	CQuatTransform interpolated;
+	Slerp( CQuatTransform( previous ), CQuatTransform( current ), m_Interpolation, interpolated );
+	CMatrix4x4 matrix;
+	interpolated.GetMatrix( matrix );
+	return matrix;
+}
+
+
+} // namespace gen
@@ -0,0 +1,232 @@
+/*******************************************
+	TransformStore.h
+
+	Contiguous storage of the node matrices
+	of all entities
+********************************************/
+
+#pragma once
+
+#include <string.h>
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CMatrix4x4.h"
+
+namespace gen
+{
+
+// The relative and absolute matrices of every entity node are held in a few large arrays (structure of arrays),
+// aligned for SIMD access, rather than in small arrays allocated per entity. Each entity owns a contiguous range of
+// slots holding its nodes in depth-first order, so a parent's slot always comes before its children's. All the
+// absolute matrices can then be updated in a single linear pass over the arrays. Nodes whose relative matrix is
+// written are marked dirty, and only they and their descendants are recalculated. Marking touches only the node's
+// own dirty flag, so entities may write their matrices from different threads at the same time
+//
+// The simulation and the renderer may run at the same time on different threads, so the renderer never reads the
+// matrices the simulation is writing. The absolute matrices from before and after the latest simulation step are
+// copied into a snapshot (double-buffered with the simulation's own matrices) while the simulation is stopped, and
+// the renderer draws with matrices interpolated between the two snapshot states
+class CTransformStore
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CTransformStore();
+	~CTransformStore();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CTransformStore( const CTransformStore& );
+	CTransformStore& operator=( const CTransformStore& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Slot index used for the parent of a root node
+	static const TUInt32 NoParent = 0xffffffff;
+
+	/////////////////////////////////////
+	// Allocation
+
+	// Allocate a contiguous range of slots for the given number of nodes, returning the first slot. All nodes start
+	// as roots with identity matrices, marked dirty. Pointers to matrices are invalidated by allocation
+	TUInt32 Allocate( TUInt32 numNodes );
+
+	// Free a range of slots previously allocated
+	void Free( TUInt32 firstSlot, TUInt32 numNodes );
+
+	// Set the parent of a node, which must be in an earlier slot of the same range
+	void SetParent( TUInt32 slot, TUInt32 parentSlot )
+	{
+		m_Parents[slot] = parentSlot;
+	}
+
+
+	/////////////////////////////////////
+	// Matrix access
+
+	// Relative matrix of a node, for writing - marks the node dirty
+	CMatrix4x4& RelMatrix( TUInt32 slot )
+	{
+		MarkDirty( slot );
+		return m_RelMatrices[slot];
+	}
+
+	// Relative matrix of a node, read-only
+	const CMatrix4x4& GetRelMatrix( TUInt32 slot )
+	{
+		return m_RelMatrices[slot];
+	}
+
+	// Absolute matrices of a range of nodes, valid after UpdateMatrices
+	CMatrix4x4* GetMatrices( TUInt32 firstSlot )
+	{
+		return &m_Matrices[firstSlot];
+	}
+
+	// Absolute matrix of a node in the snapshot, after the latest simulation step or before it
+	const CMatrix4x4& GetSnapshotMatrix( TUInt32 slot )
+	{
+		return m_SnapshotMatrices[slot];
+	}
+	const CMatrix4x4& GetPreviousSnapshotMatrix( TUInt32 slot )
+	{
+		return m_SnapshotPrevMatrices[slot];
+	}
+
+	// Interpolated absolute matrices of a range of nodes for rendering, valid after InterpolateMatrices
+	CMatrix4x4* GetRenderMatrices( TUInt32 firstSlot )
+	{
+		return &m_RenderMatrices[firstSlot];
+	}
+
+	// Mark a node's absolute matrix (and those of its descendants) to be recalculated
+	void MarkDirty( TUInt32 slot )
+	{
+		m_Dirty[slot] = 1;
+	}
+
+	// Return true if a node has been marked dirty since the last update
+	bool IsDirty( TUInt32 slot )
+	{
+		return m_Dirty[slot] != 0;
+	}
+
+	// Return true if a node's absolute matrix has been recalculated since the moved flags were last cleared
+	bool IsMoved( TUInt32 slot )
+	{
+		return m_Moved[slot] != 0;
+	}
+
+	// Clear the moved flags of all nodes
+	void ClearMoved()
+	{
+		memset( m_Moved, 0, m_NumSlots );
+	}
+
+
+	/////////////////////////////////////
+	// Update
+
+	// Recalculate the absolute matrices of dirty nodes and their descendants in one pass over the slots, starting at
+	// the first dirty slot, marking them moved. Must not be called while matrices are being written
+	void UpdateMatrices();
+
+
+	/////////////////////////////////////
+	// Simulation snapshots
+
+	// Keep the absolute matrices from before a simulation step, call at the start of each step (before the step's
+	// UpdateMatrices)
+	void SaveMatrices();
+
+	// Copy the absolute matrices before and after the latest simulation step into the snapshot for rendering. Call
+	// while the simulation is stopped. Nodes allocated since the last step have no earlier matrices, so are held
+	// still at their current matrices
+	void TakeSnapshot();
+
+	// Set how far to interpolate from the snapshot's matrices before the latest step (0) to those after it (1)
+	void SetInterpolation( TFloat32 interpolation )
+	{
+		m_Interpolation = interpolation;
+	}
+
+	// Interpolate the snapshot matrices of a range of nodes into their render matrices. Different ranges may be
+	// interpolated from different threads at the same time
+	void InterpolateMatrices( TUInt32 firstSlot, TUInt32 numNodes );
+
+	// Return the interpolated matrix of a single node, without writing its render matrix
+	CMatrix4x4 GetInterpolatedMatrix( TUInt32 slot );
+
+	// Number of slots in use (including freed slots not yet reused), and the number of absolute matrices
+	// recalculated by the last update
+	TUInt32 GetNumSlots()
+	{
+		return m_NumSlots;
+	}
+	TUInt32 GetNumUpdated()
+	{
+		return m_NumUpdated;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Alignment of the matrix arrays, enough for AVX (each matrix is 64 bytes so all matrices are aligned)
+	static const TUInt32 MatrixAlignment = 32;
+
+	// Make room for at least the given number of slots
+	void Reserve( TUInt32 numSlots );
+
+	// Allocate an aligned matrix array, returning the aligned pointer and the block to delete in memory
+	static CMatrix4x4* NewMatrices( TUInt32 numMatrices, TUInt8** memory );
+
+	// Replace a matrix array and its memory with a larger one holding the same matrices for the slots in use
+	void ResizeMatrices( CMatrix4x4** matrices, TUInt8** memory, TUInt32 capacity );
+
+	// Slot arrays, matrices are allocated aligned
+	CMatrix4x4* m_RelMatrices;
+	CMatrix4x4* m_Matrices;
+	TUInt32*    m_Parents;
+	TUInt8*     m_Dirty;
+	TUInt8*     m_Moved;
+	TUInt8*     m_RelMatricesMemory;
+	TUInt8*     m_MatricesMemory;
+
+	// Absolute matrices from before the current simulation step, the snapshot for rendering (after and before the
+	// latest step) and the interpolated matrices rendered. The simulation writes only the first array, the renderer
+	// reads only the others
+	CMatrix4x4* m_PrevMatrices;
+	CMatrix4x4* m_SnapshotMatrices;
+	CMatrix4x4* m_SnapshotPrevMatrices;
+	CMatrix4x4* m_RenderMatrices;
+	TUInt8*     m_PrevMatricesMemory;
+	TUInt8*     m_SnapshotMatricesMemory;
+	TUInt8*     m_SnapshotPrevMatricesMemory;
+	TUInt8*     m_RenderMatricesMemory;
+
+	TUInt32 m_NumSlots;
+	TUInt32 m_Capacity;
+	TUInt32 m_NumUpdated;
+
+	// Whether matrices have been saved by a simulation step since the last snapshot, and the interpolation between
+	// the snapshot states
+	bool     m_Stepped;
+	TFloat32 m_Interpolation;
+
+	// Ranges allocated since the last snapshot (first slot and number of nodes)
+	vector< pair<TUInt32, TUInt32> > m_NewRanges;
+
+	// First slots of freed ranges, in a free list for each range size (number of nodes). Entities of the same
+	// template free and allocate ranges of the same size, so ranges are reused without searching or splitting
+	vector< vector<TUInt32> > m_FreeRanges;
+};
+
+
+} // namespace gen
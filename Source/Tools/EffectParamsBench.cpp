@@ -0,0 +1,244 @@
+/***************************************************************************************
+	EffectParamsBench.cpp
+
+	Command line tool to check and time the effect parameter block (see EffectParams.h)
+	on the null backend. Drives the block through frames of post-process passes set up
+	the way SelectPostProcess does it: a full screen chain followed by an area post-
+	process, some values constant, some animated every frame, some switched back and
+	forth between passes. Checks each commit against a simple model of which values
+	have changed, so only those are uploaded, then times the frames. Builds without D3D,
+	e.g. on Linux:
+
+		g++ -O2 -std=c++11 -ISource/Common -ISource/Render Source/Tools/EffectParamsBench.cpp
+		    Source/Render/EffectParams.cpp -o EffectParamsBench
+
+	Usage: EffectParamsBench [number of timed frames]
+****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "EffectParams.h"
+
+using namespace gen;
+
+// Post-process parameters, as in PostProcessPoly.cpp
+enum PostProcessParams
+{
+	PPAreaTopLeftParam, PPAreaBottomRightParam, PPAreaDepthParam,
+	PPViewportWidthParam, PPViewportHeightParam,
+	TintColourParam, TintColour2Param, NoiseScaleParam, NoiseOffsetParam, DistortLevelParam, BurnLevelParam,
+	SpiralTimerParam, HeatHazeTimerParam, PixelationParam, ColourPalletParam, GaussianBlurSigmaParam,
+	DualFilterHalfPixelParam, DualFilterOffsetParam,
+	BloomThresholdParam, BloomPixelationParam, BloomIntensityParam, BloomOriginalIntensityParam, BloomSaturationParam,
+	BloomOriginalSaturationParam, GameboyPixelsParam, GameboyColourDepthParam, GameboyColourParam,
+	NumPostProcessParams
+};
+
+const SEffectParamDesc PPParamDescs[NumPostProcessParams] =
+{
+	{ "PPAreaTopLeft", 8 }, { "PPAreaBottomRight", 8 }, { "PPAreaDepth", 4 },
+	{ "PPViewportWidth", 4 }, { "PPViewportHeight", 4 },
+	{ "TintColour", 12 }, { "TintColour2", 12 }, { "NoiseScale", 8 }, { "NoiseOffset", 8 }, { "DistortLevel", 4 }, { "BurnLevel", 4 },
+	{ "SpiralTimer", 4 }, { "HeatHazeTimer", 4 }, { "Pixelation", 4 }, { "ColourPallet", 4 }, { "GaussianBlurSigma", 4 },
+	{ "DualFilterHalfPixel", 8 }, { "DualFilterOffset", 4 },
+	{ "BloomThreshold", 4 }, { "BloomPixelation", 4 }, { "BloomIntensity", 4 }, { "BloomOriginalIntensity", 4 }, { "BloomSaturation", 4 },
+	{ "BloomOriginalSaturation", 4 }, { "GameboyPixels", 4 }, { "GameboyColourDepth", 4 }, { "GameboyColour", 12 },
+};
+
+
+// Parameter block with a model of the values it should upload: the current value of each parameter and whether it
+// has changed since the last commit. Each commit's uploads are checked against the model
+class CCheckedParamBlock
+{
+public:
+	CCheckedParamBlock( bool check ) : m_Check( check ), m_NumErrors( 0 ), m_NumCommits( 0 )
+	{
+		m_Block.Initialise( &m_Backend, PPParamDescs, NumPostProcessParams );
+		for (TUInt32 param = 0; param < NumPostProcessParams; ++param)
+		{
+			m_Values.push_back( vector<TUInt8>( PPParamDescs[param].size, 0 ) );
+		}
+		m_Dirty.assign( NumPostProcessParams, true );
+	}
+
+	void SetRawValue( TUInt32 param, const void* data, TUInt32 size )
+	{
+		m_Block.SetRawValue( param, data, size );
+		if (m_Check && memcmp( &m_Values[param][0], data, size ) != 0)
+		{
+			memcpy( &m_Values[param][0], data, size );
+			m_Dirty[param] = true;
+		}
+	}
+	void SetFloat( TUInt32 param, TFloat32 value )
+	{
+		SetRawValue( param, &value, sizeof(value) );
+	}
+	void SetVector( TUInt32 param, TFloat32 x, TFloat32 y )
+	{
+		TFloat32 value[2] = { x, y };
+		SetRawValue( param, value, sizeof(value) );
+	}
+	void SetColour( TUInt32 param, TFloat32 r, TFloat32 g, TFloat32 b )
+	{
+		TFloat32 value[3] = { r, g, b };
+		SetRawValue( param, value, sizeof(value) );
+	}
+
+	// Commit the block, checking the uploads against the parameters changed since the last commit
+	void Commit( const char* pass )
+	{
+		++m_NumCommits;
+		if (!m_Check)
+		{
+			m_Block.Commit();
+			return;
+		}
+
+		TUInt32 expectedUploads = 0;
+		TUInt32 expectedBytes = 0;
+		for (TUInt32 param = 0; param < NumPostProcessParams; ++param)
+		{
+			if (m_Dirty[param])
+			{
+				++expectedUploads;
+				expectedBytes += PPParamDescs[param].size;
+				m_Dirty[param] = false;
+			}
+		}
+
+		m_Backend.ResetStats();
+		m_Block.Commit();
+		if (m_Backend.GetNumUploads() != expectedUploads || m_Backend.GetNumBytes() != expectedBytes)
+		{
+			printf( "Error: commit %d (%s) uploaded %d parameters (%d bytes), expected %d (%d bytes)\n", m_NumCommits,
+			        pass, m_Backend.GetNumUploads(), m_Backend.GetNumBytes(), expectedUploads, expectedBytes );
+			++m_NumErrors;
+		}
+	}
+
+	// Mark all parameters dirty
+	void Invalidate()
+	{
+		m_Block.Invalidate();
+		m_Dirty.assign( NumPostProcessParams, true );
+	}
+
+	CEffectParamBlock& Block()
+	{
+		return m_Block;
+	}
+	TUInt32 GetNumErrors()
+	{
+		return m_NumErrors;
+	}
+
+private:
+	CNullEffectParamBackend m_Backend;
+	CEffectParamBlock       m_Block;
+
+	bool                    m_Check;
+	vector< vector<TUInt8> > m_Values;
+	vector<bool>            m_Dirty;
+	TUInt32                 m_NumErrors;
+	TUInt32                 m_NumCommits;
+};
+
+
+// Set up and commit the passes of one frame: tint, burn, distort and bloom (with its blur) over the full screen,
+// then a gameboy post-process over the area of a moving entity
+void RenderFrame( CCheckedParamBlock* params, TUInt32 frame )
+{
+	TFloat32 time = frame / 60.0f;
+
+	// Full screen area, the same every frame but changed by the area post-process at the end of the last frame
+	params->SetVector( PPAreaTopLeftParam, 0.0f, 0.0f );
+	params->SetVector( PPAreaBottomRightParam, 1.0f, 1.0f );
+	params->SetFloat( PPAreaDepthParam, 0.0f );
+
+	params->SetColour( TintColourParam, 1.0f, 0.5f, 0.25f );
+	params->Commit( "tint" );
+
+	params->SetFloat( BurnLevelParam, fmodf( time * 0.2f, 1.0f ) );
+	params->Commit( "burn" );
+
+	params->SetVector( NoiseScaleParam, 1.0f, 1.0f );
+	params->SetVector( NoiseOffsetParam, static_cast<TFloat32>(rand()) / RAND_MAX,
+	                                     static_cast<TFloat32>(rand()) / RAND_MAX );
+	params->SetFloat( DistortLevelParam, 0.03f );
+	params->Commit( "distort" );
+
+	// Bloom blurs with its own strength, the plain blur pass sets it back
+	params->SetFloat( GaussianBlurSigmaParam, 40.0f );
+	params->SetFloat( BloomThresholdParam, 0.7f );
+	params->SetFloat( BloomPixelationParam, 256.0f );
+	params->SetFloat( BloomIntensityParam, 1.3f );
+	params->SetFloat( BloomOriginalIntensityParam, 1.0f );
+	params->SetFloat( BloomSaturationParam, 1.0f );
+	params->SetFloat( BloomOriginalSaturationParam, 1.0f );
+	params->Commit( "bloom" );
+	params->SetFloat( GaussianBlurSigmaParam, 5.0f );
+	params->Commit( "blur" );
+
+	// Area post-process around a moving entity
+	TFloat32 x = 0.5f + 0.25f * sinf( time );
+	params->SetVector( PPAreaTopLeftParam, x - 0.1f, 0.4f );
+	params->SetVector( PPAreaBottomRightParam, x + 0.1f, 0.6f );
+	params->SetFloat( PPAreaDepthParam, 0.9f + 0.01f * cosf( time ) );
+	params->SetFloat( GameboyPixelsParam, 160.0f );
+	params->SetFloat( GameboyColourDepthParam, 4.0f );
+	params->SetColour( GameboyColourParam, 0.6f, 0.7f, 0.2f );
+	params->Commit( "gameboy" );
+}
+
+int main( int argc, char* argv[] )
+{
+	int numFrames = (argc > 1) ? atoi( argv[1] ) : 100000;
+
+	// Check a few frames, including commits with nothing changed and after invalidating
+	CCheckedParamBlock params( true );
+	params.SetFloat( PPViewportWidthParam, 1280.0f );
+	params.SetFloat( PPViewportHeightParam, 720.0f );
+	params.Commit( "first" ); // Everything is uploaded the first time
+	params.Commit( "unchanged" );
+	for (TUInt32 frame = 0; frame < 100; ++frame)
+	{
+		if (frame == 50) params.Invalidate(); // E.g. after a device reset
+		RenderFrame( &params, frame );
+		params.SetFloat( PPViewportWidthParam, 1280.0f );
+		params.Commit( "unchanged" );
+	}
+	TUInt32 numErrors = params.GetNumErrors();
+
+	// Timed frames, with counts per frame
+	if (numFrames > 0)
+	{
+		CCheckedParamBlock timedParams( false );
+		RenderFrame( &timedParams, 0 );
+		timedParams.Block().ResetStats();
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (int frame = 1; frame <= numFrames; ++frame)
+		{
+			RenderFrame( &timedParams, frame );
+		}
+		chrono::duration<double, micro> time = chrono::high_resolution_clock::now() - start;
+
+		CEffectParamBlock& block = timedParams.Block();
+		printf( "Per frame: %.1f sets, %.1f changes, %.1f uploads (%.1f bytes)\n",
+		        static_cast<double>(block.GetNumSets()) / numFrames, static_cast<double>(block.GetNumChanges()) / numFrames,
+		        static_cast<double>(block.GetNumUploads()) / numFrames,
+		        static_cast<double>(block.GetNumBytesUploaded()) / numFrames );
+		printf( "%.3f us per frame (%d frames)\n", time.count() / numFrames, numFrames );
+	}
+
+	if (numErrors > 0) printf( "%d errors\n", numErrors );
+	return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+/***************************************************************************************
+	FrameBench.cpp
+
+	Command line tool to time the CPU cost of a whole frame on the null render device (see
+	RenderDeviceNull.h): culling and queueing the visible entities, rendering them, the
+	polygon post-process pass and the full screen post-processes (RenderFrame). The scene
+	is generated, 100,000 entities by default - spheres and boxes scattered in front of the
+	camera, a few large walls to occlude them and some post-processed glass boxes. Checks
+	that the frame culls and draws something and that rendering on worker threads draws
+	the same as rendering on one thread, then times frames both ways. Builds without D3D,
+	e.g. on Linux:
+
+		g++ -O2 -std=c++11 -pthread -ISource -ISource/Common -ISource/Math -ISource/Scene
+		    -ISource/Render -ISource/UI Source/Tools/FrameBench.cpp Source/PostProcessFrame.cpp
+		    Source/Scene/Camera.cpp Source/Scene/Entity.cpp Source/Scene/EntityBVH.cpp
+		    Source/Scene/EntityGrid.cpp Source/Scene/EntityManager.cpp Source/Scene/Light.cpp
+		    Source/Scene/Messenger.cpp Source/Scene/OcclusionCuller.cpp Source/Scene/PlanetEntity.cpp
+		    Source/Scene/TransformStore.cpp Source/Render/Mesh.cpp Source/Render/MeshSimplify.cpp
+		    Source/Render/RenderMethod.cpp Source/Render/RenderQueue.cpp
+		    Source/Render/RenderCommandList.cpp Source/Render/RenderDevice.cpp
+		    Source/Render/RenderDeviceNull.cpp Source/Render/EffectParams.cpp
+		    Source/Render/EffectParamsDevice.cpp Source/Render/PostProcessPreset.cpp
+		    Source/Render/ProceduralMaps.cpp Source/Math/BaseMath.cpp Source/Math/CVector3.cpp
+		    Source/Math/CVector4.cpp Source/Math/CMatrix4x4.cpp Source/Math/CQuaternion.cpp
+		    Source/Math/CQuatTransform.cpp Source/Math/CRandom.cpp Source/Common/JobSystem.cpp
+		    Source/Common/PoolAllocator.cpp Source/Common/GNUDefines.cpp
+		    Source/Common/CFatalException.cpp Source/Common/Utility.cpp Source/UI/Input.cpp
+		    -o FrameBench
+
+	Usage: FrameBench [number of entities] [number of timed frames]
+****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CRandom.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Mesh.h"
+#include "EntityManager.h"
+#include "Messenger.h"
+#include "JobSystem.h"
+#include "RenderMethod.h"
+#include "RenderDeviceNull.h"
+#include "PostProcessPoly.h"
+
+namespace gen
+{
+
+// Globals used by the scene and rendering code, defined by the application in Windows builds
+IRenderDevice* RenderDevice = NULL;
+extern const string MediaFolder = "Media/";
+extern const string ShaderFolder = "Source/Render/";
+TUInt32 BackBufferWidth = 1280;
+TUInt32 BackBufferHeight = 720;
+CEntityManager EntityManager;
+CCamera* MainCamera = NULL;
+CLight* Lights[2];
+extern const SColourRGBA AmbientColour( 0.3f, 0.3f, 0.4f, 1.0f );
+
+} // namespace gen
+
+using namespace gen;
+
+// Scene layout - the camera is at the origin looking along +Z, entities are scattered in a box in front of it
+const TFloat32 SceneWidth = 2000.0f;
+const TFloat32 SceneHeight = 200.0f;
+const TFloat32 SceneDepth = 2000.0f;
+const TUInt32  NumWalls = 8;
+const TUInt32  GlassEvery = 100; // One entity in this many is a post-processed glass box
+
+// Fewest indices drawn for an entity, every mesh has at least the triangles of a box at its lowest level of detail
+const TUInt32  BoxIndices = 36;
+
+
+// Generated geometry for a template mesh - a single node and sub-mesh with positions and normals. The vertex and face
+// data must outlive the mesh
+struct SGeneratedMesh
+{
+	vector<TFloat32>  vertices; // Position then normal for each vertex
+	vector<SMeshFace> faces;
+
+	void AddVertex( const CVector3& position, const CVector3& normal )
+	{
+		vertices.push_back( position.x ); vertices.push_back( position.y ); vertices.push_back( position.z );
+		vertices.push_back( normal.x );   vertices.push_back( normal.y );   vertices.push_back( normal.z );
+	}
+	void AddFace( TUInt32 a, TUInt32 b, TUInt32 c )
+	{
+		SMeshFace face = { { static_cast<TUInt16>(a), static_cast<TUInt16>(b), static_cast<TUInt16>(c) } };
+		faces.push_back( face );
+	}
+	TUInt32 NumVertices()
+	{
+		return static_cast<TUInt32>(vertices.size() / 6);
+	}
+};
+
+// Sphere of the given radius made of rings and segments
+void GenerateSphere( SGeneratedMesh* mesh, TFloat32 radius, TUInt32 rings, TUInt32 segments )
+{
+	for (TUInt32 ring = 0; ring <= rings; ++ring)
+	{
+		TFloat32 latitude = kfPi * ring / rings;
+		for (TUInt32 segment = 0; segment <= segments; ++segment)
+		{
+			TFloat32 longitude = 2.0f * kfPi * segment / segments;
+			CVector3 normal( Sin( latitude ) * Cos( longitude ), Cos( latitude ), Sin( latitude ) * Sin( longitude ) );
+			mesh->AddVertex( normal * radius, normal );
+		}
+	}
+	for (TUInt32 ring = 0; ring < rings; ++ring)
+	{
+		for (TUInt32 segment = 0; segment < segments; ++segment)
+		{
+			TUInt32 corner = ring * (segments + 1) + segment;
+			mesh->AddFace( corner, corner + 1, corner + segments + 1 );
+			mesh->AddFace( corner + 1, corner + segments + 2, corner + segments + 1 );
+		}
+	}
+}
+
+// Box from -size to +size, with separate vertices on each face for flat normals
+void GenerateBox( SGeneratedMesh* mesh, const CVector3& size )
+{
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		for (TInt32 side = -1; side <= 1; side += 2)
+		{
+			CVector3 normal( 0.0f, 0.0f, 0.0f );
+			normal[axis] = static_cast<TFloat32>(side);
+			CVector3 u( 0.0f, 0.0f, 0.0f ), v( 0.0f, 0.0f, 0.0f );
+			u[(axis + 1) % 3] = 1.0f;
+			v[(axis + 2) % 3] = 1.0f;
+
+			TUInt32 first = mesh->NumVertices();
+			for (TUInt32 corner = 0; corner < 4; ++corner)
+			{
+				CVector3 position = normal + ((corner & 1) ? u : -u) + ((corner & 2) ? v : -v);
+				mesh->AddVertex( CVector3( position.x * size.x, position.y * size.y, position.z * size.z ), normal );
+			}
+			if (side > 0)
+			{
+				mesh->AddFace( first, first + 1, first + 2 );
+				mesh->AddFace( first + 1, first + 3, first + 2 );
+			}
+			else
+			{
+				mesh->AddFace( first, first + 2, first + 1 );
+				mesh->AddFace( first + 1, first + 2, first + 3 );
+			}
+		}
+	}
+}
+
+// Create a mesh from generated geometry with a single material using the given render method
+CMesh* CreateMesh( SGeneratedMesh* geometry, ERenderMethod method, const SColourRGBA& colour )
+{
+	SMeshNode node;
+	node.name = "Root";
+	node.depth = 0;
+	node.parent = 0;
+	node.numChildren = 0;
+	node.positionMatrix = CMatrix4x4::kIdentity;
+	node.invMeshOffset = CMatrix4x4::kIdentity;
+
+	SMeshMaterial material;
+	material.renderMethod = method;
+	material.diffuseColour = colour;
+	material.specularColour = SColourRGBA( 1.0f, 1.0f, 1.0f, 1.0f );
+	material.specularPower = 20.0f;
+	material.numTextures = 0;
+
+	SSubMesh subMesh;
+	subMesh.node = 0;
+	subMesh.material = 0;
+	subMesh.numVertices = geometry->NumVertices();
+	subMesh.vertices = reinterpret_cast<TUInt8*>(&geometry->vertices[0]);
+	subMesh.vertexSize = 6 * sizeof(TFloat32);
+	subMesh.hasSkinningData = false;
+	subMesh.hasNormals = true;
+	subMesh.hasTangents = false;
+	subMesh.hasTextureCoords = false;
+	subMesh.hasVertexColours = false;
+	subMesh.numFaces = static_cast<TUInt32>(geometry->faces.size());
+	subMesh.faces = &geometry->faces[0];
+
+	CMesh* mesh = new CMesh();
+	if (!mesh->Create( &node, 1, &material, 1, &subMesh, 1 ))
+	{
+		delete mesh;
+		return NULL;
+	}
+	return mesh;
+}
+
+// Statistics of one frame on the null device
+struct SFrameStats
+{
+	TUInt32 numVisible;
+	TUInt32 numOccluded;
+	TUInt32 numDraws;     // All draw calls
+	TUInt32 numQuads;     // Non-indexed draws, i.e. post-process quads
+	TUInt64 numVertices;  // Indices for indexed draws, multiplied by instances
+	TUInt32 numCalls;
+};
+
+SFrameStats RenderFrameStats( CNullRenderDevice* device )
+{
+	device->ResetStats();
+	RenderFrame();
+
+	SFrameStats stats;
+	stats.numVisible = EntityManager.GetNumVisibleEntities();
+	stats.numOccluded = EntityManager.GetNumOccludedEntities();
+	stats.numQuads = device->GetNumCalls( CallDraw );
+	stats.numDraws = stats.numQuads + device->GetNumCalls( CallDrawIndexed ) + device->GetNumCalls( CallDrawIndexedInstanced );
+	stats.numVertices = device->GetNumVerticesDrawn();
+	stats.numCalls = device->GetTotalCalls();
+	return stats;
+}
+
+// Time the given number of frames, returns microseconds per frame
+double TimeFrames( int numFrames )
+{
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < numFrames; ++frame)
+	{
+		RenderFrame();
+	}
+	chrono::duration<double, micro> time = chrono::high_resolution_clock::now() - start;
+	return time.count() / Max( numFrames, 1 );
+}
+
+int main( int argc, char* argv[] )
+{
+	TUInt32 numEntities = (argc > 1) ? atoi( argv[1] ) : 100000;
+	int numFrames = (argc > 2) ? atoi( argv[2] ) : 20;
+
+	CNullRenderDevice device;
+	RenderDevice = &device;
+
+	// Render methods and post-processing, the null device accepts any effect and variable names
+	if (!InitialiseMethods() || !PostProcessSetup())
+	{
+		printf( "Error: failed to set up render methods or post-processing\n" );
+		return 1;
+	}
+
+	// Templates from generated meshes, kept until the templates are destroyed
+	SGeneratedMesh sphere, box, wall;
+	GenerateSphere( &sphere, 2.0f, 16, 32 );
+	GenerateBox( &box, CVector3( 2.0f, 2.0f, 2.0f ) );
+	GenerateBox( &wall, CVector3( 50.0f, 40.0f, 2.0f ) );
+	CMesh* ballMesh  = CreateMesh( &sphere, PixelLit, SColourRGBA( 0.8f, 0.2f, 0.2f, 1.0f ) );
+	CMesh* crateMesh = CreateMesh( &box, PlainColour, SColourRGBA( 0.6f, 0.5f, 0.3f, 1.0f ) );
+	CMesh* glassMesh = CreateMesh( &box, PPTint, SColourRGBA( 0.5f, 0.8f, 1.0f, 1.0f ) );
+	CMesh* wallMesh  = CreateMesh( &wall, PixelLit, SColourRGBA( 0.5f, 0.5f, 0.5f, 1.0f ) );
+	if (!ballMesh || !crateMesh || !glassMesh || !wallMesh)
+	{
+		printf( "Error: failed to create meshes\n" );
+		return 1;
+	}
+	EntityManager.CreateTemplate( "Ball", "Ball", ballMesh );
+	EntityManager.CreateTemplate( "Crate", "Crate", crateMesh );
+	EntityManager.CreateTemplate( "Glass", "Glass", glassMesh );
+	EntityManager.CreateTemplate( "Wall", "Wall", wallMesh )->SetOccluder( true );
+
+	// Entities, including the entity the area post-process follows
+	CRandom& random = ThreadRandom();
+	EntityManager.CreateEntity( "Crate", "Cubey", CVector3( 0.0f, 10.0f, 60.0f ) );
+	for (TUInt32 wall = 0; wall < NumWalls; ++wall)
+	{
+		TFloat32 x = (wall - 0.5f * (NumWalls - 1)) * 110.0f;
+		EntityManager.CreateEntity( "Wall", "", CVector3( x, 0.0f, 150.0f ) );
+	}
+	for (TUInt32 entity = NumWalls + 1; entity < numEntities; ++entity)
+	{
+		CVector3 position( random.GetFloat( -0.5f * SceneWidth, 0.5f * SceneWidth ),
+		                   random.GetFloat( -0.5f * SceneHeight, 0.5f * SceneHeight ),
+		                   random.GetFloat( 10.0f, SceneDepth ) );
+		CVector3 rotation( 0.0f, random.GetFloat( 0.0f, 2.0f * kfPi ), 0.0f );
+		const char* templateName = (entity % GlassEvery == 0) ? "Glass" : ((entity & 1) ? "Ball" : "Crate");
+		EntityManager.CreateEntity( templateName, "", position, rotation );
+	}
+	EntityManager.TakeSnapshot();
+
+	// Camera and lights
+	MainCamera = new CCamera( CVector3( 0.0f, 0.0f, 0.0f ), CVector3( 0.0f, 0.0f, 0.0f ) );
+	MainCamera->SetNearFarClip( 1.0f, 5000.0f );
+	Lights[0] = new CLight( CVector3( -10000.0f, 6000.0f, 0.0f ), SColourRGBA( 1.0f, 0.8f, 0.6f ) * 12000, 20000.0f );
+	Lights[1] = new CLight( CVector3( 0.0f, 30.0f, 50.0f ), SColourRGBA( 0.0f, 0.2f, 1.0f ) * 50, 100.0f );
+
+	// Check a frame on one thread, then the same frame recorded on worker threads. At least four threads, so the work
+	// is split even on machines with fewer cores
+	TUInt32 numErrors = 0;
+	RenderFrame(); // Post-process constants are all uploaded in the first frame
+	SFrameStats serial = RenderFrameStats( &device );
+	CJobSystem jobSystem( Max( thread::hardware_concurrency(), 4u ) - 1 );
+	EntityManager.SetJobSystem( &jobSystem );
+	SFrameStats parallel = RenderFrameStats( &device );
+
+	printf( "%d entities: %d visible, %d occluded, %d draw calls (%d post-process quads), %llu vertices, %d device calls\n",
+	        EntityManager.NumEntities(), serial.numVisible, serial.numOccluded, serial.numDraws, serial.numQuads,
+	        static_cast<unsigned long long>(serial.numVertices), serial.numCalls );
+	if (serial.numVisible == 0 || serial.numVisible >= EntityManager.NumEntities())
+	{
+		printf( "Error: %d of %d entities visible, expected some to be culled\n", serial.numVisible, EntityManager.NumEntities() );
+		++numErrors;
+	}
+	if (serial.numVertices < static_cast<TUInt64>(serial.numVisible) * BoxIndices)
+	{
+		printf( "Error: frame drew %llu vertices, fewer than a box (%d) for each visible entity\n",
+		        static_cast<unsigned long long>(serial.numVertices), BoxIndices );
+		++numErrors;
+	}
+	if (serial.numDraws <= serial.numQuads || serial.numQuads == 0)
+	{
+		printf( "Error: frame drew %d entity batches and %d post-process quads\n", serial.numDraws - serial.numQuads,
+		        serial.numQuads );
+		++numErrors;
+	}
+	if (parallel.numVisible != serial.numVisible || parallel.numVertices != serial.numVertices)
+	{
+		printf( "Error: worker threads drew %d entities (%llu vertices), one thread drew %d (%llu vertices)\n",
+		        parallel.numVisible, static_cast<unsigned long long>(parallel.numVertices), serial.numVisible,
+		        static_cast<unsigned long long>(serial.numVertices) );
+		++numErrors;
+	}
+
+	// Timed frames
+	if (numFrames > 0)
+	{
+		EntityManager.SetJobSystem( 0 );
+		printf( "One thread: %.3f ms per frame (%d frames)\n", TimeFrames( numFrames ) / 1000.0, numFrames );
+		EntityManager.SetJobSystem( &jobSystem );
+		printf( "%d threads: %.3f ms per frame (%d frames)\n", jobSystem.GetNumThreads(),
+		        TimeFrames( numFrames ) / 1000.0, numFrames );
+	}
+	EntityManager.SetJobSystem( 0 );
+
+	// Release everything, the mesh geometry last
+	PostProcessShutdown();
+	ReleaseMethods();
+	delete Lights[1];
+	delete Lights[0];
+	delete MainCamera;
+	EntityManager.DestroyAllEntities();
+	EntityManager.DestroyAllTemplates();
+
+	if (numErrors > 0) printf( "%d errors\n", numErrors );
+	return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/***************************************************************************************
+	OcclusionBench.cpp
+
+	Command line tool to check and time the software occlusion culler (see
+	OcclusionCuller.h) on a synthetic scene: a row of box shaped walls in front of the
+	camera with a grid of spheres on the ground around them. Prints the number of spheres
+	found hidden, checks that no sphere in front of the walls is hidden and that spheres
+	directly behind them are, then times drawing the occluders and testing the spheres.
+	Builds without D3D, e.g. on Linux:
+
+		g++ -O2 -std=c++11 -ISource/Common -ISource/Math -ISource/Scene
+		    Source/Tools/OcclusionBench.cpp Source/Scene/OcclusionCuller.cpp
+		    Source/Math/BaseMath.cpp Source/Math/CVector3.cpp Source/Math/CMatrix4x4.cpp
+		    Source/Common/GNUDefines.cpp Source/Common/CFatalException.cpp
+		    Source/Common/Utility.cpp -o OcclusionBench
+
+	Usage: OcclusionBench [number of timed frames]
+****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "OcclusionCuller.h"
+
+using namespace gen;
+
+// Scene layout - the camera is at the origin looking along +Z, the walls stand on the ground in front of it
+const TFloat32 CameraHeight = 2.0f;
+const TFloat32 FOV = 1.0f;
+const TFloat32 Aspect = 2.0f;
+const TFloat32 NearClip = 1.0f;
+const TFloat32 FarClip = 1000.0f;
+const TUInt32  NumWalls = 16;
+const TFloat32 WallDistance = 30.0f;
+const TFloat32 WallWidth = 10.0f;
+const TFloat32 WallHeight = 8.0f;
+const TFloat32 WallDepth = 1.0f;
+const TUInt32  GridSize = 100; // Spheres along each side of the grid
+const TFloat32 GridSpacing = 4.0f;
+const TFloat32 SphereRadius = 1.0f;
+
+// Perspective projection with D3D conventions (left-handed, depth 0 to 1 in clip space)
+CMatrix4x4 Projection( TFloat32 fov, TFloat32 aspect, TFloat32 nearClip, TFloat32 farClip )
+{
+	TFloat32 scaleY = 1.0f / tanf( fov * 0.5f );
+	TFloat32 scaleX = scaleY / aspect;
+	TFloat32 scaleZ = farClip / (farClip - nearClip);
+	return CMatrix4x4( scaleX, 0.0f,   0.0f,               0.0f,
+	                   0.0f,   scaleY, 0.0f,               0.0f,
+	                   0.0f,   0.0f,   scaleZ,             1.0f,
+	                   0.0f,   0.0f,   -nearClip * scaleZ, 0.0f );
+}
+
+int main( int argc, char* argv[] )
+{
+	int numFrames = (argc > 1) ? atoi( argv[1] ) : 100;
+
+	// View matrix moves the camera to the origin
+	CMatrix4x4 viewProj = MatrixTranslation( CVector3( 0.0f, -CameraHeight, 0.0f ) ) *
+	                      Projection( FOV, Aspect, NearClip, FarClip );
+
+	// Unit cube from (0,0,0) to (1,1,1), each wall is a scaled and translated cube
+	CVector3 cubeVertices[8];
+	for (TUInt32 corner = 0; corner < 8; ++corner)
+	{
+		cubeVertices[corner] = CVector3( (corner & 1) ? 1.0f : 0.0f, (corner & 2) ? 1.0f : 0.0f, (corner & 4) ? 1.0f : 0.0f );
+	}
+	const TUInt16 cubeIndices[36] = { 0,2,1, 1,2,3, 4,5,6, 5,7,6, 0,1,4, 1,5,4, 2,6,3, 3,6,7, 0,4,2, 2,4,6, 1,3,5, 3,7,5 };
+	vector<CMatrix4x4> walls;
+	TFloat32 wallsLeft = -0.5f * NumWalls * WallWidth;
+	for (TUInt32 wall = 0; wall < NumWalls; ++wall)
+	{
+		walls.push_back( MatrixScaling( CVector3( WallWidth, WallHeight, WallDepth ) ) *
+		                 MatrixTranslation( CVector3( wallsLeft + wall * WallWidth, 0.0f, WallDistance ) ) );
+	}
+
+	// Grid of spheres resting on the ground, centred across the camera's view
+	vector<CVector3> spheres;
+	for (TUInt32 row = 0; row < GridSize; ++row)
+	{
+		for (TUInt32 column = 0; column < GridSize; ++column)
+		{
+			spheres.push_back( CVector3( (column - 0.5f * GridSize) * GridSpacing, SphereRadius,
+			                             NearClip + SphereRadius + row * GridSpacing ) );
+		}
+	}
+
+	COcclusionCuller culler;
+	vector<bool> visible( spheres.size() );
+	auto cullFrame = [&]()
+	{
+		culler.Begin( viewProj );
+		for (TUInt32 wall = 0; wall < walls.size(); ++wall)
+		{
+			culler.RasterizeTriangles( reinterpret_cast<const TUInt8*>(cubeVertices), sizeof(CVector3), cubeIndices, 12,
+			                           walls[wall] );
+		}
+		culler.End();
+		for (TUInt32 sphere = 0; sphere < spheres.size(); ++sphere)
+		{
+			visible[sphere] = culler.IsSphereVisible( spheres[sphere], SphereRadius );
+		}
+	};
+
+	// Check one frame. Spheres in front of the walls must be visible, spheres well behind them (below the top of the
+	// walls as seen from the camera, within their width) must be hidden
+	cullFrame();
+	TUInt32 numErrors = 0;
+	TUInt32 numBehind = 0;
+	for (TUInt32 sphere = 0; sphere < spheres.size(); ++sphere)
+	{
+		const CVector3& centre = spheres[sphere];
+		if (centre.z + SphereRadius < WallDistance && !visible[sphere])
+		{
+			printf( "Error: sphere at (%.1f, %.1f, %.1f) in front of the walls is hidden\n", centre.x, centre.y, centre.z );
+			++numErrors;
+		}
+
+		// Also within the view, spheres off the screen are left to frustum culling
+		TFloat32 scale = WallDistance / (centre.z - SphereRadius);
+		bool behind = centre.z - SphereRadius > WallDistance + WallDepth &&
+		              (centre.y + SphereRadius - CameraHeight) * scale < WallHeight - CameraHeight - 1.0f &&
+		              (Abs( centre.x ) + SphereRadius) * scale < -wallsLeft - 1.0f &&
+		              Abs( centre.x ) + SphereRadius < 0.9f * Aspect * tanf( FOV * 0.5f ) * (centre.z - SphereRadius);
+		if (behind)
+		{
+			++numBehind;
+			if (visible[sphere])
+			{
+				printf( "Error: sphere at (%.1f, %.1f, %.1f) behind the walls is visible\n", centre.x, centre.y, centre.z );
+				++numErrors;
+			}
+		}
+	}
+	printf( "%dx%d depth buffer, %d triangles rasterized, %d of %d spheres hidden (%d well behind the walls)\n",
+	        culler.GetWidth(), culler.GetHeight(), culler.GetNumTrianglesRasterized(), culler.GetNumHidden(),
+	        culler.GetNumTests(), numBehind );
+
+	// Timed frames
+	if (numFrames > 0)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			cullFrame();
+		}
+		chrono::duration<double, milli> time = chrono::high_resolution_clock::now() - start;
+		printf( "%.3f ms per frame (%d frames)\n", time.count() / numFrames, numFrames );
+	}
+
+	return (numErrors > 0) ? 1 : 0;
+}
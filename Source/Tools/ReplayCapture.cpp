@@ -0,0 +1,81 @@
+/***************************************************************************************
+	ReplayCapture.cpp
+
+	Command line tool to replay a frame capture (see RenderCapture.h) on the null render
+	device. Prints the calls made by the frame, one per line so the output of two builds
+	can be diffed, then optionally times repeated replays of the frame. Builds without D3D,
+	e.g. on Linux:
+
+		g++ -O2 -std=c++11 -ISource/Common -ISource/Render Source/Tools/ReplayCapture.cpp
+		    Source/Render/RenderCapture.cpp Source/Render/RenderDevice.cpp
+		    Source/Render/RenderDeviceNull.cpp -o ReplayCapture
+
+	Usage: ReplayCapture <capture file> [number of timed replays]
+****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+using namespace std;
+
+#include "Defines.h"
+#include "RenderCapture.h"
+#include "RenderDeviceNull.h"
+
+using namespace gen;
+
+int main( int argc, char* argv[] )
+{
+	if (argc < 2)
+	{
+		printf( "Usage: %s <capture file> [number of timed replays]\n", argv[0] );
+		return 1;
+	}
+	int numReplays = (argc > 2) ? atoi( argv[2] ) : 0;
+
+	CRenderCaptureReplay replay;
+	if (!replay.Load( argv[1] ))
+	{
+		printf( "Error loading capture %s\n", argv[1] );
+		return 1;
+	}
+
+	CNullRenderDevice device;
+	if (!replay.CreateObjects( &device ))
+	{
+		printf( "Error creating objects from capture %s\n", argv[1] );
+		return 1;
+	}
+
+	// Single frame, with the statistics for that frame only
+	device.ResetStats();
+	if (!replay.ReplayFrame())
+	{
+		printf( "Error replaying capture %s\n", argv[1] );
+		return 1;
+	}
+	for (int call = 0; call < NumRenderDeviceCalls; ++call)
+	{
+		if (device.GetNumCalls( static_cast<ERenderDeviceCall>(call) ))
+		{
+			printf( "%s %u\n", RenderDeviceCallNames[call], device.GetNumCalls( static_cast<ERenderDeviceCall>(call) ) );
+		}
+	}
+	printf( "Calls %u\n", device.GetTotalCalls() );
+	printf( "Bytes %llu\n", device.GetNumBytes() );
+	printf( "Vertices %llu\n", device.GetNumVerticesDrawn() );
+
+	// Timed replays, to benchmark submission of a real frame
+	if (numReplays > 0)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (int i = 0; i < numReplays; ++i)
+		{
+			replay.ReplayFrame();
+		}
+		chrono::duration<double, milli> time = chrono::high_resolution_clock::now() - start;
+		printf( "Replay %.4f ms/frame over %d frames\n", time.count() / numReplays, numReplays );
+	}
+
+	return 0;
+}